@@ -40,6 +40,18 @@ namespace extras {namespace ParticleTracking {
 	 *		roiList
 	 *		xyMethod
 	 *		COMmethod
+	 *		GradientCache
+	 *		IntegralImage
+	 *		WindowOrder
+	 *		ImageLayout
+	 *		WeightKernelCache
+	 *		RefineIterations
+	 *		RefineTolerance
+	 *		RejectMethod
+	 *		RejectThreshold
+	 *		FitStatistics
+	 *		PyramidLevels
+	 *		PyramidWindow
 	 *		DistanceFactor
 	 *		LimFrac
 	 *
@@ -76,6 +88,42 @@ namespace extras {namespace ParticleTracking {
 			(*this)["COMmethod"] = value;
 		}
 
+		void set_GradientCache(const cmex::MxObject& value) {
+			if (!value.ischar()) {
+				throw("GradientCache must be a char specifying valid mode ('none','shared','auto')");
+			}
+			GradientCache = string2GradientCache(cmex::getstring(value));
+
+			(*this)["GradientCache"] = value;
+		}
+
+		void set_IntegralImage(const cmex::MxObject& value) {
+			if (!value.ischar()) {
+				throw("IntegralImage must be a char specifying valid mode ('none','shared','auto')");
+			}
+			IntegralImage = string2IntegralImage(cmex::getstring(value));
+
+			(*this)["IntegralImage"] = value;
+		}
+
+		void set_WindowOrder(const cmex::MxObject& value) {
+			if (!value.ischar()) {
+				throw("WindowOrder must be a char specifying valid order ('morton','input')");
+			}
+			WindowOrder = string2WindowOrder(cmex::getstring(value));
+
+			(*this)["WindowOrder"] = value;
+		}
+
+		void set_ImageLayout(const cmex::MxObject& value) {
+			if (!value.ischar()) {
+				throw("ImageLayout must be a char specifying valid layout ('column','row')");
+			}
+			ImageLayout = string2ImageLayout(cmex::getstring(value));
+
+			(*this)["ImageLayout"] = value;
+		}
+
 		void set_DistanceExponent(const cmex::MxObject& value) {
 			if (!value.isnumeric()) {
 				throw("DistanceExponent must be numeric");
@@ -120,6 +168,101 @@ namespace extras {namespace ParticleTracking {
 			(*this)["CutoffFactor"] = value;
 		}
 
+		void set_WeightKernelCache(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("WeightKernelCache must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 0)) {
+				throw("WeightKernelCache must be >=0");
+			}
+			WeightKernelCache = (size_t)val;
+			(*this)["WeightKernelCache"] = value;
+		}
+
+		void set_RefineIterations(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("RefineIterations must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 0)) {
+				throw("RefineIterations must be >=0");
+			}
+			RefineIterations = (size_t)val;
+			(*this)["RefineIterations"] = value;
+		}
+
+		void set_RefineTolerance(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("RefineTolerance must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 0)) {
+				throw("RefineTolerance must be >=0");
+			}
+			RefineTolerance = val;
+			(*this)["RefineTolerance"] = value;
+		}
+
+		void set_RejectMethod(const cmex::MxObject& value) {
+			if (!value.ischar()) {
+				throw("RejectMethod must be a char specifying valid method ('none','contrast','gradient')");
+			}
+			RejectMethod = string2RejectMethod(cmex::getstring(value));
+
+			(*this)["RejectMethod"] = value;
+		}
+
+		void set_RejectThreshold(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("RejectThreshold must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 0)) {
+				throw("RejectThreshold must be >=0");
+			}
+			RejectThreshold = val;
+			(*this)["RejectThreshold"] = value;
+		}
+
+		void set_FitStatistics(const cmex::MxObject& value) {
+			if (value.numel() != 1 || !(value.isnumeric() || mxIsLogical(value))) {
+				throw("FitStatistics must be scalar logical");
+			}
+			// without the fit statistics (varXY, RWR_N) radialcenter() skips accumulating the residual
+			if (mxGetScalar(value) != 0) {
+				OutputMask = rcdefs::OUTPUT_ALL;
+			}
+			else {
+				OutputMask = rcdefs::OUTPUT_STATUS;
+			}
+			(*this)["FitStatistics"] = value;
+		}
+
+		void set_PyramidLevels(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("PyramidLevels must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 0 && val <= 16)) {
+				throw("PyramidLevels must be between 0 and 16");
+			}
+			PyramidLevels = (size_t)val;
+			(*this)["PyramidLevels"] = value;
+		}
+
+		void set_PyramidWindow(const cmex::MxObject& value) {
+			if (!value.isnumeric() || value.numel() != 1) {
+				throw("PyramidWindow must be scalar numeric");
+			}
+			double val = mxGetScalar(value);
+			if (!(val >= 4)) {
+				throw("PyramidWindow must be >=4");
+			}
+			PyramidWindow = (size_t)val;
+			(*this)["PyramidWindow"] = value;
+		}
+
 		void set_LimFrac(const cmex::MxObject& value) {
 			if (!value.isnumeric()) {
 				throw("LimFrac must be numeric");
@@ -327,6 +470,42 @@ namespace extras {namespace ParticleTracking {
 			else if (strcmpi("COMmethod", field.c_str()) == 0) {
 				set_COMmethod(mxa);
 			}
+			else if (strcmpi("GradientCache", field.c_str()) == 0) {
+				set_GradientCache(mxa);
+			}
+			else if (strcmpi("IntegralImage", field.c_str()) == 0) {
+				set_IntegralImage(mxa);
+			}
+			else if (strcmpi("WindowOrder", field.c_str()) == 0) {
+				set_WindowOrder(mxa);
+			}
+			else if (strcmpi("ImageLayout", field.c_str()) == 0) {
+				set_ImageLayout(mxa);
+			}
+			else if (strcmpi("WeightKernelCache", field.c_str()) == 0) {
+				set_WeightKernelCache(mxa);
+			}
+			else if (strcmpi("RefineIterations", field.c_str()) == 0) {
+				set_RefineIterations(mxa);
+			}
+			else if (strcmpi("RefineTolerance", field.c_str()) == 0) {
+				set_RefineTolerance(mxa);
+			}
+			else if (strcmpi("RejectMethod", field.c_str()) == 0) {
+				set_RejectMethod(mxa);
+			}
+			else if (strcmpi("RejectThreshold", field.c_str()) == 0) {
+				set_RejectThreshold(mxa);
+			}
+			else if (strcmpi("FitStatistics", field.c_str()) == 0) {
+				set_FitStatistics(mxa);
+			}
+			else if (strcmpi("PyramidLevels", field.c_str()) == 0) {
+				set_PyramidLevels(mxa);
+			}
+			else if (strcmpi("PyramidWindow", field.c_str()) == 0) {
+				set_PyramidWindow(mxa);
+			}
 			else if (strcmpi("DistanceExponent", field.c_str()) == 0) {
 				set_DistanceExponent(mxa);
 			}
@@ -358,6 +537,18 @@ namespace extras {namespace ParticleTracking {
 		* Automatically adds fields:
 		*	'xyMethod'
 		*	'COMmethod'
+		*	'GradientCache'
+		*	'IntegralImage'
+		*	'WindowOrder'
+		*	'ImageLayout'
+		*	'WeightKernelCache'
+		*	'RefineIterations'
+		*	'RefineTolerance'
+		*	'RejectMethod'
+		*	'RejectThreshold'
+		*	'FitStatistics'
+		*	'PyramidLevels'
+		*	'PyramidWindow'
 		*	'DistanceFactor'
 		*	'LimFrac'
 		*	'roiList'
@@ -366,6 +557,18 @@ namespace extras {namespace ParticleTracking {
 			/// Add MAP Defaults
 			extras::cmex::ParameterMxMap::operator[]("xyMethod").takeOwnership(cmex::MxObject("radialcenter"));
 			extras::cmex::ParameterMxMap::operator[]("COMmethod").takeOwnership(cmex::MxObject("gradmag"));
+			extras::cmex::ParameterMxMap::operator[]("GradientCache").takeOwnership(cmex::MxObject("none"));
+			extras::cmex::ParameterMxMap::operator[]("IntegralImage").takeOwnership(cmex::MxObject("none"));
+			extras::cmex::ParameterMxMap::operator[]("WindowOrder").takeOwnership(cmex::MxObject("morton"));
+			extras::cmex::ParameterMxMap::operator[]("ImageLayout").takeOwnership(cmex::MxObject("column"));
+			extras::cmex::ParameterMxMap::operator[]("WeightKernelCache").takeOwnership(mxCreateDoubleScalar(0));
+			extras::cmex::ParameterMxMap::operator[]("RefineIterations").takeOwnership(mxCreateDoubleScalar(0));
+			extras::cmex::ParameterMxMap::operator[]("RefineTolerance").takeOwnership(mxCreateDoubleScalar(0.001));
+			extras::cmex::ParameterMxMap::operator[]("RejectMethod").takeOwnership(cmex::MxObject("none"));
+			extras::cmex::ParameterMxMap::operator[]("RejectThreshold").takeOwnership(mxCreateDoubleScalar(0));
+			extras::cmex::ParameterMxMap::operator[]("FitStatistics").takeOwnership(mxCreateLogicalScalar(true));
+			extras::cmex::ParameterMxMap::operator[]("PyramidLevels").takeOwnership(mxCreateDoubleScalar(0));
+			extras::cmex::ParameterMxMap::operator[]("PyramidWindow").takeOwnership(mxCreateDoubleScalar(32));
 			extras::cmex::ParameterMxMap::operator[]("DistanceExponent").takeOwnership(mxCreateDoubleScalar(default_DistanceExponent));
 			extras::cmex::ParameterMxMap::operator[]("GradientExponent").takeOwnership(mxCreateDoubleScalar(default_GradientExponent));
 			extras::cmex::ParameterMxMap::operator[]("RadiusCutoff").takeOwnership(mxCreateDoubleScalar(default_RadiusCutoff));
@@ -29,6 +29,18 @@ namespace extras { namespace ParticleTracking {
 	 *		'roiList',mex struct array containing "Window" field
 	 *		'xyMethod','radialcenter' or 'barycenter' specifying which tracking routine to use
 	 *		'COMmethod','meanabs','normal','gradmag' specifying what type of processing should be applied to the image before processing via radialcenter()
+	 *		'GradientCache','none','shared','auto' whether radialcenter() computes the gradient once for all ROIs
+	 *		'IntegralImage','none','shared','auto' whether radialcenter() finds the center of mass of all ROIs from one integral image
+	 *		'WindowOrder','morton','input' order in which radialcenter() processes the ROIs (results keep the ROI order)
+	 *		'ImageLayout','column','row' memory layout of the frames ('row': frames are row-major camera buffers, tracked without transposing)
+	 *		'WeightKernelCache',Q: sub-pixel steps of the cached radialcenter() weight kernels (0=no cache)
+	 *		'RefineIterations',N: refinement passes of radialcenter() with windows shrunk around the previous solution
+	 *		'RefineTolerance',tol: radialcenter() stops refining once the center moves less than tol px
+	 *		'RejectMethod','none','contrast','gradient' check radialcenter() uses to skip ROIs that lost their particle
+	 *		'RejectThreshold',val: ROIs with contrast (or RMS gradient) below val are skipped (X,Y are NaN, Status gives the reason)
+	 *		'FitStatistics',true/false: compute varXY and RWR_N (false skips radialcenter()'s residual accumulation, the fields are NaN)
+	 *		'PyramidLevels',L: radialcenter() locates large ROIs on a 2^L binned copy before the full-resolution fit (0=off)
+	 *		'PyramidWindow',w: size (px) of the full-resolution window fit around the binned center
 	 *		'DistanceFactor',val: distance factor used by radialcenter()
 	 *		'LimFrac',val: Limit Fraction used by barycenter()
 	 *
@@ -48,6 +60,11 @@ namespace extras { namespace ParticleTracking {
 
 		std::atomic_bool _IncludeImageInResults = false;
 
+		//! working memory reused by radialcenter() for every frame
+		//! ProcessTask() is only called by the processing thread, so a single workspace
+		//! (holding buffers for each of radialcenter's worker threads) is sufficient
+		RadialcenterWorkspace<double> _rcWorkspace;
+
 		//! Define ProcessTask method
 		extras::cmex::mxArrayGroup ProcessTask(const extras::cmex::mxArrayGroup& TaskArgs, std::shared_ptr<const extras::cmex::ParameterMxMap> Params) {
 			using namespace extras::cmex;
@@ -100,7 +117,8 @@ namespace extras { namespace ParticleTracking {
 			{
 				auto rcOut = radialcenter<extras::Array<double>>(
 									cmex::DynamicTypeMxArray(img,true), //image converted to DynamicMxArray
-									*ParamMap //parameters
+									*ParamMap, //parameters
+									&_rcWorkspace //reused working memory
 							);
 
 				rcOut[0] += 1; //shift for 1-indexing
@@ -109,17 +127,18 @@ namespace extras { namespace ParticleTracking {
 							   //set field values
 				for (size_t n = 0; n < ParamMap->WIND->nRows(); ++n) {
 
-					MxStruct CentroidResult(1, { "X","Y","varXY","RWR_N","xyMethod" });
+					MxStruct CentroidResult(1, { "X","Y","varXY","RWR_N","Status","xyMethod" });
 
 					CentroidResult(0, "X") = rcOut[0][n];
 					CentroidResult(0, "Y") = rcOut[1][n];
 
 					NumericArray<double> vxy(2, 1);
-					vxy(0) = rcOut[2](n, 0);
-					vxy(1) = rcOut[2](n, 1);
+					vxy(0) = rcOut[2].isempty() ? NAN : rcOut[2](n, 0);
+					vxy(1) = rcOut[2].isempty() ? NAN : rcOut[2](n, 1);
 					CentroidResult(0, "varXY") = vxy;
 
-					CentroidResult(0, "RWR_N") = rcOut[3][n];
+					CentroidResult(0, "RWR_N") = rcOut[3].isempty() ? NAN : rcOut[3][n];
+					CentroidResult(0, "Status") = rcOut[4][n];
 					CentroidResult(0, "xyMethod") = "radialcenter";
 
 					roiList(n, "CentroidResult") = CentroidResult.releaseArray();
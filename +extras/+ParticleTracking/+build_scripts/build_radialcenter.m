@@ -9,6 +9,17 @@ src = fullfile(OUTDIR,'radialcenter','source','radialcenter.cpp'); %SOURCE FILE
 %% Construct Args
 ArgsStruct = extras.mex_builds.DefaultMexArgStruct();
 
+% Enable AVX2 so that the vectorized gradient kernel is used.
+% Set to false if the mex needs to run on processors without AVX2
+USE_AVX2 = true;
+if USE_AVX2
+    if ispc
+        ArgsStruct.CompilerOptions = [ArgsStruct.CompilerOptions,{' /arch:AVX2'}];
+    else
+        ArgsStruct.CompilerOptions = [ArgsStruct.CompilerOptions,{' -mavx2'}];
+    end
+end
+
 %% BUILD
 [CA,AS] = extras.mex_builds.ArgStruct2Args(ArgsStruct);
 
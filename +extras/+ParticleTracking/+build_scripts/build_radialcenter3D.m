@@ -0,0 +1,31 @@
+% Build Radial Center 3D
+
+[THIS_PATH,~,~] =  fileparts(mfilename('fullpath'));
+OUTNAME = 'radialcenter3D'; %output function name
+OUTDIR = fullfile(THIS_PATH,'..'); %output to .../+extras/+ParticleTracking
+
+src = fullfile(OUTDIR,'radialcenter','source','radialcenter3D.cpp'); %SOURCE FILE NAME
+
+%% Construct Args
+ArgsStruct = extras.mex_builds.DefaultMexArgStruct();
+
+% Enable AVX2 so that the per-voxel loops can be vectorized.
+% Set to false if the mex needs to run on processors without AVX2
+USE_AVX2 = true;
+if USE_AVX2
+    if ispc
+        ArgsStruct.CompilerOptions = [ArgsStruct.CompilerOptions,{' /arch:AVX2'}];
+    else
+        ArgsStruct.CompilerOptions = [ArgsStruct.CompilerOptions,{' -mavx2'}];
+    end
+end
+
+%% BUILD
+[CA,AS] = extras.mex_builds.ArgStruct2Args(ArgsStruct);
+
+mex('-v',CA{:},...
+    '-outdir',OUTDIR,...
+    '-output',OUTNAME,...
+    AS{:},...
+    src);
+
@@ -0,0 +1,69 @@
+function [I,Xc,Yc,WIND] = make_ring_test_image(varargin)
+% Synthetic image of rings used by the radialcenter test scripts
+%
+%   [I,Xc,Yc,WIND] = make_ring_test_image()
+% Outputs:
+%   I: 250 x 500 image with a 2 x 5 grid of rings, each moved randomly by up to +/-7.5 px
+%   Xc,Yc: [10 x 1] centers of the rings
+%   WIND: [10 x 4] window around each ring, [x,y,w,h]
+%
+% Name,Value Parameters:
+%   'nFrames',n: I is a [250 x 500 x n] stack. The rings are centered on the regular grid
+%       (Xc,Yc) and move by up to +/-2 px from frame to frame. (default 1)
+%   'Missing',tf: [10 x 1] logical, rings that are not drawn (their windows are empty)
+%   'Noise',s: standard deviation of gaussian noise added to the image (default 0)
+
+p = inputParser;
+p.CaseSensitive = false;
+
+addParameter(p,'nFrames',1,@(x) isnumeric(x)&&isscalar(x)&&x>=1);
+addParameter(p,'Missing',[],@(x) isempty(x)||islogical(x));
+addParameter(p,'Noise',0,@(x) isnumeric(x)&&isscalar(x));
+
+parse(p,varargin{:});
+nFrames = p.Results.nFrames;
+
+Nx = 5;
+Ny = 2;
+WIDTH = 500;
+HEIGHT = 250;
+
+Rfn = @(r) (0.5+r-r.^3).*sinc(r/5).*(1./(1+exp(r-(WIDTH/(Nx+1)*0.4))));
+
+Xc = (1:Nx)*WIDTH/(Nx+1);
+Yc = (1:Ny)*HEIGHT/(Ny+1);
+
+[Xc,Yc] = meshgrid(Xc,Yc);
+
+if nFrames==1
+    Xc = Xc + 15*(rand(size(Xc))-0.5);
+    Yc = Yc + 15*(rand(size(Yc))-0.5);
+end
+Xc = reshape(Xc,[],1);
+Yc = reshape(Yc,[],1);
+
+drawn = true(size(Xc));
+if ~isempty(p.Results.Missing)
+    drawn = ~p.Results.Missing(:);
+end
+
+[xx,yy] = meshgrid(1:WIDTH,1:HEIGHT);
+
+I = zeros(HEIGHT,WIDTH,nFrames);
+for f = 1:nFrames
+    Xf = Xc;
+    Yf = Yc;
+    if nFrames>1 % particles drift a little between frames
+        Xf = Xf + 4*(rand(size(Xc))-0.5);
+        Yf = Yf + 4*(rand(size(Yc))-0.5);
+    end
+    for n = find(drawn)'
+        rr = sqrt( (xx-Xf(n)).^2 + (yy-Yf(n)).^2);
+        I(:,:,f) = I(:,:,f) + Rfn(rr);
+    end
+end
+if p.Results.Noise>0
+    I = I + p.Results.Noise*randn(size(I));
+end
+
+WIND = [Xc,Yc,zeros(size(Xc)),zeros(size(Yc))] + [-WIDTH/(Nx+1)*0.4,-WIDTH/(Nx+1)*0.4,WIDTH/(Nx+1)*0.8,WIDTH/(Nx+1)*0.8];
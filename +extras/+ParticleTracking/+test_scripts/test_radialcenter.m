@@ -74,5 +74,11 @@ Ityp = cast(double(intmax(typename))*mat2gray(I),typename);
 plot(X,Y,'og','DisplayName','From Guess2 with RF, typecast and GradExp=3');
 %plot(XYc(:,1),XYc(:,2),'om');
 
+%% Test multi-threaded windows give identical results
+[X1,Y1,varXY1,d21] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',20,'nThreads',1);
+[Xn,Yn,varXYn,d2n] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',20,'nThreads',0);
+assert(isequaln(X1,Xn) && isequaln(Y1,Yn) && isequaln(varXY1,varXYn) && isequaln(d21,d2n),...
+    'radialcenter: multi-threaded result differs from single-threaded result');
+
 %% END
 legend show
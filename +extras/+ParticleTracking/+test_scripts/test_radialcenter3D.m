@@ -0,0 +1,71 @@
+% Test extras.ParticleTracking.radialcenter3D on a volume of synthetic beads
+% and check that the result does not depend on the number of threads
+
+%% Generate Test Volume
+Nx = 3;
+Ny = 2;
+Nz = 1;
+WIDTH = 120;
+HEIGHT = 80;
+DEPTH = 60;
+R = 12; % bead radius
+
+Rfn = @(r) (0.5+r-r.^3/R^2).*exp(-r.^2/(2*(R/3)^2));
+
+[Xc,Yc,Zc] = meshgrid((1:Nx)*WIDTH/(Nx+1),(1:Ny)*HEIGHT/(Ny+1),(1:Nz)*DEPTH/(Nz+1));
+
+Xc = reshape(Xc,[],1) + 6*(rand(numel(Xc),1)-0.5);
+Yc = reshape(Yc,[],1) + 6*(rand(numel(Yc),1)-0.5);
+Zc = reshape(Zc,[],1) + 6*(rand(numel(Zc),1)-0.5);
+
+V = zeros(HEIGHT,WIDTH,DEPTH);
+
+[xx,yy,zz] = meshgrid(1:WIDTH,1:HEIGHT,1:DEPTH);
+
+for n = 1:numel(Xc)
+    rr = sqrt( (xx-Xc(n)).^2 + (yy-Yc(n)).^2 + (zz-Zc(n)).^2);
+    V = V + Rfn(rr);
+end
+
+% boxes of size 2R around each bead (not centered on the bead)
+WIND = [round([Xc,Yc,Zc]) - R + randi([-2,2],numel(Xc),3), repmat(2*R,numel(Xc),3)];
+
+%% Find centers
+[X,Y,Z,VarXYZ,D,S] = extras.ParticleTracking.radialcenter3D(V,WIND,'RadiusCutoff',R);
+err = [X-Xc,Y-Yc,Z-Zc];
+fprintf('radialcenter3D: max error %g voxel\n',max(abs(err(:))));
+assert(all(abs(err(:))<0.05),'radialcenter3D: center error is too large');
+assert(all(S==0),'radialcenter3D: status must be 0 for boxes that were fit');
+assert(isequal(size(VarXYZ),[numel(Xc),3])&&all(VarXYZ(:)>=0)&&all(D>=0),'radialcenter3D: invalid varXYZ or d2');
+
+%% Threads and requested outputs
+[X2,Y2,Z2,V2,D2] = extras.ParticleTracking.radialcenter3D(V,WIND,'RadiusCutoff',R,'nThreads',4);
+assert(isequal(X,X2)&&isequal(Y,Y2)&&isequal(Z,Z2)&&isequal(VarXYZ,V2)&&isequal(D,D2),'radialcenter3D: result depends on nThreads');
+
+[X3,Y3,Z3] = extras.ParticleTracking.radialcenter3D(V,WIND,'RadiusCutoff',R);
+assert(isequal(X,X3)&&isequal(Y,Y3)&&isequal(Z,Z3),'radialcenter3D: [x,y,z] output differs from [x,y,z,varXYZ,d2,status]');
+
+%% Center estimates instead of boxes
+[X4,Y4,Z4] = extras.ParticleTracking.radialcenter3D(V,'XYZc',round([Xc,Yc,Zc]),'RadiusCutoff',R);
+err = [X4-Xc,Y4-Yc,Z4-Zc];
+assert(all(abs(err(:))<0.05),'radialcenter3D: center error is too large (XYZc)');
+
+%% Single precision and integer volume
+V16 = uint16(60000*mat2gray(V));
+[X5,Y5,Z5] = extras.ParticleTracking.radialcenter3D(V16,WIND,'RadiusCutoff',R,'Precision','single');
+err = [X5-Xc,Y5-Yc,Z5-Zc];
+assert(all(abs(err(:))<0.05),'radialcenter3D: center error is too large (uint16, single precision)');
+
+%% Single precision with a large range of voxel values
+% the gradient weights |g|^GradientExponent are out of the range of float unless they are scaled
+V32 = int32(2e9*mat2gray(V));
+[Xd,Yd,Zd] = extras.ParticleTracking.radialcenter3D(V32,WIND,'RadiusCutoff',R,'GradientExponent',9,'Precision','double');
+[Xs,Ys,Zs,~,~,Ss] = extras.ParticleTracking.radialcenter3D(V32,WIND,'RadiusCutoff',R,'GradientExponent',9,'Precision','single');
+err = max(abs([Xd-Xs;Yd-Ys;Zd-Zs]));
+fprintf('radialcenter3D: max difference between single and double precision (int32): %g voxel\n',err);
+assert(err<=1e-3,'radialcenter3D: single precision result disagrees with double precision (int32, GradientExponent=9)');
+assert(all(Ss==0),'radialcenter3D: status must be 0 for boxes that were fit (int32, single precision)');
+
+%% Degenerate box
+[~,~,~,~,~,S6] = extras.ParticleTracking.radialcenter3D(V,[1,1,1,1,10,10]);
+assert(S6==3,'radialcenter3D: box with a single column must fail');
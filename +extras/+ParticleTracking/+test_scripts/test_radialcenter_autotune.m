@@ -0,0 +1,55 @@
+% Test extras.ParticleTracking.radialcenter_autotune on a stack of stuck beads
+% with camera noise and a slow stage drift
+
+%% Generate Test Stack
+nFrames = 20;
+WIDTH = 300;
+HEIGHT = 200;
+
+Rfn = @(r) 100*cos(r/2.5).*exp(-r/15);
+
+Xc = [60;140;220;100];
+Yc = [50;60;140;150];
+
+[xx,yy] = meshgrid(1:WIDTH,1:HEIGHT);
+
+I = zeros(HEIGHT,WIDTH,nFrames);
+for f=1:nFrames
+    drift = 0.3*f/nFrames; % common motion of all beads
+    for n = 1:numel(Xc)
+        rr = sqrt( (xx-Xc(n)-drift).^2 + (yy-Yc(n)).^2);
+        I(:,:,f) = I(:,:,f) + Rfn(rr);
+    end
+    I(:,:,f) = I(:,:,f) + 2*randn(HEIGHT,WIDTH);
+end
+
+% approximate bead positions
+XYc = [Xc,Yc] + 0.7*(rand(numel(Xc),2)-0.5);
+
+%% Tune
+Target = 0.02;
+[best,info,results] = extras.ParticleTracking.radialcenter_autotune(I,XYc,Target,'WindowSize',[16,24,32,48]);
+
+assert(isequal(sort(fieldnames(best)),sort({'RadiusCutoff';'CutoffFactor';'DistanceExponent';'GradientExponent'})),...
+    'radialcenter_autotune: first output must only hold RoiTracker parameters');
+assert(size(results,1)==4*2*2,'radialcenter_autotune: wrong number of configurations');
+assert(info.MeetsTarget && info.Precision<=Target,'radialcenter_autotune: target precision not met');
+ok = results(:,6)<=Target;
+assert(info.Cost==min(results(ok,7)),'radialcenter_autotune: best is not the cheapest configuration meeting the target');
+
+% check the reported precision with radialcenter
+w = info.WindowSize;
+WIND = [floor(XYc-(w-1)/2),w*ones(numel(Xc),2)];
+args = [fieldnames(best),struct2cell(best)]';
+[x,y] = extras.ParticleTracking.radialcenter(I,WIND,args{:});
+jx = x - mean(x,2); jx = jx - mean(jx,1); % subtract the mean position and the drift
+jy = y - mean(y,2); jy = jy - mean(jy,1);
+prec = sqrt( sum(jx(:).^2+jy(:).^2)/(2*(nFrames-1)*(numel(Xc)-1)) );
+assert(abs(prec-info.Precision)<1e-9,'radialcenter_autotune: precision differs from radialcenter (%g vs %g)',prec,info.Precision);
+
+fprintf('best: %dx%d window, DistanceExponent=%g, GradientExponent=%g: %.4f px, %.0f ns/ROI\n',...
+    w,w,best.DistanceExponent,best.GradientExponent,info.Precision,info.Cost);
+
+%% Unreachable target returns the most precise configuration
+[~,info2] = extras.ParticleTracking.radialcenter_autotune(I,XYc,1e-6,'WindowSize',[16,24,32,48]);
+assert(~info2.MeetsTarget && info2.Precision==min(results(:,6)),'radialcenter_autotune: most precise configuration not returned for an unreachable target');
@@ -0,0 +1,63 @@
+% Test that extras.ParticleTracking.RadialcenterContext gives the same result as
+% extras.ParticleTracking.radialcenter, and compare the per-call overhead
+% for a loop over small images
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare with radialcenter
+opts = {{},...
+    {'RadiusCutoff',25},...
+    {'RadiusCutoff',25,'CutoffFactor',2,'Precision','single'},...
+    {'RadiusCutoff',25,'RefineIterations',3,'RejectMethod','contrast','RejectThreshold',1}};
+for k=1:numel(opts)
+    ctx = extras.ParticleTracking.RadialcenterContext(WIND,opts{k}{:});
+    assert(isequal(ctx.Window,WIND),'RadialcenterContext: Window was not stored (options %d)',k);
+    assert(ctx.NumWindows==size(WIND,1),'RadialcenterContext: wrong number of windows (options %d)',k);
+
+    [X,Y,V,D,S] = extras.ParticleTracking.radialcenter(I,WIND,opts{k}{:});
+    for rep=1:2 % the second call reuses the workspace
+        [Xk,Yk,Vk,Dk,Sk] = ctx.run(I);
+        assert(isequal(X,Xk)&&isequal(Y,Yk)&&isequal(V,Vk)&&isequal(D,Dk)&&isequal(S,Sk),...
+            'RadialcenterContext: result differs from radialcenter (options %d, call %d)',k,rep);
+    end
+    [X2,Y2] = ctx.run(single(I));
+    [X3,Y3] = extras.ParticleTracking.radialcenter(single(I),WIND,opts{k}{:});
+    assert(isequal(X2,X3)&&isequal(Y2,Y3),'RadialcenterContext: result for single image differs from radialcenter (options %d)',k);
+    delete(ctx);
+end
+
+% changing the parameters keeps the windows
+ctx = extras.ParticleTracking.RadialcenterContext(WIND);
+ctx.setParameters('RadiusCutoff',25);
+[X,Y] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',25);
+[Xk,Yk] = ctx.run(I);
+assert(isequal(X,Xk)&&isequal(Y,Yk),'RadialcenterContext: setParameters changed the windows');
+
+% entire image
+ctx.Window = [];
+[X,Y] = extras.ParticleTracking.radialcenter(I(1:80,1:80),'RadiusCutoff',25);
+[Xk,Yk] = ctx.run(I(1:80,1:80));
+assert(isequal(X,Xk)&&isequal(Y,Yk),'RadialcenterContext: result for the entire image differs from radialcenter');
+delete(ctx);
+fprintf('RadialcenterContext gives the same result as radialcenter\n');
+
+%% Per-call overhead for small images
+Ismall = I(1:32,1:32);
+nCalls = 5000;
+ctx = extras.ParticleTracking.RadialcenterContext([],'RadiusCutoff',12,'COMmethod','gradmag');
+
+tic;
+for n=1:nCalls
+    [x,y] = extras.ParticleTracking.radialcenter(Ismall,[],'RadiusCutoff',12,'COMmethod','gradmag');
+end
+t_rc = toc;
+
+tic;
+for n=1:nCalls
+    [x,y] = ctx.run(Ismall);
+end
+t_ctx = toc;
+delete(ctx);
+
+fprintf('32x32 image: radialcenter %.1f us/call, RadialcenterContext %.1f us/call\n',t_rc/nCalls*1e6,t_ctx/nCalls*1e6);
@@ -0,0 +1,25 @@
+% Test the specialized weighting loops of extras.ParticleTracking.radialcenter
+% Integer exponents (0,1,2,4,5) use specialized loops, while slightly perturbed
+% exponents use the generic (pow) loop. Both should give the same result.
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare specialized and generic exponents for each cutoff type
+exponents = [0,1,2,4,5];
+cutoffs = {{'RadiusCutoff',Inf},... no cutoff
+           {'RadiusCutoff',30},... top-hat
+           {'RadiusCutoff',30,'CutoffFactor',0.5}}; % logistic
+perturb = 1+1e-9;
+
+for c=1:numel(cutoffs)
+    for de = exponents
+        for ge = exponents
+            [Xi,Yi] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'DistanceExponent',de,'GradientExponent',ge);
+            [Xg,Yg] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'DistanceExponent',de*perturb+(de==0)*1e-12,'GradientExponent',ge*perturb+(ge==0)*1e-12);
+            err = max(abs([Xi-Xg;Yi-Yg]));
+            assert(err<=1e-6,'radialcenter: specialized weights (DistanceExponent=%d, GradientExponent=%d, cutoff %d) disagree with generic: %g px',de,ge,c,err);
+        end
+    end
+end
+fprintf('specialized and generic weighting loops agree\n');
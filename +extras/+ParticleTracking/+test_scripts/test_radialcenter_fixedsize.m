@@ -0,0 +1,30 @@
+% Test the weighting loops of extras.ParticleTracking.radialcenter compiled for
+% 32, 48 and 64 px windows ('FixedSizeKernels',true, the default). They should
+% give the same result as the generic loop ('FixedSizeKernels',false).
+
+%% Generate Test Image
+[I,Xc,Yc] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare fixed-size and generic loops for each window size and cutoff type
+for w = [32,48,64]
+    % integer corners, so that every window is exactly w x w px
+    WIND = [round(Xc)-w/2,round(Yc)-w/2,w*ones(numel(Xc),2)];
+    R = 0.4*w;
+    cutoffs = {{'RadiusCutoff',Inf},... no cutoff
+               {'RadiusCutoff',R},... top-hat
+               {'RadiusCutoff',R,'CutoffFactor',0.5}}; % logistic
+    for c=1:numel(cutoffs)
+        for prec = {'double','single'}
+            tol = 1e-6;
+            if strcmp(prec{1},'single')
+                tol = 1e-5; % rounding differs when the compiler contracts the float loops to FMA
+            end
+            [Xf,Yf] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'Precision',prec{1});
+            [Xg,Yg] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'Precision',prec{1},'FixedSizeKernels',false);
+            err = max(abs([Xf-Xg;Yf-Yg]));
+            fprintf('FixedSizeKernels (%d px, cutoff %d, %s): max difference from generic loop %g px\n',w,c,prec{1},err);
+            assert(err<=tol,'radialcenter: fixed-size loop (%d px, cutoff %d, %s) disagrees with generic: %g px',w,c,prec{1},err);
+        end
+    end
+end
+fprintf('fixed-size and generic weighting loops agree\n');
@@ -0,0 +1,32 @@
+% Test that extras.ParticleTracking.radialcenter with a shared gradient cache
+% agrees with the per-window gradient for heavily overlapping windows
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Overlapping windows: several jittered windows around each particle
+nRep = 4;
+Xw = repmat(Xc,nRep,1) + 6*(rand(nRep*numel(Xc),1)-0.5);
+Yw = repmat(Yc,nRep,1) + 6*(rand(nRep*numel(Yc),1)-0.5);
+WIND = [Xw-WIND(1,3)/2,Yw-WIND(1,4)/2,repmat(WIND(1,3:4),numel(Xw),1)];
+
+%% Compare shared and per-window gradients
+types = {'double','single','uint16'};
+for n=1:numel(types)
+    if strcmp(types{n},'double')||strcmp(types{n},'single')
+        Ityp = cast(I,types{n});
+    else
+        Ityp = cast(double(intmax(types{n}))*mat2gray(I),types{n});
+    end
+    [Xn,Yn] = extras.ParticleTracking.radialcenter(Ityp,WIND,'GradientCache','none');
+    [Xs,Ys] = extras.ParticleTracking.radialcenter(Ityp,WIND,'GradientCache','shared');
+    [Xa,Ya] = extras.ParticleTracking.radialcenter(Ityp,WIND,'GradientCache','auto','nThreads',0);
+
+    % only the pixels on the window borders are smoothed differently
+    err = max(abs([Xn-Xs;Yn-Ys]));
+    fprintf('%s: max difference between shared and per-window gradient: %g px\n',types{n},err);
+    assert(err<=1e-2,'radialcenter: shared gradient result disagrees with per-window gradient for %s image',types{n});
+
+    % windows overlap, so 'auto' should choose the shared gradient
+    assert(isequal(Xs,Xa)&&isequal(Ys,Ya),'radialcenter: GradientCache auto did not match shared for %s image',types{n});
+end
@@ -0,0 +1,23 @@
+% Test that the fused gradient kernel used by extras.ParticleTracking.radialcenter
+% gives the same results as the reference (multi-pass) implementation
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare kernels for each image type
+types = {'double','single','uint8','int8','uint16','int16','int32','uint32'};
+for n=1:numel(types)
+    if strcmp(types{n},'double')||strcmp(types{n},'single')
+        Ityp = cast(I,types{n});
+    else
+        Ityp = cast(double(intmax(types{n}))*mat2gray(I),types{n});
+    end
+    [Xr,Yr,varXYr,d2r] = extras.ParticleTracking.radialcenter(Ityp,WIND,'GradientKernel','reference');
+    [Xf,Yf,varXYf,d2f] = extras.ParticleTracking.radialcenter(Ityp,WIND,'GradientKernel','fused');
+
+    err = max(abs([Xr-Xf;Yr-Yf]));
+    fprintf('%s: max difference between fused and reference kernel: %g px\n',types{n},err);
+    assert(err<=1e-10,'radialcenter: fused gradient kernel disagrees with reference kernel for %s image',types{n});
+    assert(max(abs(varXYr(:)-varXYf(:))./abs(varXYr(:)))<=1e-10 && max(abs(d2r-d2f)./abs(d2r))<=1e-10,...
+        'radialcenter: fused gradient kernel variance disagrees with reference kernel for %s image',types{n});
+end
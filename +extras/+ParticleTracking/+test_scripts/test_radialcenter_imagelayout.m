@@ -0,0 +1,39 @@
+% Test that extras.ParticleTracking.radialcenter gives the same results for
+% a row-major frame ('ImageLayout','row') as for the column-major image
+% (a row-major frame is processed as the transposed image, so the results agree up to rounding)
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare row-major frame with column-major image
+% a row-major frame of I is stored in MATLAB as I.'
+opts = {{},...
+    {'RadiusCutoff',25},...
+    {'RadiusCutoff',25,'COMmethod','normal','IntegralImage','shared'},...
+    {'RadiusCutoff',25,'GradientCache','shared','GradientKernel','reference'},...
+    {'RadiusCutoff',25,'XYc',[Xc,Yc],'RefineIterations',3}};
+types = {'double','uint16'};
+for t=1:numel(types)
+    if strcmp(types{t},'double')
+        Ityp = I;
+    else
+        Ityp = cast(double(intmax(types{t}))*mat2gray(I),types{t});
+    end
+    for k=1:numel(opts)
+        [Xc1,Yc1,V1,D1] = extras.ParticleTracking.radialcenter(Ityp,WIND,opts{k}{:});
+        [Xr,Yr,Vr,Dr] = extras.ParticleTracking.radialcenter(Ityp.',WIND,opts{k}{:},'ImageLayout','row');
+        err = sqrt((Xr-Xc1).^2+(Yr-Yc1).^2);
+        fprintf('row-major layout (%s image, options %d): max difference %g px\n',types{t},k,max(err));
+        assert(all(err<1e-9),'radialcenter: row-major layout (%s image, options %d) changed the result',types{t},k);
+        assert(all(abs(Vr(:)-V1(:))<=1e-6*abs(V1(:)))&&all(abs(Dr-D1)<=1e-6*abs(D1)),'radialcenter: row-major layout (%s image, options %d) changed the variance',types{t},k);
+    end
+end
+
+% stack of row-major frames
+Istack = cat(3,I.',circshift(I,[3,5]).');
+[Xs,Ys] = extras.ParticleTracking.radialcenter(Istack,WIND,'ImageLayout','row');
+[X1,Y1] = extras.ParticleTracking.radialcenter(I,WIND);
+[X2,Y2] = extras.ParticleTracking.radialcenter(circshift(I,[3,5]),WIND);
+err = sqrt((Xs-[X1,X2]).^2+(Ys-[Y1,Y2]).^2);
+assert(all(err(:)<1e-9),'radialcenter: row-major stack changed the result');
+fprintf('row-major layout gives the same result as column-major\n');
@@ -0,0 +1,30 @@
+% Test that extras.ParticleTracking.radialcenter finds the same center of mass
+% with the shared integral image ('IntegralImage','shared') as when the
+% center of mass is summed over each window
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare integral image and per-window center of mass
+% the radius cutoff makes the result depend on the center of mass
+methods = {'normal','meanabs','gradmag'};
+types = {'double','uint16'};
+for t=1:numel(types)
+    if strcmp(types{t},'double')
+        Ityp = I;
+    else
+        Ityp = cast(double(intmax(types{t}))*mat2gray(I),types{t});
+    end
+    for m=1:numel(methods)
+        % gradmag uses the integral image of the shared gradient
+        [Xn,Yn] = extras.ParticleTracking.radialcenter(Ityp,WIND,'RadiusCutoff',25,'COMmethod',methods{m},'GradientCache','shared');
+        [Xi,Yi] = extras.ParticleTracking.radialcenter(Ityp,WIND,'RadiusCutoff',25,'COMmethod',methods{m},'GradientCache','shared','IntegralImage','shared');
+
+        err = max(abs([Xn-Xi;Yn-Yi]));
+        assert(err<=1e-6,'radialcenter: integral image center of mass (%s, %s image) disagrees with per-window sum: %g px',methods{m},types{t},err);
+
+        errT = max(hypot(Xi-Xc,Yi-Yc));
+        fprintf('%s, %s: max error: %g px\n',types{t},methods{m},errT);
+        assert(errT<=0.1,'radialcenter: COMmethod %s (%s image) too far from true center: %g px',methods{m},types{t},errT);
+    end
+end
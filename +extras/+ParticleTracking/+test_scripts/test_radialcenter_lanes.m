@@ -0,0 +1,60 @@
+% Test that extras.ParticleTracking.radialcenter with 'LaneBatchSize' (batches of small windows, one window
+% per SIMD lane) gives the same results as processing each window separately
+
+%% Generate Test Image
+% dense field of small spots
+Nx = 30;
+Ny = 20;
+WIDTH = 640;
+HEIGHT = 440;
+WSZ = 12; % window size
+
+Rfn = @(r) exp(-r.^2/(2*1.5^2));
+
+Xc = (1:Nx)*WIDTH/(Nx+1);
+Yc = (1:Ny)*HEIGHT/(Ny+1);
+
+[Xc,Yc] = meshgrid(Xc,Yc);
+
+Xc = Xc + 3*(rand(size(Xc))-0.5);
+Yc = Yc + 3*(rand(size(Yc))-0.5);
+Xc = reshape(Xc,[],1);
+Yc = reshape(Yc,[],1);
+
+I = 0.02*rand(HEIGHT,WIDTH);
+
+[xx,yy] = meshgrid(1:WIDTH,1:HEIGHT);
+
+for n = 1:numel(Xc)
+    rr = sqrt( (xx-Xc(n)).^2 + (yy-Yc(n)).^2);
+    I = I + Rfn(rr);
+end
+
+WIND = [floor(Xc-WSZ/2),floor(Yc-WSZ/2),WSZ*ones(numel(Xc),2)];
+WIND(1:7:end,3:4) = WSZ+4; % a second window size
+WIND(5,3) = 2; % too small to be batched
+
+%% Compare batched windows with separate windows
+params = {{},...
+    {'RadiusCutoff',4},...
+    {'RadiusCutoff',4,'CutoffFactor',2,'DistanceExponent',2,'GradientExponent',2},...
+    {'DistanceExponent',0,'GradientExponent',0},...
+    {'XYc',[Xc,Yc]}};
+for p=1:numel(params)
+    for prec = {'double','single'}
+        [X0,Y0,V0,D0,S0] = extras.ParticleTracking.radialcenter(I,WIND,params{p}{:},'Precision',prec{1});
+        [X,Y,V,D,S] = extras.ParticleTracking.radialcenter(I,WIND,params{p}{:},'Precision',prec{1},'LaneBatchSize',24);
+        err = sqrt((X-X0).^2+(Y-Y0).^2);
+        fprintf('LaneBatchSize (%s, parameter set %d): max difference from separate windows %g px\n',prec{1},p,max(err));
+        assert(all(err<1e-6),'radialcenter: LaneBatchSize differs from separate windows (%s, parameter set %d)',prec{1},p);
+        assert(all(abs(V(:)-V0(:))<=1e-6*abs(V0(:)))&&all(abs(D-D0)<=1e-6*abs(D0)),'radialcenter: LaneBatchSize variance differs (%s, parameter set %d)',prec{1},p);
+        assert(isequal(S,S0),'radialcenter: LaneBatchSize status differs (%s, parameter set %d)',prec{1},p);
+    end
+end
+
+%% Threads and image stacks give the same result
+[X,Y] = extras.ParticleTracking.radialcenter(I,WIND,'LaneBatchSize',24);
+[Xt,Yt] = extras.ParticleTracking.radialcenter(I,WIND,'LaneBatchSize',24,'nThreads',4);
+assert(isequal(X,Xt)&&isequal(Y,Yt),'radialcenter: LaneBatchSize gives different results with multiple threads');
+[Xs,Ys] = extras.ParticleTracking.radialcenter(cat(3,I,I),WIND,'LaneBatchSize',24);
+assert(isequal(Xs,[X,X])&&isequal(Ys,[Y,Y]),'radialcenter: LaneBatchSize gives different results for an image stack');
@@ -0,0 +1,31 @@
+% Test that extras.ParticleTracking.radialcenter gives the same center when
+% only some of the outputs are requested (the residual is not accumulated if
+% varXY and d2 are not requested)
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare number of outputs
+opts = {{},...
+    {'RadiusCutoff',25},...
+    {'RadiusCutoff',25,'CutoffFactor',2,'WeightKernelCache',16},...
+    {'RadiusCutoff',25,'RefineIterations',3}};
+for k=1:numel(opts)
+    [X,Y,V,D,S] = extras.ParticleTracking.radialcenter(I,WIND,opts{k}{:});
+
+    [X2,Y2] = extras.ParticleTracking.radialcenter(I,WIND,opts{k}{:});
+    assert(isequal(X,X2)&&isequal(Y,Y2),'radialcenter: [x,y] output differs from [x,y,varXY,d2] (options %d)',k);
+
+    [X3,Y3,V3] = extras.ParticleTracking.radialcenter(I,WIND,opts{k}{:});
+    assert(isequal(X,X3)&&isequal(Y,Y3)&&isequal(V,V3),'radialcenter: [x,y,varXY] output differs from [x,y,varXY,d2] (options %d)',k);
+
+    [X4,Y4,V4,D4] = extras.ParticleTracking.radialcenter(I,WIND,opts{k}{:});
+    assert(isequal(X,X4)&&isequal(Y,Y4)&&isequal(V,V4)&&isequal(D,D4),'radialcenter: [x,y,varXY,d2] output differs from [x,y,varXY,d2,status] (options %d)',k);
+    assert(all(S==0),'radialcenter: status must be 0 for windows that were fit');
+end
+
+% image stack
+[Xs,Ys] = extras.ParticleTracking.radialcenter(cat(3,I,I),WIND);
+[X,Y] = extras.ParticleTracking.radialcenter(I,WIND);
+assert(isequal(Xs,[X,X])&&isequal(Ys,[Y,Y]),'radialcenter: [x,y] output of image stack is wrong');
+fprintf('requested outputs do not change the result\n');
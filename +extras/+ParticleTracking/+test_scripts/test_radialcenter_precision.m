@@ -0,0 +1,38 @@
+% Test that the single precision compute path of extras.ParticleTracking.radialcenter
+% and extras.ParticleTracking.imradialavg agrees with the double precision path
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare radialcenter precision for each image type
+types = {'double','single','uint8','uint16','int16'};
+for n=1:numel(types)
+    if strcmp(types{n},'double')||strcmp(types{n},'single')
+        Ityp = cast(I,types{n});
+    else
+        Ityp = cast(double(intmax(types{n}))*mat2gray(I),types{n});
+    end
+    [Xd,Yd] = extras.ParticleTracking.radialcenter(Ityp,WIND,'Precision','double');
+    [Xs,Ys] = extras.ParticleTracking.radialcenter(Ityp,WIND,'Precision','single');
+
+    assert(isa(Xs,'double'),'radialcenter: outputs should be double for single precision');
+
+    err = max(abs([Xd-Xs;Yd-Ys]));
+    fprintf('%s: max difference between single and double precision: %g px\n',types{n},err);
+    assert(err<=1e-3,'radialcenter: single precision result disagrees with double precision for %s image',types{n});
+end
+
+%% Compare imradialavg precision
+% only pixels within rounding of a bin edge can fall into a different bin
+for n=1:numel(Xc)
+    [Rd,Ld,Cd] = extras.ParticleTracking.imradialavg(I,Xc(n),Yc(n),WIND(n,3)/2,0,0.5);
+    [Rs,Ls,Cs] = extras.ParticleTracking.imradialavg(I,Xc(n),Yc(n),WIND(n,3)/2,0,0.5,'Precision','single');
+
+    assert(isequal(Ld,Ls),'imradialavg: bin locations differ between single and double precision');
+
+    nMoved = sum(abs(Cd-Cs));
+    err = max(abs(Rd-Rs));
+    fprintf('imradialavg (ring %d): %d bins with different counts (%d pixels), max difference %g\n',n,nnz(Cd~=Cs),nMoved,err);
+    assert(nMoved<=10,'imradialavg: single precision puts %d pixels in a different bin than double precision',nMoved);
+    assert(err<=0.05*max(abs(I(:))),'imradialavg: single precision average disagrees with double precision: %g',err);
+end
@@ -0,0 +1,50 @@
+% Test that extras.ParticleTracking.radialcenter with 'PyramidLevels' (coarse-to-fine search)
+% gives the same center as fitting the full window, for large ring patterns
+
+%% Generate Test Image
+Nx = 4;
+Ny = 2;
+WIDTH = 700;
+HEIGHT = 400;
+RING = 75; % radius of the outer ring
+
+Rfn = @(r) (1+cos(r/4)).*exp(-r/60).*(1./(1+exp(r-RING)));
+
+Xc = (1:Nx)*WIDTH/(Nx+1);
+Yc = (1:Ny)*HEIGHT/(Ny+1);
+
+[Xc,Yc] = meshgrid(Xc,Yc);
+
+Xc = Xc + 15*(rand(size(Xc))-0.5);
+Yc = Yc + 15*(rand(size(Yc))-0.5);
+Xc = reshape(Xc,[],1);
+Yc = reshape(Yc,[],1);
+
+I = zeros(HEIGHT,WIDTH);
+
+[xx,yy] = meshgrid(1:WIDTH,1:HEIGHT);
+
+for n = 1:numel(Xc)
+    rr = sqrt( (xx-Xc(n)).^2 + (yy-Yc(n)).^2);
+    I = I + Rfn(rr);
+end
+
+WIND = [Xc,Yc,zeros(size(Xc)),zeros(size(Yc))] + [-2*RING/2-5,-2*RING/2-5,2*RING+10,2*RING+10] + [10*(rand(numel(Xc),2)-0.5),zeros(numel(Xc),2)];
+
+%% Compare pyramid with the full window
+[X0,Y0,V0,D0,S0] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',RING);
+for L=1:3
+    [X,Y,V,D,S] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',RING,'PyramidLevels',L);
+    err = sqrt((X-X0).^2+(Y-Y0).^2);
+    fprintf('PyramidLevels=%d: max difference from full window %g px\n',L,max(err));
+    assert(all(err<0.05),'radialcenter: PyramidLevels=%d differs from the full window fit',L);
+    assert(all(S==0)&&all(isfinite(V(:)))&&all(isfinite(D)),'radialcenter: PyramidLevels=%d did not fit every window',L);
+
+    % image stack
+    [Xs,Ys] = extras.ParticleTracking.radialcenter(cat(3,I,I),WIND,'RadiusCutoff',RING,'PyramidLevels',L);
+    assert(isequal(Xs,[X,X])&&isequal(Ys,[Y,Y]),'radialcenter: PyramidLevels=%d gives different results for an image stack',L);
+end
+
+%% Windows that are not larger than PyramidWindow are fit directly
+[X,Y,V,D] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',RING,'PyramidLevels',2,'PyramidWindow',1000);
+assert(isequal(X,X0)&&isequal(Y,Y0)&&isequal(V,V0)&&isequal(D,D0),'radialcenter: windows smaller than PyramidWindow must not use the pyramid');
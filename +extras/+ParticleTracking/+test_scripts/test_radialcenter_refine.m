@@ -0,0 +1,32 @@
+% Test the iterative refinement mode of extras.ParticleTracking.radialcenter
+% ('RefineIterations',N re-fits each particle with the window shrunk to the
+% radius cutoff around the previous solution)
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+% windows are deliberately off-center so the first fit is not the final answer
+WIND = WIND + [8,-6,0,0];
+
+%% Compare refined and single-pass results for each cutoff type
+cutoffs = {{'RadiusCutoff',25},... top-hat
+           {'RadiusCutoff',25,'CutoffFactor',0.5}}; % logistic
+
+for c=1:numel(cutoffs)
+    [X0,Y0] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:});
+
+    % RefineIterations=0 is the single-pass fit
+    [Xz,Yz] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'RefineIterations',0);
+    assert(isequal(X0,Xz)&&isequal(Y0,Yz),'radialcenter: RefineIterations=0 changed the result (cutoff %d)',c);
+
+    [Xr,Yr] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'RefineIterations',10);
+    err0 = max(hypot(X0-Xc,Y0-Yc));
+    errR = max(hypot(Xr-Xc,Yr-Yc));
+    fprintf('cutoff %d: max error single pass: %g px, refined: %g px\n',c,err0,errR);
+    assert(errR<=0.1,'radialcenter: refined result too far from true center (cutoff %d): %g px',c,errR);
+
+    % once converged, further passes should not move the center
+    [Xr2,Yr2] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'RefineIterations',20,'RefineTolerance',0);
+    err = max(abs([Xr-Xr2;Yr-Yr2]));
+    assert(err<=0.01,'radialcenter: refinement did not converge (cutoff %d): %g px',c,err);
+end
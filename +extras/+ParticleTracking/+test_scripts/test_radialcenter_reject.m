@@ -0,0 +1,28 @@
+% Test that extras.ParticleTracking.radialcenter skips windows without a
+% particle ('RejectMethod') and reports the reason in the status output,
+% without changing the result of the windows that are fit
+
+%% Generate Test Image
+% every third particle is missing (lost bead), with background noise
+empty = mod((1:10)',3)==0;
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image('Missing',empty,'Noise',0.01);
+
+%% Compare with and without rejection
+[X0,Y0,V0,D0,S0] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',25);
+assert(all(S0==0|S0==3),'radialcenter: windows rejected with RejectMethod=''none''');
+
+methods = {'contrast','gradient'};
+codes = [1,2];
+thresholds = [1,0.1]; % well above the background noise, far below the particles
+for m=1:numel(methods)
+    [X,Y,V,D,S] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',25,'RejectMethod',methods{m},'RejectThreshold',thresholds(m));
+    assert(isequal(S==codes(m),empty),'radialcenter: RejectMethod %s did not reject exactly the empty windows',methods{m});
+    assert(all(isnan([X(empty);Y(empty);D(empty);reshape(V(empty,:),[],1)])),'radialcenter: rejected windows (%s) must return NaN',methods{m});
+    assert(isequal(X(~empty),X0(~empty))&&isequal(Y(~empty),Y0(~empty))&&isequal(V(~empty,:),V0(~empty,:))&&isequal(D(~empty),D0(~empty)),...
+        'radialcenter: RejectMethod %s changed the result of windows that were fit',methods{m});
+
+    % image stack: status is [nPart x nFrames]
+    [~,~,~,~,Ss] = extras.ParticleTracking.radialcenter(cat(3,I,I),WIND,'RadiusCutoff',25,'RejectMethod',methods{m},'RejectThreshold',thresholds(m));
+    assert(isequal(Ss,[S,S]),'radialcenter: RejectMethod %s gives different status for an image stack',methods{m});
+end
+fprintf('rejected %d of %d windows\n',nnz(empty),numel(empty));
@@ -0,0 +1,41 @@
+% Test that extras.ParticleTracking.radialcenter processes image stacks
+% ([nRows x nCols x nFrames] arrays and cell arrays of frames) identically
+% to calling radialcenter on each frame
+
+%% Generate Test Stack
+nFrames = 8;
+[I,~,~,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image('nFrames',nFrames);
+nPart = size(WIND,1);
+
+%% Compare stack and per-frame results
+types = {'double','single','uint16'};
+for n=1:numel(types)
+    if strcmp(types{n},'double')||strcmp(types{n},'single')
+        Ityp = cast(I,types{n});
+    else
+        Ityp = cast(double(intmax(types{n}))*mat2gray(I),types{n});
+    end
+
+    X = zeros(nPart,nFrames);
+    Y = zeros(nPart,nFrames);
+    V = zeros(nPart,2,nFrames);
+    D = zeros(nPart,nFrames);
+    for f=1:nFrames
+        [X(:,f),Y(:,f),V(:,:,f),D(:,f)] = extras.ParticleTracking.radialcenter(Ityp(:,:,f),WIND);
+    end
+
+    tic;
+    [Xs,Ys,Vs,Ds] = extras.ParticleTracking.radialcenter(Ityp,WIND,'nThreads',0);
+    t_stack = toc;
+    assert(isequal(size(Xs),[nPart,nFrames]),'radialcenter: stack output has wrong size');
+    assert(isequal(size(Vs),[nPart,2,nFrames]),'radialcenter: stack varXY has wrong size');
+    assert(isequal(X,Xs)&&isequal(Y,Ys)&&isequal(V,Vs)&&isequal(D,Ds),...
+        'radialcenter: stack result differs from per-frame result for %s image',types{n});
+
+    frames = squeeze(num2cell(Ityp,[1,2]));
+    [Xc2,Yc2,Vc2,Dc2] = extras.ParticleTracking.radialcenter(frames,WIND,'nThreads',0);
+    assert(isequal(X,Xc2)&&isequal(Y,Yc2)&&isequal(V,Vc2)&&isequal(D,Dc2),...
+        'radialcenter: cell stack result differs from per-frame result for %s image',types{n});
+
+    fprintf('%s: %d frames processed as a stack in %g s\n',types{n},nFrames,t_stack);
+end
@@ -0,0 +1,36 @@
+% Test the cached weight kernels of extras.ParticleTracking.radialcenter
+% ('WeightKernelCache',Q rounds the center guess to 1/Q pixel and reuses the
+% precomputed distance weights)
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Compare cached and direct weights for each cutoff type
+cutoffs = {{'RadiusCutoff',Inf},... no cutoff
+           {'RadiusCutoff',25},... top-hat
+           {'RadiusCutoff',25,'CutoffFactor',0.5}}; % logistic
+
+for c=1:numel(cutoffs)
+    [X0,Y0] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:});
+
+    % very fine quantization should reproduce the direct calculation
+    [Xf,Yf] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'WeightKernelCache',1e6);
+    err = max(abs([X0-Xf;Y0-Yf]));
+    assert(err<=1e-5,'radialcenter: cached weights (Q=1e6, cutoff %d) disagree with direct weights: %g px',c,err);
+
+    % typical quantization only shifts the result slightly
+    [Xq,Yq] = extras.ParticleTracking.radialcenter(I,WIND,cutoffs{c}{:},'WeightKernelCache',16);
+    err = max(abs([X0-Xq;Y0-Yq]));
+    fprintf('cutoff %d: max difference with WeightKernelCache=16: %g px\n',c,err);
+    assert(err<=0.05,'radialcenter: cached weights (Q=16, cutoff %d) disagree with direct weights: %g px',c,err);
+end
+
+%% Center guess on a pixel center
+% the pixel at the quantized center guess is excluded (1/r^DistanceExponent is infinite)
+XYc = round([Xc,Yc])+0.5;
+[Xp,Yp] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',25,'XYc',XYc,'WeightKernelCache',16);
+[X0,Y0] = extras.ParticleTracking.radialcenter(I,WIND,'RadiusCutoff',25,'XYc',XYc+1/16,'WeightKernelCache',16);
+assert(all(isfinite([Xp;Yp])),'radialcenter: cached weights fail when the center guess is on a pixel center');
+err = max(abs([X0-Xp;Y0-Yp]));
+fprintf('center guess on a pixel center: max difference %g px\n',err);
+assert(err<=0.05,'radialcenter: cached weights with the center guess on a pixel center disagree: %g px',err);
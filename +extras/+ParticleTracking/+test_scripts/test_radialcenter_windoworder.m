@@ -0,0 +1,28 @@
+% Test that the order in which extras.ParticleTracking.radialcenter processes
+% the windows ('WindowOrder') does not change the results, and that results
+% are returned in the order of WIND
+
+%% Generate Test Image
+[I,Xc,Yc,WIND] = extras.ParticleTracking.test_scripts.make_ring_test_image();
+
+%% Windows listed in random order (including duplicates)
+nRep = 3;
+Xw = repmat(Xc,nRep,1) + round(4*(rand(nRep*numel(Xc),1)-0.5));
+Yw = repmat(Yc,nRep,1) + round(4*(rand(nRep*numel(Yc),1)-0.5));
+WIND = [Xw-WIND(1,3)/2,Yw-WIND(1,4)/2,repmat(WIND(1,3:4),numel(Xw),1)];
+WIND = [WIND;WIND(1:3,:)];
+WIND = WIND(randperm(size(WIND,1)),:);
+
+%% Compare processing orders
+[Xi,Yi,Vi,Di] = extras.ParticleTracking.radialcenter(I,WIND,'WindowOrder','input');
+[Xm,Ym,Vm,Dm] = extras.ParticleTracking.radialcenter(I,WIND,'WindowOrder','morton');
+assert(isequal(Xi,Xm)&&isequal(Yi,Ym)&&isequal(Vi,Vm)&&isequal(Di,Dm),'radialcenter: morton window order changed the result');
+
+[Xt,Yt,Vt,Dt] = extras.ParticleTracking.radialcenter(I,WIND,'WindowOrder','morton','nThreads',0);
+assert(isequal(Xi,Xt)&&isequal(Yi,Yt)&&isequal(Vi,Vt)&&isequal(Di,Dt),'radialcenter: multi-threaded morton window order changed the result');
+
+% results follow the order of WIND
+p = randperm(size(WIND,1));
+[Xp,Yp] = extras.ParticleTracking.radialcenter(I,WIND(p,:));
+assert(isequal(Xp,Xm(p))&&isequal(Yp,Ym(p)),'radialcenter: results are not returned in the order of WIND');
+fprintf('window order does not change the result\n');
@@ -0,0 +1,443 @@
+/*--------------------------------------------------
+Copyright 2018-2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+
+/*
+Native benchmark of the header-only particle-tracking kernels
+	radialcenter.h, radialavg.h, spline.h and barycenter.hpp
+(no MATLAB or mex libraries are needed)
+
+Synthetic ring images are generated the same way as in test_speed_radialcenter.m:
+	I(r) = (0.5+r-r^3)*sinc(r/5)/(1+exp(r-R0))
+with one particle (at a random sub-pixel position) in each window.
+
+The benchmark sweeps window size, particle count, pixel type and thread count, and prints one
+CSV line per configuration (lines starting with # are comments):
+	kernel,pixel,threads,window,particles,ns_per_pixel,frames_per_s,err_mean,err_max
+	ns_per_pixel: time per frame / number of window pixels processed per frame
+	frames_per_s: frames (all particles) processed per second
+	err_mean, err_max: localization error (px, or z-units for splineroot), nan if not applicable
+For 32, 48 and 64 px windows radialcenter_generic<T> rows repeat the single-threaded radialcenter<T>
+run without the loops compiled for those window sizes (RadialcenterParameters::FixedSizeKernels=false).
+Both loops must give the same localization error: if err_max differs by more than 1e-6 px (double)
+or 1e-5 px (float, which can differ by rounding when the compiler contracts to FMA) the benchmark
+reports an error and exits with status 3.
+For windows up to 24 px radialcenter_lanes<T> rows repeat the single-threaded radialcenter<T> run with
+the windows processed in batches, one window per SIMD lane (RadialcenterParameters::LaneBatchSize=24).
+
+Build (from the +extras directory):
+	g++ -std=c++17 -O2 -march=native -pthread -Iinclude -I+ParticleTracking +ParticleTracking/+test_speed/bench_particletracking.cpp -o bench_particletracking
+	cl /std:c++17 /O2 /EHsc /arch:AVX2 /Iinclude /I+ParticleTracking +ParticleTracking\+test_speed\bench_particletracking.cpp
+
+Usage:
+	bench_particletracking [--quick] [--time seconds]
+		--quick: smaller sweep (still includes the 32, 48 and 64 px windows of the fixed-size loops)
+		--time: minimum time spent on each configuration (default=0.2 s)
+*/
+
+#define _USE_MATH_DEFINES //M_PI for MSVC
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include <radialcenter/source/radialcenter.h>
+#include <imradialavg/source/radialavg.h>
+#include <splineroot/source/spline.h>
+#include <barycenter/source/barycenter.hpp>
+
+namespace {
+
+	using namespace extras::ParticleTracking;
+
+	//! Synthetic frame with one ring particle per window
+	//! Particles are placed on a grid with spacing of 1.25 window widths
+	template<typename M>
+	struct RingFrame {
+		size_t nRows = 0;
+		size_t nCols = 0;
+		std::vector<M> img; //column-major image
+		std::vector<double> WIND; //[x0,y0,w,h] (nPart x 4, column-major)
+		std::vector<double> Xc; //true centers (0-indexed pixel coordinates)
+		std::vector<double> Yc;
+
+		RingFrame(size_t window, size_t nPart, unsigned seed) {
+			const size_t spacing = window + window / 4;
+			const size_t nGrid = (size_t)std::ceil(std::sqrt((double)nPart));
+			nRows = nGrid*spacing;
+			nCols = nGrid*spacing;
+
+			std::mt19937 gen(seed);
+			std::uniform_real_distribution<double> jitter(-2.0, 2.0);
+
+			WIND.resize(4 * nPart);
+			Xc.resize(nPart);
+			Yc.resize(nPart);
+			for (size_t n = 0; n < nPart; ++n) {
+				double x0 = double((n / nGrid)*spacing + (spacing - window) / 2);
+				double y0 = double((n%nGrid)*spacing + (spacing - window) / 2);
+				Xc[n] = x0 + window / 2.0 + jitter(gen);
+				Yc[n] = y0 + window / 2.0 + jitter(gen);
+				WIND[n + 0 * nPart] = x0;
+				WIND[n + 1 * nPart] = y0;
+				WIND[n + 2 * nPart] = double(window);
+				WIND[n + 3 * nPart] = double(window);
+			}
+
+			// ring profile, extending to 0.4 windows from the center
+			const double R0 = 0.4*window;
+			auto Rfn = [R0](double r) {
+				double sinc = (r == 0) ? 1.0 : std::sin(M_PI*r / 5) / (M_PI*r / 5);
+				return (0.5 + r - r*r*r)*sinc / (1 + std::exp(r - R0));
+			};
+
+			std::vector<double> I(nRows*nCols, 0.0);
+			for (size_t n = 0; n < nPart; ++n) { //each particle only covers its own window
+				size_t x1 = (size_t)WIND[n + 0 * nPart];
+				size_t y1 = (size_t)WIND[n + 1 * nPart];
+				for (size_t x = x1; x < x1 + window; ++x) {
+					for (size_t y = y1; y < y1 + window; ++y) {
+						I[y + x*nRows] += Rfn(std::hypot(x - Xc[n], y - Yc[n]));
+					}
+				}
+			}
+
+			// scale to the range of the pixel type (integer types), or copy
+			img.resize(I.size());
+			if (std::is_integral<M>::value) {
+				double mn = *std::min_element(I.begin(), I.end());
+				double mx = *std::max_element(I.begin(), I.end());
+				double scale = (mx > mn) ? double(std::numeric_limits<M>::max()) / (mx - mn) : 0;
+				for (size_t k = 0; k < I.size(); ++k) {
+					img[k] = (M)std::lround((I[k] - mn)*scale);
+				}
+			}
+			else {
+				for (size_t k = 0; k < I.size(); ++k) {
+					img[k] = (M)I[k];
+				}
+			}
+		}
+
+		size_t nPart() const {
+			return Xc.size();
+		}
+
+		extras::ImageView<M> view() const {
+			return extras::ImageView<M>(img.data(), nRows, nCols);
+		}
+	};
+
+	//! One line of results
+	struct BenchResult {
+		double sec_per_frame = NAN;
+		double err_mean = NAN;
+		double err_max = NAN;
+	};
+
+	//! Run fn() repeatedly for at least min_time seconds (after one warm-up call)
+	//! returns the mean time per call
+	template<typename Fn>
+	double time_it(double min_time, Fn&& fn) {
+		using clock = std::chrono::steady_clock;
+		fn(); //warm-up (allocates workspaces, fills caches)
+		size_t nCalls = 0;
+		auto t0 = clock::now();
+		double elapsed = 0;
+		do {
+			fn();
+			++nCalls;
+			elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+		} while (elapsed < min_time);
+		return elapsed / nCalls;
+	}
+
+	//! localization error of (x,y) compared to the true centers
+	template<typename M>
+	void localization_error(const RingFrame<M>& frame, const double* x, const double* y, BenchResult& res) {
+		double acc = 0;
+		double mx = 0;
+		for (size_t n = 0; n < frame.nPart(); ++n) {
+			double e = std::hypot(x[n] - frame.Xc[n], y[n] - frame.Yc[n]);
+			acc += e;
+			mx = std::isfinite(e) ? std::max(mx, e) : e;
+		}
+		res.err_mean = acc / frame.nPart();
+		res.err_max = mx;
+	}
+
+	//! radialcenter<T>() on all windows of the frame
+	//! fixed_size=false disables the loops compiled for 32, 48 and 64 px windows (RadialcenterParameters::FixedSizeKernels)
+	//! lane_batch>0 processes windows up to that size in batches, one window per SIMD lane (RadialcenterParameters::LaneBatchSize)
+	template<typename T, typename M>
+	BenchResult bench_radialcenter(const RingFrame<M>& frame, size_t nThreads, double min_time, bool fixed_size = true, size_t lane_batch = 0) {
+		size_t nPart = frame.nPart();
+		std::vector<double> x(nPart), y(nPart), varXY(2 * nPart), RWR_N(nPart);
+
+		RadialcenterParameters params;
+		params.WIND = const_cast<double*>(frame.WIND.data());
+		params.nWIND = nPart;
+		params.nThreads = nThreads;
+		params.FixedSizeKernels = fixed_size;
+		params.LaneBatchSize = lane_batch;
+
+		RadialcenterWorkspace<T> workspace;
+		BenchResult res;
+		res.sec_per_frame = time_it(min_time, [&]() {
+			radialcenter(x.data(), y.data(), varXY.data(), RWR_N.data(), frame.img.data(), frame.nRows, frame.nCols, params, workspace);
+		});
+		localization_error(frame, x.data(), y.data(), res);
+		return res;
+	}
+
+	//! radialavg<T>() around the true center of each particle (out to the window edge)
+	template<typename T, typename M>
+	BenchResult bench_radialavg(const RingFrame<M>& frame, size_t window, double min_time) {
+		size_t nPart = frame.nPart();
+		double Rmax = window / 2.0;
+		size_t nAvg = (size_t)std::floor(Rmax) + 1;
+		std::vector<double> imavg(nAvg);
+		std::vector<size_t> counts(nAvg);
+
+		BenchResult res;
+		res.sec_per_frame = time_it(min_time, [&]() {
+			for (size_t n = 0; n < nPart; ++n) {
+				radialavg<T>(frame.img.data(), frame.nRows, frame.nCols, frame.Xc[n], frame.Yc[n], imavg.data(), nAvg, Rmax, 0.0, 1.0, (double*)nullptr, counts.data());
+			}
+		});
+		return res;
+	}
+
+	//! barycenter (mass_center) of each window, only meaningful for 8-bit images
+	BenchResult bench_barycenter(const RingFrame<uint8_t>& frame, double min_time) {
+		size_t nPart = frame.nPart();
+		std::vector<double> x(nPart), y(nPart);
+		MassCenterWorkspace ws;
+
+		BenchResult res;
+		res.sec_per_frame = time_it(min_time, [&]() {
+			for (size_t n = 0; n < nPart; ++n) {
+				size_t X0 = (size_t)frame.WIND[n + 0 * nPart];
+				size_t Y0 = (size_t)frame.WIND[n + 1 * nPart];
+				size_t W = (size_t)frame.WIND[n + 2 * nPart];
+				size_t H = (size_t)frame.WIND[n + 3 * nPart];
+				double xw, yw;
+				mass_center(frame.view().subview(Y0, X0, H, W), 0.2, 50, &xw, &yw, ws);
+				x[n] = xw + X0;
+				y[n] = yw + Y0;
+			}
+		});
+		localization_error(frame, x.data(), y.data(), res);
+		return res;
+	}
+
+	//! splineroot() on radial profiles of a ring whose radius changes with z
+	//! window is the number of profile bins (spline dimensions), nPart the number of profiles solved per "frame"
+	BenchResult bench_splineroot(size_t dim, size_t nPart, double min_time) {
+		// lookup table: gaussian ring whose radius moves across the profile with z, for z=0...nBreaks-1
+		const size_t nBreaks = 41;
+		const size_t order = 4;
+		auto profile = [dim, nBreaks](double r, double z) {
+			double R = 2.0 + z*(dim - 4.0) / (nBreaks - 1.0);
+			return std::exp(-(r - R)*(r - R) / 8.0);
+		};
+
+		// cubic Hermite (Catmull-Rom) spline through the table, in MATLAB pp-form
+		std::vector<double> breaks(nBreaks);
+		for (size_t b = 0; b < nBreaks; ++b) {
+			breaks[b] = double(b);
+		}
+		const size_t stride = (nBreaks - 1)*dim;
+		std::vector<double> coefs(stride*order), dcoefs(stride*(order - 1), 0.0);
+		for (size_t b = 0; b + 1 < nBreaks; ++b) {
+			for (size_t d = 0; d < dim; ++d) {
+				double p0 = profile(d, b);
+				double p1 = profile(d, b + 1.0);
+				double m0 = (profile(d, b + 1.0) - profile(d, b - 1.0)) / 2;
+				double m1 = (profile(d, b + 2.0) - profile(d, b)) / 2;
+				coefs[d + b*dim + stride * 0] = 2 * p0 - 2 * p1 + m0 + m1;
+				coefs[d + b*dim + stride * 1] = -3 * p0 + 3 * p1 - 2 * m0 - m1;
+				coefs[d + b*dim + stride * 2] = m0;
+				coefs[d + b*dim + stride * 3] = p0;
+			}
+		}
+		spline pp{ coefs.data(), breaks.data(), nBreaks, order, dim, stride };
+		spline dpp{ dcoefs.data(), breaks.data(), nBreaks, order - 1, dim, stride };
+		std::vector<char> dpp_calc(nBreaks, 0);
+
+		// profiles to solve
+		std::mt19937 gen(7);
+		std::uniform_real_distribution<double> uz(2.0, nBreaks - 3.0);
+		std::vector<double> ztrue(nPart), v(nPart*dim), z(nPart);
+		for (size_t n = 0; n < nPart; ++n) {
+			ztrue[n] = uz(gen);
+			for (size_t d = 0; d < dim; ++d) {
+				v[d + n*dim] = profile(d, ztrue[n]);
+			}
+		}
+
+		BenchResult res;
+		res.sec_per_frame = time_it(min_time, [&]() {
+			for (size_t n = 0; n < nPart; ++n) {
+				z[n] = splineroot(&v[n*dim], pp, dpp, dpp_calc.data(), nullptr, 1e-9);
+			}
+		});
+
+		double acc = 0;
+		double mx = 0;
+		for (size_t n = 0; n < nPart; ++n) {
+			double e = std::fabs(z[n] - ztrue[n]);
+			acc += e;
+			mx = std::isfinite(e) ? std::max(mx, e) : e;
+		}
+		res.err_mean = acc / nPart;
+		res.err_max = mx;
+		return res;
+	}
+
+	void print_result(const char* kernel, const char* pixel, size_t threads, size_t window, size_t nPart, double pixels_per_frame, const BenchResult& res) {
+		std::printf("%s,%s,%zu,%zu,%zu,%.4g,%.4g,%.4g,%.4g\n", kernel, pixel, threads, window, nPart,
+			res.sec_per_frame / pixels_per_frame*1e9, 1.0 / res.sec_per_frame, res.err_mean, res.err_max);
+		std::fflush(stdout);
+	}
+
+	//! true if the generic loop gave the same localization error as the fixed-size loop (within tolerance px),
+	//! otherwise prints an error
+	bool check_fixed_size(const char* kernel, const char* pixel, size_t window, size_t nPart, const BenchResult& fixed, const BenchResult& generic, double tolerance) {
+		if (std::fabs(generic.err_max - fixed.err_max) <= tolerance || (std::isnan(generic.err_max) && std::isnan(fixed.err_max))) {
+			return true;
+		}
+		std::fprintf(stderr, "error: %s (%s, %zu px, %zu particles): err_max %.6g differs from the fixed-size loop (%.6g)\n",
+			kernel, pixel, window, nPart, generic.err_max, fixed.err_max);
+		return false;
+	}
+
+	//! all image kernels for pixel type M
+	//! returns false if the generic and fixed-size loops disagree (see check_fixed_size())
+	template<typename M>
+	bool bench_pixel_type(const char* pixel, const std::vector<size_t>& windows, const std::vector<size_t>& particles,
+		const std::vector<size_t>& threads, double min_time) {
+		bool ok = true;
+		for (size_t window : windows) {
+			for (size_t nPart : particles) {
+				RingFrame<M> frame(window, nPart, unsigned(window * 1000 + nPart));
+				double pixels = double(window)*double(window)*double(nPart);
+
+				BenchResult single_double, single_float; //single-threaded results
+				for (size_t nThreads : threads) {
+					BenchResult rd = bench_radialcenter<double>(frame, nThreads, min_time);
+					print_result("radialcenter<double>", pixel, nThreads, window, nPart, pixels, rd);
+					BenchResult rf = bench_radialcenter<float>(frame, nThreads, min_time);
+					print_result("radialcenter<float>", pixel, nThreads, window, nPart, pixels, rf);
+					if (nThreads == 1) {
+						single_double = rd;
+						single_float = rf;
+					}
+				}
+
+				// generic loops, for comparison with the fixed-size loops
+				if (window == 32 || window == 48 || window == 64) {
+					BenchResult gd = bench_radialcenter<double>(frame, 1, min_time, false);
+					print_result("radialcenter_generic<double>", pixel, 1, window, nPart, pixels, gd);
+					ok &= check_fixed_size("radialcenter_generic<double>", pixel, window, nPart, single_double, gd, 1e-6);
+					BenchResult gf = bench_radialcenter<float>(frame, 1, min_time, false);
+					print_result("radialcenter_generic<float>", pixel, 1, window, nPart, pixels, gf);
+					ok &= check_fixed_size("radialcenter_generic<float>", pixel, window, nPart, single_float, gf, 1e-5);
+				}
+
+				// one window per SIMD lane, for small windows
+				if (window <= 24) {
+					print_result("radialcenter_lanes<double>", pixel, 1, window, nPart, pixels, bench_radialcenter<double>(frame, 1, min_time, true, 24));
+					print_result("radialcenter_lanes<float>", pixel, 1, window, nPart, pixels, bench_radialcenter<float>(frame, 1, min_time, true, 24));
+				}
+
+				// area of the circle that is averaged
+				double avg_pixels = M_PI*window*window / 4.0*nPart;
+				print_result("radialavg<double>", pixel, 1, window, nPart, avg_pixels, bench_radialavg<double>(frame, window, min_time));
+				print_result("radialavg<float>", pixel, 1, window, nPart, avg_pixels, bench_radialavg<float>(frame, window, min_time));
+			}
+		}
+		return ok;
+	}
+
+	void bench_barycenter_sweep(const std::vector<size_t>& windows, const std::vector<size_t>& particles, double min_time) {
+		for (size_t window : windows) {
+			for (size_t nPart : particles) {
+				RingFrame<uint8_t> frame(window, nPart, unsigned(window * 1000 + nPart));
+				print_result("barycenter", "uint8", 1, window, nPart, double(window)*double(window)*double(nPart), bench_barycenter(frame, min_time));
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	bool quick = false;
+	double min_time = 0.2;
+	for (int k = 1; k < argc; ++k) {
+		if (std::strcmp(argv[k], "--quick") == 0) {
+			quick = true;
+		}
+		else if (std::strcmp(argv[k], "--time") == 0 && k + 1 < argc) {
+			min_time = std::atof(argv[++k]);
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--quick] [--time seconds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<size_t> windows = quick ? std::vector<size_t>{ 16, 32, 48, 64 } : std::vector<size_t>{ 16, 32, 48, 64, 128 };
+	std::vector<size_t> particles = quick ? std::vector<size_t>{ 1, 64 } : std::vector<size_t>{ 1, 16, 256 };
+	std::vector<size_t> threads{ 1 };
+	size_t hw = std::max(1u, std::thread::hardware_concurrency());
+	if (hw > 1) {
+		threads.push_back(hw);
+	}
+
+	std::printf("# bench_particletracking: hardware threads=%zu, min time per configuration=%g s\n", hw, min_time);
+#if defined(__AVX512F__)
+	std::printf("# SIMD: AVX-512\n");
+#elif defined(__AVX2__)
+	std::printf("# SIMD: AVX2\n");
+#else
+	std::printf("# SIMD: none\n");
+#endif
+	std::printf("kernel,pixel,threads,window,particles,ns_per_pixel,frames_per_s,err_mean,err_max\n");
+
+	bool ok = true;
+	try {
+		ok &= bench_pixel_type<uint8_t>("uint8", windows, particles, threads, min_time);
+		ok &= bench_pixel_type<uint16_t>("uint16", windows, particles, threads, min_time);
+		ok &= bench_pixel_type<float>("single", windows, particles, threads, min_time);
+		ok &= bench_pixel_type<double>("double", windows, particles, threads, min_time);
+
+		bench_barycenter_sweep(windows, particles, min_time);
+
+		// splineroot: "window" is the number of profile bins, "pixels" are spline dimensions
+		for (size_t dim : windows) {
+			for (size_t nPart : particles) {
+				print_result("splineroot", "double", 1, dim, nPart, double(dim)*double(nPart), bench_splineroot(dim, nPart, min_time));
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::fprintf(stderr, "error: %s\n", e.what());
+		return 2;
+	}
+	catch (const char* e) {
+		std::fprintf(stderr, "error: %s\n", e);
+		return 2;
+	}
+
+	return ok ? 0 : 3;
+}
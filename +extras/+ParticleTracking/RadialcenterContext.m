@@ -0,0 +1,73 @@
+classdef RadialcenterContext < extras.SessionManager.Session
+%% extras.ParticleTracking.RadialcenterContext
+% Persistent radialcenter session, for tracking many small images in a loop.
+% The windows and Name,Value parameters are parsed once and kept (with the
+% working memory) by the mex object, so
+%   [x,y,varXY,d2,status] = ctx.run(I)
+% gives the same result as
+%   [x,y,varXY,d2,status] = extras.ParticleTracking.radialcenter(I,WIND,Name,Value,...)
+% without parsing the arguments or allocating the workspace on every call.
+%
+% Usage:
+%   ctx = extras.ParticleTracking.RadialcenterContext(WIND,Name,Value,...)
+%   ctx = extras.ParticleTracking.RadialcenterContext(Name,Value,...) % use the entire image
+%   for f=1:nFrames
+%       [x,y] = ctx.run(I(:,:,f));
+%   end
+%
+% The Name,Value parameters are the same as radialcenter(), see
+% help extras.ParticleTracking.radialcenter
+% run() only accepts 2D images, use radialcenter() for image stacks.
+
+    %% Constructor
+    methods
+        function this = RadialcenterContext(varargin)
+            % Create RadialcenterContext
+            % optionally specify the windows [n x 4] and Name,Value parameters
+
+            this@extras.SessionManager.Session(@extras.ParticleTracking.RadialcenterContext_mex);
+            if nargin>0 && ~ischar(varargin{1})
+                this.Window = varargin{1};
+                varargin(1) = [];
+            end
+            if ~isempty(varargin)
+                this.setParameters(varargin{:});
+            end
+        end
+    end
+
+    %% Window
+    properties(Dependent)
+        Window %[n x 4] windows [x,y,w,h] (empty=entire image)
+    end
+    properties(Dependent,SetAccess=private)
+        NumWindows %number of windows returned by run()
+    end
+    methods
+        function set.Window(this,WIND)
+            this.runMethod('setWindow',WIND);
+        end
+        function WIND = get.Window(this)
+            WIND = this.runMethod('getWindow');
+        end
+        function n = get.NumWindows(this)
+            n = this.runMethod('numWindows');
+        end
+    end
+
+    %% public methods
+    methods
+        function setParameters(this,varargin)
+            % set the Name,Value parameters (same as radialcenter)
+            % parameters that are not specified are reset to their defaults,
+            % the windows are not changed
+            this.runMethod('setParameters',varargin{:});
+        end
+        function varargout = run(this,I)
+            % [x,y,varXY,d2,status] = ctx.run(I)
+            % track the 2D image I using the stored windows and parameters
+            % (calls the mex function directly, bypassing runMethod, to keep the per-call overhead low)
+            [varargout{1:nargout}] = this.MEX_function('run',this.intPointer,I);
+        end
+    end
+end
@@ -3,34 +3,88 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
 
 #include <extras/Array.hpp>
-
-
-#define MAXS 10000
-#define MAXM 10000
+#include <extras/ImageView.hpp>
 
 namespace extras{namespace ParticleTracking{
-    /* find contiguous areas */
-    template<typename T>
-    inline void metti_punto_sup(int pv,int qv,int jv,int kv,char *mask, T *im, unsigned char& sup,int & abv, long& sx, long& sy, long& s, int& sl, int* sp, int* sq, int*sj, int* sk) {
-    if (mask[qv]!=2 && im[pv]>sup) {
-      abv=im[pv]-sup;sx+=jv*abv;sy+=kv*abv;s+=abv;
-      mask[qv]=2;
-      sl++;
-    //if (sl>=MAXS) throw("exit(3)");
-    sp[sl]=pv; sq[sl]=qv; sj[sl]=jv; sk[sl]=kv;
-    }
-    }
-    template<typename T>
-    inline void metti_punto_inf(int pv,int qv,int jv,int kv,char *mask, T *im, unsigned char& inf,int & abv, long& sx, long& sy, long& s, int& sl, int* sp, int* sq, int*sj, int* sk) {
-    if (mask[qv]!=1 && im[pv]<inf) {
-      abv=inf-im[pv];sx+=jv*abv;sy+=kv*abv;s+=abv;
-      mask[qv]=1;
-      sl++;
-    //if (sl>=MAXS) throw("exit(3)");
-    sp[sl]=pv; sq[sl]=qv; sj[sl]=jv; sk[sl]=kv;
-    }
+    /* run of contiguous pixels j0...j1 of line k of the ROI */
+    struct MassCenterSpan {
+      int j0, j1, k;
+    };
+
+    /*
+       Working memory of mass_center(), reused between calls so that no allocations are needed
+       once it has grown to the largest ROI.
+       mask          : 1 byte per pixel of the ROI (1: dark area, 2: light area)
+       spans         : stack of runs still to be expanded by the scanline fill
+    */
+    struct MassCenterWorkspace {
+      std::vector<char> mask;
+      std::vector<MassCenterSpan> spans;
+
+      /* clear the mask for a ROI of n pixels */
+      char* reset(size_t n) {
+        if (mask.size() < n) mask.resize(n);
+        std::fill(mask.begin(), mask.begin() + n, char(0));
+        spans.clear();
+        return mask.data();
+      }
+    };
+
+    /* find contiguous areas:
+       scanline fill of the 4-connected area above sup (LIGHT) or below inf (!LIGHT) containing pixel (j,k).
+       Whole runs of a line are marked and summed at once, and only the runs are pushed on the stack. */
+    template<bool LIGHT, typename T>
+    inline void mass_center_fill(const T *im, int start, int width, int height, int linestride,
+        unsigned char lim, int j, int k, MassCenterWorkspace& ws, long& sx, long& sy, long& s) {
+      const char mark = LIGHT ? 2 : 1;
+      char *mask = ws.mask.data();
+      /* local sums (the char mask could alias the arguments) */
+      long asx = 0, asy = 0, as = 0;
+      /* pixel p (mask index q) belongs to the area and was not visited yet */
+      auto inside = [&](int p, int q) { return mask[q] != mark && (LIGHT ? im[p] > lim : im[p] < lim); };
+      /* mark and sum the run j0...j1 of line kv */
+      auto add_run = [&](int j0, int j1, int kv) {
+        int p = start + kv*linestride, q = kv*width, abv;
+        long rsx = 0, rs = 0;
+        for (int jv = j0; jv <= j1; jv++) {
+          abv = LIGHT ? im[p + jv] - lim : lim - im[p + jv];
+          rsx += jv*abv; rs += abv;
+          mask[q + jv] = mark;
+        }
+        asx += rsx; asy += kv*rs; as += rs;
+        ws.spans.push_back(MassCenterSpan{ j0, j1, kv });
+      };
+      /* extend pixel jv of line kv (which is inside) to the left and right, then add the run; returns the end of the run */
+      auto fill_run = [&](int jv, int kv) {
+        int p = start + kv*linestride, q = kv*width;
+        int j0 = jv, j1 = jv;
+        while (j0 > 0 && inside(p + j0 - 1, q + j0 - 1)) j0--;
+        while (j1 < width - 1 && inside(p + j1 + 1, q + j1 + 1)) j1++;
+        add_run(j0, j1, kv);
+        return j1;
+      };
+
+      ws.spans.clear();
+      if (!inside(start + k*linestride + j, k*width + j)) return;
+      fill_run(j, k);
+      while (!ws.spans.empty()) {
+        MassCenterSpan r = ws.spans.back();
+        ws.spans.pop_back();
+        /* runs of the lines above and below touching r */
+        for (int kv = r.k - 1; kv <= r.k + 1; kv += 2) {
+          if (kv < 0 || kv >= height) continue;
+          int p = start + kv*linestride, q = kv*width;
+          for (int jv = r.j0; jv <= r.j1; jv++) {
+            if (inside(p + jv, q + jv)) jv = fill_run(jv, kv) + 1;
+          }
+        }
+      }
+      sx += asx; sy += asy; s += as;
     }
 
     /*
@@ -43,33 +97,29 @@ namespace extras{namespace ParticleTracking{
        alpha         : the factor for defining the tresholds
        weight        : the weight of the light region vs. the dark region (%)
        x,y           : the resulting position
+       ws            : working memory (can be reused for any number of calls and ROI sizes)
 
-       REMEMBER: THIS FUNCTION PROBABLY ASSUMES ROW MAJOR IMAGE DATA!
+       The ROI is read as height lines of width contiguous pixels, so for row-major data
+       x is the column and y the row. For column-major data (MATLAB) the roles are swapped:
+       pass the ROI height as width and swap x and y (or use the ImageView overload below).
     */
     template<typename T>
     void mass_center(
-    		 T *im,
+    		 const T *im,
     		 int start,int width,int height,int linestride,
     		 double alpha,
     		 int weight,
-    		 double *x,double *y
+    		 double *x,double *y,
+    		 MassCenterWorkspace& ws
     		 ) {
       /* position and the value of extreme */
-      int maxp,maxq,maxj,maxk,
-        minp,minq,minj,mink;
+      int maxj,maxk,
+        minj,mink;
       unsigned char maxv,minv;
       /* chopping top and bottom */
       unsigned char inf,sup;
-      /* stack to the coverage of contiguous areas*/
-      int * sp = new int[width*height];
-      int *sq = new int[width*height];
-      int*sj = new int[width*height];
-      int* sk = new int[width*height];
-      int sl;
-      /* mask to cover adjacent areas */
-      char *mask = new char[width*height];
       /* coordinate */
-      int j,k,p,q;
+      int j,k,p;
       /* sums*/
       long s,sx,sy;
       /* final values x,y ligth/dark */
@@ -77,19 +127,16 @@ namespace extras{namespace ParticleTracking{
       /* abbreviations*/
       int abv;
 
-      //if (width*height>MAXM) throw("exit(2)");
-
-      for (j=0;j<width*height;j++) mask[j]=0;
+      /* mask to cover adjacent areas */
+      ws.reset(size_t(width)*size_t(height));
 
       /* minimum, maximum, average */
-      maxp=minp=start;
-      maxq=minq=0;
       maxj=minj=maxk=mink=0;
       maxv=minv=im[start];s=0;
       abv=linestride-width;
-      for (k=0,p=start,q=0;k<height;k++,p+=abv) for (j=0;j<width;j++,p++,q++) {
-        if (im[p]>maxv) {maxv=im[p];maxp=p;maxq=q;maxj=j;maxk=k;}
-        if (im[p]<minv) {minv=im[p];minp=p;minq=q;minj=j;mink=k;}
+      for (k=0,p=start;k<height;k++,p+=abv) for (j=0;j<width;j++,p++) {
+        if (im[p]>maxv) {maxv=im[p];maxj=j;maxk=k;}
+        if (im[p]<minv) {minv=im[p];minj=j;mink=k;}
         s+=im[p];
       }
       s/=width*height;
@@ -100,15 +147,8 @@ namespace extras{namespace ParticleTracking{
 
       /* average over the adjacent upper */
       if (weight!=0) {
-        sx=sy=s=0;sl=-1;
-        metti_punto_sup(maxp,maxq,maxj,maxk,mask,im,sup,abv,sx,sy,s,sl,sp,sq,sj,sk);
-        while (sl>=0) {
-          p=sp[sl];q=sq[sl];j=sj[sl];k=sk[sl];sl--;
-          if (j>0) metti_punto_sup(p-1,q-1,j-1,k,mask,im,sup,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (j<width-1) metti_punto_sup(p+1,q+1,j+1,k,mask,im,sup,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (k>0) metti_punto_sup(p-linestride,q-width,j,k-1,mask,im,sup,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (k<height-1) metti_punto_sup(p+linestride,q+width,j,k+1,mask,im,sup,abv,sx,sy,s,sl,sp,sq,sj,sk);
-        }
+        sx=sy=s=0;
+        mass_center_fill<true>(im,start,width,height,linestride,sup,maxj,maxk,ws,sx,sy,s);
         xl=(double)sx/s;
         yl=(double)sy/s;
       }
@@ -116,15 +156,8 @@ namespace extras{namespace ParticleTracking{
 
       /* average over the adjacent lower */
       if (weight!=100) {
-        sx=sy=s=0;sl=-1;
-        metti_punto_inf(minp,minq,minj,mink,mask,im,inf,abv,sx,sy,s,sl,sp,sq,sj,sk);
-        while (sl>=0) {
-          p=sp[sl];q=sq[sl];j=sj[sl];k=sk[sl];sl--;
-          if (j>0) metti_punto_inf(p-1,q-1,j-1,k,mask,im,inf,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (j<width-1) metti_punto_inf(p+1,q+1,j+1,k,mask,im,inf,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (k>0) metti_punto_inf(p-linestride,q-width,j,k-1,mask,im,inf,abv,sx,sy,s,sl,sp,sq,sj,sk);
-          if (k<height-1) metti_punto_inf(p+linestride,q+width,j,k+1,mask,im,inf,abv,sx,sy,s,sl,sp,sq,sj,sk);
-        }
+        sx=sy=s=0;
+        mass_center_fill<false>(im,start,width,height,linestride,inf,minj,mink,ws,sx,sy,s);
         xd=(double)sx/s;
         yd=(double)sy/s;
       }
@@ -133,13 +166,36 @@ namespace extras{namespace ParticleTracking{
       /* results */
       *x=(xl*weight+xd*(100-weight))/100;
       *y=(yl*weight+yd*(100-weight))/100;
+    }
 
-      //delete arrays
-      delete[] sp;
-      delete[] sq;
-      delete[] sj;
-      delete[] sk;
-      delete[] mask;
+    /* mass_center() with temporary working memory */
+    template<typename T>
+    void mass_center(const T *im, int start, int width, int height, int linestride, double alpha, int weight, double *x, double *y) {
+      MassCenterWorkspace ws;
+      mass_center(im, start, width, height, linestride, alpha, weight, x, y, ws);
+    }
+
+    /*
+       mass_center() of an image view (column- or row-major, lines may be padded)
+       The view can be a sub-region of a larger image; the data are not copied.
+       x,y           : the resulting position (relative to the view, independent of the layout)
+       ws            : working memory (see MassCenterWorkspace)
+    */
+    template<typename T, typename Layout>
+    void mass_center(const extras::ImageView<T, Layout>& view, double alpha, int weight, double *x, double *y, MassCenterWorkspace& ws) {
+      if (std::is_same<Layout, extras::RowMajor>::value) { // rows are the lines of mass_center()
+        mass_center(view.data, 0, int(view.nCols), int(view.nRows), int(view.stride), alpha, weight, x, y, ws);
+      }
+      else { // columns are the lines of mass_center()
+        mass_center(view.data, 0, int(view.nRows), int(view.nCols), int(view.stride), alpha, weight, y, x, ws);
+      }
+    }
+
+    /* mass_center() of an image view, with temporary working memory */
+    template<typename T, typename Layout>
+    void mass_center(const extras::ImageView<T, Layout>& view, double alpha, int weight, double *x, double *y) {
+      MassCenterWorkspace ws;
+      mass_center(view, alpha, weight, x, y, ws);
     }
 
     template<class OutContainerClass=extras::Array<double>, typename ImageType=double> //OutContainerClass should be a container with resize(size_t) and operator[size_t] methods
@@ -178,6 +234,9 @@ namespace extras{namespace ParticleTracking{
         X.resize(pWIND->nRows(),1);
         Y.resize(pWIND->nRows(),1);
 
+        // working memory shared by all windows
+        MassCenterWorkspace ws;
+
         //loop over windows and find positions
 		for (size_t w = 0; w<WIND.nRows(); w++) {
 			X[w] = NAN; //default value is nan
@@ -197,12 +256,13 @@ namespace extras{namespace ParticleTracking{
 				continue; //just process next window
 			}
 
-            const ImageType* windImg = &I(Y0,X0);
+            // view of the window (no copy)
+            extras::ImageView<ImageType> windImg = extras::ImageView<ImageType>(I.getdata(), HEIGHT, WIDTH).subview(Y0, X0, H, W);
 
 			double y;
 			double x;
 
-            mass_center(windImg,0,H,W,I.nRows(),LimFrac,50,&y,&x);
+            mass_center(windImg,LimFrac,50,&x,&y,ws);
 
 			X[w] = x+double(X0);
 			Y[w] = y+double(Y0);
@@ -7,4 +7,7 @@ extras.ParticleTracking.RoiTracker.buildAll;
 extras.ParticleTracking.build_scripts.build_barycenter;
 extras.ParticleTracking.build_scripts.build_imradialavg;
 extras.ParticleTracking.build_scripts.build_radialcenter;
+extras.ParticleTracking.build_scripts.build_radialcenter3D;
+extras.ParticleTracking.build_scripts.build_radialcenter_autotune;
+extras.ParticleTracking.build_scripts.build_RadialcenterContext;
 extras.ParticleTracking.build_scripts.build_splineroot;
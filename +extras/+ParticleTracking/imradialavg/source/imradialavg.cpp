@@ -19,6 +19,12 @@ All rights reserved.
 *       logical ordering: imradialavg(__,Rmin,Rmax);
 *   BinWidth(=1): width and spacing of the bins
 *
+* Name,Value Parameters (after the numeric arguments):
+*   'Precision','double' or 'single': floating point type used for the pixel radius calculations
+*       'double' (default)
+*       'single': pixel radii and bin indices are computed in single precision; pixels within rounding of
+*           a bin edge can fall into the neighboring bin. Averages are still accumulated and returned in double
+*
 * Outputs:
 *   Avg: radial averages
 *   BinLocations: locations of the radial bins (e.g. 0,1,...,Rmax)
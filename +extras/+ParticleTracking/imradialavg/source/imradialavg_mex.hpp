@@ -5,7 +5,10 @@ All rights reserved.
 #pragma once
 
 #include <extras/cmex/NumericArray.hpp>
+#include <extras/cmex/mxparamparse.hpp>
+#include <extras/string_extras.hpp>
 #include "radialavg.hpp"
+#include "../../radialcenter/source/radialcenter.h" //string2SinglePrecision
 
 namespace extras{namespace ParticleTracking{
 
@@ -22,7 +25,9 @@ namespace extras{namespace ParticleTracking{
 	*	double BinWidth = 1,//optinal bin width
 	*	double * rLoc = nullptr, //optional output array specifying radii coordinates of bins in imavg. Must be same size as imavg
 	*	CountsType * Counts = nullptr //optional output array with counts in each bin. Must be same size as imavg
+	* ComputeT specifies the type (double or float) used for the per-pixel radius calculations
 	*/
+    template<typename ComputeT = double>
     std::tuple<extras::cmex::NumericArray<double>, extras::cmex::NumericArray<double>, extras::cmex::NumericArray<double>>
     radialavg(const mxArray* mxI, //image
 		double x, double y, //location around which radial average is computed (0,0 is top left of image)
@@ -32,37 +37,38 @@ namespace extras{namespace ParticleTracking{
 		bool computeRloc = true //flag specifying if r locations should be computed and stored in the output
 		)
     {
+		typedef extras::cmex::NumericArray<double> NA;
 
     	switch (mxGetClassID(mxI)) { //handle different image types seperatelys
     	case mxDOUBLE_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, double, ComputeT>
     			(extras::cmex::NumericArray<double>(mxI), x, y,Rmax, Rmin, BinWidth, computeRloc);
     	case mxSINGLE_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, float, ComputeT>
     			(extras::cmex::NumericArray<float>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxINT8_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, int8_t, ComputeT>
     			(extras::cmex::NumericArray<int8_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxUINT8_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, uint8_t, ComputeT>
     			(extras::cmex::NumericArray<uint8_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxINT16_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, int16_t, ComputeT>
     			(extras::cmex::NumericArray<int16_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxUINT16_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, uint16_t, ComputeT>
     			(extras::cmex::NumericArray<uint16_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxINT32_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, int32_t, ComputeT>
     			(extras::cmex::NumericArray<int32_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxUINT32_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, uint32_t, ComputeT>
     			(extras::cmex::NumericArray<uint32_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxINT64_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, int64_t, ComputeT>
     			(extras::cmex::NumericArray<int64_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	case mxUINT64_CLASS:
-    		return radialavg<double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>, double, extras::cmex::NumericArray<double>>
+    		return radialavg<double, NA, double, NA, double, NA, uint64_t, ComputeT>
     			(extras::cmex::NumericArray<uint64_t>(mxI), x, y, Rmax, Rmin, BinWidth, computeRloc);
     	default:
     		throw(extras::stacktrace_error("radialavg: Only numeric image types allowed"));
@@ -84,6 +90,12 @@ namespace extras{namespace ParticleTracking{
 	*       logical ordering: imradialavg(__,Rmin,Rmax);
 	*   BinWidth(=1): width and spacing of the bins
 	*
+	* Name,Value Parameters (after the numeric arguments):
+	*   'Precision','double' or 'single': floating point type used for the pixel radius calculations
+	*       'double' (default)
+	*       'single': pixel radii and bin indices are computed in single precision; pixels within rounding of
+	*           a bin edge can fall into the neighboring bin. Averages are still accumulated and returned in double
+	*
 	* Outputs:
 	*   Avg: radial averages
 	*   BinLocations: locations of the radial bins (e.g. 0,1,...,Rmax)
@@ -95,6 +107,26 @@ namespace extras{namespace ParticleTracking{
             mexErrMsgTxt("Three inputs required");
         }
 
+		// numeric arguments end at the first char argument, the rest are name,value pairs
+		int nNumArgs = nrhs;
+		for (int k = 3; k < nrhs; ++k) {
+			if (mxIsChar(prhs[k])) {
+				nNumArgs = k;
+				break;
+			}
+		}
+
+		extras::cmex::MxInputParser Parser(false); //create non-case sensitive input parser
+		Parser.AddParameter("Precision", "double");
+		if (nNumArgs < nrhs) {
+			int res = Parser.Parse(nrhs - nNumArgs, &prhs[nNumArgs]);
+			if (res != 0) {
+				mexErrMsgTxt("could not parse input parameters");
+			}
+		}
+
+		bool single_precision = string2SinglePrecision(extras::cmex::getstring(Parser("Precision")));
+
     	if (mxGetNumberOfElements(prhs[1]) != mxGetNumberOfElements(prhs[2])) {
     		mexErrMsgTxt("numel x must be same as numel y");
     	}
@@ -108,7 +140,7 @@ namespace extras{namespace ParticleTracking{
 
     	extras::cmex::NumericArray<double> Rmax(1, 1);
     	Rmax[0] = NAN;
-        if(nrhs>3){
+        if(nNumArgs>3){
     		Rmax = prhs[3];
         }
 
@@ -118,7 +150,7 @@ namespace extras{namespace ParticleTracking{
 
     	extras::cmex::NumericArray<double> Rmin(1, 1);
         Rmin[0] = 0;
-        if(nrhs>4){
+        if(nNumArgs>4){
     		Rmin = prhs[4];
         }
 
@@ -128,7 +160,7 @@ namespace extras{namespace ParticleTracking{
 
     	extras::cmex::NumericArray<double> BinWidth(1, 1);
         BinWidth[0] = 1;
-        if(nrhs>5){
+        if(nNumArgs>5){
     		BinWidth = prhs[5];
         }
 
@@ -152,7 +184,9 @@ namespace extras{namespace ParticleTracking{
 
     		// Calc Rad avg
     		if (X.numel() == 1) {
-    			auto res = radialavg(prhs[0], X[n] - 1, Y[n] - 1, Rmax[0], Rmin[0], BinWidth[0]);
+    			auto res = single_precision ?
+    				radialavg<float>(prhs[0], X[n] - 1, Y[n] - 1, Rmax[0], Rmin[0], BinWidth[0]) :
+    				radialavg<double>(prhs[0], X[n] - 1, Y[n] - 1, Rmax[0], Rmin[0], BinWidth[0]);
 
     			plhs[0] = std::get<0>(res);
 
@@ -182,7 +216,9 @@ namespace extras{namespace ParticleTracking{
     				Bw = BinWidth[n];
     			}
 
-    			auto res = radialavg(prhs[0], X[n] - 1, Y[n] - 1, Rmx, Rmn, Bw);
+    			auto res = single_precision ?
+    				radialavg<float>(prhs[0], X[n] - 1, Y[n] - 1, Rmx, Rmn, Bw) :
+    				radialavg<double>(prhs[0], X[n] - 1, Y[n] - 1, Rmx, Rmn, Bw);
 
     			mxSetCell(plhs[0], n, std::get<0>(res));
 
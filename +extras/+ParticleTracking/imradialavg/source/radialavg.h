@@ -11,15 +11,17 @@ All rights reserved.
 #include <algorithm>
 #include <type_traits>
 
+#include <extras/ImageView.hpp>
+
 namespace extras {namespace ParticleTracking {
 
-	/** template wrapper for radialavg<> accepting c-style numeric array as image data
+	/** radial average of an image view
 	* returns tuple with
 	* get<0>(out) -> average at each radial bin
 	* get<1>(out) -> radial bin locations (if computeRloc==true)
 	* get<2>(out) -> counts in each radial bin
 	* Inputs:
-	*   const M* img, size_t nRows, size_t nCols, //input image and size
+	*   const extras::ImageView<M, Layout>& img, //input image (column- or row-major, lines may be padded)
 	*	double x0, double y0, //location around which radial average is computed (0,0 is top left of image)
 	*	double* imavg, size_t nAvg, //output array and number of elements
 	*	double Rmax, //max radius to average over
@@ -27,10 +29,17 @@ namespace extras {namespace ParticleTracking {
 	*	double BinWidth = 1,//optinal bin width
 	*	double * rLoc = nullptr, //optional output array specifying radii coordinates of bins in imavg. Must be same size as imavg
 	*	CountsType * Counts = nullptr //optional output array with counts in each bin. Must be same size as imavg
+	*
+	* T is the compute type (double or float) used for the pixel radii and bin locations.
+	* Call as radialavg<float>(...) to use single precision. Sums are always accumulated in imavg (double).
+	* img may refer to a sub-region of a larger image (or a buffer with padded lines) without copying;
+	* x0,y0 are then relative to the view.
+	* The memory layout of img is a compile-time policy (extras::ColumnMajor or extras::RowMajor);
+	* x0,y0 and the result do not depend on the layout.
 	*/
-	template<typename M,typename CountsType = size_t>
+	template<typename T = double, typename M, typename Layout, typename CountsType = size_t>
 	void radialavg(
-		const M* img, size_t nRows, size_t nCols, //input image and size
+		const extras::ImageView<M, Layout>& img, //input image (column- or row-major, lines may be padded)
 		double x0, double y0, //location around which radial average is computed (0,0 is top left of image)
 		double* imavg, size_t nAvg, //output array and number of elements
 		double Rmax, //max radius to average over
@@ -42,6 +51,9 @@ namespace extras {namespace ParticleTracking {
 	{
 		using namespace std;
 
+		const size_t nRows = img.nRows;
+		const size_t nCols = img.nCols;
+
 		bool free_counts = (Counts == nullptr);
 		if (free_counts) {
 			Counts = (CountsType*)std::malloc(nAvg * sizeof(CountsType));
@@ -66,6 +78,12 @@ namespace extras {namespace ParticleTracking {
 			double Rinner = fmax(0, Rmin - BinWidth_2);
 			double Rinner2 = pow(Rinner, 2);
 
+			// per-pixel calculations use the compute type
+			const T tx0 = (T)x0;
+			const T ty0 = (T)y0;
+			const T tRmin = (T)Rmin;
+			const T tBinWidth = (T)BinWidth;
+
 			if (rLoc != nullptr) {
 				for (size_t n = 0; n<nBins; ++n) {
 					rLoc[n] = Rmin + BinWidth * n;
@@ -78,6 +96,7 @@ namespace extras {namespace ParticleTracking {
 			for (size_t xi = std::max(int(0), int(floor(x0 - Rlim))); xi <= min(int(nCols - 1), int(ceil(x0 + Rlim))); ++xi) {
 				if (xi >= (x0 - Rlim) && xi <= (x0 + Rlim)) {
 					double x2 = pow(xi - x0, 2);
+					const T dx2 = (T(xi) - tx0)*(T(xi) - tx0);
 
 					double yedge = sqrt(Rlim2 - x2);
 
@@ -85,11 +104,11 @@ namespace extras {namespace ParticleTracking {
 						for (size_t yi = max(int(0), int(floor(y0 - yedge)));
 							yi <= min(int(nRows - 1), int(y0 + yedge)); ++yi)
 						{
-							if (is_integral<M>::value || !isnan(img[yi + nRows * xi])) { //if value is nan, just skip, otherwise compute bin location and add to sum
+							if (is_integral<M>::value || !isnan(img(yi, xi))) { //if value is nan, just skip, otherwise compute bin location and add to sum
 																			  //determine bin id
-								size_t id = ceil((sqrt(pow(xi - x0, 2) + pow(yi - y0, 2)) - Rmin) / BinWidth - 0.5);
+								size_t id = ceil((sqrt(dx2 + (T(yi) - ty0)*(T(yi) - ty0)) - tRmin) / tBinWidth - T(0.5));
 								if (id<nBins) {
-									imavg[id] += img[yi + nRows * xi];//I(yi, xi);
+									imavg[id] += img(yi, xi);//I(yi, xi);
 									Counts[id]++;
 								}
 							}
@@ -100,11 +119,11 @@ namespace extras {namespace ParticleTracking {
 						//lower half
 						for (int yi = max(int(0), int(floor(y0 - yedge)));
 							yi <= min(int(nRows - 1), int(y0 - yinner)); ++yi) {
-							if (is_integral<M>::value || !isnan(img[yi + nRows * xi])) { //if value is nan, just skip, otherwise compute bin location and add to sum
+							if (is_integral<M>::value || !isnan(img(yi, xi))) { //if value is nan, just skip, otherwise compute bin location and add to sum
 																			  //determine bin id
-								size_t id = ceil((sqrt(pow(xi - x0, 2) + pow(yi - y0, 2)) - Rmin) / BinWidth - 0.5);
+								size_t id = ceil((sqrt(dx2 + (T(yi) - ty0)*(T(yi) - ty0)) - tRmin) / tBinWidth - T(0.5));
 								if (id<nBins) {
-									imavg[id] += img[yi + nRows * xi]; //I(yi, xi);
+									imavg[id] += img(yi, xi); //I(yi, xi);
 									Counts[id]++;
 								}
 							}
@@ -112,11 +131,11 @@ namespace extras {namespace ParticleTracking {
 						//upper half
 						for (int yi = max(int(0), int(floor(y0 + yinner)));
 							yi <= min(int(nRows - 1), int(y0 + yedge)); ++yi) {
-							if (is_integral<M>::value || !isnan(img[yi + nRows * xi])) { //if value is nan, just skip, otherwise compute bin location and add to sum
+							if (is_integral<M>::value || !isnan(img(yi, xi))) { //if value is nan, just skip, otherwise compute bin location and add to sum
 																			  //determine bin id
-								size_t id = ceil((sqrt(pow(xi - x0, 2) + pow(yi - y0, 2)) - Rmin) / BinWidth - 0.5);
+								size_t id = ceil((sqrt(dx2 + (T(yi) - ty0)*(T(yi) - ty0)) - tRmin) / tBinWidth - T(0.5));
 								if (id<nBins) {
-									imavg[id] += img[yi + nRows * xi]; //I(yi, xi);
+									imavg[id] += img(yi, xi); //I(yi, xi);
 									Counts[id]++;
 								}
 							}
@@ -142,7 +161,7 @@ namespace extras {namespace ParticleTracking {
 				int rx0 = (int)round(x0);
 				int ry0 = (int)round(y0);
 				if (rx0 >= 0 && rx0 < nCols && ry0 >= 0 && ry0 < nRows) {
-					imavg[0] = img[ry0 + nRows * rx0]; //I(ry0, rx0);
+					imavg[0] = img(ry0, rx0); //I(ry0, rx0);
 				}
 			}
 		}
@@ -160,4 +179,22 @@ namespace extras {namespace ParticleTracking {
 
 	}
 
+	/** template wrapper for radialavg<> accepting c-style numeric array as image data
+	* same as above for a packed image: const M* img, size_t nRows, size_t nCols (column-major)
+	*/
+	template<typename T = double, typename M, typename CountsType = size_t>
+	void radialavg(
+		const M* img, size_t nRows, size_t nCols, //input image and size
+		double x0, double y0, //location around which radial average is computed (0,0 is top left of image)
+		double* imavg, size_t nAvg, //output array and number of elements
+		double Rmax, //max radius to average over
+		double Rmin, // min radius to average over
+		double BinWidth = 1,//optinal bin width
+		double * rLoc = nullptr, //optional output array specifying radii coordinates of bins in imavg. Must be same size as imavg
+		CountsType * Counts = nullptr //optional output array with counts in each bin. Must be same size as imavg
+		)
+	{
+		radialavg<T>(extras::ImageView<M>(img, nRows, nCols), x0, y0, imavg, nAvg, Rmax, Rmin, BinWidth, rLoc, Counts);
+	}
+
 }}
\ No newline at end of file
@@ -27,10 +27,11 @@ namespace extras{namespace ParticleTracking{
 	/// get<2>(out) -> counts in each radial bin
 	///
 	/// Output types are determined by the template arguments
+	/// ComputeT specifies the type (double or float) used for the per-pixel radius calculations
 	template<typename resultsT=double, class resultsArrayClass=extras::Array<double>,
 			typename locT=size_t, class locArrayClass=extras::Array<locT>,
 			typename countT=size_t, class countArrayClass=extras::Array<countT>,
-	        typename M=double>
+	        typename M=double, typename ComputeT=double>
 	std::tuple<resultsArrayClass,locArrayClass, countArrayClass>
 	radialavg(const extras::ArrayBase<M>& I, double x0, double y0, double Rmax = NAN, double Rmin = 0, double BinWidth = 1,bool computeRloc = true){
 
@@ -66,7 +67,7 @@ namespace extras{namespace ParticleTracking{
 
 		if (computeRloc) {
 			RadiusPoints.resize_nocpy(nBins, 1);
-			radialavg(I.getdata(), I.nRows(), I.nCols(), //input image and size
+			radialavg<ComputeT>(I.getdata(), I.nRows(), I.nCols(), //input image and size
 				x0,y0,
 				results.getdata(), nBins, //output array and number of elements
 				Rmax, //max radius to average over
@@ -78,7 +79,7 @@ namespace extras{namespace ParticleTracking{
 			//radialavg(I.getdata(), I.nRows(), I.nCols(), results.getdata(), results.numel(), Rmax, Rmin, BinWidth, RadiusPoints.getdata(), Counts.getdata());
 		}
 		else {
-			radialavg(I.getdata(), I.nRows(), I.nCols(), //input image and size
+			radialavg<ComputeT>(I.getdata(), I.nRows(), I.nCols(), //input image and size
 				x0, y0,
 				results.getdata(), nBins, //output array and number of elements
 				Rmax, //max radius to average over
@@ -0,0 +1,23 @@
+/*
+% ctx = extras.ParticleTracking.RadialcenterContext(WIND,Name,Value,...)
+% [x,y,varXY,d2,status] = ctx.run(I)
+%
+% Persistent radialcenter session (see RadialcenterContext.m)
+% The windows and Name,Value parameters are parsed once, and the working memory is
+% kept between calls, so run(I) gives the same result as radialcenter(I,WIND,Name,Value,...)
+% without parsing the arguments or allocating the workspace on every call.
+*/
+
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+
+#include "RadialcenterContext.hpp"
+
+extras::SessionManager::ObjectManager<extras::ParticleTracking::RadialcenterContext> manager;
+extras::ParticleTracking::RadialcenterContextInterface<extras::ParticleTracking::RadialcenterContext, manager> mex_interface;
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+	mex_interface.mexFunction(nlhs, plhs, nrhs, prhs);
+}
@@ -0,0 +1,222 @@
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+#include <mex.h>
+#include "radialcenter_mex.hpp"
+#include <extras/SessionManager/mexInterface.hpp>
+
+namespace extras{namespace ParticleTracking{
+
+    //! Persistent radialcenter session
+    //! The windows and Name,Value parameters are parsed once (setWindow(), setParameters()) and kept,
+    //! together with the workspace, between calls. run() only tracks the image: it does not parse
+    //! any arguments and, once the workspace has grown to the size of the windows, does not allocate
+    //! (other than the output arrays returned to MATLAB).
+    class RadialcenterContext {
+    protected:
+        RadialcenterParameters_Shared shared_params; //parsed parameters and windows (owns the arrays)
+        RadialcenterParameters params; //parameters passed to radialcenter(), points into shared_params
+        size_t nPart = 1; //number of windows
+        bool single_precision = false; //'Precision','single'
+        RadialcenterWorkspace<double> workspace; //working memory used for 'Precision','double'
+        RadialcenterWorkspace<float> workspace_single; //working memory used for 'Precision','single'
+
+        //! call radialcenter() for an image of type M, using the workspace of the selected precision
+        template<typename M>
+        void run_typed(double* x, double* y, double* varXY, double* RWR_N, double* Status,
+            const M* img, size_t nRows, size_t nCols)
+        {
+            if (single_precision) {
+                radialcenter(x, y, varXY, RWR_N, img, nRows, nCols, params, workspace_single, Status);
+            }
+            else {
+                radialcenter(x, y, varXY, RWR_N, img, nRows, nCols, params, workspace, Status);
+            }
+        }
+
+    public:
+        RadialcenterContext() {
+            params = radialcenter_parameters(shared_params, nPart);
+        }
+
+        //! Set the windows ([n x 4], [x,y,w,h], 1-indexed); empty uses the entire image
+        void setWindow(const mxArray* pWIND) {
+            RadialcenterParameters_Shared new_params = shared_params;
+            radialcenter_set_window(pWIND, new_params);
+
+            size_t new_nPart;
+            RadialcenterParameters new_rc_params = radialcenter_parameters(new_params, new_nPart); //validate before changing the session
+            shared_params = new_params;
+            params = new_rc_params;
+            nPart = new_nPart;
+        }
+
+        //! Windows as a [n x 4] array (1-indexed)
+        mxArray* getWindow() const {
+            const extras::ArrayBase<double>& WIND = *shared_params.WIND;
+            mxArray* out = mxCreateDoubleMatrix(WIND.nRows(), WIND.nCols(), mxREAL);
+            double* pOut = mxGetPr(out);
+            for (size_t n = 0; n < WIND.nRows(); ++n) {
+                pOut[n] = WIND(n, 0) + 1;
+                pOut[n + WIND.nRows()] = WIND(n, 1) + 1;
+                pOut[n + 2 * WIND.nRows()] = WIND(n, 2);
+                pOut[n + 3 * WIND.nRows()] = WIND(n, 3);
+            }
+            return out;
+        }
+
+        //! Set the Name,Value parameters (same as radialcenter(I,WIND,Name,Value,...))
+        //! Parameters that are not specified are reset to their default values; the windows are not changed
+        void setParameters(int nParams, const mxArray* prhs[]) {
+            RadialcenterParameters_Shared new_params;
+            bool new_single_precision;
+            radialcenter_parse_parameters(nParams, prhs, new_params, new_single_precision, false);
+            new_params.WIND = shared_params.WIND;
+
+            size_t new_nPart;
+            RadialcenterParameters new_rc_params = radialcenter_parameters(new_params, new_nPart); //validate before changing the session
+            shared_params = new_params;
+            params = new_rc_params;
+            nPart = new_nPart;
+            single_precision = new_single_precision;
+        }
+
+        //! Number of windows tracked by run()
+        size_t numWindows() const {
+            return nPart;
+        }
+
+        //! Track the 2D image pI using the stored windows and parameters
+        //! Sets plhs[0..nlhs-1] = [x,y,varXY,d2,status] (same as radialcenter()); only the requested outputs are computed
+        void run(int nlhs, mxArray* plhs[], const mxArray* pI) {
+            if (!mxIsNumeric(pI) || mxIsComplex(pI) || mxGetNumberOfDimensions(pI) > 2) {
+                throw(std::runtime_error("RadialcenterContext::run: I must be a real, 2D numeric image (use radialcenter() for image stacks)"));
+            }
+
+            // only compute the outputs that were requested
+            params.OutputMask = radialcenter_output_mask(nlhs);
+
+            mxArray* out[5] = { nullptr, nullptr, nullptr, nullptr, nullptr };
+            out[0] = mxCreateUninitNumericMatrix(nPart, 1, mxDOUBLE_CLASS, mxREAL);
+            out[1] = mxCreateUninitNumericMatrix(nPart, 1, mxDOUBLE_CLASS, mxREAL);
+            double* x = mxGetPr(out[0]);
+            double* y = mxGetPr(out[1]);
+
+            double* varXY = nullptr;
+            double* RWR_N = nullptr;
+            double* Status = nullptr;
+            if (params.OutputMask & rcdefs::OUTPUT_VARXY) {
+                out[2] = mxCreateUninitNumericMatrix(nPart, 2, mxDOUBLE_CLASS, mxREAL);
+                varXY = mxGetPr(out[2]);
+            }
+            if (params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+                out[3] = mxCreateUninitNumericMatrix(nPart, 1, mxDOUBLE_CLASS, mxREAL);
+                RWR_N = mxGetPr(out[3]);
+            }
+            if (params.OutputMask & rcdefs::OUTPUT_STATUS) {
+                out[4] = mxCreateUninitNumericMatrix(nPart, 1, mxDOUBLE_CLASS, mxREAL);
+                Status = mxGetPr(out[4]);
+            }
+
+            // size of the image (for ROW_MAJOR_LAYOUT pI holds a row-major frame, i.e. the transposed image)
+            size_t nRows = mxGetM(pI);
+            size_t nCols = mxGetN(pI);
+            if (params.ImageLayout == rcdefs::ROW_MAJOR_LAYOUT) {
+                std::swap(nRows, nCols);
+            }
+
+            switch (mxGetClassID(pI)) { //handle different image types seperately
+            case mxDOUBLE_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (double*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxSINGLE_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (float*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxINT8_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (int8_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxUINT8_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (uint8_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxINT16_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (int16_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxUINT16_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (uint16_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxINT32_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (int32_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxUINT32_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (uint32_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxINT64_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (int64_t*)mxGetData(pI), nRows, nCols);
+                break;
+            case mxUINT64_CLASS:
+                run_typed(x, y, varXY, RWR_N, Status, (uint64_t*)mxGetData(pI), nRows, nCols);
+                break;
+            default:
+                throw(std::runtime_error("RadialcenterContext::run: Only numeric image types allowed"));
+            }
+
+            for (size_t n = 0; n < nPart; ++n) { //shift to 1-indexing
+                x[n] += 1;
+                y[n] += 1;
+            }
+
+            // return the requested outputs (plhs[0] is always set, for ans)
+            int nOut = std::max(1, std::min(nlhs, 5));
+            for (int k = 0; k < 5; ++k) {
+                if (k < nOut) {
+                    plhs[k] = out[k];
+                }
+                else if (out[k] != nullptr) {
+                    mxDestroyArray(out[k]);
+                }
+            }
+        }
+    };
+
+    //! implement mexInterface for RadialcenterContext
+    template<class ObjType, extras::SessionManager::ObjectManager<ObjType>& ObjManager> /*ObjType should be a derivative of RadialcenterContext*/
+    class RadialcenterContextInterface : public SessionManager::mexInterface<ObjType, ObjManager> {
+        typedef SessionManager::mexInterface<ObjType, ObjManager> ParentType;
+    protected:
+        void setWindow(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+            if (nrhs < 2) {
+                throw(std::runtime_error("RadialcenterContext::setWindow requires WIND argument"));
+            }
+            ParentType::getObjectPtr(nrhs, prhs)->setWindow(prhs[1]);
+        }
+        void getWindow(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+            plhs[0] = ParentType::getObjectPtr(nrhs, prhs)->getWindow();
+        }
+        void setParameters(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+            ParentType::getObjectPtr(nrhs, prhs)->setParameters(nrhs - 1, &prhs[1]);
+        }
+        void numWindows(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+            size_t val = ParentType::getObjectPtr(nrhs, prhs)->numWindows();
+            plhs[0] = mxCreateDoubleScalar(val);
+        }
+        void run(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+            if (nrhs < 2) {
+                throw(std::runtime_error("RadialcenterContext::run requires image argument"));
+            }
+            ParentType::getObjectPtr(nrhs, prhs)->run(nlhs, plhs, prhs[1]);
+        }
+
+    public:
+        RadialcenterContextInterface() {
+            using namespace std::placeholders;
+            ParentType::addFunction("setWindow", std::bind(&RadialcenterContextInterface::setWindow, this, _1, _2, _3, _4));
+            ParentType::addFunction("getWindow", std::bind(&RadialcenterContextInterface::getWindow, this, _1, _2, _3, _4));
+            ParentType::addFunction("setParameters", std::bind(&RadialcenterContextInterface::setParameters, this, _1, _2, _3, _4));
+            ParentType::addFunction("numWindows", std::bind(&RadialcenterContextInterface::numWindows, this, _1, _2, _3, _4));
+            ParentType::addFunction("run", std::bind(&RadialcenterContextInterface::run, this, _1, _2, _3, _4));
+        }
+    };
+}}
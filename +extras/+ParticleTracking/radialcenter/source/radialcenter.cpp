@@ -1,19 +1,23 @@
 /*//////////////////////////////
 /// Wrapper for radialcenter, accepting the standard arguments for a mexFunction
-% [x,y,varXY,d2] = radialcenter(I,WIND)
+% [x,y,varXY,d2,status] = radialcenter(I,WIND)
 %                = radialcenter(__,name,value);
 %
 % Estimate the center of radial symmetry of an image
 %
 % Input:
 %   I: the image to process
+%       I can also be an image stack: [nRows x nCols x nFrames] array or cell array of [nRows x nCols] frames
+%       all frames are processed using the same WIND (and parameters), in parallel using nThreads
 %   WIND: [N x 4] specifying windows [x,y,w,h], default is entire image
 %
 % Output:
 %   x,y: center positions
+%       for an image stack x,y are [nPart x nFrames]
 %
 %   varXY: variance estimate of the fit
 %       varXY = [Vx,Vy], where Vx and Vy are the variances of each X and Y
+%       for an image stack varXY is [nPart x 2 x nFrames] and d2 is [nPart x nFrames]
 %
 %   d2: the square of the weighted residual, normalized by the effective number of pixels
 %       d2>>1 indicates poor localization. This roughly characterizes the
@@ -24,6 +28,16 @@
 %      apparent symmetric center, while varXY is useful for characterizing the
 %      precision of the fit
 %
+%   status: reason code for each window (same size as x)
+%       0: window was fit
+%       1: skipped, pixel contrast below RejectThreshold ('RejectMethod','contrast')
+%       2: skipped, gradient below RejectThreshold ('RejectMethod','gradient')
+%       3: fit failed, the center is not finite (e.g. the window has no gradient)
+%       skipped windows return x,y,varXY,d2 = NaN
+%
+%   Only the requested outputs are computed: e.g. [x,y] = radialcenter(...) skips the
+%   accumulation of the weighted residual that is needed for varXY and d2
+%
 %
 % Name,Value Parameters:
 % -------------------------
@@ -38,6 +52,69 @@
 %       method='gradmag': use magnitude of image gradient to find COM (defalut)
 %   'DistanceExponent',value or [v1,v2,...,vN]: distance scaling from center guess Wii *= 1/r_guess^(DistanceExponent)
 %	'GradientExponent',value or [v1,v2,...,vN]: gradient scaling from center guess Wii *= |GradI_i|^(DistanceExponent)
+%   'nThreads',n: number of threads used to process the windows (default=1)
+%       n=0 uses all available processor threads
+%   'GradientKernel','fused' or 'reference': implementation used to compute the smoothed gradient
+%       'fused' (default): single-pass kernel (vectorized if compiled with AVX2/AVX-512 enabled)
+%       'reference': original multi-pass implementation, results are identical
+%           (up to rounding for uint8 and uint16 images, which 'fused' processes using integer arithmetic)
+%   'GradientCache','none','shared', or 'auto': how the smoothed gradient is computed
+%       'none' (default): gradient is computed separately for each window
+%       'shared': gradient is computed once for the region covering all windows and reused by every window
+%           faster when many windows overlap, but pixels on the edge of a window are smoothed
+%           using their neighbors outside the window, so results differ slightly from 'none'
+%       'auto': 'shared' if the windows overlap enough that it requires less computation, otherwise 'none'
+%   'WeightKernelCache',Q: cache the distance dependent weights (default=0, no cache)
+%       the center guess is rounded to 1/Q pixel and the weights for each sub-pixel offset are
+%       computed once and reused by all windows (and frames) with the same parameters
+%       Q>0 changes the result slightly (e.g. Q=16 moves the center guess by at most 1/32 px)
+%   'IntegralImage','none','shared', or 'auto': how the center of mass (COMmethod) is found
+%       'none' (default): the center of mass is summed over each window
+%       'shared': a summed-area table and first moment images are computed once for the region
+%           covering all windows, so the center of mass of each window costs the same regardless of its size
+%           for 'gradmag' this requires the shared gradient (GradientCache), otherwise it is ignored
+%       'auto': 'shared' if the windows overlap enough that it requires less computation, otherwise 'none'
+%   'WindowOrder','morton' or 'input': order in which the windows are processed
+%       'morton' (default): windows are sorted along a Z-order curve through the image, so consecutive
+%           windows (and the windows handled by each thread) read neighboring parts of the frame
+%       'input': windows are processed in the order they are listed
+%       results are always returned in the order of WIND (and are identical for both orders)
+%   'RefineIterations',N: number of refinement passes (default=0, no refinement)
+%       each pass uses the previous solution as the center guess and shrinks the window
+%       to the radius cutoff around it (RadiusCutoff, or the extent of the logistic cutoff)
+%       the gradient of the original window is reused, so refinement never reads new pixels
+%   'RefineTolerance',tol: stop refining once the center moves less than tol px (default=0.001)
+%   'Precision','double' or 'single': floating point type used for the per-pixel calculations
+%       'double' (default)
+%       'single': gradient, weights and sums are computed in single precision (faster)
+%           the sums of each row are added up in double and outputs are always double
+%   'ImageLayout','column' or 'row': memory layout of I
+%       'column' (default): I is the image (MATLAB's column-major order)
+%       'row': I holds a row-major frame, e.g. a camera buffer that was not transposed (size(I)=[width,height])
+%           the frame is tracked in place without a transpose pass; WIND, XYc and x,y refer to the frame,
+%           and the results are the same as radialcenter(I.',...) up to rounding
+%   'RejectMethod','none','contrast', or 'gradient': check used to skip windows that do not contain a particle
+%       'none' (default): every window is fit
+%       'contrast': windows with max(I)-min(I) < RejectThreshold are skipped before the gradient is computed
+%       'gradient': windows with RMS smoothed gradient magnitude < RejectThreshold are skipped
+%           before the center of mass, weights and fit are computed
+%   'RejectThreshold',val: threshold used by RejectMethod, in intensity units of I (default=0)
+%   'PyramidLevels',L: coarse-to-fine search for large windows (default=0, off)
+%       the window is binned by 2^L x 2^L (fewer levels if the binned window would be smaller than 8x8 px)
+%       and the center is located on the binned window, then the fit is repeated at full resolution on a
+%       PyramidWindow sized window around it. Much faster for large ring patterns; the result differs
+%       slightly from fitting the full window. GradientCache and IntegralImage are not used.
+%   'PyramidWindow',w: size (px) of the full-resolution window used by PyramidLevels (default=32)
+%       windows that are not larger than w are fit directly
+%   'LaneBatchSize',w: windows up to w px (both width and height) are processed in batches of windows of the
+%       same size, one window per SIMD lane (default=0, off). Much faster for many small windows (e.g. dense
+%       single-molecule fields with w<=24); the results are the same as processing each window separately
+%       (up to rounding). Only used with a single value of RadiusCutoff, CutoffFactor, DistanceExponent and
+%       GradientExponent, COMmethod 'gradmag' (or valid XYc), GradientKernel 'fused', and without
+%       GradientCache, IntegralImage, WeightKernelCache, RefineIterations, RejectMethod and PyramidLevels.
+%   'FixedSizeKernels',tf: use the weight loops compiled for 32, 48 and 64 px windows when a window has one
+%       of those sizes and the exponents are integers (default=true). The results are the same as with
+%       false (the generic loop), up to rounding.
 */
 
 /*--------------------------------------------------
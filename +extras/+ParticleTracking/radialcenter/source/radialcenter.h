@@ -12,12 +12,47 @@ Version of radial center which does not use extras::ArrayBase class
 
 #include <algorithm>
 #include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 #include <extras/assert.hpp>
 #include <extras/string_extras.hpp>
+#include <extras/ImageView.hpp>
+
+#include "radialcenter_weights.h"
+#include "radialcenter_lanes.h"
 
 namespace rcdefs {
 	enum COM_METHOD { MEAN_ABS, NORMAL, GRAD_MAG };
+	enum GRADIENT_KERNEL { FUSED_GRADIENT, REFERENCE_GRADIENT };
+	enum GRADIENT_CACHE { NO_GRADIENT_CACHE, SHARED_GRADIENT_CACHE, AUTO_GRADIENT_CACHE };
+	enum INTEGRAL_IMAGE { NO_INTEGRAL_IMAGE, SHARED_INTEGRAL_IMAGE, AUTO_INTEGRAL_IMAGE };
+	enum WINDOW_ORDER { INPUT_ORDER, MORTON_ORDER };
+	enum IMAGE_LAYOUT { COLUMN_MAJOR_LAYOUT, ROW_MAJOR_LAYOUT };
+	enum REJECT_METHOD { NO_REJECT, CONTRAST_REJECT, GRADIENT_REJECT };
+
+	//! Status code returned for each window by radialcenter()
+	enum WINDOW_STATUS {
+		WINDOW_OK = 0, //window was fit
+		WINDOW_LOW_CONTRAST = 1, //skipped: pixel range below RejectThreshold (RejectMethod=CONTRAST_REJECT)
+		WINDOW_LOW_GRADIENT = 2, //skipped: RMS gradient magnitude below RejectThreshold (RejectMethod=GRADIENT_REJECT)
+		WINDOW_FIT_FAILED = 3 //fit did not produce a finite center (e.g. the window has no gradient)
+	};
+
+	//! Optional outputs of radialcenter() (bit mask, x and y are always computed)
+	//! varXY and RWR_N require the weighted residual moments, which are not accumulated
+	//! if neither is requested
+	enum OUTPUT_MASK {
+		OUTPUT_XY = 0,
+		OUTPUT_VARXY = 1,
+		OUTPUT_RWR_N = 2,
+		OUTPUT_STATUS = 4,
+		OUTPUT_ALL = OUTPUT_VARXY | OUTPUT_RWR_N | OUTPUT_STATUS
+	};
 
 	// Apply 3x3 average to image
 	// Edges are corrected so they are 2x3 (corners are 2x2)
@@ -29,47 +64,57 @@ namespace rcdefs {
 	// O: pointer to pre-allocated Output
 	// 	strideO: stride of output O(y,x) = O[y+strideO*x]
 	// 	O must have same dim as I, but stride can be different
-	template<typename M>
-	void mean3x3(const M *I, size_t Ny, size_t Nx, size_t strideI, double* O, size_t strideO) {
-
-		double * Ot = (double*)malloc(Ny*Nx * sizeof(double));
+	// work: optional pre-allocated buffer with space for Ny*Nx elements
+	//	if nullptr, a temporary buffer is allocated
+	template<typename M, typename T = double>
+	void mean3x3(const M *I, size_t Ny, size_t Nx, size_t strideI, T* O, size_t strideO, T* work = nullptr) {
+
+		T * Ot = work;
+		if (work == nullptr) {
+			Ot = (T*)malloc(Ny*Nx * sizeof(T));
+			if (Ot == nullptr) {
+				throw std::bad_alloc();
+			}
+		}
 		// filter along x using 1x3
 		for (size_t y = 0; y<Ny; ++y) {
 			//handle first column separately
-			Ot[y] = double(I[y] + I[y + strideI * 1]) / 2.0;
+			Ot[y] = T(I[y] + I[y + strideI * 1]) / T(2.0);
 
 			//middle no special handling needed
 			for (size_t x = 1; x<Nx - 1; ++x) {
-				Ot[y + Ny*(x)] = double(I[y + strideI*(x - 1)] + I[y + strideI*(x)] + I[y + strideI*(x + 1)]) / 3.0;
+				Ot[y + Ny*(x)] = T(I[y + strideI*(x - 1)] + I[y + strideI*(x)] + I[y + strideI*(x + 1)]) / T(3.0);
 			}
 
 			//handle last column separately
-			Ot[y + Ny*(Nx - 1)] = double(I[y + strideI*(Nx - 2)] + I[y + strideI*(Nx - 1)]) / 2.0;
+			Ot[y + Ny*(Nx - 1)] = T(I[y + strideI*(Nx - 2)] + I[y + strideI*(Nx - 1)]) / T(2.0);
 		}
 
 		//filter along y using 3x1
 		for (size_t x = 0; x<Nx; ++x) {
 			//handle first row separately
-			O[strideO*x] = (Ot[Ny*x] + Ot[1 + Ny*x]) / 2.0;
+			O[strideO*x] = (Ot[Ny*x] + Ot[1 + Ny*x]) / T(2.0);
 
 			//middle no special handling needed
 			for (size_t y = 1; y<Ny - 1; ++y) {
-				O[y + strideO*(x)] = (Ot[y - 1 + Ny*(x)] + Ot[y + Ny*(x)] + Ot[y + 1 + Ny*(x)]) / 3.0;
+				O[y + strideO*(x)] = (Ot[y - 1 + Ny*(x)] + Ot[y + Ny*(x)] + Ot[y + 1 + Ny*(x)]) / T(3.0);
 			}
 
 			//handle last row separately
-			O[Ny - 1 + strideO*x] = (Ot[Ny - 2 + Ny*x] + Ot[Ny - 1 + Ny*x]) / 2.0;
+			O[Ny - 1 + strideO*x] = (Ot[Ny - 2 + Ny*x] + Ot[Ny - 1 + Ny*x]) / T(2.0);
 		}
 
-		free(Ot);
+		if (work == nullptr) {
+			free(Ot);
+		}
 
 	}
 
 	// Alias to mean3x3(...)
 	// calls mean3x3 w/ strideI=stride)=Ny
-	template <typename M>
-	void mean3x3(const M *I, size_t Ny, size_t Nx, double* O) {
-		mean3x3<M>(I, Ny, Nx, Ny, O, Ny);
+	template <typename M, typename T>
+	void mean3x3(const M *I, size_t Ny, size_t Nx, T* O, T* work = nullptr) {
+		mean3x3<M,T>(I, Ny, Nx, Ny, O, Ny, work);
 	}
 
 	// Calculate 3x3-smoothed image gradient
@@ -77,29 +122,50 @@ namespace rcdefs {
 	// du and dv should point to pre-allocated extras::Arrays of size dNy x dNx
 	// corresponding to the window height and width:
 	//		dNy = y2-y1; dNx = x2-x1;
-	template<typename M>
-	void smoothgrad(const M *I, size_t stride, double *du, double * dv, size_t dNy, size_t dNx) {
+	// work: optional pre-allocated buffer with space for 3*dNy*dNx elements
+	//	if nullptr, temporary buffers are allocated
+	template<typename M, typename T = double>
+	void smoothgrad(const M *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, T* work = nullptr) {
+
+		if (dNy == 0 || dNx == 0) { //empty window, nothing to smooth
+			return;
+		}
 
 		//temp variables
-		double *tmp_u, *tmp_v; //finite grad
+		T *tmp_u, *tmp_v; //finite grad
+		T *tmp_mean = nullptr; //buffer used by mean3x3
 
-		tmp_u = (double*)malloc(dNy*dNx * sizeof(double));
-		tmp_v = (double*)malloc(dNy*dNx * sizeof(double));
+		if (work != nullptr) {
+			tmp_u = work;
+			tmp_v = work + dNy * dNx;
+			tmp_mean = work + 2 * dNy*dNx;
+		}
+		else {
+			tmp_u = (T*)malloc(dNy*dNx * sizeof(T));
+			tmp_v = (T*)malloc(dNy*dNx * sizeof(T));
+			if (tmp_u == nullptr || tmp_v == nullptr) {
+				free(tmp_u);
+				free(tmp_v);
+				throw std::bad_alloc();
+			}
+		}
 
 		// calc finite difference
 		for (size_t x = 0; x < dNx; ++x) {
 			for (size_t y = 0; y < dNy; ++y) {
-				tmp_u[y + x*dNy] = (double)I[(y + 1) + (x + 1)*stride] - (double)I[(y)+(x)*stride];
-				tmp_v[y + x*dNy] = (double)I[(y + 1) + (x)*stride] - (double)I[(y)+(x + 1)*stride];
+				tmp_u[y + x*dNy] = (T)I[(y + 1) + (x + 1)*stride] - (T)I[(y)+(x)*stride];
+				tmp_v[y + x*dNy] = (T)I[(y + 1) + (x)*stride] - (T)I[(y)+(x + 1)*stride];
 			}
 		}
 
 		// apply 3x3 smoothing
-		mean3x3(tmp_u, dNy, dNx, du);
-		mean3x3(tmp_v, dNy, dNx, dv);
+		mean3x3(tmp_u, dNy, dNx, du, tmp_mean);
+		mean3x3(tmp_v, dNy, dNx, dv, tmp_mean);
 
-		free(tmp_u);
-		free(tmp_v);
+		if (work == nullptr) {
+			free(tmp_u);
+			free(tmp_v);
+		}
 	}
 
     /*template<typename M>
@@ -111,6 +177,12 @@ namespace rcdefs {
         return data[r+c*stride];
     }*/
 
+	//! square of a value, computed in the type of the argument
+	template<typename T>
+	inline T sqr(T v) {
+		return v * v;
+	}
+
 	//!safely realloc memory
 	//throws bad_alloc if realloc fails
 	// frees p before throwing error
@@ -122,8 +194,490 @@ namespace rcdefs {
 		}
 		return p2;
 	}
+
+	//! Scratch buffers used while processing a single window
+	//! Each worker thread owns one of these so that windows can be processed concurrently.
+	//! Buffers only grow (they are never shrunk or freed until the scratch is destroyed),
+	//! so once the largest window has been processed no further allocations are made.
+	//! The scratch also remembers the extent of the last window it processed so that
+	//! consecutive windows with identical extents can skip recomputing the gradient.
+	//! T is the compute type (double or float) used for the per-pixel buffers
+	template<typename T = double>
+	struct RadialcenterScratch {
+		T * du = nullptr;
+		T * dv = nullptr;
+		T * GradMag = nullptr;
+		bool calced_grad_mag = false;
+		T * colbuf = nullptr; //column buffer used by smoothgrad_fused()
+		T * refbuf = nullptr; //work buffer used by the reference smoothgrad()
+		T * pyramid = nullptr; //binned copy of a window (params.PyramidLevels>0)
+		T * lanes = nullptr; //lane-interleaved tile, gradient and column buffer of a batch of windows (params.LaneBatchSize>0)
+
+		size_t GradCap = 0; //number of elements allocated for du,dv
+		size_t GradMagCap = 0; //number of elements allocated for GradMag
+		size_t colbufCap = 0; //number of elements allocated for colbuf
+		size_t refbufCap = 0; //number of elements allocated for refbuf
+		size_t pyramidCap = 0; //number of elements allocated for pyramid
+		size_t lanesCap = 0; //number of elements allocated for lanes
+		size_t nAllocations = 0; //number of times a buffer has been allocated
+
+		bool has_window = false; //flag specifying if Ix1..Iy2 hold a valid (already computed) window
+		size_t Ix1 = 0;
+		size_t Iy1 = 0;
+		size_t Ix2 = 0;
+		size_t Iy2 = 0;
+
+		WeightKernelCache<T> weight_cache; //precomputed distance weights (used if params.WeightKernelCache>0)
+
+		RadialcenterScratch() = default;
+		RadialcenterScratch(const RadialcenterScratch&) = delete;
+		RadialcenterScratch& operator=(const RadialcenterScratch&) = delete;
+
+		~RadialcenterScratch() {
+			std::free(du);
+			std::free(dv);
+			std::free(GradMag);
+			std::free(colbuf);
+			std::free(refbuf);
+			std::free(pyramid);
+			std::free(lanes);
+		}
+
+		//! make sure du, dv can hold n elements
+		void reserve_gradient(size_t n) {
+			if (n > GradCap) {
+				grow(du, n);
+				grow(dv, n);
+				GradCap = n;
+			}
+		}
+
+		//! make sure GradMag can hold n elements
+		void reserve_gradmag(size_t n) {
+			if (n > GradMagCap) {
+				grow(GradMag, n);
+				GradMagCap = n;
+			}
+		}
+
+		//! make sure colbuf can hold n elements
+		void reserve_colbuf(size_t n) {
+			if (n > colbufCap) {
+				grow(colbuf, n);
+				colbufCap = n;
+			}
+		}
+
+		//! make sure refbuf can hold n elements
+		void reserve_refbuf(size_t n) {
+			if (n > refbufCap) {
+				grow(refbuf, n);
+				refbufCap = n;
+			}
+		}
+
+		//! make sure pyramid can hold n elements
+		void reserve_pyramid(size_t n) {
+			if (n > pyramidCap) {
+				grow(pyramid, n);
+				pyramidCap = n;
+			}
+		}
+
+		//! make sure lanes can hold n elements
+		void reserve_lanes(size_t n) {
+			if (n > lanesCap) {
+				grow(lanes, n);
+				lanesCap = n;
+			}
+		}
+
+	private:
+		//! replace p with a new (uninitialized) buffer of n elements
+		//! throws bad_alloc if allocation fails
+		void grow(T*& p, size_t n) {
+			std::free(p);
+			p = (T*)std::malloc(n * sizeof(T));
+			if (p == nullptr) {
+				throw std::bad_alloc();
+			}
+			++nAllocations;
+		}
+	};
+
+	//! Smoothed gradient of a region of the image
+	//! Computed once per image and read (concurrently) by every window inside the region
+	//! du and dv have size (Iy2-Iy1) x (Ix2-Ix1), with column stride (Iy2-Iy1)
+	template<typename T = double>
+	struct SharedGradient {
+		T * du = nullptr;
+		T * dv = nullptr;
+		size_t GradCap = 0; //number of elements allocated for du,dv
+		size_t nAllocations = 0; //number of times du,dv have been allocated
+
+		size_t Ix1 = 0; //extent of the region in the image
+		size_t Iy1 = 0;
+		size_t Ix2 = 0;
+		size_t Iy2 = 0;
+
+		SharedGradient() = default;
+		SharedGradient(const SharedGradient&) = delete;
+		SharedGradient& operator=(const SharedGradient&) = delete;
+
+		~SharedGradient() {
+			std::free(du);
+			std::free(dv);
+		}
+
+		//! column stride of du and dv
+		size_t stride() const {
+			return Iy2 - Iy1;
+		}
+
+		//! make sure du, dv can hold n elements
+		void reserve(size_t n) {
+			if (n > GradCap) {
+				std::free(du);
+				std::free(dv);
+				du = (T*)std::malloc(n * sizeof(T));
+				dv = (T*)std::malloc(n * sizeof(T));
+				if (du == nullptr || dv == nullptr) {
+					std::free(du);
+					std::free(dv);
+					du = nullptr;
+					dv = nullptr;
+					GradCap = 0;
+					throw std::bad_alloc();
+				}
+				GradCap = n;
+				nAllocations += 2;
+			}
+		}
+	};
+
+	//! Summed-area table (integral image) and first moment images of a region
+	//! Computed once per image and read (concurrently) by every window inside the region,
+	//! so the sum and first moments of any window are found from 4 elements of each table.
+	//! For pixel values v(y,x) of the region (x=0...nX-1, y=0...nY-1):
+	//!		S(y,x) = sum_{y'<y, x'<x} v(y',x')
+	//!		Sx(y,x) = sum_{y'<y, x'<x} x'*v(y',x')
+	//!		Sy(y,x) = sum_{y'<y, x'<x} y'*v(y',x')
+	//! The tables are (nY+1) x (nX+1), column-major, with column stride nY+1
+	struct IntegralImage {
+		double * S = nullptr;
+		double * Sx = nullptr;
+		double * Sy = nullptr;
+		size_t Cap = 0; //number of elements allocated for S,Sx,Sy
+		size_t nAllocations = 0; //number of times S,Sx,Sy have been allocated
+
+		size_t Ix1 = 0; //origin of the region (in image or gradient coordinates)
+		size_t Iy1 = 0;
+		size_t nX = 0; //size of the region
+		size_t nY = 0;
+
+		IntegralImage() = default;
+		IntegralImage(const IntegralImage&) = delete;
+		IntegralImage& operator=(const IntegralImage&) = delete;
+
+		~IntegralImage() {
+			std::free(S);
+			std::free(Sx);
+			std::free(Sy);
+		}
+
+		//! column stride of S, Sx and Sy
+		size_t stride() const {
+			return nY + 1;
+		}
+
+		//! make sure S, Sx, Sy can hold n elements
+		void reserve(size_t n) {
+			if (n > Cap) {
+				std::free(S);
+				std::free(Sx);
+				std::free(Sy);
+				S = (double*)std::malloc(n * sizeof(double));
+				Sx = (double*)std::malloc(n * sizeof(double));
+				Sy = (double*)std::malloc(n * sizeof(double));
+				if (S == nullptr || Sx == nullptr || Sy == nullptr) {
+					std::free(S);
+					std::free(Sx);
+					std::free(Sy);
+					S = nullptr;
+					Sx = nullptr;
+					Sy = nullptr;
+					Cap = 0;
+					throw std::bad_alloc();
+				}
+				Cap = n;
+				nAllocations += 3;
+			}
+		}
+
+		//! Build the tables for a region of size ny x nx
+		//! value(y,x) returns the (double) value of pixel (y,x) of the region
+		//! The region is traversed column by column, so value() should read column-major data
+		template<typename F>
+		void build(size_t ny, size_t nx, F value) {
+			nY = ny;
+			nX = nx;
+			const size_t st = stride();
+			reserve(st*(nX + 1));
+
+			for (size_t y = 0; y < st; ++y) {
+				S[y] = 0;
+				Sx[y] = 0;
+				Sy[y] = 0;
+			}
+			for (size_t x = 0; x < nX; ++x) {
+				const double* S0 = S + x*st; //previous column
+				const double* Sx0 = Sx + x*st;
+				const double* Sy0 = Sy + x*st;
+				double* S1 = S + (x + 1)*st; //this column
+				double* Sx1 = Sx + (x + 1)*st;
+				double* Sy1 = Sy + (x + 1)*st;
+				S1[0] = 0;
+				Sx1[0] = 0;
+				Sy1[0] = 0;
+
+				double c = 0; //running sums of this column
+				double cy = 0;
+				for (size_t y = 0; y < nY; ++y) {
+					double v = value(y, x);
+					c += v;
+					cy += double(y)*v;
+					S1[y + 1] = S0[y + 1] + c;
+					Sx1[y + 1] = Sx0[y + 1] + double(x)*c;
+					Sy1[y + 1] = Sy0[y + 1] + cy;
+				}
+			}
+		}
+
+		//! Sum (s) and first moments (mx, my) of the rectangle [y1,y2) x [x1,x2) of the region
+		//! The moments are relative to (y1,x1), i.e. mx = sum (x-x1)*v(y,x)
+		void rect(size_t y1, size_t x1, size_t y2, size_t x2, double& s, double& mx, double& my) const {
+			const size_t st = stride();
+			const size_t i11 = y1 + x1*st;
+			const size_t i21 = y2 + x1*st;
+			const size_t i12 = y1 + x2*st;
+			const size_t i22 = y2 + x2*st;
+			s = S[i22] - S[i21] - S[i12] + S[i11];
+			mx = Sx[i22] - Sx[i21] - Sx[i12] + Sx[i11] - double(x1)*s;
+			my = Sy[i22] - Sy[i21] - Sy[i12] + Sy[i11] - double(y1)*s;
+		}
+	};
+
+	//! Windows of radialcenter() grouped into tasks for the lane kernels (params.LaneBatchSize>0)
+	//! Task t processes windows[start[t]...start[t+1]-1]: either a single window, or a batch of
+	//! simd::pack<T>::width windows of the same size (one window per SIMD lane, see radialcenter_lanes.h)
+	//! The vectors only grow, so once they hold the largest number of windows no further allocations are made.
+	struct RadialcenterTasks {
+		std::vector<std::pair<uint64_t, size_t>> batched; //(size key, processing position) of the windows that can be batched
+		std::vector<size_t> windows; //window indices of the tasks
+		std::vector<size_t> start; //first element of windows of each task (and one past the last task)
+		size_t nAllocations = 0; //number of times the vectors have been grown
+
+		//! number of tasks
+		size_t count() const {
+			return start.size() - 1;
+		}
+
+		//! clear the tasks, and make sure nPart windows fit without reallocating
+		void reset(size_t nPart) {
+			if (nPart > batched.capacity() || nPart > windows.capacity() || nPart + 1 > start.capacity()) {
+				++nAllocations;
+			}
+			batched.clear();
+			windows.clear();
+			start.clear();
+			batched.reserve(nPart);
+			windows.reserve(nPart);
+			start.reserve(nPart + 1);
+		}
+
+		//! add a task processing windows w[0...count-1]
+		void add(const size_t* w, size_t count) {
+			start.push_back(windows.size());
+			windows.insert(windows.end(), w, w + count);
+		}
+	};
+
+	//! Morton (Z-order curve) key of a point: interleaves the bits of x and y
+	//! Points that are close in the image have (mostly) close keys
+	inline uint64_t morton_key(uint32_t x, uint32_t y) {
+		auto spread = [](uint64_t v) { //insert a zero bit between each bit of v
+			v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+			v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+			v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+			v = (v | (v << 2)) & 0x3333333333333333ull;
+			v = (v | (v << 1)) & 0x5555555555555555ull;
+			return v;
+		};
+		return (spread(x) << 1) | spread(y);
+	}
+
+	//! Resolve requested number of threads
+	//! nThreads==0 means use all hardware threads
+	//! result is limited to the number of tasks
+	inline size_t resolve_threads(size_t nThreads, size_t nTasks) {
+		if (nThreads == 0) {
+			nThreads = std::max(1u, std::thread::hardware_concurrency());
+		}
+		return std::max(size_t(1), std::min(nThreads, nTasks));
+	}
+
+	//! Persistent pool of worker threads used by parallel_for()
+	//! Workers are started the first time they are needed and then wait on a condition variable
+	//! between calls, so repeated calls neither start threads nor allocate memory.
+	//! The calling thread takes part in every call as thread_id 0. A pool must not be used by two
+	//! calls at the same time (each RadialcenterWorkspace owns its own pool).
+	class ThreadPool {
+	protected:
+		std::vector<std::thread> _threads; //worker thread_id = index+1
+		std::mutex _mutex;
+		std::condition_variable _wake; //signals workers that a job was posted (or that the pool is stopping)
+		std::condition_variable _done; //signals the calling thread that all workers finished the job
+		size_t _generation = 0; //incremented for each job
+		size_t _nActive = 0; //threads taking part in the current job (including the calling thread)
+		size_t _nRunning = 0; //workers that have not finished the current job
+		bool _stop = false;
+
+		// current job: _call(_ctx, task, thread_id)
+		void(*_call)(void*, size_t, size_t) = nullptr;
+		void* _ctx = nullptr;
+		size_t _nTasks = 0;
+		std::atomic<size_t> _next_task{ 0 };
+		std::atomic<bool> _abort{ false };
+		std::exception_ptr _first_error = nullptr;
+
+		//! run tasks of the current job until there are none left
+		void work(size_t thread_id) {
+			try {
+				size_t n;
+				while (!_abort && (n = _next_task.fetch_add(1)) < _nTasks) {
+					_call(_ctx, n, thread_id);
+				}
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (!_first_error) {
+					_first_error = std::current_exception();
+				}
+				_abort = true;
+			}
+		}
+
+		//! worker loop; generation is the last job the worker has seen
+		void worker(size_t thread_id, size_t generation) {
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (true) {
+				_wake.wait(lock, [&]() { return _stop || _generation != generation; });
+				if (_stop) {
+					return;
+				}
+				generation = _generation;
+				if (thread_id >= _nActive) { //not needed for this job
+					continue;
+				}
+				lock.unlock();
+				work(thread_id);
+				lock.lock();
+				if (--_nRunning == 0) {
+					_done.notify_one();
+				}
+			}
+		}
+
+	public:
+		size_t nAllocations = 0; //number of times worker threads were started
+
+		ThreadPool() = default;
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (auto& th : _threads) {
+				th.join();
+			}
+		}
+
+		//! number of threads a call can use without starting new workers (including the calling thread)
+		size_t nThreads() const {
+			return _threads.size() + 1;
+		}
+
+		//! Execute fn(task, thread_id) for task=0...nTasks-1 using nThreads threads (see parallel_for())
+		template<class Fn>
+		void run(size_t nTasks, size_t nThreads, Fn& fn) {
+			if (_threads.size() < nThreads - 1) { //start the missing workers
+				++nAllocations;
+				_threads.reserve(nThreads - 1);
+				while (_threads.size() < nThreads - 1) {
+					_threads.emplace_back(&ThreadPool::worker, this, _threads.size() + 1, _generation);
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_call = [](void* ctx, size_t n, size_t thread_id) { (*static_cast<Fn*>(ctx))(n, thread_id); };
+				_ctx = &fn;
+				_nTasks = nTasks;
+				_next_task = 0;
+				_abort = false;
+				_first_error = nullptr;
+				_nActive = nThreads;
+				_nRunning = nThreads - 1;
+				++_generation;
+			}
+			_wake.notify_all();
+
+			work(0); //calling thread also does work
+
+			std::exception_ptr err;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_done.wait(lock, [&]() { return _nRunning == 0; });
+				std::swap(err, _first_error);
+			}
+			if (err) {
+				std::rethrow_exception(err);
+			}
+		}
+	};
+
+	//! Execute fn(task, thread_id) for task=0...nTasks-1 using nThreads threads of pool
+	//! Tasks are handed out dynamically so that windows of different size are balanced across threads.
+	//! If any task throws, remaining tasks are abandoned and the first exception is rethrown in the calling thread.
+	//! With a single thread the tasks are run in the calling thread, without using the pool.
+	template<class Fn>
+	void parallel_for(ThreadPool& pool, size_t nTasks, size_t nThreads, Fn&& fn) {
+		nThreads = resolve_threads(nThreads, nTasks);
+		if (nThreads == 1) { //run serially in calling thread
+			for (size_t n = 0; n < nTasks; ++n) {
+				fn(n, size_t(0));
+			}
+			return;
+		}
+		pool.run(nTasks, nThreads, fn);
+	}
+
+	//! Pixels of the region of img starting at (y1,x1), in the column-major layout expected by the gradient kernels.
+	//! stride is set to the column stride of the returned data (the pixels are used in place).
+	//! Only defined for column-major images: radialcenter() processes a row-major image through its transposed view.
+	template<typename M>
+	const M* column_major_region(const extras::ImageView<M, extras::ColumnMajor>& img, size_t y1, size_t x1, size_t& stride) {
+		stride = img.stride;
+		return img.ptr(y1, x1);
+	}
 }
 
+#include "smoothgrad_simd.h"
+
 namespace extras{ namespace ParticleTracking{
 
 	//! Convert string into valid COMmethod
@@ -151,6 +705,158 @@ namespace extras{ namespace ParticleTracking{
 		}
 	}
 
+	//! Convert string into valid GradientKernel
+	//! throws error if string does not correspond to valid kernel
+	//!
+	//! Valid Strings:
+	//!		"fused" (default, single-pass vectorized kernel)
+	//!		"reference" (original multi-pass implementation)
+	rcdefs::GRADIENT_KERNEL string2GradientKernel(std::string kern) {
+		kern = tolower(kern);
+
+		if (kern.compare("fused") == 0) {
+			return rcdefs::FUSED_GRADIENT;
+		}
+		else if (kern.compare("reference") == 0) {
+			return rcdefs::REFERENCE_GRADIENT;
+		}
+		else {
+			throw(std::runtime_error("GradientKernel invalid"));
+		}
+	}
+
+	//! Convert string into valid GradientCache mode
+	//! throws error if string does not correspond to valid mode
+	//!
+	//! Valid Strings:
+	//!		"none" (default, gradient is computed separately for each window)
+	//!		"shared" (gradient is computed once for the region covering all windows)
+	//!		"auto" (shared if the windows overlap enough that it is cheaper)
+	rcdefs::GRADIENT_CACHE string2GradientCache(std::string mode) {
+		mode = tolower(mode);
+
+		if (mode.compare("none") == 0) {
+			return rcdefs::NO_GRADIENT_CACHE;
+		}
+		else if (mode.compare("shared") == 0) {
+			return rcdefs::SHARED_GRADIENT_CACHE;
+		}
+		else if (mode.compare("auto") == 0) {
+			return rcdefs::AUTO_GRADIENT_CACHE;
+		}
+		else {
+			throw(std::runtime_error("GradientCache invalid"));
+		}
+	}
+
+	//! Convert string into valid IntegralImage mode
+	//! throws error if string does not correspond to valid mode
+	//!
+	//! Valid Strings:
+	//!		"none" (default, center of mass is summed separately for each window)
+	//!		"shared" (integral image is computed once for the region covering all windows)
+	//!		"auto" (shared if the windows overlap enough that it is cheaper)
+	rcdefs::INTEGRAL_IMAGE string2IntegralImage(std::string mode) {
+		mode = tolower(mode);
+
+		if (mode.compare("none") == 0) {
+			return rcdefs::NO_INTEGRAL_IMAGE;
+		}
+		else if (mode.compare("shared") == 0) {
+			return rcdefs::SHARED_INTEGRAL_IMAGE;
+		}
+		else if (mode.compare("auto") == 0) {
+			return rcdefs::AUTO_INTEGRAL_IMAGE;
+		}
+		else {
+			throw(std::runtime_error("IntegralImage invalid"));
+		}
+	}
+
+	//! Convert string into valid WindowOrder
+	//! throws error if string does not correspond to valid order
+	//!
+	//! Valid Strings:
+	//!		"morton" (default, windows are processed along a Z-order curve through the image)
+	//!		"input" (windows are processed in the order they are listed)
+	rcdefs::WINDOW_ORDER string2WindowOrder(std::string order) {
+		order = tolower(order);
+
+		if (order.compare("morton") == 0) {
+			return rcdefs::MORTON_ORDER;
+		}
+		else if (order.compare("input") == 0) {
+			return rcdefs::INPUT_ORDER;
+		}
+		else {
+			throw(std::runtime_error("WindowOrder invalid"));
+		}
+	}
+
+	//! Convert string into valid ImageLayout
+	//! throws error if string does not correspond to valid layout
+	//!
+	//! Valid Strings:
+	//!		"column" (default, column-major, I(y,x) = I[y+nRows*x])
+	//!		"row" (row-major, I(y,x) = I[x+nCols*y])
+	rcdefs::IMAGE_LAYOUT string2ImageLayout(std::string layout) {
+		layout = tolower(layout);
+
+		if (layout.compare("column") == 0) {
+			return rcdefs::COLUMN_MAJOR_LAYOUT;
+		}
+		else if (layout.compare("row") == 0) {
+			return rcdefs::ROW_MAJOR_LAYOUT;
+		}
+		else {
+			throw(std::runtime_error("ImageLayout invalid"));
+		}
+	}
+
+	//! Convert string into valid RejectMethod
+	//! throws error if string does not correspond to valid method
+	//!
+	//! Valid Strings:
+	//!		"none" (default, every window is fit)
+	//!		"contrast" (skip windows with max(I)-min(I) < RejectThreshold)
+	//!		"gradient" (skip windows with RMS smoothed gradient magnitude < RejectThreshold)
+	rcdefs::REJECT_METHOD string2RejectMethod(std::string method) {
+		method = tolower(method);
+
+		if (method.compare("none") == 0) {
+			return rcdefs::NO_REJECT;
+		}
+		else if (method.compare("contrast") == 0) {
+			return rcdefs::CONTRAST_REJECT;
+		}
+		else if (method.compare("gradient") == 0) {
+			return rcdefs::GRADIENT_REJECT;
+		}
+		else {
+			throw(std::runtime_error("RejectMethod invalid"));
+		}
+	}
+
+	//! Convert Precision string into flag specifying if the single precision (float) compute path should be used
+	//! throws error if string does not correspond to valid precision
+	//!
+	//! Valid Strings:
+	//!		"double" (default)
+	//!		"single"
+	bool string2SinglePrecision(std::string prec) {
+		prec = tolower(prec);
+
+		if (prec.compare("double") == 0) {
+			return false;
+		}
+		else if (prec.compare("single") == 0) {
+			return true;
+		}
+		else {
+			throw(std::runtime_error("Precision invalid"));
+		}
+	}
+
     struct RadialcenterParameters{
         double default_RadiusCutoff = INFINITY;
         double default_CutoffFactor = INFINITY;
@@ -170,6 +876,22 @@ namespace extras{ namespace ParticleTracking{
         size_t nDistanceExponent = 1;
         double* GradientExponent = &default_GradientExponent;
         size_t nGradientExponent = 1;
+        size_t nThreads = 1; //number of worker threads used to process windows (0 = use all hardware threads)
+        rcdefs::GRADIENT_KERNEL GradientKernel = rcdefs::FUSED_GRADIENT; //implementation used for the smoothed gradient
+        rcdefs::GRADIENT_CACHE GradientCache = rcdefs::NO_GRADIENT_CACHE; //compute gradient per window, or once for all windows
+        size_t WeightKernelCache = 0; //number of sub-pixel steps used to quantize the center guess for cached weight kernels (0 = no cache)
+        bool FixedSizeKernels = true; //use the weight loops compiled for 32, 48 and 64 px windows when a window has one of those sizes
+        rcdefs::INTEGRAL_IMAGE IntegralImage = rcdefs::NO_INTEGRAL_IMAGE; //sum center of mass per window, or use an integral image of all windows
+        rcdefs::WINDOW_ORDER WindowOrder = rcdefs::MORTON_ORDER; //order in which windows are processed (results are returned in input order)
+        size_t RefineIterations = 0; //number of times the solution is used as the new center guess (with the window shrunk around it)
+        double RefineTolerance = 0.001; //stop refining once the center moves less than this (px)
+        rcdefs::IMAGE_LAYOUT ImageLayout = rcdefs::COLUMN_MAJOR_LAYOUT; //memory layout of images passed by pointer (image views carry their own layout)
+        rcdefs::REJECT_METHOD RejectMethod = rcdefs::NO_REJECT; //check used to skip windows that do not contain a particle
+        double RejectThreshold = 0; //windows scoring below this are skipped (units of the image intensity)
+        unsigned OutputMask = rcdefs::OUTPUT_ALL; //outputs that are computed (rcdefs::OUTPUT_MASK); the others are not written and may be nullptr
+        size_t PyramidLevels = 0; //number of 2x binning levels used to locate the center before the full-resolution fit (0 = off)
+        size_t PyramidWindow = 32; //size (px) of the full-resolution window fit around the center found on the binned window
+        size_t LaneBatchSize = 0; //windows up to this size (px) are processed in batches, one window per SIMD lane (0 = off, see radialcenter_lane_batch())
 
         RadialcenterParameters() = default;
         RadialcenterParameters(const RadialcenterParameters&) = default;
@@ -179,589 +901,1591 @@ namespace extras{ namespace ParticleTracking{
 
     };
 
-    template <typename M>
-    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
-        const M* img, size_t nRows, size_t nCols, //image and size (assume column-major indexing)
-        const RadialcenterParameters& params = RadialcenterParameters()//, //parameters
-		//double * oXYc=nullptr
-        )
-    {
-        // Check Input Dimensions and Parameters
-		//---------------------------------------
-		using namespace std;
-        using namespace rcdefs;
+    //! Reusable working memory for radialcenter()
+    //! The workspace holds one set of scratch buffers for each worker thread.
+    //! Buffers only grow, so once the workspace has processed the largest windows used by the caller
+    //! repeated calls to radialcenter() do not allocate any memory.
+    //! A workspace can be reused for any number of calls (and images), but it must not be
+    //! used by two calls to radialcenter() at the same time.
+    //! The worker threads used when params.nThreads>1 are also kept by the workspace (see rcdefs::ThreadPool).
+    //! T is the compute type (double or float) and must match the type used by radialcenter<T>()
+    template<typename T = double>
+    class RadialcenterWorkspace {
+    protected:
+        std::vector<std::unique_ptr<rcdefs::RadialcenterScratch<T>>> _scratch;
+        std::unique_ptr<rcdefs::SharedGradient<T>> _shared;
+        std::unique_ptr<rcdefs::IntegralImage> _integral;
+        std::vector<std::pair<uint64_t, size_t>> _order; //(sort key, window index) in processing order
+        size_t _orderAllocations = 0;
+        std::vector<double> _transposed; //WIND and XYc of the transposed image (row-major images)
+        size_t _transposedAllocations = 0;
+        rcdefs::RadialcenterTasks _tasks; //windows grouped for the lane kernels
+        std::unique_ptr<rcdefs::ThreadPool> _pool; //worker threads
+    public:
+        RadialcenterWorkspace() = default;
+        RadialcenterWorkspace(const RadialcenterWorkspace&) = delete;
+        RadialcenterWorkspace& operator=(const RadialcenterWorkspace&) = delete;
+        RadialcenterWorkspace(RadialcenterWorkspace&&) = default;
+        RadialcenterWorkspace& operator=(RadialcenterWorkspace&&) = default;
+
+        //! Prepare the workspace for a call using nWorkers threads
+        //! Adds scratch buffers if needed and invalidates gradients cached from the previous image
+        void prepare(size_t nWorkers) {
+            while (_scratch.size() < nWorkers) {
+                _scratch.emplace_back(new rcdefs::RadialcenterScratch<T>());
+            }
+            for (auto& s : _scratch) {
+                s->has_window = false;
+            }
+        }
 
-        size_t nPart = max(size_t(1), params.nWIND); //number of windows
+        //! scratch buffers used by worker thread_id
+        rcdefs::RadialcenterScratch<T>& scratch(size_t thread_id) {
+            return *_scratch[thread_id];
+        }
 
-        // check for XYc
-		if(params.nXYc != 0){
-			if(params.nWIND!=0){
-				if(params.nXYc!=params.nWIND){
-					throw(std::runtime_error("radialcenter: nRows XYc must match nRows WIND"));
-				}
-			}
-			else{
-				nPart = params.nXYc;
-			}
+        //! worker threads used by radialcenter()
+        rcdefs::ThreadPool& pool() {
+            if (!_pool) {
+                _pool.reset(new rcdefs::ThreadPool());
+            }
+            return *_pool;
+        }
+
+        //! gradient buffer shared by all windows (used when params.GradientCache is enabled)
+        rcdefs::SharedGradient<T>& shared_gradient() {
+            if (!_shared) {
+                _shared.reset(new rcdefs::SharedGradient<T>());
+            }
+            return *_shared;
+        }
+
+        //! integral image shared by all windows (used when params.IntegralImage is enabled)
+        rcdefs::IntegralImage& integral_image() {
+            if (!_integral) {
+                _integral.reset(new rcdefs::IntegralImage());
+            }
+            return *_integral;
+        }
+
+        //! buffer holding the processing order of n windows (as (key, window index) pairs)
+        std::vector<std::pair<uint64_t, size_t>>& window_order(size_t n) {
+            if (n > _order.capacity()) {
+                ++_orderAllocations;
+            }
+            _order.resize(n);
+            return _order;
+        }
+
+        //! buffer of n elements holding the window coordinates of the transposed image (used for row-major images)
+        std::vector<double>& transposed_coordinates(size_t n) {
+            if (n > _transposed.capacity()) {
+                ++_transposedAllocations;
+            }
+            _transposed.resize(n);
+            return _transposed;
+        }
+
+        //! buffer holding the tasks of n windows (used when params.LaneBatchSize>0)
+        rcdefs::RadialcenterTasks& tasks(size_t n) {
+            _tasks.reset(n);
+            return _tasks;
+        }
+
+        //! combined statistics of the weight kernel caches of all workers
+        rcdefs::WeightKernelCacheStats weight_cache_stats() const {
+            rcdefs::WeightKernelCacheStats s;
+            for (const auto& sc : _scratch) {
+                s += sc->weight_cache.stats();
+            }
+            return s;
+        }
+
+        //! number of workers the workspace currently holds buffers for
+        size_t nWorkers() const {
+            return _scratch.size();
+        }
+
+        //! total number of buffer allocations made by the workspace
+        //! stops changing once the workspace has grown to fit the largest window
+        size_t nAllocations() const {
+            size_t n = 0;
+            for (const auto& s : _scratch) {
+                n += s->nAllocations;
+            }
+            if (_shared) {
+                n += _shared->nAllocations;
+            }
+            if (_integral) {
+                n += _integral->nAllocations;
+            }
+            n += _orderAllocations;
+            n += _transposedAllocations;
+            n += _tasks.nAllocations;
+            if (_pool) {
+                n += _pool->nAllocations;
+            }
+            return n;
+        }
+
+        //! release all memory held by the workspace
+        void clear() {
+            _scratch.clear();
+            _shared.reset();
+            _integral.reset();
+            std::vector<std::pair<uint64_t, size_t>>().swap(_order);
+            std::vector<double>().swap(_transposed);
+            _tasks = rcdefs::RadialcenterTasks();
+            _pool.reset();
+        }
+    };
+
+    //! Parameters and image extent of a single window
+    struct RadialcenterWindowSpec {
+        double RadiusCutoff;
+        double CutoffFactor;
+        double DistanceExponent;
+        double GradientExponent;
+        double RadExtents; //radius around the center needed by the radius cutoff
+        size_t Ix1; //starting x-coord of the window
+        size_t Ix2; //ending x-coord of the window
+        size_t Iy1; //starting y-coord of the window
+        size_t Iy2; //ending y-coord of the window
+    };
+
+    //! Determine the parameters and the image extent used by window n
+    inline RadialcenterWindowSpec radialcenter_window_spec(size_t n, size_t nRows, size_t nCols, const RadialcenterParameters& params) {
+        using namespace std;
+
+        RadialcenterWindowSpec spec;
+
+
+		double& this_RadiusCutoff = spec.RadiusCutoff;
+		if (params.nRadiusCutoff==0) {
+			this_RadiusCutoff = params.default_RadiusCutoff;
 		}
+        else if(params.nRadiusCutoff==1){
+            this_RadiusCutoff = params.RadiusCutoff[0];
+        }
+		else {
+			this_RadiusCutoff = params.RadiusCutoff[n];
+		}
+		assert_condition(this_RadiusCutoff >= 0, "RadiusCutoff must be >=0");
 
-        // validate RadiusCutoff
-        if (params.nRadiusCutoff ==0) { //empty RadiusCutoff
-            throw("Empty RadiusCutoff not supported");
+		double& this_CutoffFactor = spec.CutoffFactor;
+        if (params.nCutoffFactor==0) {
+			this_CutoffFactor = params.default_CutoffFactor;
 		}
-		else if (params.nRadiusCutoff ==1) { //
+        else if(params.nCutoffFactor==1){
+            this_CutoffFactor = params.CutoffFactor[0];
+        }
+		else {
+			this_CutoffFactor = params.CutoffFactor[n];
 		}
-		else { //make sure same size as nPart
-			extras::assert_condition(params.nRadiusCutoff == nPart,"RadiusCutoff has wrong number of elements");
+		assert_condition(this_CutoffFactor >= 0, "CutoffFactor must be >=0");
+		if (this_CutoffFactor == 0) {
+			this_RadiusCutoff = INFINITY;
 		}
 
-        if (params.nCutoffFactor ==0) { //empty RadiusCutoff
-            throw("Empty CutoffFactor not supported");
+		double& this_DistanceExponent = spec.DistanceExponent;
+        if (params.nDistanceExponent==0) {
+			this_DistanceExponent = params.default_DistanceExponent;
 		}
-		else if (params.nCutoffFactor ==1) { //
-		}
-		else { //make sure same size as nPart
-			extras::assert_condition(params.nCutoffFactor == nPart,"CutoffFactor has wrong number of elements");
+        else if(params.nDistanceExponent==1){
+            this_DistanceExponent = params.DistanceExponent[0];
+        }
+		else {
+			this_DistanceExponent = params.DistanceExponent[n];
 		}
 
-        if (params.nDistanceExponent ==0) { //empty RadiusCutoff
-            throw("Empty DistanceExponent not supported");
+		double& this_GradientExponent = spec.GradientExponent;
+        if (params.nGradientExponent==0) {
+			this_GradientExponent = params.default_GradientExponent;
 		}
-		else if (params.nDistanceExponent ==1) { //
+        else if(params.nGradientExponent==1){
+            this_GradientExponent = params.GradientExponent[0];
+        }
+		else {
+			this_GradientExponent = params.GradientExponent[n];
 		}
-		else { //make sure same size as nPart
-			extras::assert_condition(params.nDistanceExponent == nPart,"DistanceExponent has wrong number of elements");
+
+		//determine extent of image needed
+		double& RadExtents = spec.RadExtents;
+		RadExtents = this_RadiusCutoff;
+		if (isfinite(this_CutoffFactor)) { //non-inf Logistic Factor
+			double eLRF = exp(this_CutoffFactor*this_RadiusCutoff);
+			double eLRFpow = pow(eLRF + 1, 0.99);
+			RadExtents = -(log(1 + eLRF - eLRFpow) - log(eLRF*eLRFpow)) / this_CutoffFactor;
 		}
 
-        if (params.nGradientExponent ==0) { //empty RadiusCutoff
-            throw("Empty GradientExponent not supported");
+        //////////////////////////////////
+		//Get Sub window range
+		size_t& newIx1 = spec.Ix1;
+		size_t& newIx2 = spec.Ix2;
+		size_t& newIy1 = spec.Iy1;
+		size_t& newIy2 = spec.Iy2;
+		if (params.nWIND!=0) { //we have window
+			/* Old WIND=[X1,X2,Y1,Y2]
+			newIx1 = fmax(0,fmin(I.nCols()-1,floor(WIND(n, 0))));
+			newIx2 = fmax(0,fmin(I.nCols()-1,ceil(WIND(n, 1))));
+			newIy1 = fmax(0,fmin(I.nRows()-1,floor(WIND(n, 2))));
+			newIy2 = fmax(0,fmin(I.nRows()-1,ceil(WIND(n, 3))));
+			*/
+			/*New WIND=[x0,y0,w,h]*/
+			newIx1 = fmax(0,fmin(nCols-1,floor( params.WIND[n+0*params.nWIND])));//WIND(n, 0))));
+			newIx2 = fmax(0,fmin(nCols-1,ceil(params.WIND[n+0*params.nWIND] + params.WIND[n+2*params.nWIND] -1)));///WIND(n, 0)+WIND(n,2)-1)));
+			newIy1 = fmax(0,fmin(nRows-1,floor(params.WIND[n+1*params.nWIND])));///WIND(n, 1))));
+			newIy2 = fmax(0,fmin(nRows-1,ceil(params.WIND[n+1*params.nWIND]+params.WIND[n+3*params.nWIND]-1)));///WIND(n, 1)+WIND(n,3)-1)));
 		}
-		else if (params.nGradientExponent ==1) { //
+		else if(params.nXYc!=0 && isfinite(this_RadiusCutoff)&& this_RadiusCutoff !=0){ //using region around XY center
+
+			newIx1 = fmax(0,fmin(nCols-1,floor( params.XYc[n+0*params.nXYc] - RadExtents)));//(*params.XYc.get())(n,0) - RadExtents )));
+			newIx2 = fmax(0,fmin(nCols-1,ceil( params.XYc[n+0*params.nXYc] + RadExtents)));///(*params.XYc.get())(n,0) + RadExtents )));
+			newIy1 = fmax(0,fmin(nRows-1,floor(params.XYc[n+1*params.nXYc] - RadExtents)));///(*params.XYc.get())(n,1) - RadExtents )));
+			newIy2 = fmax(0,fmin(nRows-1,ceil(params.XYc[n+1*params.nXYc] + RadExtents)));///*params.XYc.get())(n,1) + RadExtents )));
 		}
-		else { //make sure same size as nPart
-			extras::assert_condition(params.nGradientExponent == nPart,"GradientExponent has wrong number of elements");
+		else{ //need full frame
+			newIx1 = 0; //starting x-coord of the window
+			newIy1 = 0; //starting y-coord of the window
+			newIx2 = nCols - 1;//ending x-coord of the window
+			newIy2 = nRows - 1;//ending y-coord of the window
 		}
 
-        // Gradient variables
-        double * du = nullptr;
-        double * dv = nullptr;
+		return spec;
+    }
 
-        double *sqWX = nullptr;
-        double *sqWy = nullptr;
+    //! Determine if the center of mass of window n is needed as the center guess
+    //! (false if the weights do not depend on distance, or a valid XYc was supplied)
+    inline bool radialcenter_needs_com(size_t n, const RadialcenterWindowSpec& spec, const RadialcenterParameters& params) {
+        using namespace std;
+        if (spec.DistanceExponent == 0 && ((spec.RadiusCutoff == 0 || !isfinite(spec.RadiusCutoff)) || spec.CutoffFactor == 0)) {
+            return false;
+        }
+        if (params.nXYc != 0 && isfinite(params.XYc[n + 0 * params.nXYc]) && isfinite(params.XYc[n + 1 * params.nXYc])) {
+            return false;
+        }
+        return true;
+    }
 
-        double* GradMag = nullptr;
-        bool calced_grad_mag = false;
+    //! Determine the order in which the windows are processed
+    //! MORTON_ORDER sorts the windows by the Morton key of their centers, so consecutive windows
+    //! read neighboring parts of the image (and windows with identical extents are processed
+    //! consecutively, which lets them reuse the gradient).
+    //! Returns a pointer to nPart (key, window index) pairs in processing order (stored in the workspace),
+    //! or nullptr for input order.
+    template <typename T>
+    const std::pair<uint64_t, size_t>* radialcenter_window_order(size_t nPart, size_t nRows, size_t nCols, const RadialcenterParameters& params,
+        RadialcenterWorkspace<T>& workspace)
+    {
+        if (params.WindowOrder == rcdefs::INPUT_ORDER || nPart < 2) {
+            return nullptr;
+        }
+        std::vector<std::pair<uint64_t, size_t>>& order = workspace.window_order(nPart);
+        for (size_t n = 0; n < nPart; ++n) {
+            RadialcenterWindowSpec spec = radialcenter_window_spec(n, nRows, nCols, params);
+            order[n].first = rcdefs::morton_key(uint32_t((spec.Ix1 + spec.Ix2) / 2), uint32_t((spec.Iy1 + spec.Iy2) / 2));
+            order[n].second = n;
+        }
+        std::sort(order.begin(), order.begin() + nPart); //ties are broken by window index
+        return order.data();
+    }
 
-        size_t Ix1 = 0; //starting x-coord of the window
-		size_t Iy1 = 0; //starting y-coord of the window
-		size_t Ix2 = nCols - 1;//ending x-coord of the window
-		size_t Iy2 = nRows - 1;//ending y-coord of the window
-		size_t dNx = Ix2 - Ix1; //width of gradient image
-		size_t dNy = Iy2 - Iy1; //height of gradient image
+    //! Solve the 2x2 normal equations of the radial symmetry fit from the weighted sums (see radialcenter_fit())
+    //! Xref,Yref: reference point of the residual moments Syy, SXy1, SXy2 (see radialcenter_weights.h)
+    //! If residual==false varX, varY and RWR_N are NaN
+    inline void radialcenter_solve(double sw, double sw2, double A, double B, double D, double XWy1, double XWy2,
+        double Syy, double SXy1, double SXy2, double Xref, double Yref, bool residual,
+        double& x, double& y, double& varX, double& varY, double& RWR_N)
+    {
+		const double sumA = A; //sums before division by the determinant (used by the residual)
+		const double sumB = B;
+		const double sumD = D;
+
+		double det = (A*D - B*B); //calc determinant for inverse
+
+		A /= det;
+		B /= det;
+		D /= det;
+		x = (D*XWy1 - B*XWy2);
+		y = (A*XWy2 - B*XWy1);
+
+		/////////////////////////
+		// calc variance
+
+		if (!residual) {
+			varX = NAN;
+			varY = NAN;
+			RWR_N = NAN;
+			return;
+		}
 
-		size_t last_WindSz = 0;
+		double RWR = rcdefs::weighted_residual(x, y, Xref, Yref, sumA, sumB, sumD, Syy, SXy1, SXy2);
 
-        // loop over particles and compute
-        for (size_t n = 0; n < nPart; ++n) {
-            ///////////////////////////
-			// Parameters
+		//calc variance
+		double denom = sw*sw / sw2;
+		if (denom > 2) {
+			denom -= 2;
+		}
 
-			double this_RadiusCutoff;
-			if (params.nRadiusCutoff==0) {
-				this_RadiusCutoff = params.default_RadiusCutoff;
-			}
-            else if(params.nRadiusCutoff==1){
-                this_RadiusCutoff = params.RadiusCutoff[0];
-            }
-			else {
-				this_RadiusCutoff = params.RadiusCutoff[n];
-			}
-			assert_condition(this_RadiusCutoff >= 0, "RadiusCutoff must be >=0");
+		RWR_N = RWR / (sw - 2 * sw2 / sw);
 
-			double this_CutoffFactor;
-            if (params.nCutoffFactor==0) {
-				this_CutoffFactor = params.default_CutoffFactor;
-			}
-            else if(params.nCutoffFactor==1){
-                this_CutoffFactor = params.CutoffFactor[0];
-            }
-			else {
-				this_CutoffFactor = params.CutoffFactor[n];
-			}
-			assert_condition(this_CutoffFactor >= 0, "CutoffFactor must be >=0");
-			if (this_CutoffFactor == 0) {
-				this_RadiusCutoff = INFINITY;
-			}
+		RWR /= denom;
 
-			double this_DistanceExponent;
-            if (params.nDistanceExponent==0) {
-				this_DistanceExponent = params.default_DistanceExponent;
+		varX = D*RWR;
+		varY = A*RWR;
+    }
+
+    //! Radial symmetry least-squares fit of a window
+    //! du,dv: gradient of the window, du(yi,xi) = du[yi + xi*gStride], yi<dNy, xi<dNx
+    //! GradMag: magnitude of the gradient (dNy x dNx, contiguous), or nullptr if it has not been computed
+    //! Xcom,Ycom: center guess relative to the window
+    //! The normal equations and the residual moments are accumulated in a single pass over the pixels
+    //! (no per-pixel values are stored, other than one strip of rows for the fixed-size loops).
+    //! If residual==false the residual moments are not accumulated and varX, varY and RWR_N are NaN
+    //! FixedSizeKernels: use the loops compiled for 32, 48 and 64 px windows (see radialcenter_weights.h)
+    //! The center (x,y) is returned relative to the window
+    template <typename T>
+    void radialcenter_fit(const RadialcenterWindowSpec& spec, double Xcom, double Ycom,
+        const T* du, const T* dv, size_t gStride, const T* GradMag, size_t dNx, size_t dNy,
+        size_t WeightKernelCache, bool FixedSizeKernels, rcdefs::RadialcenterScratch<T>& scratch, bool residual,
+        double& x, double& y, double& varX, double& varY, double& RWR_N)
+    {
+        using namespace std;
+        using namespace rcdefs;
+
+
+		const double this_RadiusCutoff = spec.RadiusCutoff;
+		const double this_CutoffFactor = spec.CutoffFactor;
+		const double this_DistanceExponent = spec.DistanceExponent;
+		const double this_GradientExponent = spec.GradientExponent;
+		const double RadExtents = spec.RadExtents;
+
+		const bool calced_grad_mag = (GradMag != nullptr);
+
+		// per-pixel arithmetic is done using the compute type
+		const T tXcom = (T)Xcom;
+		const T tYcom = (T)Ycom;
+		const T tRadiusCutoff = (T)this_RadiusCutoff;
+		const T tCutoffFactor = (T)this_CutoffFactor;
+		const T tDistanceExponent = (T)this_DistanceExponent;
+		const T tGradientExponent = (T)this_GradientExponent;
+
+		// the sums of each row are accumulated in T and added to the sums of the window in double
+		// (see Single precision in radialcenter_weights.h)
+		double sw2 = 0;
+		double sw = 0;
+
+		// cov Matrix terms: 1/(AD-B^2)*[D,-B;-B,A]
+		double A = 0;
+		double B = 0;
+		double D = 0;
+
+		double XWy1 = 0;
+		double XWy2 = 0;
+
+		// residual moments about the center guess (or the middle of the window), see radialcenter_weights.h
+		const double Xref = isfinite(Xcom) ? Xcom : 0.5*dNx;
+		const double Yref = isfinite(Ycom) ? Ycom : 0.5*dNy;
+		const T tXref = (T)Xref;
+		const T tYref = (T)Yref;
+		double Syy = 0;
+		double SXy1 = 0;
+		double SXy2 = 0;
+
+		//////////////////////////////////
+		//Build Matricies for Radial Center least-squares
+		if (this_GradientExponent == 0 && !isfinite(this_RadiusCutoff) && this_DistanceExponent==0) { //no weighting fractor used
+			WeightedRowSums<double> sums;
+			for (size_t yi = 0; yi<dNy; ++yi) {
+				T yk = yi + T(0.5);
+				WeightedRowSums<T> row;
+				for (size_t xi = 0; xi<dNx; ++xi) {
+					size_t ind = yi + xi*dNy;
+					size_t gind = yi + xi * gStride; //index of pixel in gradient
+					T xk = xi + T(0.5);
+
+                    T mag;
+                    if(!calced_grad_mag){
+                        mag= sqrt( sqr(du[gind]) + sqr(dv[gind]) );
+
+                    }else{
+                        mag = GradMag[ind];
+                    }
+
+					const T wx0 = (du[gind] + dv[gind])/mag;// //sqWX(ind, 0) = (du(yi, xi) + dv(yi, xi)) / mag;
+					const T wx1 = (dv[gind] - du[gind])/mag;//sqWX(ind, 0) = (dv(yi, xi) - du(yi, xi)) / mag;
+
+					const T wy = xk*wx0 + yk*wx1;//xk*sqWX(ind, 0) + yk*sqWX(ind, 1);
+
+					row.add(1, wx0, wx1, wy);
+					if (residual) {
+						row.add_residual(wx0, wx1, (xk - tXref)*wx0 + (yk - tYref)*wx1);
+					}
+				}
+				row.add_to(sums);
 			}
-            else if(params.nDistanceExponent==1){
-                this_DistanceExponent = params.DistanceExponent[0];
-            }
-			else {
-				this_DistanceExponent = params.DistanceExponent[n];
+
+			sw = sums.sw;
+			sw2 = sums.sw2;
+			A = sums.A;
+			B = sums.B;
+			D = sums.D;
+			XWy1 = sums.XWy1;
+			XWy2 = sums.XWy2;
+			Syy = sums.Syy;
+			SXy1 = sums.SXy1;
+			SXy2 = sums.SXy2;
+		}
+		else { //use weighting
+			// the weighting loop is specialized for common exponents and the type of cutoff (see radialcenter_weights.h)
+			RADIUS_CUTOFF cutoff = NO_CUTOFF;
+			if (isfinite(this_RadiusCutoff)) { //using radius cutoff, only sum over circle
+				cutoff = isfinite(this_CutoffFactor) ? LOGISTIC_CUTOFF : TOPHAT_CUTOFF;
 			}
 
-			double this_GradientExponent;
-            if (params.nGradientExponent==0) {
-				this_GradientExponent = params.default_GradientExponent;
+			WeightedSums<T> ws;
+			ws.du = du;
+			ws.dv = dv;
+			ws.gStride = gStride;
+			ws.GradMag = GradMag;
+			ws.calced_grad_mag = calced_grad_mag;
+			ws.residual = residual;
+			ws.Xref = tXref;
+			ws.Yref = tYref;
+			ws.dNx = dNx;
+			ws.dNy = dNy;
+			ws.Xcom = tXcom;
+			ws.Ycom = tYcom;
+			ws.RE2 = (T)pow(RadExtents, 2);
+			ws.RadiusCutoff = tRadiusCutoff;
+			ws.CutoffFactor = tCutoffFactor;
+			ws.DistanceExponent = tDistanceExponent;
+			ws.GradientExponent = tGradientExponent;
+			ws.GradScale = gradient_weight_scale(ws);
+
+			// use precomputed distance weights if the center guess (quantized to 1/WeightKernelCache pixel) is inside the window
+			bool used_cache = false;
+			if (WeightKernelCache > 0 && (cutoff != NO_CUTOFF || this_DistanceExponent != 0) && isfinite(Xcom) && isfinite(Ycom)) {
+				long Q = (long)WeightKernelCache;
+				long sx = lround(Xcom*Q);
+				long sy = lround(Ycom*Q);
+				if (sx >= 0 && sy >= 0 && sx / Q <= (long)dNx && sy / Q <= (long)dNy) {
+					long Kmax = (long)max(dNx, dNy);
+
+					WeightKernelKey key;
+					key.cutoff = cutoff;
+					key.K = (cutoff == NO_CUTOFF) ? Kmax : min(Kmax, (long)ceil(RadExtents) + 1);
+					key.Q = Q;
+					key.fx = sx % Q;
+					key.fy = sy % Q;
+					key.RadiusCutoff = this_RadiusCutoff;
+					key.CutoffFactor = this_CutoffFactor;
+					key.DistanceExponent = this_DistanceExponent;
+					key.RadExtents = RadExtents;
+
+					weighted_sums_cached(ws, scratch.weight_cache.get(key), sx / Q, sy / Q);
+					used_cache = true;
+				}
 			}
-            else if(params.nGradientExponent==1){
-                this_GradientExponent = params.GradientExponent[0];
-            }
-			else {
-				this_GradientExponent = params.GradientExponent[n];
+			if (!used_cache) {
+				weighted_sums(ws, cutoff, FixedSizeKernels);
 			}
 
-			//determine extent of image needed
-			double RadExtents = this_RadiusCutoff;
-			if (isfinite(this_CutoffFactor)) { //non-inf Logistic Factor
-				double eLRF = exp(this_CutoffFactor*this_RadiusCutoff);
-				double eLRFpow = pow(eLRF + 1, 0.99);
-				RadExtents = -(log(1 + eLRF - eLRFpow) - log(eLRF*eLRFpow)) / this_CutoffFactor;
-			}
+			sw = ws.sw;
+			sw2 = ws.sw2;
+			A = ws.A;
+			B = ws.B;
+			D = ws.D;
+			XWy1 = ws.XWy1;
+			XWy2 = ws.XWy2;
+			Syy = ws.Syy;
+			SXy1 = ws.SXy1;
+			SXy2 = ws.SXy2;
+		}// end if use weight
+
+		radialcenter_solve(sw, sw2, A, B, D, XWy1, XWy2, Syy, SXy1, SXy2, Xref, Yref, residual, x, y, varX, varY, RWR_N);
+    }
 
-            //////////////////////////////////
-			//Get Sub window range
-			bool calc_grad = false; //flag saying gradient needs to be calculated
+    //! Process a single window (particle n) for radialcenter()
+    //! Results are written to x[n], y[n], varXY[n+nPart*{0,1}] and RWR_N[n].
+    //! scratch holds the working buffers used by the window; it must not be shared between threads.
+    //! If shared is not null, the gradient is read from the shared gradient (which must cover the window)
+    //! instead of being computed for the window.
+    //! If integral is not null, the center of mass is found from the integral image (of the image,
+    //! or of the shared gradient magnitude if COMmethod=GRAD_MAG) instead of being summed over the window.
+    //! Windows rejected by params.RejectMethod return NaN without being fit; if Status is not null
+    //! Status[n] is set to the reason (rcdefs::WINDOW_STATUS).
+    //! Outputs not included in params.OutputMask are not written (and may be nullptr).
+    //! Parameters are assumed to have been validated by radialcenter()
+    //! T is the compute type used for the gradient and per-pixel weights (and for the sums of each row, which are added up in double)
+    template <typename M, typename T, typename Layout>
+    void radialcenter_window(size_t n, size_t nPart, //index of window to process and total number of windows
+        double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params, //parameters
+        rcdefs::RadialcenterScratch<T>& scratch, //working buffers
+        const rcdefs::SharedGradient<T>* shared = nullptr, //gradient computed for all windows (or nullptr)
+        const rcdefs::IntegralImage* integral = nullptr, //integral image covering all windows (or nullptr)
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        using namespace std;
+        using namespace rcdefs;
 
-			size_t newIx1, newIx2,newIy1,newIy2;
-			last_WindSz = dNx * dNy;
-			if (n == 0) {
-				last_WindSz = 0;
+        // Gradient variables
+        T *& GradMag = scratch.GradMag;
+        bool& calced_grad_mag = scratch.calced_grad_mag;
+
+        size_t& Ix1 = scratch.Ix1; //starting x-coord of the window
+        size_t& Iy1 = scratch.Iy1; //starting y-coord of the window
+        size_t& Ix2 = scratch.Ix2; //ending x-coord of the window
+        size_t& Iy2 = scratch.Iy2; //ending y-coord of the window
+
+        ///////////////////////////
+		// Parameters and sub window range
+		const RadialcenterWindowSpec spec = radialcenter_window_spec(n, img.nRows, img.nCols, params);
+		const double this_RadiusCutoff = spec.RadiusCutoff;
+		const double this_CutoffFactor = spec.CutoffFactor;
+		const double this_DistanceExponent = spec.DistanceExponent;
+		const double RadExtents = spec.RadExtents;
+		const size_t newIx1 = spec.Ix1;
+		const size_t newIx2 = spec.Ix2;
+		const size_t newIy1 = spec.Iy1;
+		const size_t newIy2 = spec.Iy2;
+
+		// optional outputs
+		const bool out_varXY = (params.OutputMask & OUTPUT_VARXY) != 0 && varXY != nullptr;
+		const bool out_RWR_N = (params.OutputMask & OUTPUT_RWR_N) != 0 && RWR_N != nullptr;
+		const bool out_Status = (params.OutputMask & OUTPUT_STATUS) != 0 && Status != nullptr;
+		const bool residual = out_varXY || out_RWR_N; //the residual moments are only needed for varXY and RWR_N
+
+		// skip the window without fitting it
+		auto reject = [&](rcdefs::WINDOW_STATUS reason) {
+			x[n] = NAN;
+			y[n] = NAN;
+			if (out_varXY) {
+				varXY[n + nPart * 0] = NAN;
+				varXY[n + nPart * 1] = NAN;
 			}
-			if (params.nWIND!=0) { //we have window
-				/* Old WIND=[X1,X2,Y1,Y2]
-				newIx1 = fmax(0,fmin(I.nCols()-1,floor(WIND(n, 0))));
-				newIx2 = fmax(0,fmin(I.nCols()-1,ceil(WIND(n, 1))));
-				newIy1 = fmax(0,fmin(I.nRows()-1,floor(WIND(n, 2))));
-				newIy2 = fmax(0,fmin(I.nRows()-1,ceil(WIND(n, 3))));
-				*/
-				/*New WIND=[x0,y0,w,h]*/
-				newIx1 = fmax(0,fmin(nCols-1,floor( params.WIND[n+0*params.nWIND])));//WIND(n, 0))));
-				newIx2 = fmax(0,fmin(nCols-1,ceil(params.WIND[n+0*params.nWIND] + params.WIND[n+2*params.nWIND] -1)));///WIND(n, 0)+WIND(n,2)-1)));
-				newIy1 = fmax(0,fmin(nRows-1,floor(params.WIND[n+1*params.nWIND])));///WIND(n, 1))));
-				newIy2 = fmax(0,fmin(nRows-1,ceil(params.WIND[n+1*params.nWIND]+params.WIND[n+3*params.nWIND]-1)));///WIND(n, 1)+WIND(n,3)-1)));
+			if (out_RWR_N) {
+				RWR_N[n] = NAN;
 			}
-			else if(params.nXYc!=0 && isfinite(this_RadiusCutoff)&& this_RadiusCutoff !=0){ //using region around XY center
-
-				newIx1 = fmax(0,fmin(nCols-1,floor( params.XYc[n+0*params.nXYc] - RadExtents)));//(*params.XYc.get())(n,0) - RadExtents )));
-				newIx2 = fmax(0,fmin(nCols-1,ceil( params.XYc[n+0*params.nXYc] + RadExtents)));///(*params.XYc.get())(n,0) + RadExtents )));
-				newIy1 = fmax(0,fmin(nRows-1,floor(params.XYc[n+1*params.nXYc] - RadExtents)));///(*params.XYc.get())(n,1) - RadExtents )));
-				newIy2 = fmax(0,fmin(nRows-1,ceil(params.XYc[n+1*params.nXYc] + RadExtents)));///*params.XYc.get())(n,1) + RadExtents )));
+			if (out_Status) {
+				Status[n] = reason;
 			}
-			else{ //need full frame
-				newIx1 = 0; //starting x-coord of the window
-				newIy1 = 0; //starting y-coord of the window
-				newIx2 = nCols - 1;//ending x-coord of the window
-				newIy2 = nRows - 1;//ending y-coord of the window
+		};
+
+		// contrast check is done before anything else is computed for the window
+		if (params.RejectMethod == CONTRAST_REJECT) {
+			M Imin = img(newIy1, newIx1);
+			M Imax = Imin;
+			for (size_t xi = newIx1; xi <= newIx2; ++xi) {
+				for (size_t yi = newIy1; yi <= newIy2; ++yi) {
+					const M v = img(yi, xi);
+					Imin = v < Imin ? v : Imin;
+					Imax = v > Imax ? v : Imax;
+				}
 			}
-
-			if(newIx1!=Ix1 || newIx2!=Ix2 || newIy1!=Iy1 || newIy2!=Iy2){ //check if we need to calc grad again
-				Ix1 = newIx1;
-				Ix2 = newIx2;
-				Iy1 = newIy1;
-				Iy2 = newIy2;
-
-				calc_grad = true;
-				dNx = Ix2-Ix1;
-				dNy = Iy2-Iy1;
+			if (!(double(Imax) - double(Imin) >= params.RejectThreshold)) {
+				reject(WINDOW_LOW_CONTRAST);
+				return;
 			}
+		}
 
-			// update the gradient image on first pass, or if we are using sub-windows
-			if (n == 0 || calc_grad) {
-				if (last_WindSz != dNy * dNx) {
-					//resize du
-					du = (double*)rcdefs::safe_realloc(du, dNy*dNx * sizeof(double));
-
-					//resize dv
-					dv = (double*)rcdefs::safe_realloc(dv, dNy*dNx * sizeof(double));
-
-					//resize sqWX
-					sqWX = (double*)rcdefs::safe_realloc(sqWX, 2 * dNy*dNx * sizeof(double));
+		// update the gradient image if this thread has not yet processed a window with the same extents
+		if (!scratch.has_window || newIx1 != Ix1 || newIx2 != Ix2 || newIy1 != Iy1 || newIy2 != Iy2) {
+			Ix1 = newIx1;
+			Ix2 = newIx2;
+			Iy1 = newIy1;
+			Iy2 = newIy2;
+			scratch.has_window = true;
+
+			size_t dNx = Ix2 - Ix1;
+			size_t dNy = Iy2 - Iy1;
+
+			//calculate new gradient data
+			if (shared == nullptr) {
+				scratch.reserve_gradient(dNy*dNx);
+				size_t iStride;
+				const M * thisI = column_major_region(img, Iy1, Ix1, iStride); //I(y1,x1)
+				if (params.GradientKernel == REFERENCE_GRADIENT || dNx < 2 || dNy < 2) {
+					scratch.reserve_refbuf(3 * dNy*dNx);
+					rcdefs::smoothgrad(thisI, iStride, scratch.du, scratch.dv, dNy, dNx, scratch.refbuf);
+				}
+				else {
+					scratch.reserve_colbuf(2 * dNy);
+					rcdefs::smoothgrad_fused(thisI, iStride, scratch.du, scratch.dv, dNy, dNx, scratch.colbuf);
+				}
+			}
 
-					//resize sqWy
-					sqWy = (double*)rcdefs::safe_realloc(sqWy, dNy*dNx * sizeof(double));
+            calced_grad_mag = false;
+		}
+		const size_t dNx = Ix2 - Ix1; //width of gradient image
+		const size_t dNy = Iy2 - Iy1; //height of gradient image
+
+		// gradient of the window, du(yi,xi) = du[yi + xi*gStride]
+		const T * du = scratch.du;
+		const T * dv = scratch.dv;
+		size_t gStride = dNy;
+		if (shared != nullptr) {
+			gStride = shared->stride();
+			du = shared->du + (Iy1 - shared->Iy1) + (Ix1 - shared->Ix1)*gStride;
+			dv = shared->dv + (Iy1 - shared->Iy1) + (Ix1 - shared->Ix1)*gStride;
+		}
 
-					//set lastsz
-					last_WindSz = dNy * dNx;
+		// gradient check is done before the center of mass, weights and fit
+		if (params.RejectMethod == GRADIENT_REJECT) {
+			double energy = 0;
+			for (size_t xi = 0; xi < dNx; ++xi) {
+				T cacc = 0;
+				for (size_t yi = 0; yi < dNy; ++yi) {
+					cacc += sqr(du[yi + xi*gStride]) + sqr(dv[yi + xi*gStride]);
 				}
+				energy += cacc;
+			}
+			if (!(sqrt(energy / double(dNx*dNy)) >= params.RejectThreshold)) {
+				reject(WINDOW_LOW_GRADIENT);
+				return;
+			}
+		}
 
-				//calculate new gradient data
-				const M * thisI = &( img[Iy1+Ix1*nRows]); //I(Iy1,Ix1)); //I(y1,x1)
-				rcdefs::smoothgrad(thisI, nRows, du, dv, dNy, dNx);
-                calc_grad = false;
+		// Determine if we need to calculate COM
+		double Xcom=0;
+		double Ycom=0;//x any y center relative to windows edge
 
-				std::free(GradMag);
-				GradMag = nullptr;
-                calced_grad_mag = false;
-			}
+		if (this_DistanceExponent == 0 && ((this_RadiusCutoff == 0 || !isfinite(this_RadiusCutoff)) || this_CutoffFactor == 0)) { //dont need COM because we aren't using distance dependence
+			Xcom = NAN;
+			Ycom = NAN;
+		}
+		else if( params.nXYc != 0 && isfinite(params.XYc[n+0*params.nXYc]) && isfinite(params.XYc[n+1*params.nXYc])){ //dont need because we were valid told XYc
+			Xcom = params.XYc[n+0*params.nXYc]-Ix1;//params.XYc->getElement(n, 0) - Ix1;
+			Ycom = params.XYc[n+1*params.nXYc]-Iy1;//params.XYc->getElement(n, 1) - Iy1;
+		}
+		else { //need to calculate COM (same condition as radialcenter_needs_com())
+			switch (params.COMmethod)
+			{
+			case rcdefs::GRAD_MAG: //COM from magnitude of gradient
+			{
+				if (integral != nullptr) { //integral image of the (shared) gradient magnitude
+					double s, mx, my;
+					integral->rect(Iy1 - integral->Iy1, Ix1 - integral->Ix1, Iy2 - integral->Iy1, Ix2 - integral->Ix1, s, mx, my);
+					Xcom = mx / s + 0.5;
+					Ycom = my / s + 0.5;
+					break;
+				}
 
-			// Determine if we need to calculate COM
-			double Xcom=0;
-			double Ycom=0;//x any y center relative to windows edge
+				//GradMag.resize_nocpy(dNy, dNx);
+                if(!calced_grad_mag){
+					scratch.reserve_gradmag(dNy*dNx);
+                }
 
-			if (this_DistanceExponent == 0 && ((this_RadiusCutoff == 0 || !isfinite(this_RadiusCutoff)) || this_CutoffFactor == 0)) { //dont need COM because we aren't using distance dependence
-				Xcom = NAN;
-				Ycom = NAN;
-			}
-			else if( params.nXYc != 0 && isfinite(params.XYc[n+0*params.nXYc]) && isfinite(params.XYc[n+1*params.nXYc])){ //dont need because we were valid told XYc
-				Xcom = params.XYc[n+0*params.nXYc]-Ix1;//params.XYc->getElement(n, 0) - Ix1;
-				Ycom = params.XYc[n+1*params.nXYc]-Iy1;//params.XYc->getElement(n, 1) - Iy1;
-			}
-			else { //need to calculate COM
-				switch (params.COMmethod)
-				{
-				case rcdefs::GRAD_MAG: //COM from magnitude of gradient
-				{
-					//GradMag.resize_nocpy(dNy, dNx);
-                    if(!calced_grad_mag){
-						GradMag = (double*)rcdefs::safe_realloc(GradMag, dNy*dNx * sizeof(double));
-                    }
+				Xcom = 0;
+				Ycom = 0;
+				double grad_acc = 0;
+				for (size_t yi = 0; yi<dNy; ++yi) {
+					T yk = yi + T(0.5);
+					for (size_t xi = 0; xi<dNx; ++xi) {
+						T xk = xi + T(0.5);
+                        size_t ind = yi + xi*dNy;
+                        size_t gind = yi + xi * gStride; //index of pixel in gradient
+                        if(!calced_grad_mag){
+                            GradMag[ind]= sqrt( sqr(du[gind]) + sqr(dv[gind]) ); //GradMag(yi, xi) = sqrt(pow(du(yi, xi), 2) + pow(dv(yi, xi), 2));
+                        }
 
-					Xcom = 0;
-					Ycom = 0;
-					double grad_acc = 0;
-					for (size_t yi = 0; yi<dNy; ++yi) {
-						double yk = yi + 0.5;
-						for (size_t xi = 0; xi<dNx; ++xi) {
-							double xk = xi + 0.5;
-                            size_t ind = yi + xi*dNy;
-                            if(!calced_grad_mag){
-                                GradMag[ind]= sqrt( pow(du[ind],2) + pow(dv[ind],2) ); //GradMag(yi, xi) = sqrt(pow(du(yi, xi), 2) + pow(dv(yi, xi), 2));
-                            }
-
-							Xcom += xk * GradMag[ind];//GradMag(yi, xi);
-							Ycom += yk * GradMag[ind];//GradMag(yi, xi);
-							grad_acc += GradMag[ind];//GradMag(yi, xi);
-						}
+						Xcom += xk * GradMag[ind];//GradMag(yi, xi);
+						Ycom += yk * GradMag[ind];//GradMag(yi, xi);
+						grad_acc += GradMag[ind];//GradMag(yi, xi);
 					}
-					Xcom /= grad_acc;
-					Ycom /= grad_acc;
-					calced_grad_mag = true;
 				}
-				break;
-				case rcdefs::MEAN_ABS: //com from absolute of mean-shifted image
-				{
-
-					//est im mean
-					double I_mean = 0;
+				Xcom /= grad_acc;
+				Ycom /= grad_acc;
+				calced_grad_mag = true;
+			}
+			break;
+			case rcdefs::MEAN_ABS: //com from absolute of mean-shifted image
+			{
+				//est im mean
+				double I_mean = 0;
+				if (integral != nullptr) {
+					double s, mx, my;
+					integral->rect(Iy1 - integral->Iy1, Ix1 - integral->Ix1, Iy2 + 1 - integral->Iy1, Ix2 + 1 - integral->Ix1, s, mx, my);
+					I_mean = s / ((dNx + 1)*(dNy + 1));
+				}
+				else {
 					double I_acc = 0;
-					for (size_t yi = Iy1; yi <= Iy2; ++yi) {
-						for (size_t xi = Ix1; xi <= Ix2; ++xi) {
-
-							I_acc += img[yi*nRows*xi];//I(yi, xi);
+					for (size_t xi = Ix1; xi <= Ix2; ++xi) {
+						for (size_t yi = Iy1; yi <= Iy2; ++yi) {
+							I_acc += img(yi, xi);
 						}
 					}
 					I_mean = I_acc / ((dNx + 1)*(dNy + 1));
+				}
 
-					Xcom = 0;
-					Ycom = 0;
+				// COM of |I-mean|
+				double I_acc = 0;
+				Xcom = 0;
+				Ycom = 0;
+				for (size_t xi = Ix1; xi <= Ix2; ++xi) {
+					double cacc = 0;
+					double cy = 0;
 					for (size_t yi = Iy1; yi <= Iy2; ++yi) {
-						for (size_t xi = Ix1; xi <= Ix2; ++xi) {
-                            double i_m = img[yi*nRows*xi] - I_mean;
-							Xcom += (double)xi*i_m;//I(yi, xi) - I_mean);
-							Ycom += (double)yi*i_m;//I(yi, xi) - I_mean);
-						}
+						double i_m = fabs(img(yi, xi) - I_mean);
+						cacc += i_m;
+						cy += double(yi - Iy1)*i_m;
 					}
-					Xcom /= I_acc;
-					Ycom /= I_acc;
+					Xcom += double(xi - Ix1)*cacc;
+					Ycom += cy;
+					I_acc += cacc;
+				}
+				Xcom /= I_acc;
+				Ycom /= I_acc;
+			}
+			break;
+			case rcdefs::NORMAL: //com from image
+			{
+				if (integral != nullptr) {
+					double s, mx, my;
+					integral->rect(Iy1 - integral->Iy1, Ix1 - integral->Ix1, Iy2 + 1 - integral->Iy1, Ix2 + 1 - integral->Ix1, s, mx, my);
+					Xcom = mx / s;
+					Ycom = my / s;
+					break;
 				}
-				break;
-				case rcdefs::NORMAL: //com from image
-				{
-
-					//mexPrintf("about to calc com from normal\n");
-					//mexEvalString("pause(0.1)");
 
-					//est im mean
-					double I_acc = 0;
-					Xcom = 0;
-					Ycom = 0;
+				double I_acc = 0;
+				Xcom = 0;
+				Ycom = 0;
+				for (size_t xi = Ix1; xi <= Ix2; ++xi) {
+					double cacc = 0;
+					double cy = 0;
 					for (size_t yi = Iy1; yi <= Iy2; ++yi) {
-						for (size_t xi = Ix1; xi <= Ix2; ++xi) {
-							Xcom += (double)xi*img[yi*nRows*xi];//I(yi, xi);
-							Ycom += (double)yi*img[yi*nRows*xi];//I(yi, xi);
-							I_acc += img[yi*nRows*xi];//I(yi, xi);
-						}
+						cacc += img(yi, xi);
+						cy += double(yi - Iy1)*img(yi, xi);
 					}
-					Xcom /= I_acc;
-					Ycom /= I_acc;
+					Xcom += double(xi - Ix1)*cacc;
+					Ycom += cy;
+					I_acc += cacc;
 				}
+				Xcom /= I_acc;
+				Ycom /= I_acc;
+			}
+			break;
+			}
+		}
+
+		/*if(oXYc!=nullptr){
+			oXYc[n+0*nPart] = Xcom + Ix1;
+			oXYc[n+1*nPart] = Ycom + Iy1;
+		}*/
+
+		////////////////////////////////
+		// Calculate fit
+		double xw, yw, varX, varY, this_RWR_N; //result relative to window
+		radialcenter_fit(spec, Xcom, Ycom, du, dv, gStride, calced_grad_mag ? GradMag : nullptr, dNx, dNy,
+			params.WeightKernelCache, params.FixedSizeKernels, scratch, residual, xw, yw, varX, varY, this_RWR_N);
+
+		////////////////////////////////
+		// Iterative refinement
+		// use the solution as the new center guess and shrink the window to RadExtents around it
+		// the sub-windows use the gradient that was already computed for the window
+		for (size_t it = 0; it < params.RefineIterations; ++it) {
+			if (!isfinite(xw) || !isfinite(yw)) {
+				break;
+			}
+			size_t sx1 = (size_t)min((double)dNx, max(0.0, floor(xw - RadExtents)));
+			size_t sx2 = (size_t)min((double)dNx, max(0.0, ceil(xw + RadExtents)));
+			size_t sy1 = (size_t)min((double)dNy, max(0.0, floor(yw - RadExtents)));
+			size_t sy2 = (size_t)min((double)dNy, max(0.0, ceil(yw + RadExtents)));
+			if (sx2 < sx1 + 2 || sy2 < sy1 + 2) { //sub window too small
+				break;
+			}
+
+			double new_x, new_y;
+			radialcenter_fit(spec, xw - sx1, yw - sy1,
+				du + sy1 + sx1*gStride, dv + sy1 + sx1*gStride, gStride, (const T*)nullptr, sx2 - sx1, sy2 - sy1,
+				params.WeightKernelCache, params.FixedSizeKernels, scratch, residual, new_x, new_y, varX, varY, this_RWR_N);
+			new_x += sx1;
+			new_y += sy1;
+
+			double shift = sqrt(sqr(new_x - xw) + sqr(new_y - yw));
+			xw = new_x;
+			yw = new_y;
+			if (shift < params.RefineTolerance) {
 				break;
-				}
 			}
+		}
+
+		x[n] = xw + Ix1;
+		y[n] = yw + Iy1;
+		if (out_varXY) {
+			varXY[n+nPart*0] = varX;
+			varXY[n+nPart*1] = varY;
+		}
+		if (out_RWR_N) {
+			RWR_N[n] = this_RWR_N;
+		}
+		if (out_Status) {
+			Status[n] = (isfinite(x[n]) && isfinite(y[n])) ? WINDOW_OK : WINDOW_FIT_FAILED;
+		}
+    }
 
-			/*if(oXYc!=nullptr){
-				oXYc[n+0*nPart] = Xcom + Ix1;
-				oXYc[n+1*nPart] = Ycom + Iy1;
-			}*/
+    //! Process a single window (particle n) for radialcenter() using a coarse-to-fine pyramid
+    //! The window is binned by 2^L x 2^L (L<=params.PyramidLevels, reduced so the binned window is at least
+    //! 8x8 px) and the center is located on the binned window. The fit is then repeated at full resolution on a
+    //! params.PyramidWindow sized window around that center (clipped to the original window), using it as the
+    //! center guess. The full-resolution gradient and weights are therefore only computed for the small window,
+    //! which is much faster for large ring patterns.
+    //! Windows that are not larger than PyramidWindow, or whose binned center is not finite, are processed
+    //! at full resolution by radialcenter_window().
+    //! RejectMethod is applied to the full-resolution window. Outputs are the same as for radialcenter_window().
+    template <typename M, typename T, typename Layout>
+    void radialcenter_pyramid_window(size_t n, size_t nPart, //index of window to process and total number of windows
+        double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params, //parameters
+        rcdefs::RadialcenterScratch<T>& scratch, //working buffers
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        using namespace std;
+        using namespace rcdefs;
 
-			////////////////////////////////
-			// Calculate fit
+        const RadialcenterWindowSpec spec = radialcenter_window_spec(n, img.nRows, img.nCols, params);
+        const size_t wNx = spec.Ix2 - spec.Ix1 + 1;
+        const size_t wNy = spec.Iy2 - spec.Iy1 + 1;
+
+        // number of levels that leave at least 8x8 binned pixels
+        size_t levels = 0;
+        while (levels < params.PyramidLevels && (wNx >> (levels + 1)) >= 8 && (wNy >> (levels + 1)) >= 8) {
+            ++levels;
+        }
+        if (levels == 0 || (wNx <= params.PyramidWindow && wNy <= params.PyramidWindow)) {
+            radialcenter_window(n, nPart, x, y, varXY, RWR_N, img, params, scratch, (const SharedGradient<T>*)nullptr, nullptr, Status);
+            return;
+        }
+
+        ////////////////////////////////
+        // Bin the window
+        const size_t f = size_t(1) << levels; //binning factor
+        const size_t cNx = wNx / f;
+        const size_t cNy = wNy / f;
+        scratch.reserve_pyramid(cNy*cNx);
+        T* coarse = scratch.pyramid;
+        for (size_t cx = 0; cx < cNx; ++cx) {
+            for (size_t cy = 0; cy < cNy; ++cy) {
+                double acc = 0;
+                for (size_t xi = spec.Ix1 + cx*f; xi < spec.Ix1 + (cx + 1)*f; ++xi) {
+                    for (size_t yi = spec.Iy1 + cy*f; yi < spec.Iy1 + (cy + 1)*f; ++yi) {
+                        acc += img(yi, xi);
+                    }
+                }
+                coarse[cy + cx*cNy] = T(acc / double(f*f));
+            }
+        }
+
+        // binned pixel c covers pixels c*f...c*f+f-1 of the window
+        const double offset = 0.5*double(f - 1);
+
+        ////////////////////////////////
+        // Locate the center on the binned window
+        // distances are scaled by the binning factor, the other parameters are unchanged
+        RadialcenterParameters cparams;
+        double cRadiusCutoff = spec.RadiusCutoff / f;
+        double cCutoffFactor = spec.CutoffFactor * f;
+        double cDistanceExponent = spec.DistanceExponent;
+        double cGradientExponent = spec.GradientExponent;
+        cparams.RadiusCutoff = &cRadiusCutoff;
+        cparams.CutoffFactor = &cCutoffFactor;
+        cparams.DistanceExponent = &cDistanceExponent;
+        cparams.GradientExponent = &cGradientExponent;
+        cparams.COMmethod = params.COMmethod;
+        cparams.GradientKernel = params.GradientKernel;
+        cparams.OutputMask = OUTPUT_XY;
+
+        double cXYc[2];
+        if (params.nXYc != 0 && isfinite(params.XYc[n + 0 * params.nXYc]) && isfinite(params.XYc[n + 1 * params.nXYc])) {
+            cXYc[0] = (params.XYc[n + 0 * params.nXYc] - spec.Ix1 - offset) / f;
+            cXYc[1] = (params.XYc[n + 1 * params.nXYc] - spec.Iy1 - offset) / f;
+            cparams.XYc = cXYc;
+            cparams.nXYc = 1;
+        }
+
+        double cx, cy;
+        scratch.has_window = false;
+        radialcenter_window(0, 1, &cx, &cy, nullptr, nullptr, extras::ImageView<T>(coarse, cNy, cNx), cparams, scratch);
+        scratch.has_window = false; //gradient in scratch belongs to the binned window
+
+        const double Xc = cx*f + offset + spec.Ix1;
+        const double Yc = cy*f + offset + spec.Iy1;
+        if (!isfinite(Xc) || !isfinite(Yc)) { //use the full window instead
+            radialcenter_window(n, nPart, x, y, varXY, RWR_N, img, params, scratch, (const SharedGradient<T>*)nullptr, nullptr, Status);
+            return;
+        }
+
+        ////////////////////////////////
+        // Full-resolution fit of the small window around the center
+        const double half = 0.5*double(params.PyramidWindow - 1);
+        const double Fx1 = max((double)spec.Ix1, floor(Xc - half));
+        const double Fx2 = min((double)spec.Ix2, ceil(Xc + half));
+        const double Fy1 = max((double)spec.Iy1, floor(Yc - half));
+        const double Fy2 = min((double)spec.Iy2, ceil(Yc + half));
+
+        RadialcenterParameters fparams = params;
+        double fWIND[4] = { Fx1, Fy1, Fx2 - Fx1 + 1, Fy2 - Fy1 + 1 };
+        double fXYc[2] = { Xc, Yc };
+        double fRadiusCutoff = spec.RadiusCutoff;
+        double fCutoffFactor = spec.CutoffFactor;
+        double fDistanceExponent = spec.DistanceExponent;
+        double fGradientExponent = spec.GradientExponent;
+        fparams.WIND = fWIND;
+        fparams.nWIND = 1;
+        fparams.XYc = fXYc;
+        fparams.nXYc = 1;
+        fparams.RadiusCutoff = &fRadiusCutoff;
+        fparams.nRadiusCutoff = 1;
+        fparams.CutoffFactor = &fCutoffFactor;
+        fparams.nCutoffFactor = 1;
+        fparams.DistanceExponent = &fDistanceExponent;
+        fparams.nDistanceExponent = 1;
+        fparams.GradientExponent = &fGradientExponent;
+        fparams.nGradientExponent = 1;
+
+        double fx, fy, fvarXY[2], fRWR_N, fStatus;
+        radialcenter_window(0, 1, &fx, &fy, fvarXY, &fRWR_N, img, fparams, scratch, (const SharedGradient<T>*)nullptr, nullptr, &fStatus);
+
+        x[n] = fx;
+        y[n] = fy;
+        if (params.OutputMask & OUTPUT_VARXY) {
+            varXY[n + nPart * 0] = fvarXY[0];
+            varXY[n + nPart * 1] = fvarXY[1];
+        }
+        if (params.OutputMask & OUTPUT_RWR_N) {
+            RWR_N[n] = fRWR_N;
+        }
+        if ((params.OutputMask & OUTPUT_STATUS) && Status != nullptr) {
+            Status[n] = fStatus;
+        }
+    }
 
-			double sw2 = 0;
-			double sw = 0;
+    //! Determine if radialcenter() can use the lane kernels (radialcenter_lane_batch()) with these parameters
+    //! Requires params.LaneBatchSize>0, SIMD vectors (more than one lane), one value of each of RadiusCutoff,
+    //! CutoffFactor, DistanceExponent and GradientExponent for all windows, and none of the options the lane
+    //! kernels do not implement (pyramid, shared gradient, integral image, RejectMethod, RefineIterations,
+    //! WeightKernelCache, REFERENCE_GRADIENT)
+    template <typename T>
+    inline bool radialcenter_use_lanes(const RadialcenterParameters& params, bool pyramid, bool shared_gradient, bool integral_image) {
+        return params.LaneBatchSize > 0 && rcdefs::simd::pack<T>::width > 1 &&
+            !pyramid && !shared_gradient && !integral_image &&
+            params.RejectMethod == rcdefs::NO_REJECT && params.RefineIterations == 0 && params.WeightKernelCache == 0 &&
+            params.GradientKernel == rcdefs::FUSED_GRADIENT &&
+            params.nRadiusCutoff == 1 && params.nCutoffFactor == 1 && params.nDistanceExponent == 1 && params.nGradientExponent == 1;
+    }
 
-			// cov Matrix terms: 1/(AD-B^2)*[D,-B;-B,A]
-			double A = 0;
-			double B = 0;
-			double D = 0;
+    //! Determine if window n can be processed by the lane kernels
+    //! (between 3x3 px and params.LaneBatchSize px, and, if the center of mass is needed, COMmethod=GRAD_MAG)
+    inline bool radialcenter_lane_window(size_t n, const RadialcenterWindowSpec& spec, const RadialcenterParameters& params) {
+        const size_t wNx = spec.Ix2 - spec.Ix1 + 1;
+        const size_t wNy = spec.Iy2 - spec.Iy1 + 1;
+        if (wNx < 3 || wNy < 3 || wNx > params.LaneBatchSize || wNy > params.LaneBatchSize) {
+            return false;
+        }
+        return params.COMmethod == rcdefs::GRAD_MAG || !radialcenter_needs_com(n, spec, params);
+    }
 
-			double XWy1 = 0;
-			double XWy2 = 0;
+    //! Process a batch of windows for radialcenter(), one window per SIMD lane (see radialcenter_lanes.h)
+    //! win[0...LANES-1] (LANES = simd::pack<T>::width) are the indices of the windows, which must all have
+    //! the same size and be accepted by radialcenter_lane_window(); radialcenter_use_lanes() must be true.
+    //! The pixels of the windows are gathered into a lane-interleaved tile, and the gradient, center of mass,
+    //! weighted sums and fit of all windows are computed together. Outputs are the same as for radialcenter_window().
+    template <typename M, typename T, typename Layout>
+    void radialcenter_lane_batch(const size_t* win, size_t nPart, //indices of the windows to process and total number of windows
+        double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params, //parameters
+        rcdefs::RadialcenterScratch<T>& scratch, //working buffers
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        using namespace std;
+        using namespace rcdefs;
+        const size_t L = simd::pack<T>::width;
+
+        RadialcenterWindowSpec spec[L];
+        for (size_t l = 0; l < L; ++l) {
+            spec[l] = radialcenter_window_spec(win[l], img.nRows, img.nCols, params);
+        }
+        const size_t dNx = spec[0].Ix2 - spec[0].Ix1; //width of gradient image
+        const size_t dNy = spec[0].Iy2 - spec[0].Iy1; //height of gradient image
+        const size_t nY = dNy + 1;
+        const size_t nX = dNx + 1;
+
+        // the parameters are the same for every window
+        const double this_RadiusCutoff = spec[0].RadiusCutoff;
+        const double this_CutoffFactor = spec[0].CutoffFactor;
+        const double this_DistanceExponent = spec[0].DistanceExponent;
+        const double this_GradientExponent = spec[0].GradientExponent;
+
+        // optional outputs
+        const bool out_varXY = (params.OutputMask & OUTPUT_VARXY) != 0;
+        const bool out_RWR_N = (params.OutputMask & OUTPUT_RWR_N) != 0;
+        const bool out_Status = (params.OutputMask & OUTPUT_STATUS) != 0 && Status != nullptr;
+        const bool residual = out_varXY || out_RWR_N;
+
+        scratch.reserve_lanes((nY*nX + 2 * dNy*dNx + 2 * dNy)*L);
+        T* tile = scratch.lanes;
+        T* du = tile + nY*nX*L;
+        T* dv = du + dNy*dNx*L;
+        T* colbuf = dv + dNy*dNx*L;
+
+        // gather the pixels of the windows, element (yi,xi) of window l at [(yi + xi*nY)*L + l]
+        for (size_t l = 0; l < L; ++l) {
+            for (size_t xi = 0; xi < nX; ++xi) {
+                for (size_t yi = 0; yi < nY; ++yi) {
+                    tile[(yi + xi*nY)*L + l] = (T)img(spec[l].Iy1 + yi, spec[l].Ix1 + xi);
+                }
+            }
+        }
 
-			//////////////////////////////////
-			//Build Matricies for Radial Center least-squares
-			if (this_GradientExponent == 0 && !isfinite(this_RadiusCutoff) && this_DistanceExponent==0) { //no weighting fractor used
-				sw2 = dNx*dNy;
-				sw = dNx*dNy;
+        lane_smoothgrad(tile, dNy, dNx, du, dv, colbuf);
 
-				for (size_t yi = 0; yi<dNy; ++yi) {
-					double yk = yi + 0.5;
-					for (size_t xi = 0; xi<dNx; ++xi) {
-						size_t ind = yi + xi*dNy;
-						double xk = xi + 0.5;
+        // center guess (same as radialcenter_window())
+        alignas(64) double Xcom[L];
+        alignas(64) double Ycom[L];
+        if (this_DistanceExponent == 0 && ((this_RadiusCutoff == 0 || !isfinite(this_RadiusCutoff)) || this_CutoffFactor == 0)) {
+            for (size_t l = 0; l < L; ++l) {
+                Xcom[l] = NAN;
+                Ycom[l] = NAN;
+            }
+        }
+        else {
+            bool needs_com = false;
+            for (size_t l = 0; l < L; ++l) {
+                needs_com = needs_com || radialcenter_needs_com(win[l], spec[l], params);
+            }
+            if (needs_com) {
+                lane_gradmag_com(du, dv, dNy, dNx, Xcom, Ycom);
+            }
+            for (size_t l = 0; l < L; ++l) { //windows with a valid XYc use it instead
+                if (!radialcenter_needs_com(win[l], spec[l], params)) {
+                    Xcom[l] = params.XYc[win[l] + 0 * params.nXYc] - spec[l].Ix1;
+                    Ycom[l] = params.XYc[win[l] + 1 * params.nXYc] - spec[l].Iy1;
+                }
+            }
+        }
+
+        ////////////////////////////////
+        // Weighted sums (same parameters as radialcenter_fit())
+        LaneWeightedSums<T> s;
+        s.du = du;
+        s.dv = dv;
+        s.dNx = dNx;
+        s.dNy = dNy;
+        s.residual = residual;
+        s.weighted = !(this_GradientExponent == 0 && !isfinite(this_RadiusCutoff) && this_DistanceExponent == 0);
+        s.cutoff = NO_CUTOFF;
+        if (isfinite(this_RadiusCutoff)) {
+            s.cutoff = isfinite(this_CutoffFactor) ? LOGISTIC_CUTOFF : TOPHAT_CUTOFF;
+        }
+        s.RE2 = (T)pow(spec[0].RadExtents, 2);
+        s.RadiusCutoff = (T)this_RadiusCutoff;
+        s.CutoffFactor = (T)this_CutoffFactor;
+        s.DistanceExponent = (T)this_DistanceExponent;
+        s.GradientExponent = (T)this_GradientExponent;
+
+        double Xref[L];
+        double Yref[L];
+        for (size_t l = 0; l < L; ++l) {
+            Xref[l] = isfinite(Xcom[l]) ? Xcom[l] : 0.5*dNx;
+            Yref[l] = isfinite(Ycom[l]) ? Ycom[l] : 0.5*dNy;
+            s.Xcom[l] = (T)Xcom[l];
+            s.Ycom[l] = (T)Ycom[l];
+            s.Xref[l] = (T)Xref[l];
+            s.Yref[l] = (T)Yref[l];
+        }
+
+        lane_weighted_sums(s);
+
+        ////////////////////////////////
+        // Solve each window
+        for (size_t l = 0; l < L; ++l) {
+            const size_t n = win[l];
+            double xw, yw, varX, varY, this_RWR_N; //result relative to window
+            radialcenter_solve(s.sw[l], s.sw2[l], s.A[l], s.B[l], s.D[l], s.XWy1[l], s.XWy2[l], s.Syy[l], s.SXy1[l], s.SXy2[l],
+                Xref[l], Yref[l], residual, xw, yw, varX, varY, this_RWR_N);
+
+            x[n] = xw + spec[l].Ix1;
+            y[n] = yw + spec[l].Iy1;
+            if (out_varXY) {
+                varXY[n + nPart * 0] = varX;
+                varXY[n + nPart * 1] = varY;
+            }
+            if (out_RWR_N) {
+                RWR_N[n] = this_RWR_N;
+            }
+            if (out_Status) {
+                Status[n] = (isfinite(x[n]) && isfinite(y[n])) ? WINDOW_OK : WINDOW_FIT_FAILED;
+            }
+        }
+    }
 
-                        double mag;
-                        if(!calced_grad_mag){
-                            mag= sqrt( pow(du[ind],2) + pow(dv[ind],2) );
+    //! Group the windows into tasks for the lane kernels (stored in workspace.tasks())
+    //! Windows accepted by radialcenter_lane_window() are sorted by size (keeping the processing order within
+    //! each size) and every LANES consecutive windows of the same size form a batch (radialcenter_lane_batch()).
+    //! The other windows, and the windows of each size left over after the last full batch, are processed
+    //! one at a time (radialcenter_window()).
+    //! order is the processing order from radialcenter_window_order() (or nullptr for input order)
+    template <typename T>
+    const rcdefs::RadialcenterTasks& radialcenter_lane_tasks(size_t nPart, size_t nRows, size_t nCols, const RadialcenterParameters& params,
+        const std::pair<uint64_t, size_t>* order, RadialcenterWorkspace<T>& workspace)
+    {
+        const size_t L = rcdefs::simd::pack<T>::width;
+        rcdefs::RadialcenterTasks& tasks = workspace.tasks(nPart);
+
+        for (size_t k = 0; k < nPart; ++k) {
+            size_t n = (order != nullptr) ? order[k].second : k;
+            RadialcenterWindowSpec spec = radialcenter_window_spec(n, nRows, nCols, params);
+            if (radialcenter_lane_window(n, spec, params)) {
+                uint64_t key = (uint64_t(spec.Iy2 - spec.Iy1) << 32) | uint64_t(spec.Ix2 - spec.Ix1);
+                tasks.batched.emplace_back(key, k);
+            }
+            else {
+                tasks.add(&n, 1);
+            }
+        }
+        std::sort(tasks.batched.begin(), tasks.batched.end());
+
+        size_t batch[L];
+        size_t i = 0;
+        while (i < tasks.batched.size()) {
+            size_t run = 1; //number of windows of the same size
+            while (i + run < tasks.batched.size() && tasks.batched[i + run].first == tasks.batched[i].first) {
+                ++run;
+            }
+            for (size_t j = 0; j < run; ++j) {
+                size_t k = tasks.batched[i + j].second;
+                batch[j % L] = (order != nullptr) ? order[k].second : k;
+                if (j >= run - run % L) { //left over
+                    tasks.add(&batch[j % L], 1);
+                }
+                else if (j % L == L - 1) {
+                    tasks.add(batch, L);
+                }
+            }
+            i += run;
+        }
+        tasks.start.push_back(tasks.windows.size());
+        return tasks;
+    }
 
-                        }else{
-                            mag = GradMag[ind];
-                        }
+    //! Compute the smoothed gradient of the region covering all windows, stored in workspace.shared_gradient()
+    //! Returns nullptr if the gradient should be computed per window instead
+    //! (GradientCache="auto" and the windows do not overlap enough, or the region is smaller than 2x2)
+    //! Note: pixels on the border of a window are smoothed using their neighbors outside of the window,
+    //! so the result differs slightly from computing the gradient separately for each window.
+    template <typename T, typename M, typename Layout>
+    const rcdefs::SharedGradient<T>* radialcenter_shared_gradient(size_t nPart,
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params,
+        RadialcenterWorkspace<T>& workspace, size_t nThreads)
+    {
+        using namespace std;
+
+        // bounding box of all windows
+        size_t Bx1 = img.nCols;
+        size_t By1 = img.nRows;
+        size_t Bx2 = 0;
+        size_t By2 = 0;
+        double WindArea = 0; //number of gradient pixels computed if each window is processed separately
+        for (size_t n = 0; n < nPart; ++n) {
+            RadialcenterWindowSpec spec = radialcenter_window_spec(n, img.nRows, img.nCols, params);
+            Bx1 = min(Bx1, spec.Ix1);
+            By1 = min(By1, spec.Iy1);
+            Bx2 = max(Bx2, spec.Ix2);
+            By2 = max(By2, spec.Iy2);
+            WindArea += double(spec.Ix2 - spec.Ix1)*double(spec.Iy2 - spec.Iy1);
+        }
+        if (Bx2 < Bx1 + 2 || By2 < By1 + 2) {
+            return nullptr;
+        }
+
+        size_t dNx = Bx2 - Bx1;
+        size_t dNy = By2 - By1;
+        if (params.GradientCache == rcdefs::AUTO_GRADIENT_CACHE && WindArea < double(dNx)*double(dNy)) {
+            return nullptr;
+        }
+
+        rcdefs::SharedGradient<T>& shared = workspace.shared_gradient();
+        shared.reserve(dNy*dNx);
+        shared.Ix1 = Bx1;
+        shared.Iy1 = By1;
+        shared.Ix2 = Bx2;
+        shared.Iy2 = By2;
+
+        size_t iStride;
+        const M * thisI = rcdefs::column_major_region(img, By1, Bx1, iStride);
+        if (params.GradientKernel == rcdefs::REFERENCE_GRADIENT) {
+            rcdefs::RadialcenterScratch<T>& scratch = workspace.scratch(0);
+            scratch.reserve_refbuf(3 * dNy*dNx);
+            rcdefs::smoothgrad(thisI, iStride, shared.du, shared.dv, dNy, dNx, scratch.refbuf);
+        }
+        else { // split columns between the worker threads
+            size_t nChunks = min(nThreads, dNx);
+            rcdefs::parallel_for(workspace.pool(), nChunks, nChunks, [&](size_t c, size_t thread_id) {
+                rcdefs::RadialcenterScratch<T>& scratch = workspace.scratch(thread_id);
+                scratch.reserve_colbuf(2 * dNy);
+                rcdefs::smoothgrad_fused_columns(thisI, iStride, shared.du, shared.dv, dNy, dNx, c*dNx / nChunks, (c + 1)*dNx / nChunks, scratch.colbuf);
+            });
+        }
+
+        return &shared;
+    }
 
-						sqWX[ind+dNy*dNx*0] = (du[ind] + dv[ind])/mag;// //sqWX(ind, 0) = (du(yi, xi) + dv(yi, xi)) / mag;
-						sqWX[ind+dNy*dNx*1] = (dv[ind] - du[ind])/mag;//sqWX(ind, 0) = (dv(yi, xi) - du(yi, xi)) / mag;
+    //! Compute the integral image of the region covering all windows, stored in workspace.integral_image()
+    //! For COMmethod=NORMAL or MEAN_ABS the integral image is built from the image.
+    //! For COMmethod=GRAD_MAG it is built from the magnitude of the shared gradient, so it requires shared!=nullptr.
+    //! Returns nullptr if the center of mass should be summed per window instead
+    //! (no window needs the center of mass, GRAD_MAG without a shared gradient,
+    //! or IntegralImage="auto" and the windows do not cover the region often enough)
+    template <typename T, typename M, typename Layout>
+    const rcdefs::IntegralImage* radialcenter_integral_image(size_t nPart,
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params,
+        RadialcenterWorkspace<T>& workspace,
+        const rcdefs::SharedGradient<T>* shared) //gradient computed for all windows (or nullptr)
+    {
+        using namespace std;
+
+        if (params.COMmethod == rcdefs::GRAD_MAG && shared == nullptr) {
+            return nullptr;
+        }
+
+        // bounding box of the windows that need the center of mass
+        size_t Bx1 = img.nCols;
+        size_t By1 = img.nRows;
+        size_t Bx2 = 0;
+        size_t By2 = 0;
+        double WindArea = 0; //number of pixels summed if each window is processed separately
+        bool needs_com = false;
+        for (size_t n = 0; n < nPart; ++n) {
+            RadialcenterWindowSpec spec = radialcenter_window_spec(n, img.nRows, img.nCols, params);
+            if (!radialcenter_needs_com(n, spec, params)) {
+                continue;
+            }
+            needs_com = true;
+            Bx1 = min(Bx1, spec.Ix1);
+            By1 = min(By1, spec.Iy1);
+            Bx2 = max(Bx2, spec.Ix2);
+            By2 = max(By2, spec.Iy2);
+            WindArea += double(spec.Ix2 - spec.Ix1 + 1)*double(spec.Iy2 - spec.Iy1 + 1);
+        }
+        if (!needs_com) {
+            return nullptr;
+        }
+
+        rcdefs::IntegralImage& integral = workspace.integral_image();
+        if (params.COMmethod == rcdefs::GRAD_MAG) { // magnitude of the shared gradient
+            size_t dNx = shared->Ix2 - shared->Ix1;
+            size_t dNy = shared->stride();
+            if (params.IntegralImage == rcdefs::AUTO_INTEGRAL_IMAGE && WindArea < double(dNx)*double(dNy)) {
+                return nullptr;
+            }
+            integral.Ix1 = shared->Ix1;
+            integral.Iy1 = shared->Iy1;
+            const T* du = shared->du;
+            const T* dv = shared->dv;
+            integral.build(dNy, dNx, [&](size_t yi, size_t xi) {
+                size_t gind = yi + xi*dNy;
+                return double(sqrt(rcdefs::sqr(du[gind]) + rcdefs::sqr(dv[gind])));
+            });
+        }
+        else { // image pixels
+            size_t dNx = Bx2 - Bx1 + 1;
+            size_t dNy = By2 - By1 + 1;
+            if (params.IntegralImage == rcdefs::AUTO_INTEGRAL_IMAGE && WindArea < double(dNx)*double(dNy)) {
+                return nullptr;
+            }
+            integral.Ix1 = Bx1;
+            integral.Iy1 = By1;
+            const extras::ImageView<M, Layout> region = img.subview(By1, Bx1, dNy, dNx);
+            integral.build(dNy, dNx, [&](size_t yi, size_t xi) {
+                return double(region(yi, xi));
+            });
+        }
+
+        return &integral;
+    }
 
-						sqWy[ind] = xk*sqWX[ind+dNy*dNx*0] + yk*sqWX[ind+dNy*dNx*1];//xk*sqWX(ind, 0) + yk*sqWX(ind, 1);
+    //! Radial Center Detection
+    //! Windows are processed by params.nThreads worker threads;
+    //! results are identical regardless of the number of threads used
+    //! T is the compute type (double or float) used for the per-pixel calculations
+    //! workspace holds the working memory; reusing the same workspace for every call
+    //! (e.g. once per frame) makes repeated calls allocation-free
+    //! img is a view of the image, which may be a sub-region of a larger frame or a buffer
+    //! with padded lines (the data are not copied); window coordinates are relative to the view
+    //! The memory layout of img is a compile-time policy (extras::ColumnMajor or extras::RowMajor,
+    //! see the overload below). Coordinates are always x=column, y=row.
+    //! Status (optional, nPart elements) receives the rcdefs::WINDOW_STATUS of each window; windows skipped
+    //! by params.RejectMethod return NaN.
+    //! If params.PyramidLevels>0, large windows are located on a binned copy and refined on a small
+    //! full-resolution window (see radialcenter_pyramid_window()); GradientCache and IntegralImage are ignored.
+    //! If params.LaneBatchSize>0, windows up to that size are processed in batches of windows of the same size,
+    //! one window per SIMD lane (see radialcenter_lane_batch()), when the other parameters allow it (radialcenter_use_lanes()).
+    template <typename T, typename M, typename Layout>
+    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params, //parameters
+        RadialcenterWorkspace<T>& workspace, //working memory
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        // Check Input Dimensions and Parameters
+		//---------------------------------------
+		using namespace std;
+        using namespace rcdefs;
 
-						A += pow(sqWX[ind+dNy*dNx*0],2);//sqWX(ind, 0)*sqWX(ind, 0);
-						D += pow(sqWX[ind+dNy*dNx*1],2);//sqWX(ind, 1)*sqWX(ind, 1);
-						B += sqWX[ind+dNy*dNx*0]*sqWX[ind+dNy*dNx*1];//sqWX(ind, 0)*sqWX(ind, 1);
+        size_t nPart = max(size_t(1), params.nWIND); //number of windows
 
-						XWy1 += sqWX[ind+dNy*dNx*0]*sqWy[ind];//sqWX(ind, 0)*sqWy(ind);
-						XWy2 += sqWX[ind+dNy*dNx*1]*sqWy[ind];//qWX(ind, 1)*sqWy(ind);
-					}
+        // check for XYc
+		if(params.nXYc != 0){
+			if(params.nWIND!=0){
+				if(params.nXYc!=params.nWIND){
+					throw(std::runtime_error("radialcenter: nRows XYc must match nRows WIND"));
 				}
 			}
-			else { //use weighting
-				double RE2 = pow(RadExtents, 2);
-				if (isfinite(this_RadiusCutoff) || this_DistanceExponent != 0) { //has distance dependence
-					if (isfinite(this_RadiusCutoff) ) { //using radius cutoff, only sum over circle
-						for (size_t yi = 0; yi < dNy; ++yi) {
-							double yk = yi + 0.5; // y coordinate
-							double dy2 = pow(Ycom - yk, 2); //square of y-component of radius
-							double xr = sqrt(RE2 - dy2); //x-component of the radius
-							for (size_t xi = (size_t)max(0.0,(Xcom - xr - 0.5)); xi < (size_t)min((double)dNx, (Xcom + xr - 0.5)); xi++) {
-								size_t ind = yi + xi * dNy; //index of pixel at coordinate xi,yi
-								double xk = xi + 0.5; //x coordinate
-
-								double sqw_mag = 1; //sqrt(w)/mag
-								double mag = 1; //|grad(I)|
-								double w = 1; //weight factor
-
-								if (isfinite(this_CutoffFactor) || this_DistanceExponent!=0) { //need to compute radius
-									double this_r = sqrt(pow(Xcom - xk, 2) + dy2);
-									if (this_DistanceExponent != 0) {
-										w /= pow(this_r, this_DistanceExponent);
-									}
-									if (isfinite(this_CutoffFactor)) { //using logistic filter
-										w *= 1.0 / (1.0 + exp(this_CutoffFactor*(this_r - this_RadiusCutoff)));
-									}
-									else {
-										if (this_r > this_RadiusCutoff) {
-											w = 0;
-										}
-									}
-								}
-
-								if (w != 0) { //haven't been excluded by radius filter yet
-									//calc mag^2, sqrt(w)/mag, w
-									if (!calced_grad_mag) {
-										mag = sqrt(pow(du[ind], 2) + pow(dv[ind], 2));
-									}
-									else {
-										mag = GradMag[ind];
-									}
-
-									if (mag == 0) { //special case when gradient was exactly zero (probably rare)
-										sqw_mag = 0;
-										w = 0;
-									}
-									else {
-										w *= pow(mag, this_GradientExponent); //weight factor;
-										sqw_mag = sqrt(w) / mag;
-									}
-								}
-								else {
-									sqw_mag = 0;
-								}
-
-								sw2 += w * w;
-								sw += w;
-
-								sqWX[ind + dNy * dNx * 0] = (du[ind] + dv[ind])*sqw_mag;//sqWX(ind, 0) = (du(yi, xi) + dv(yi, xi))*sqw_mag;
-								sqWX[ind + dNy * dNx * 1] = (dv[ind] - du[ind])*sqw_mag;//sqWX(ind, 1) = (dv(yi, xi) - du(yi, xi))*sqw_mag;
-
-								sqWy[ind] = xk * sqWX[ind + dNy * dNx * 0] + yk * sqWX[ind + dNy * dNx * 1];//xk*sqWX(ind, 0) + yk*sqWX(ind, 1);
-
-								A += pow(sqWX[ind + dNy * dNx * 0], 2);//sqWX(ind, 0)*sqWX(ind, 0);
-								D += pow(sqWX[ind + dNy * dNx * 1], 2);//sqWX(ind, 1)*sqWX(ind, 1);
-								B += sqWX[ind + dNy * dNx * 0] * sqWX[ind + dNy * dNx * 1];//sqWX(ind, 0)*sqWX(ind, 1);
-
-								XWy1 += sqWX[ind + dNy * dNx * 0] * sqWy[ind];//sqWX(ind, 0)*sqWy(ind);
-								XWy2 += sqWX[ind + dNy * dNx * 1] * sqWy[ind];//qWX(ind, 1)*sqWy(ind);
-							}//end xi loop
-						}//end yi loop
-					}//end has distance dependence
-					else { // not using radius cutoff, only sum whole thing
-						for (size_t yi = 0; yi < dNy; ++yi) {
-							double yk = yi + 0.5;
-							double dy2 = pow(Ycom - yk, 2);
-							for (size_t xi = 0; xi < dNx; ++xi) {
-								size_t ind = yi + xi * dNy;
-								double xk = xi + 0.5;
-
-								double sqw_mag; //sqrt(w)/mag
-								double mag; //|grad(I)|
-								double w = 1; //weight factor
-
-								if (this_DistanceExponent != 0) {
-									w /= pow(sqrt(pow(Xcom - xk, 2) + dy2), this_DistanceExponent);
-								}
-
-								if (w != 0) { //haven't been excluded by radius filter yet
-											  //calc mag^2, sqrt(w)/mag, w
-									if (!calced_grad_mag) {
-										mag = sqrt(pow(du[ind], 2) + pow(dv[ind], 2));
-									}
-									else {
-										mag = GradMag[ind];
-									}
-
-									if (mag == 0) { //special case when gradient was exactly zero (probably rare)
-										sqw_mag = 0;
-										w = 0;
-									}
-									else {
-										w *= pow(mag, this_GradientExponent); //weight factor;
-										sqw_mag = sqrt(w) / mag;
-									}
-								}
-								else {
-									sqw_mag = 0;
-								}
-
-								sw2 += w * w;
-								sw += w;
-
-								sqWX[ind + dNy * dNx * 0] = (du[ind] + dv[ind])*sqw_mag;//sqWX(ind, 0) = (du(yi, xi) + dv(yi, xi))*sqw_mag;
-								sqWX[ind + dNy * dNx * 1] = (dv[ind] - du[ind])*sqw_mag;//sqWX(ind, 1) = (dv(yi, xi) - du(yi, xi))*sqw_mag;
-
-								sqWy[ind] = xk * sqWX[ind + dNy * dNx * 0] + yk * sqWX[ind + dNy * dNx * 1];//xk*sqWX(ind, 0) + yk*sqWX(ind, 1);
-
-								A += pow(sqWX[ind + dNy * dNx * 0], 2);//sqWX(ind, 0)*sqWX(ind, 0);
-								D += pow(sqWX[ind + dNy * dNx * 1], 2);//sqWX(ind, 1)*sqWX(ind, 1);
-								B += sqWX[ind + dNy * dNx * 0] * sqWX[ind + dNy * dNx * 1];//sqWX(ind, 0)*sqWX(ind, 1);
-
-								XWy1 += sqWX[ind + dNy * dNx * 0] * sqWy[ind];//sqWX(ind, 0)*sqWy(ind);
-								XWy2 += sqWX[ind + dNy * dNx * 1] * sqWy[ind];//qWX(ind, 1)*sqWy(ind);
-
-							} //end xi loop
-						} //end yi loop
-					}//end not using rad cutoff
-				} else { //no distance dependence
-					for (size_t yi = 0; yi < dNy; ++yi) {
-						double yk = yi + 0.5;
-						for (size_t xi = 0; xi < dNx; ++xi) {
-							size_t ind = yi + xi * dNy;
-							double xk = xi + 0.5;
-
-							double sqw_mag; //sqrt(w)/mag
-							double mag; //|grad(I)|
-							double w = 1; //weight factor
-
-							//calc mag^2, sqrt(w)/mag, w
-							if (!calced_grad_mag) {
-								mag = sqrt(pow(du[ind], 2) + pow(dv[ind], 2));
-							}
-							else {
-								mag = GradMag[ind];
-							}
-
-							if (mag == 0) { //special case when gradient was exactly zero (probably rare)
-								sqw_mag = 0;
-								w = 0;
-							}
-							else {
-								w = pow(mag, this_GradientExponent); //weight factor;
-								sqw_mag = sqrt(w) / mag;
-							}
-
-							sw2 += w*w;
-							sw += w;
-
-							sqWX[ind + dNy * dNx * 0] = (du[ind] + dv[ind])*sqw_mag;//sqWX(ind, 0) = (du(yi, xi) + dv(yi, xi))*sqw_mag;
-							sqWX[ind + dNy * dNx * 1] = (dv[ind] - du[ind])*sqw_mag;//sqWX(ind, 1) = (dv(yi, xi) - du(yi, xi))*sqw_mag;
-
-							sqWy[ind] = xk * sqWX[ind + dNy * dNx * 0] + yk * sqWX[ind + dNy * dNx * 1];//xk*sqWX(ind, 0) + yk*sqWX(ind, 1);
-
-							A += pow(sqWX[ind + dNy * dNx * 0], 2);//sqWX(ind, 0)*sqWX(ind, 0);
-							D += pow(sqWX[ind + dNy * dNx * 1], 2);//sqWX(ind, 1)*sqWX(ind, 1);
-							B += sqWX[ind + dNy * dNx * 0] * sqWX[ind + dNy * dNx * 1];//sqWX(ind, 0)*sqWX(ind, 1);
-
-							XWy1 += sqWX[ind + dNy * dNx * 0] * sqWy[ind];//sqWX(ind, 0)*sqWy(ind);
-							XWy2 += sqWX[ind + dNy * dNx * 1] * sqWy[ind];//qWX(ind, 1)*sqWy(ind);
-
-						}//end xi loop
-					}//end yi loop
-				}//end if distance dependence
-			}// end if use weight
-
-			double det = (A*D - B*B); //calc determinant for inverse
-
-			A /= det;
-			B /= det;
-			D /= det;
-			x[n] = (D*XWy1 - B*XWy2);
-			y[n] = (A*XWy2 - B*XWy1);
+			else{
+				nPart = params.nXYc;
+			}
+		}
 
-			/////////////////////////
-			// calc variance
-
-			double RWR = 0;
-			for (int i = 0; i<dNx*dNy; ++i) {
-				RWR += pow(sqWy[i] - sqWX[i+dNy*dNx*0]*x[n] - sqWX[i+dNy*dNx*1]*y[n], 2);
-			}
+        // validate RadiusCutoff
+        if (params.nRadiusCutoff ==0) { //empty RadiusCutoff
+            throw("Empty RadiusCutoff not supported");
+		}
+		else if (params.nRadiusCutoff ==1) { //
+		}
+		else { //make sure same size as nPart
+			extras::assert_condition(params.nRadiusCutoff == nPart,"RadiusCutoff has wrong number of elements");
+		}
 
-			//calc variance
-			double denom = sw*sw / sw2;
-			if (denom > 2) {
-				denom -= 2;
-			}
+        if (params.nCutoffFactor ==0) { //empty RadiusCutoff
+            throw("Empty CutoffFactor not supported");
+		}
+		else if (params.nCutoffFactor ==1) { //
+		}
+		else { //make sure same size as nPart
+			extras::assert_condition(params.nCutoffFactor == nPart,"CutoffFactor has wrong number of elements");
+		}
 
-			RWR_N[n] = RWR / (sw - 2 * sw2 / sw);
+        if (params.nDistanceExponent ==0) { //empty RadiusCutoff
+            throw("Empty DistanceExponent not supported");
+		}
+		else if (params.nDistanceExponent ==1) { //
+		}
+		else { //make sure same size as nPart
+			extras::assert_condition(params.nDistanceExponent == nPart,"DistanceExponent has wrong number of elements");
+		}
 
-			RWR /= denom;
+        if (params.nGradientExponent ==0) { //empty RadiusCutoff
+            throw("Empty GradientExponent not supported");
+		}
+		else if (params.nGradientExponent ==1) { //
+		}
+		else { //make sure same size as nPart
+			extras::assert_condition(params.nGradientExponent == nPart,"GradientExponent has wrong number of elements");
+		}
 
-			varXY[n+nPart*0] = D*RWR;
-			varXY[n+nPart*1] = A*RWR;
+        // each worker thread gets its own set of scratch buffers
+        size_t nThreads = rcdefs::resolve_threads(params.nThreads, nPart);
+        workspace.prepare(nThreads);
+
+        // compute gradient once for all windows, if requested
+        // (not used by the pyramid, which only computes the full-resolution gradient of a small window)
+        const bool pyramid = params.PyramidLevels > 0;
+        const rcdefs::SharedGradient<T>* shared = nullptr;
+        if (params.GradientCache != rcdefs::NO_GRADIENT_CACHE && !pyramid) {
+            shared = radialcenter_shared_gradient(nPart, img, params, workspace, nThreads);
+        }
+
+        // integral image used to find the center of mass of every window, if requested
+        const rcdefs::IntegralImage* integral = nullptr;
+        if (params.IntegralImage != rcdefs::NO_INTEGRAL_IMAGE && !pyramid) {
+            integral = radialcenter_integral_image(nPart, img, params, workspace, shared);
+        }
+
+        // processing order (results are still written to the window's own index)
+        const std::pair<uint64_t, size_t>* order = radialcenter_window_order(nPart, img.nRows, img.nCols, params, workspace);
+
+        // small windows of the same size are processed in batches, one window per SIMD lane
+        if (radialcenter_use_lanes<T>(params, pyramid, shared != nullptr, integral != nullptr)) {
+            const rcdefs::RadialcenterTasks& tasks = radialcenter_lane_tasks(nPart, img.nRows, img.nCols, params, order, workspace);
+            const size_t nTasks = tasks.count();
+            size_t nChunks = (nThreads == 1) ? 1 : min(nTasks, 4 * nThreads);
+            rcdefs::parallel_for(workspace.pool(), nChunks, nThreads, [&](size_t c, size_t thread_id) {
+                for (size_t t = c*nTasks / nChunks; t < (c + 1)*nTasks / nChunks; ++t) {
+                    const size_t* win = tasks.windows.data() + tasks.start[t];
+                    if (tasks.start[t + 1] - tasks.start[t] > 1) {
+                        radialcenter_lane_batch(win, nPart, x, y, varXY, RWR_N, img, params, workspace.scratch(thread_id), Status);
+                    }
+                    else {
+                        radialcenter_window(*win, nPart, x, y, varXY, RWR_N, img, params, workspace.scratch(thread_id), shared, integral, Status);
+                    }
+                }
+            });
+            return;
+        }
 
-			x[n] += Ix1;
-			y[n] += Iy1;
+        // loop over particles and compute
+        // consecutive windows are grouped into chunks (several per thread) so that each thread
+        // works on one region of the image at a time, while the chunks still balance the load
+        size_t nChunks = (nThreads == 1) ? 1 : min(nPart, 4 * nThreads);
+        rcdefs::parallel_for(workspace.pool(), nChunks, nThreads, [&](size_t c, size_t thread_id) {
+            for (size_t k = c*nPart / nChunks; k < (c + 1)*nPart / nChunks; ++k) {
+                size_t n = (order != nullptr) ? order[k].second : k;
+                if (pyramid) {
+                    radialcenter_pyramid_window(n, nPart, x, y, varXY, RWR_N, img, params, workspace.scratch(thread_id), Status);
+                }
+                else {
+                    radialcenter_window(n, nPart, x, y, varXY, RWR_N, img, params, workspace.scratch(thread_id), shared, integral, Status);
+                }
+            }
+        });
+    }
 
-		}
+    //! Radial Center Detection
+    //! Same as above, for a row-major image (e.g. a camera buffer)
+    //! A row-major image is the column-major view of its transpose (extras::ImageView::transposed()), so the
+    //! windows are processed on the transposed view with x and y swapped (the columns of WIND and XYc, and the
+    //! outputs). The frame is not copied. The results are those of the column-major copy of the frame, up to
+    //! rounding (the gradient and the sums run along the rows instead of the columns).
+    template <typename T, typename M>
+    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, extras::RowMajor>& img, //image (rows may be padded)
+        const RadialcenterParameters& params, //parameters
+        RadialcenterWorkspace<T>& workspace, //working memory
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        // WIND=[x,y,w,h] and XYc=[x,y] in the coordinates of the transposed image
+        const size_t nW = params.nWIND;
+        const size_t nC = params.nXYc;
+        std::vector<double>& coords = workspace.transposed_coordinates(4 * nW + 2 * nC);
+        RadialcenterParameters tparams = params;
+        if (nW != 0) {
+            tparams.WIND = coords.data();
+            for (size_t n = 0; n < nW; ++n) {
+                tparams.WIND[n + 0 * nW] = params.WIND[n + 1 * nW];
+                tparams.WIND[n + 1 * nW] = params.WIND[n + 0 * nW];
+                tparams.WIND[n + 2 * nW] = params.WIND[n + 3 * nW];
+                tparams.WIND[n + 3 * nW] = params.WIND[n + 2 * nW];
+            }
+        }
+        if (nC != 0) {
+            tparams.XYc = coords.data() + 4 * nW;
+            for (size_t n = 0; n < nC; ++n) {
+                tparams.XYc[n + 0 * nC] = params.XYc[n + 1 * nC];
+                tparams.XYc[n + 1 * nC] = params.XYc[n + 0 * nC];
+            }
+        }
+
+        radialcenter(y, x, varXY, RWR_N, img.transposed(), tparams, workspace, Status);
+
+        // varXY of the transposed image is [varY, varX]
+        if (varXY != nullptr && (params.OutputMask & rcdefs::OUTPUT_VARXY) != 0) {
+            const size_t nPart = (nW != 0) ? nW : std::max(size_t(1), nC);
+            for (size_t n = 0; n < nPart; ++n) {
+                std::swap(varXY[n], varXY[n + nPart]);
+            }
+        }
+    }
+
+    //! Radial Center Detection
+    //! Same as above, for a packed image (nRows x nCols)
+    //! params.ImageLayout specifies if img is column-major (I(y,x) = img[y+nRows*x], default)
+    //! or row-major (I(y,x) = img[x+nCols*y])
+    template <typename T, typename M>
+    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const M* img, size_t nRows, size_t nCols, //image and size
+        const RadialcenterParameters& params, //parameters
+        RadialcenterWorkspace<T>& workspace, //working memory
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        if (params.ImageLayout == rcdefs::ROW_MAJOR_LAYOUT) {
+            radialcenter(x, y, varXY, RWR_N, extras::ImageView<M, extras::RowMajor>(img, nRows, nCols), params, workspace, Status);
+        }
+        else {
+            radialcenter(x, y, varXY, RWR_N, extras::ImageView<M>(img, nRows, nCols), params, workspace, Status);
+        }
+    }
+
+    //! Radial Center Detection
+    //! Same as above, but uses a temporary workspace
+    //! T is the compute type (double or float) used for the per-pixel calculations;
+    //! call as radialcenter<float>(...) to use single precision
+    template <typename T = double, typename M>
+    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const M* img, size_t nRows, size_t nCols, //image and size (layout given by params.ImageLayout)
+        const RadialcenterParameters& params = RadialcenterParameters(), //parameters
+		double* Status = nullptr //status code of each window (or nullptr)
+		//double * oXYc=nullptr
+        )
+    {
+        RadialcenterWorkspace<T> workspace;
+        radialcenter(x, y, varXY, RWR_N, img, nRows, nCols, params, workspace, Status);
+    }
 
-		///////////
-		// Cleanup memory
-		std::free(du);
-		std::free(dv);
-		std::free(sqWX);
-		std::free(sqWy);
-		std::free(GradMag);
+    //! Radial Center Detection
+    //! Same as above, for an image view (uses a temporary workspace)
+    template <typename T = double, typename M, typename Layout>
+    void radialcenter(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const extras::ImageView<M, Layout>& img, //image (columns or rows may be padded)
+        const RadialcenterParameters& params = RadialcenterParameters(), //parameters
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        RadialcenterWorkspace<T> workspace;
+        radialcenter(x, y, varXY, RWR_N, img, params, workspace, Status);
+    }
 
+    //! Radial Center Detection for a stack of images
+    //! Applies the same windows (and parameters) to every frame of the stack.
+    //! frames[f] points to frame f (all frames are nRows x nCols, with the layout given by params.ImageLayout)
+    //! Output arrays are sized for nPart x nFrames:
+    //!     x[n+nPart*f], y[n+nPart*f], RWR_N[n+nPart*f], Status[n+nPart*f]
+    //!     varXY[n+nPart*(k+2*f)] (i.e. [nPart x 2 x nFrames])
+    //! Frames are distributed over params.nThreads threads (each frame is processed by a single thread)
+    //! workspaces holds one workspace per thread and is grown if needed; reuse it between calls to avoid allocations
+    //! (the worker threads are kept by workspaces[0])
+    template <typename T, typename M>
+    void radialcenter_stack(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const M* const* frames, size_t nFrames, //pointers to each frame and number of frames
+        size_t nRows, size_t nCols, //size of each frame
+        const RadialcenterParameters& params, //parameters
+        std::vector<RadialcenterWorkspace<T>>& workspaces, //working memory for each thread
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        size_t nPart = std::max(std::max(size_t(1), params.nWIND), params.nXYc); //number of windows
+
+        size_t nThreads = rcdefs::resolve_threads(params.nThreads, nFrames);
+        while (workspaces.size() < nThreads) {
+            workspaces.emplace_back();
+        }
+
+        // frames are processed in parallel, so each frame runs on one thread
+        RadialcenterParameters frame_params = params;
+        if (nFrames > 1) {
+            frame_params.nThreads = 1;
+        }
+
+        rcdefs::parallel_for(workspaces[0].pool(), nFrames, nThreads, [&](size_t f, size_t thread_id) {
+            radialcenter(x + nPart*f, y + nPart*f, varXY ? varXY + 2 * nPart*f : nullptr, RWR_N ? RWR_N + nPart*f : nullptr,
+                frames[f], nRows, nCols, frame_params, workspaces[thread_id], Status ? Status + nPart*f : nullptr);
+        });
+    }
+
+    //! Radial Center Detection for a stack of images
+    //! Same as above, but uses temporary workspaces
+    template <typename T = double, typename M>
+    void radialcenter_stack(double* x, double* y, double* varXY, double* RWR_N, //pointers to 4 arrays of appropriate size
+        const M* const* frames, size_t nFrames, //pointers to each frame and number of frames
+        size_t nRows, size_t nCols, //size of each frame
+        const RadialcenterParameters& params = RadialcenterParameters(), //parameters
+        double* Status = nullptr) //status code of each window (or nullptr)
+    {
+        std::vector<RadialcenterWorkspace<T>> workspaces;
+        radialcenter_stack(x, y, varXY, RWR_N, frames, nFrames, nRows, nCols, params, workspaces, Status);
     }
 }}
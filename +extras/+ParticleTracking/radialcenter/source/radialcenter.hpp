@@ -26,35 +26,37 @@ namespace extras{namespace ParticleTracking{
 		rcdefs::COM_METHOD COMmethod = rcdefs::GRAD_MAG; //method used for estimating center of mass
 		std::shared_ptr<extras::ArrayBase<double>> DistanceExponent = std::make_shared<extras::Array<double>>(std::vector<double>({ 1 })); //Distance-depencence exponent
 		std::shared_ptr<extras::ArrayBase<double>> GradientExponent = std::make_shared<extras::Array<double>>(std::vector<double>({ 5 })); //gradient exponent
+		size_t nThreads = 1; //number of threads used to process windows (0 = all hardware threads)
+		rcdefs::GRADIENT_KERNEL GradientKernel = rcdefs::FUSED_GRADIENT; //implementation used for the smoothed gradient
+		rcdefs::GRADIENT_CACHE GradientCache = rcdefs::NO_GRADIENT_CACHE; //compute gradient per window, or once for all windows
+		size_t WeightKernelCache = 0; //sub-pixel steps used for cached weight kernels (0 = no cache)
+		rcdefs::INTEGRAL_IMAGE IntegralImage = rcdefs::NO_INTEGRAL_IMAGE; //sum center of mass per window, or use an integral image of all windows
+		rcdefs::WINDOW_ORDER WindowOrder = rcdefs::MORTON_ORDER; //order in which windows are processed
+		size_t RefineIterations = 0; //number of refinement passes with the window shrunk around the previous solution
+		double RefineTolerance = 0.001; //stop refining once the center moves less than this (px)
+		rcdefs::IMAGE_LAYOUT ImageLayout = rcdefs::COLUMN_MAJOR_LAYOUT; //COLUMN_MAJOR_LAYOUT: I is the image; ROW_MAJOR_LAYOUT: I holds a row-major frame (the image is I')
+		rcdefs::REJECT_METHOD RejectMethod = rcdefs::NO_REJECT; //check used to skip windows that do not contain a particle
+		double RejectThreshold = 0; //windows scoring below this are skipped
+		unsigned OutputMask = rcdefs::OUTPUT_ALL; //optional outputs that are computed (rcdefs::OUTPUT_MASK), the others are returned empty
+		size_t PyramidLevels = 0; //number of 2x binning levels used to locate the center of large windows (0 = off)
+		size_t PyramidWindow = 32; //size (px) of the full-resolution window fit around the binned center
+		size_t LaneBatchSize = 0; //windows up to this size (px) are processed in batches, one window per SIMD lane (0 = off)
+		bool FixedSizeKernels = true; //use the weight loops compiled for 32, 48 and 64 px windows
 
 	};
 
-	///Radial Center Detection
-	///Description:
-	/// radialcenter uses Parthasarathy's radial symmetry algorithm to detect origins of asmuthal symmetry in an image
-	/// This implementation is capable of using sub-windows to look for multiple particles in the same image
-	///
-	///Usage:
-	/// This function is a template allowing different output types to be specified.
-	///
-	/// Output argument order is:
-	///	X - the x locations of the particle centers
-	///	Y - the y locations of the particle centers
-	///	varXY - [Nx2] extras::Array of the localization confidence level for X (column 1) and Y (column 2)
-	///	RWR/N - the weighted-average distance between the estimated center and all the graident vectors in the sub-image
-	template<class OutContainerClass=extras::Array<double>,typename ImageType=double> //OutContainerClass should be class derived from extras::ArrayBase
-	std::vector<OutContainerClass> radialcenter(const extras::ArrayBase<ImageType>& I, //input image
-												const RadialcenterParameters_Shared& params = RadialcenterParameters_Shared())//parameters
+	//! Validate the shared parameters and convert them to RadialcenterParameters
+	//! The returned struct points into the arrays held by params.
+	//! nPart is set to the number of windows
+	inline RadialcenterParameters radialcenter_parameters(const RadialcenterParameters_Shared& params, size_t& nPart)
 	{
-		// Check Input Dimensions and Parameters
-		//---------------------------------------
 		using namespace std;
 
 		// Validate WIND
 		if(!params.WIND->isempty() && params.WIND->nCols() != 4){
 			throw(runtime_error("radialcenter: WIND must be empty or Mx4 extras::Array."));
 		}
-		size_t nPart = max(size_t(1), params.WIND->nRows());//number of particles to find
+		nPart = max(size_t(1), params.WIND->nRows());//number of particles to find
 
 		//validate XYc
 		if(!params.XYc->isempty()){
@@ -67,7 +69,6 @@ namespace extras{namespace ParticleTracking{
 				}
 			}
 			else{
-				//nPart_via_WIND = false;
 				nPart = params.XYc->nRows();
 			}
 		}
@@ -87,149 +88,226 @@ namespace extras{namespace ParticleTracking{
 		rc_params.WIND = params.WIND->getdata();
 		rc_params.nXYc = params.XYc->nRows();
 		rc_params.XYc = params.XYc->getdata();
+		rc_params.nThreads = params.nThreads;
+		rc_params.GradientKernel = params.GradientKernel;
+		rc_params.GradientCache = params.GradientCache;
+		rc_params.WeightKernelCache = params.WeightKernelCache;
+		rc_params.IntegralImage = params.IntegralImage;
+		rc_params.WindowOrder = params.WindowOrder;
+		rc_params.RefineIterations = params.RefineIterations;
+		rc_params.RefineTolerance = params.RefineTolerance;
+		rc_params.ImageLayout = params.ImageLayout;
+		rc_params.RejectMethod = params.RejectMethod;
+		rc_params.RejectThreshold = params.RejectThreshold;
+		rc_params.OutputMask = params.OutputMask;
+		rc_params.PyramidLevels = params.PyramidLevels;
+		rc_params.PyramidWindow = params.PyramidWindow;
+		rc_params.LaneBatchSize = params.LaneBatchSize;
+		rc_params.FixedSizeKernels = params.FixedSizeKernels;
+
+		return rc_params;
+	}
+
+	//! Size of the image held by the array I
+	//! For ROW_MAJOR_LAYOUT the array holds a row-major frame, so the image is the transpose of the array
+	inline void radialcenter_image_size(const extras::DynamicTypeArrayBase& I, rcdefs::IMAGE_LAYOUT layout, size_t& nRows, size_t& nCols) {
+		nRows = I.nRows();
+		nCols = I.nCols();
+		if (layout == rcdefs::ROW_MAJOR_LAYOUT) {
+			std::swap(nRows, nCols);
+		}
+	}
+
+	///Radial Center Detection
+	///Description:
+	/// radialcenter uses Parthasarathy's radial symmetry algorithm to detect origins of asmuthal symmetry in an image
+	/// This implementation is capable of using sub-windows to look for multiple particles in the same image
+	///
+	///Usage:
+	/// This function is a template allowing different output types to be specified.
+	///
+	/// Output argument order is:
+	///	X - the x locations of the particle centers
+	///	Y - the y locations of the particle centers
+	///	varXY - [Nx2] extras::Array of the localization confidence level for X (column 1) and Y (column 2)
+	///	RWR/N - the weighted-average distance between the estimated center and all the graident vectors in the sub-image
+	///	Status - rcdefs::WINDOW_STATUS of each window (windows skipped by params.RejectMethod are NaN in the other outputs)
+	///
+	/// varXY, RWR/N and Status are only computed if they are included in params.OutputMask (otherwise they are empty);
+	/// skipping varXY and RWR/N avoids accumulating the weighted residual.
+	///
+	/// ComputeT specifies the type (double or float) used for the per-pixel calculations
+	///
+	/// workspace (optional) is reused working memory. Callers that process many frames
+	/// (e.g. RoiTracker) should keep one workspace and pass it to every call so that
+	/// steady-state processing does not allocate. If nullptr a temporary workspace is used.
+	///
+	/// If params.ImageLayout==ROW_MAJOR_LAYOUT, I holds a row-major frame (e.g. a camera buffer that was
+	/// not transposed), so the image has I.nCols() rows and I.nRows() columns. Coordinates refer to that image.
+	template<class OutContainerClass=extras::Array<double>,typename ImageType=double,typename ComputeT=double> //OutContainerClass should be class derived from extras::ArrayBase
+	std::vector<OutContainerClass> radialcenter(const extras::ArrayBase<ImageType>& I, //input image
+												const RadialcenterParameters_Shared& params = RadialcenterParameters_Shared(),//parameters
+												RadialcenterWorkspace<ComputeT>* workspace = nullptr) //working memory
+	{
+		// Check Input Dimensions and Parameters
+		//---------------------------------------
+		using namespace std;
+
+		size_t nPart; //number of particles to find
+		RadialcenterParameters rc_params = radialcenter_parameters(params, nPart);
 
 		//Setup Output variables
 		//----------------------------
 		vector<OutContainerClass> out;
-		out.resize(4);
+		out.resize(5);
 
 		auto& x = out[0];
 		auto& y = out[1];
 		auto& varXY = out[2];
 		auto& RWR_N = out[3];
+		auto& Status = out[4];
 
-		// Resize output vars
+		// Resize output vars (outputs that are not requested are left empty)
 		x.resize(nPart, 1);
 		y.resize(nPart, 1);
 
-		varXY.resize(nPart, 2);
-		RWR_N.resize(nPart, 1);
+		double* pVarXY = nullptr;
+		double* pRWR_N = nullptr;
+		double* pStatus = nullptr;
+		if (rc_params.OutputMask & rcdefs::OUTPUT_VARXY) {
+			varXY.resize(nPart, 2);
+			pVarXY = varXY.getdata();
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+			RWR_N.resize(nPart, 1);
+			pRWR_N = RWR_N.getdata();
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_STATUS) {
+			Status.resize(nPart, 1);
+			pStatus = Status.getdata();
+		}
 
 		//Call radialcenter
 		//---------------------
-		radialcenter(x.getdata(),y.getdata(),varXY.getdata(),RWR_N.getdata(),
-					I.getdata(),I.nRows(),I.nCols(),
-					rc_params);
+		RadialcenterWorkspace<ComputeT> local_workspace;
+		if (workspace == nullptr) {
+			workspace = &local_workspace;
+		}
+
+		size_t nRows, nCols; //size of the image
+		radialcenter_image_size(I, params.ImageLayout, nRows, nCols);
+
+		radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+					I.getdata(),nRows,nCols,
+					rc_params, *workspace, pStatus);
 
 		// Return output
 		return out;
 	}
 
-	template<class OutContainerClass = extras::Array<double>> //OutContainerClass should be class derived from extras::ArrayBase
+	template<class OutContainerClass = extras::Array<double>, typename ComputeT = double> //OutContainerClass should be class derived from extras::ArrayBase
 	std::vector<OutContainerClass> radialcenter(const extras::DynamicTypeArrayBase& I, //input image
-		const RadialcenterParameters_Shared& params = RadialcenterParameters_Shared())//parameters
+		const RadialcenterParameters_Shared& params = RadialcenterParameters_Shared(),//parameters
+		RadialcenterWorkspace<ComputeT>* workspace = nullptr) //working memory (see above)
 	{
 		// Check Input Dimensions and Parameters
 		//---------------------------------------
 		using namespace std;
 
-		// Validate WIND
-		if (!params.WIND->isempty() && params.WIND->nCols() != 4) {
-			throw(runtime_error("radialcenter: WIND must be empty or Mx4 extras::Array."));
-		}
-		size_t nPart = max(size_t(1), params.WIND->nRows());//number of particles to find
-
-															//validate XYc
-		if (!params.XYc->isempty()) {
-			if (params.XYc->nCols() != 2) {
-				throw(std::runtime_error("radialcenter: XYc must have two columns"));
-			}
-			if (!params.WIND->isempty()) {
-				if (params.XYc->nRows() != params.WIND->nRows()) {
-					throw(std::runtime_error("radialcenter: nRows XYc must match nRows WIND"));
-				}
-			}
-			else {
-				//nPart_via_WIND = false;
-				nPart = params.XYc->nRows();
-			}
-		}
-
-		//Create Params Struct
-		RadialcenterParameters rc_params;
-		rc_params.COMmethod = params.COMmethod;
-		rc_params.nRadiusCutoff = params.RadiusCutoff->numel();
-		rc_params.RadiusCutoff = params.RadiusCutoff->getdata();
-		rc_params.nCutoffFactor = params.CutoffFactor->numel();
-		rc_params.CutoffFactor = params.CutoffFactor->getdata();
-		rc_params.nDistanceExponent = params.DistanceExponent->numel();
-		rc_params.DistanceExponent = params.DistanceExponent->getdata();
-		rc_params.nGradientExponent = params.GradientExponent->numel();
-		rc_params.GradientExponent = params.GradientExponent->getdata();
-		rc_params.nWIND = params.WIND->nRows();
-		rc_params.WIND = params.WIND->getdata();
-		rc_params.nXYc = params.XYc->nRows();
-		rc_params.XYc = params.XYc->getdata();
+		size_t nPart; //number of particles to find
+		RadialcenterParameters rc_params = radialcenter_parameters(params, nPart);
 
 		//Setup Output variables
 		//----------------------------
 		vector<OutContainerClass> out;
-		out.resize(4);
+		out.resize(5);
 
 		auto& x = out[0];
 		auto& y = out[1];
 		auto& varXY = out[2];
 		auto& RWR_N = out[3];
+		auto& Status = out[4];
 
-		// Resize output vars
+		// Resize output vars (outputs that are not requested are left empty)
 		x.resize(nPart, 1);
 		y.resize(nPart, 1);
 
-		varXY.resize(nPart, 2);
-		RWR_N.resize(nPart, 1);
+		double* pVarXY = nullptr;
+		double* pRWR_N = nullptr;
+		double* pStatus = nullptr;
+		if (rc_params.OutputMask & rcdefs::OUTPUT_VARXY) {
+			varXY.resize(nPart, 2);
+			pVarXY = varXY.getdata();
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+			RWR_N.resize(nPart, 1);
+			pRWR_N = RWR_N.getdata();
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_STATUS) {
+			Status.resize(nPart, 1);
+			pStatus = Status.getdata();
+		}
 
 		//Call radialcenter
 		//---------------------
+		RadialcenterWorkspace<ComputeT> local_workspace;
+		if (workspace == nullptr) {
+			workspace = &local_workspace;
+		}
+
+		size_t nRows, nCols; //size of the image
+		radialcenter_image_size(I, params.ImageLayout, nRows, nCols);
+
 		switch (I.getValueType()) {
 		case vt_double:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<double>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<double>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_float:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<float>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<float>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_int8:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<int8_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<int8_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_uint8:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<uint8_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<uint8_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_int16:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<int16_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<int16_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_uint16:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<uint16_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<uint16_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_int32:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<int32_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<int32_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_uint32:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<uint32_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<uint32_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_int64:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<int64_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<int64_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		case vt_uint64:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				I.typed_data<uint64_t>(), I.nRows(), I.nCols(),
-				rc_params);
+			radialcenter(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				I.typed_data<uint64_t>(), nRows, nCols,
+				rc_params, *workspace, pStatus);
 			break;
 		default:
 			throw("radialcenter(): Image type not supported.");
@@ -239,4 +317,75 @@ namespace extras{namespace ParticleTracking{
 		// Return output
 		return out;
 	}
+
+	///Radial Center Detection for an image stack
+	///Description:
+	/// Same as radialcenter(), but processes every frame of an nRows x nCols x nFrames stack
+	/// using the same windows. Frames are processed in parallel using params.nThreads threads.
+	///
+	/// Output argument order is:
+	///	X - [nPart x nFrames] x locations of the particle centers
+	///	Y - [nPart x nFrames] y locations of the particle centers
+	///	varXY - [nPart x 2 x nFrames] localization confidence level for X and Y
+	///	RWR/N - [nPart x nFrames] weighted-average distance between the estimated center and the gradient vectors
+	///	Status - [nPart x nFrames] rcdefs::WINDOW_STATUS of each window
+	///
+	/// workspaces (optional) holds one workspace per thread, reuse it between calls to avoid allocations.
+	template<class OutContainerClass=extras::Array<double>,typename ImageType=double,typename ComputeT=double> //OutContainerClass should be class derived from extras::ArrayBase
+	std::vector<OutContainerClass> radialcenter_stack(const extras::ArrayBase<ImageType>& I, //input image stack
+												const RadialcenterParameters_Shared& params = RadialcenterParameters_Shared(),//parameters
+												std::vector<RadialcenterWorkspace<ComputeT>>* workspaces = nullptr) //working memory
+	{
+		using namespace std;
+
+		size_t nPart;
+		RadialcenterParameters rc_params = radialcenter_parameters(params, nPart);
+
+		// frames (nCols() includes the trailing dimensions, so use dims())
+		vector<size_t> dims = I.dims();
+		size_t nRows = dims.size() > 0 ? dims[0] : 0;
+		size_t nCols = dims.size() > 1 ? dims[1] : 1;
+		size_t nFrames = (nRows*nCols == 0) ? 0 : I.numel() / (nRows*nCols);
+
+		vector<const ImageType*> frames(nFrames);
+		for (size_t f = 0; f < nFrames; ++f) {
+			frames[f] = I.getdata() + f*nRows*nCols;
+		}
+		if (params.ImageLayout == rcdefs::ROW_MAJOR_LAYOUT) { //each frame is the transpose of the array's page
+			swap(nRows, nCols);
+		}
+
+		//Setup Output variables
+		//----------------------------
+		vector<OutContainerClass> out;
+		out.resize(5);
+
+		out[0].resize(nPart, nFrames);
+		out[1].resize(nPart, nFrames);
+		if (rc_params.OutputMask & rcdefs::OUTPUT_VARXY) {
+			out[2].resize({ nPart, 2, nFrames });
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+			out[3].resize(nPart, nFrames);
+		}
+		if (rc_params.OutputMask & rcdefs::OUTPUT_STATUS) {
+			out[4].resize(nPart, nFrames);
+		}
+
+		//Call radialcenter
+		//---------------------
+		vector<RadialcenterWorkspace<ComputeT>> local_workspaces;
+		if (workspaces == nullptr) {
+			workspaces = &local_workspaces;
+		}
+
+		radialcenter_stack(out[0].getdata(), out[1].getdata(),
+			(rc_params.OutputMask & rcdefs::OUTPUT_VARXY) ? out[2].getdata() : nullptr,
+			(rc_params.OutputMask & rcdefs::OUTPUT_RWR_N) ? out[3].getdata() : nullptr,
+			frames.data(), nFrames, nRows, nCols,
+			rc_params, *workspaces,
+			(rc_params.OutputMask & rcdefs::OUTPUT_STATUS) ? out[4].getdata() : nullptr);
+
+		return out;
+	}
 }}
@@ -0,0 +1,65 @@
+/*//////////////////////////////
+/// Wrapper for radialcenter3D, accepting the standard arguments for a mexFunction
+% [x,y,z,varXYZ,d2,status] = radialcenter3D(V,WIND)
+%                = radialcenter3D(__,name,value);
+%
+% Estimate the center of radial symmetry of particles in a volume (e.g. a z-stack)
+% The 3D smoothed gradient of each box defines a line through every voxel;
+% the center is the weighted least-squares intersection of those lines.
+%
+% Input:
+%   V: the volume to process, [nRows x nCols x nSlices] array
+%   WIND: [N x 6] specifying boxes [x,y,z,w,h,d], default is entire volume
+%       x,y,z is the first voxel (column, row, slice) and w,h,d the size of the box
+%       boxes must span at least 2 voxels in each direction
+%
+% Output:
+%   x,y,z: center positions (column, row, slice)
+%
+%   varXYZ: variance estimate of the fit
+%       varXYZ = [Vx,Vy,Vz]
+%
+%   d2: the square of the weighted residual, normalized by the effective number of voxels
+%       d2>>1 indicates poor localization. This roughly characterizes the
+%       distance between each gradient line and the determined center location.
+%
+%   status: reason code for each box (same size as x)
+%       0: box was fit
+%       3: fit failed, the center is not finite (e.g. the box has no gradient or is too small)
+%
+%   Only the requested outputs are computed: e.g. [x,y,z] = radialcenter3D(...) skips the
+%   accumulation of the weighted residual that is needed for varXYZ and d2
+%
+%
+% Name,Value Parameters:
+% -------------------------
+%   'RadiusCutoff',val or [v1,v2,...vN]: radius of the sphere around the center guess used for the fit
+%	'CutoffFactor',val or [v1,v2,...vN]: size cutoff is applied by weighting using a logistic function :1/(1 + exp(CutoffFactor*(r_guess - RadiusCutoff)));
+%		default = INFINITY (i.e. top-hat function)
+%   'XYZc',[X,Y,Z] : particle center estimates
+%       if WIND is not specified the boxes extend RadiusCutoff around XYZc
+%   'COMmethod',method: center guess used for the distance dependent weights
+%       method='meanABS' : use COM on |V-mean(V)|
+%       method='normal': use COM on unmodified V
+%       method='gradmag': use magnitude of the volume gradient (default)
+%   'DistanceExponent',value or [v1,v2,...,vN]: distance scaling from center guess Wii *= 1/r_guess^(DistanceExponent)
+%	'GradientExponent',value or [v1,v2,...,vN]: gradient scaling Wii *= |GradV_i|^(GradientExponent)
+%   'nThreads',n: number of threads used to process the boxes (default=1)
+%       n=0 uses all available processor threads
+%   'Precision','double' or 'single': floating point type used for the per-voxel calculations
+%       'double' (default)
+%       'single': gradient and weights are computed in single precision
+%           sums are still accumulated in double and outputs are always double
+*/
+
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+
+
+#include "radialcenter3D_mex.hpp"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+    extras::ParticleTracking::radialcenter3D_mex(nlhs,plhs,nrhs,prhs);
+}
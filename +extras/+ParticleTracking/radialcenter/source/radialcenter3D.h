@@ -0,0 +1,699 @@
+#pragma once
+
+/*
+Radial symmetry center of a volume (3D extension of radialcenter.h)
+
+Each voxel of the smoothed volume gradient defines a line through the voxel, pointing along the gradient.
+The center is the point minimizing the weighted sum of the squared distances to those lines:
+	d_k^2 = |q_k|^2 - (n_k.q_k)^2,   q_k = c - p_k,  n_k = g_k/|g_k|
+which gives the 3x3 normal equations
+	[sum w_k (I - n_k n_k')] c = sum w_k (I - n_k n_k') p_k
+The weights are the same as for the 2D radialcenter: w = |g|^GradientExponent / r^DistanceExponent,
+multiplied by the radius cutoff (top-hat or logistic) around the center guess.
+As for the 2D fit, the sums are taken relative to a reference point (the center guess) and the
+residual is accumulated in the same pass, so no per-voxel values are stored.
+For single precision the gradient magnitude is divided by its maximum around the center guess before
+it is raised to GradientExponent (see gradient_weight_scale3D()), as for the 2D fit.
+
+The volume is column-major (MATLAB order): V(y,x,z) = V[y + nRows*x + nRows*nCols*z]
+Coordinates are x=column, y=row, z=slice
+*/
+
+#include "radialcenter.h"
+
+namespace rcdefs {
+
+	//! 3-point average of a Ny x Nx x Nz volume (contiguous, column-major) along one axis
+	//! axis: 0=y (rows), 1=x (columns), 2=z (slices)
+	//! Edges are corrected so they are 2-point averages; out must not overlap in
+	template<typename T>
+	void mean3_axis(const T* in, T* out, size_t Ny, size_t Nx, size_t Nz, int axis) {
+		const size_t step = (axis == 0) ? 1 : ((axis == 1) ? Ny : Ny*Nx);
+		const size_t len = (axis == 0) ? Ny : ((axis == 1) ? Nx : Nz);
+		if (len < 2) {
+			std::memcpy(out, in, Ny*Nx*Nz * sizeof(T));
+			return;
+		}
+		for (size_t z = 0; z < Nz; ++z) {
+			for (size_t x = 0; x < Nx; ++x) {
+				const size_t k0 = Ny*(x + Nx*z);
+				for (size_t y = 0; y < Ny; ++y) {
+					const size_t k = k0 + y;
+					const size_t i = (axis == 0) ? y : ((axis == 1) ? x : z); //position along the axis
+					if (i == 0) {
+						out[k] = (in[k] + in[k + step]) / T(2.0);
+					}
+					else if (i == len - 1) {
+						out[k] = (in[k - step] + in[k]) / T(2.0);
+					}
+					else {
+						out[k] = (in[k - step] + in[k] + in[k + step]) / T(3.0);
+					}
+				}
+			}
+		}
+	}
+
+	//! Calculate the 3x3x3-smoothed gradient of a volume
+	//! V is column-major data pointing to voxel (y1,x1,z1): V(y,x,z) = V[y + x*strideX + z*strideZ]
+	//! The window is (dNy+1) x (dNx+1) x (dNz+1) voxels, the gradient is found at the centers of the
+	//! dNy x dNx x dNz cubes between them (i.e. at (yi+0.5,xi+0.5,zi+0.5)) from the average of the
+	//! 4 finite differences along each axis, and is then smoothed using a 3x3x3 average.
+	//! gx, gy, gz: pre-allocated outputs (dNy x dNx x dNz, contiguous)
+	//! work: pre-allocated buffer with space for 2*dNy*dNx*dNz elements
+	template<typename M, typename T = double>
+	void smoothgrad3D(const M* V, size_t strideX, size_t strideZ, T* gx, T* gy, T* gz, size_t dNy, size_t dNx, size_t dNz, T* work) {
+
+		// finite differences over each cube
+		for (size_t z = 0; z < dNz; ++z) {
+			for (size_t x = 0; x < dNx; ++x) {
+				const M* c000 = V + x*strideX + z*strideZ;
+				const M* c010 = c000 + strideX; //x+1
+				const M* c001 = c000 + strideZ; //z+1
+				const M* c011 = c010 + strideZ; //x+1,z+1
+				const size_t k0 = dNy*(x + dNx*z);
+				for (size_t y = 0; y < dNy; ++y) {
+					const T v000 = (T)c000[y], v100 = (T)c000[y + 1];
+					const T v010 = (T)c010[y], v110 = (T)c010[y + 1];
+					const T v001 = (T)c001[y], v101 = (T)c001[y + 1];
+					const T v011 = (T)c011[y], v111 = (T)c011[y + 1];
+
+					gy[k0 + y] = T(0.25)*((v100 - v000) + (v110 - v010) + (v101 - v001) + (v111 - v011));
+					gx[k0 + y] = T(0.25)*((v010 - v000) + (v110 - v100) + (v011 - v001) + (v111 - v101));
+					gz[k0 + y] = T(0.25)*((v001 - v000) + (v101 - v100) + (v011 - v010) + (v111 - v110));
+				}
+			}
+		}
+
+		// apply 3x3x3 smoothing (separable)
+		T* w1 = work;
+		T* w2 = work + dNy*dNx*dNz;
+		for (T* g : { gx, gy, gz }) {
+			mean3_axis(g, w1, dNy, dNx, dNz, 0);
+			mean3_axis(w1, w2, dNy, dNx, dNz, 1);
+			mean3_axis(w2, g, dNy, dNx, dNz, 2);
+		}
+	}
+
+	//! Scale of the gradient magnitude in the weights of a box (3D version of gradient_weight_scale())
+	//! float: 1/max|g| over the voxels within RadExtents (+2 voxels) of the reference point, so the gradient
+	//! weights are <=1 and |g|^GradientExponent (and its square) stay within the range of float
+	//! double, or weights that do not depend on the gradient: 1
+	template<typename T>
+	T gradient_weight_scale3D(const T* GradMag, size_t dNx, size_t dNy, size_t dNz, double GradientExponent,
+		double RadExtents, double Xref, double Yref, double Zref)
+	{
+		using namespace std;
+		if (GradientExponent == 0) {
+			return 1;
+		}
+
+		// bounding box of the voxels that are summed
+		size_t x0 = 0, x1 = dNx;
+		size_t y0 = 0, y1 = dNy;
+		size_t z0 = 0, z1 = dNz;
+		const double RE = RadExtents + 2;
+		if (isfinite(RE)) {
+			x0 = (size_t)max(0.0, Xref - RE);
+			x1 = (size_t)max(0.0, min((double)dNx, Xref + RE));
+			y0 = (size_t)max(0.0, Yref - RE);
+			y1 = (size_t)max(0.0, min((double)dNy, Yref + RE));
+			z0 = (size_t)max(0.0, Zref - RE);
+			z1 = (size_t)max(0.0, min((double)dNz, Zref + RE));
+		}
+
+		T m = 0; //max |g|
+		for (size_t zi = z0; zi < z1; ++zi) {
+			for (size_t xi = x0; xi < x1; ++xi) {
+				const T* G = GradMag + dNy*(xi + dNx*zi);
+				for (size_t yi = y0; yi < y1; ++yi) {
+					m = max(m, G[yi]);
+				}
+			}
+		}
+		return (m > 0 && isfinite(m)) ? T(1) / m : T(1);
+	}
+	inline double gradient_weight_scale3D(const double*, size_t, size_t, size_t, double, double, double, double, double) {
+		return 1;
+	}
+
+	//! Scratch buffers used while processing a single box of radialcenter3D()
+	//! Each worker thread owns one of these; buffers only grow
+	template<typename T = double>
+	struct Radialcenter3DScratch {
+		T * gx = nullptr;
+		T * gy = nullptr;
+		T * gz = nullptr;
+		T * GradMag = nullptr;
+		T * work = nullptr; //smoothing buffer used by smoothgrad3D()
+
+		size_t GradCap = 0; //number of elements allocated for gx,gy,gz,GradMag (work has 2x)
+		size_t nAllocations = 0; //number of times a buffer has been allocated
+
+		Radialcenter3DScratch() = default;
+		Radialcenter3DScratch(const Radialcenter3DScratch&) = delete;
+		Radialcenter3DScratch& operator=(const Radialcenter3DScratch&) = delete;
+
+		~Radialcenter3DScratch() {
+			std::free(gx);
+			std::free(gy);
+			std::free(gz);
+			std::free(GradMag);
+			std::free(work);
+		}
+
+		//! make sure the gradient buffers can hold n elements
+		void reserve_gradient(size_t n) {
+			if (n > GradCap) {
+				grow(gx, n);
+				grow(gy, n);
+				grow(gz, n);
+				grow(GradMag, n);
+				grow(work, 2 * n);
+				GradCap = n;
+			}
+		}
+
+	private:
+		//! replace p with a new (uninitialized) buffer of n elements
+		//! throws bad_alloc if allocation fails
+		void grow(T*& p, size_t n) {
+			std::free(p);
+			p = (T*)std::malloc(n * sizeof(T));
+			if (p == nullptr) {
+				throw std::bad_alloc();
+			}
+			++nAllocations;
+		}
+	};
+}
+
+namespace extras{ namespace ParticleTracking{
+
+    //! Parameters of radialcenter3D()
+    //! Per-box parameters (RadiusCutoff, CutoffFactor, DistanceExponent, GradientExponent) are either
+    //! scalars or arrays with one element for each box, as for radialcenter()
+    struct Radialcenter3DParameters{
+        double default_RadiusCutoff = INFINITY;
+        double default_CutoffFactor = INFINITY;
+        double default_DistanceExponent = 1;
+        double default_GradientExponent = 5;
+
+        double* WIND = nullptr; //[nWIND x 6] boxes [x,y,z,w,h,d] (column-major, 0-indexed)
+        size_t nWIND = 0;
+        double* XYZc = nullptr; //[nXYZc x 3] center estimates [x,y,z] (column-major, 0-indexed)
+        size_t nXYZc = 0;
+        double* RadiusCutoff = &default_RadiusCutoff;
+        size_t nRadiusCutoff = 1;
+        double* CutoffFactor = &default_CutoffFactor;
+        size_t nCutoffFactor = 1;
+        rcdefs::COM_METHOD COMmethod = rcdefs::GRAD_MAG;
+        double* DistanceExponent = &default_DistanceExponent;
+        size_t nDistanceExponent = 1;
+        double* GradientExponent = &default_GradientExponent;
+        size_t nGradientExponent = 1;
+        size_t nThreads = 1; //number of worker threads used to process boxes (0 = use all hardware threads)
+        unsigned OutputMask = rcdefs::OUTPUT_ALL; //outputs that are computed (OUTPUT_VARXY selects varXYZ)
+    };
+
+    //! Reusable working memory for radialcenter3D()
+    //! Holds one set of scratch buffers for each worker thread; buffers only grow, so repeated calls
+    //! with boxes of the same size do not allocate any memory. The worker threads are kept as well (see rcdefs::ThreadPool).
+    //! T is the compute type (double or float) and must match the type used by radialcenter3D<T>()
+    template<typename T = double>
+    class Radialcenter3DWorkspace {
+    protected:
+        std::vector<std::unique_ptr<rcdefs::Radialcenter3DScratch<T>>> _scratch;
+        std::unique_ptr<rcdefs::ThreadPool> _pool; //worker threads
+    public:
+        Radialcenter3DWorkspace() = default;
+        Radialcenter3DWorkspace(const Radialcenter3DWorkspace&) = delete;
+        Radialcenter3DWorkspace& operator=(const Radialcenter3DWorkspace&) = delete;
+        Radialcenter3DWorkspace(Radialcenter3DWorkspace&&) = default;
+        Radialcenter3DWorkspace& operator=(Radialcenter3DWorkspace&&) = default;
+
+        //! Prepare the workspace for a call using nWorkers threads
+        void prepare(size_t nWorkers) {
+            while (_scratch.size() < nWorkers) {
+                _scratch.emplace_back(new rcdefs::Radialcenter3DScratch<T>());
+            }
+        }
+
+        //! scratch buffers used by worker thread_id
+        rcdefs::Radialcenter3DScratch<T>& scratch(size_t thread_id) {
+            return *_scratch[thread_id];
+        }
+
+        //! worker threads used by radialcenter3D()
+        rcdefs::ThreadPool& pool() {
+            if (!_pool) {
+                _pool.reset(new rcdefs::ThreadPool());
+            }
+            return *_pool;
+        }
+
+        //! total number of buffer allocations made by the workspace
+        size_t nAllocations() const {
+            size_t n = 0;
+            for (const auto& s : _scratch) {
+                n += s->nAllocations;
+            }
+            if (_pool) {
+                n += _pool->nAllocations;
+            }
+            return n;
+        }
+
+        //! release all memory held by the workspace
+        void clear() {
+            _scratch.clear();
+            _pool.reset();
+        }
+    };
+
+    //! Parameters and volume extent of a single box
+    struct Radialcenter3DWindowSpec {
+        double RadiusCutoff;
+        double CutoffFactor;
+        double DistanceExponent;
+        double GradientExponent;
+        double RadExtents; //radius around the center needed by the radius cutoff
+        size_t Ix1, Ix2; //first and last x-coord of the box
+        size_t Iy1, Iy2; //first and last y-coord of the box
+        size_t Iz1, Iz2; //first and last z-coord of the box
+    };
+
+    //! Determine the parameters and the volume extent used by box n
+    inline Radialcenter3DWindowSpec radialcenter3D_window_spec(size_t n, size_t nRows, size_t nCols, size_t nSlices, const Radialcenter3DParameters& params) {
+        using namespace std;
+
+        // per-box value of a parameter
+        auto param = [n](const double* p, size_t np, double def) {
+            if (np == 0) {
+                return def;
+            }
+            return (np == 1) ? p[0] : p[n];
+        };
+
+        Radialcenter3DWindowSpec spec;
+        spec.RadiusCutoff = param(params.RadiusCutoff, params.nRadiusCutoff, params.default_RadiusCutoff);
+        assert_condition(spec.RadiusCutoff >= 0, "RadiusCutoff must be >=0");
+        spec.CutoffFactor = param(params.CutoffFactor, params.nCutoffFactor, params.default_CutoffFactor);
+        assert_condition(spec.CutoffFactor >= 0, "CutoffFactor must be >=0");
+        if (spec.CutoffFactor == 0) {
+            spec.RadiusCutoff = INFINITY;
+        }
+        spec.DistanceExponent = param(params.DistanceExponent, params.nDistanceExponent, params.default_DistanceExponent);
+        spec.GradientExponent = param(params.GradientExponent, params.nGradientExponent, params.default_GradientExponent);
+
+        //determine extent of volume needed (same as radialcenter_window_spec())
+        spec.RadExtents = spec.RadiusCutoff;
+        if (isfinite(spec.CutoffFactor)) { //non-inf Logistic Factor
+            double eLRF = exp(spec.CutoffFactor*spec.RadiusCutoff);
+            double eLRFpow = pow(eLRF + 1, 0.99);
+            spec.RadExtents = -(log(1 + eLRF - eLRFpow) - log(eLRF*eLRFpow)) / spec.CutoffFactor;
+        }
+
+        // clamp the range [a,b] to [0,N-1]
+        auto clamp_range = [](double a, double b, size_t N, size_t& i1, size_t& i2) {
+            i1 = (size_t)fmax(0, fmin(N - 1, floor(a)));
+            i2 = (size_t)fmax(0, fmin(N - 1, ceil(b)));
+        };
+
+        if (params.nWIND != 0) { //WIND=[x0,y0,z0,w,h,d]
+            const double* W = params.WIND;
+            const size_t nW = params.nWIND;
+            clamp_range(W[n + 0 * nW], W[n + 0 * nW] + W[n + 3 * nW] - 1, nCols, spec.Ix1, spec.Ix2);
+            clamp_range(W[n + 1 * nW], W[n + 1 * nW] + W[n + 4 * nW] - 1, nRows, spec.Iy1, spec.Iy2);
+            clamp_range(W[n + 2 * nW], W[n + 2 * nW] + W[n + 5 * nW] - 1, nSlices, spec.Iz1, spec.Iz2);
+        }
+        else if (params.nXYZc != 0 && isfinite(spec.RadiusCutoff) && spec.RadiusCutoff != 0) { //region around the center estimate
+            const double* C = params.XYZc;
+            const size_t nC = params.nXYZc;
+            clamp_range(C[n + 0 * nC] - spec.RadExtents, C[n + 0 * nC] + spec.RadExtents, nCols, spec.Ix1, spec.Ix2);
+            clamp_range(C[n + 1 * nC] - spec.RadExtents, C[n + 1 * nC] + spec.RadExtents, nRows, spec.Iy1, spec.Iy2);
+            clamp_range(C[n + 2 * nC] - spec.RadExtents, C[n + 2 * nC] + spec.RadExtents, nSlices, spec.Iz1, spec.Iz2);
+        }
+        else { //need full volume
+            spec.Ix1 = 0;
+            spec.Iy1 = 0;
+            spec.Iz1 = 0;
+            spec.Ix2 = nCols - 1;
+            spec.Iy2 = nRows - 1;
+            spec.Iz2 = nSlices - 1;
+        }
+
+        return spec;
+    }
+
+    //! Radial symmetry least-squares fit of a box
+    //! gx,gy,gz: gradient of the box (dNy x dNx x dNz, contiguous), located at (yi+0.5,xi+0.5,zi+0.5)
+    //! GradMag: magnitude of the gradient
+    //! Xcom,Ycom,Zcom: center guess relative to the box (NaN if the weights do not depend on distance)
+    //! If residual==false the residual is not accumulated and var and RWR_N are NaN
+    //! The center (x,y,z) is returned relative to the box
+    template <typename T>
+    void radialcenter3D_fit(const Radialcenter3DWindowSpec& spec, double Xcom, double Ycom, double Zcom,
+        const T* gx, const T* gy, const T* gz, const T* GradMag, size_t dNx, size_t dNy, size_t dNz,
+        bool residual, double& x, double& y, double& z, double* var, double& RWR_N)
+    {
+        using namespace std;
+        using namespace rcdefs;
+
+        RADIUS_CUTOFF cutoff = NO_CUTOFF;
+        if (isfinite(spec.RadiusCutoff)) { //using radius cutoff, only sum over sphere
+            cutoff = isfinite(spec.CutoffFactor) ? LOGISTIC_CUTOFF : TOPHAT_CUTOFF;
+        }
+        const bool use_distance = spec.DistanceExponent != 0 || cutoff != NO_CUTOFF;
+
+        // sums are taken about the center guess (or the middle of the box)
+        const double Xref = isfinite(Xcom) ? Xcom : 0.5*dNx;
+        const double Yref = isfinite(Ycom) ? Ycom : 0.5*dNy;
+        const double Zref = isfinite(Zcom) ? Zcom : 0.5*dNz;
+        const T tXref = (T)Xref;
+        const T tYref = (T)Yref;
+        const T tZref = (T)Zref;
+        const T tRadiusCutoff = (T)spec.RadiusCutoff;
+        const T tCutoffFactor = (T)spec.CutoffFactor;
+        const T tDistanceExponent = (T)spec.DistanceExponent;
+        const T tGradientExponent = (T)spec.GradientExponent;
+        const T RE2 = (T)(spec.RadExtents*spec.RadExtents);
+        const T GradScale = gradient_weight_scale3D(GradMag, dNx, dNy, dNz, spec.GradientExponent,
+            (cutoff == NO_CUTOFF) ? INFINITY : spec.RadExtents, Xref, Yref, Zref);
+
+        // sums are accumulated in double
+        double sw = 0;
+        double sw2 = 0;
+        double Mxx = 0, Mxy = 0, Mxz = 0, Myy = 0, Myz = 0, Mzz = 0; //sum w*(I - n*n')
+        double bx = 0, by = 0, bz = 0; //sum w*(I - n*n')*(p - ref)
+        double Syy = 0; //sum w*d^2 at the reference point
+
+        for (size_t zi = 0; zi < dNz; ++zi) {
+            const T zk = zi + T(0.5) - tZref;
+            for (size_t xi = 0; xi < dNx; ++xi) {
+                const T xk = xi + T(0.5) - tXref;
+                const T dxz2 = xk*xk + zk*zk;
+
+                size_t yStart = 0;
+                size_t yEnd = dNy;
+                if (cutoff != NO_CUTOFF) { //only sum over sphere
+                    if (dxz2 > RE2) { //column does not intersect the sphere
+                        continue;
+                    }
+                    T yr = sqrt(RE2 - dxz2); //y-component of the radius
+                    yStart = (size_t)min((T)dNy, max(T(0), ceil(tYref - yr - T(0.5))));
+                    yEnd = (size_t)min((T)dNy, max(T(0), floor(tYref + yr - T(0.5)) + 1));
+                }
+
+                const size_t k0 = dNy*(xi + dNx*zi);
+                for (size_t yi = yStart; yi < yEnd; ++yi) {
+                    const size_t k = k0 + yi;
+                    const T yk = yi + T(0.5) - tYref;
+
+                    const T mag = GradMag[k];
+                    if (mag == 0) { //no gradient direction
+                        continue;
+                    }
+
+                    T w = (tGradientExponent == 0) ? T(1) : pow(mag*GradScale, tGradientExponent);
+                    if (use_distance) {
+                        const T r = sqrt(dxz2 + yk*yk);
+                        if (tDistanceExponent != 0) {
+                            w /= pow(r, tDistanceExponent);
+                        }
+                        if (cutoff == LOGISTIC_CUTOFF) {
+                            w *= T(1.0) / (T(1.0) + exp(tCutoffFactor*(r - tRadiusCutoff)));
+                        }
+                        else if (cutoff == TOPHAT_CUTOFF && r > tRadiusCutoff) {
+                            continue;
+                        }
+                    }
+                    if (!(w > 0) || !isfinite(w)) { //excluded (or voxel at the center guess with DistanceExponent>0)
+                        continue;
+                    }
+
+                    // unit gradient direction
+                    const T nx = gx[k] / mag;
+                    const T ny = gy[k] / mag;
+                    const T nz = gz[k] / mag;
+                    const T nq = nx*xk + ny*yk + nz*zk; //projection of (p-ref) onto the gradient
+
+                    const double dw = w;
+                    sw += dw;
+                    sw2 += dw*dw;
+
+                    Mxx += dw*(1 - (double)nx*nx);
+                    Myy += dw*(1 - (double)ny*ny);
+                    Mzz += dw*(1 - (double)nz*nz);
+                    Mxy -= dw*((double)nx*ny);
+                    Mxz -= dw*((double)nx*nz);
+                    Myz -= dw*((double)ny*nz);
+
+                    bx += dw*((double)xk - (double)nx*nq);
+                    by += dw*((double)yk - (double)ny*nq);
+                    bz += dw*((double)zk - (double)nz*nq);
+
+                    if (residual) {
+                        Syy += dw*((double)xk*xk + (double)yk*yk + (double)zk*zk - (double)nq*nq);
+                    }
+                }
+            }
+        }
+
+        // inverse of the (symmetric) 3x3 system using the adjugate
+        const double Cxx = Myy*Mzz - Myz*Myz;
+        const double Cxy = Mxz*Myz - Mxy*Mzz;
+        const double Cxz = Mxy*Myz - Mxz*Myy;
+        const double Cyy = Mxx*Mzz - Mxz*Mxz;
+        const double Cyz = Mxy*Mxz - Mxx*Myz;
+        const double Czz = Mxx*Myy - Mxy*Mxy;
+        const double det = Mxx*Cxx + Mxy*Cxy + Mxz*Cxz;
+
+        // offset of the solution from the reference point
+        const double dx = (Cxx*bx + Cxy*by + Cxz*bz) / det;
+        const double dy = (Cxy*bx + Cyy*by + Cyz*bz) / det;
+        const double dz = (Cxz*bx + Cyz*by + Czz*bz) / det;
+        x = Xref + dx;
+        y = Yref + dy;
+        z = Zref + dz;
+
+        if (!residual) {
+            var[0] = NAN;
+            var[1] = NAN;
+            var[2] = NAN;
+            RWR_N = NAN;
+            return;
+        }
+
+        // residual at the solution: Syy - 2*d'b + d'Md = Syy - d'b (since Md=b)
+        double RWR = Syy - (dx*bx + dy*by + dz*bz);
+        RWR = RWR > 0 ? RWR : 0; //rounding can make a perfect fit slightly negative
+
+        //calc variance
+        double denom = sw*sw / sw2;
+        if (denom > 3) {
+            denom -= 3;
+        }
+
+        RWR_N = RWR / (sw - 3 * sw2 / sw);
+
+        RWR /= denom;
+
+        var[0] = Cxx / det*RWR;
+        var[1] = Cyy / det*RWR;
+        var[2] = Czz / det*RWR;
+    }
+
+    //! Process a single box (particle n) for radialcenter3D()
+    //! Results are written to x[n], y[n], z[n], varXYZ[n+nPart*{0,1,2}], RWR_N[n] and Status[n]
+    //! Outputs not included in params.OutputMask are not written (and may be nullptr).
+    //! scratch holds the working buffers used by the box; it must not be shared between threads.
+    template <typename M, typename T>
+    void radialcenter3D_window(size_t n, size_t nPart,
+        double* x, double* y, double* z, double* varXYZ, double* RWR_N, double* Status,
+        const M* V, size_t nRows, size_t nCols, size_t nSlices,
+        const Radialcenter3DParameters& params, rcdefs::Radialcenter3DScratch<T>& scratch)
+    {
+        using namespace std;
+        using namespace rcdefs;
+
+        const bool out_var = (params.OutputMask & OUTPUT_VARXY) != 0;
+        const bool out_RWR_N = (params.OutputMask & OUTPUT_RWR_N) != 0;
+        const bool out_Status = (params.OutputMask & OUTPUT_STATUS) != 0 && Status != nullptr;
+
+        const Radialcenter3DWindowSpec spec = radialcenter3D_window_spec(n, nRows, nCols, nSlices, params);
+        const size_t Ix1 = spec.Ix1;
+        const size_t Iy1 = spec.Iy1;
+        const size_t Iz1 = spec.Iz1;
+        const size_t dNx = spec.Ix2 - spec.Ix1;
+        const size_t dNy = spec.Iy2 - spec.Iy1;
+        const size_t dNz = spec.Iz2 - spec.Iz1;
+
+        double xw = NAN, yw = NAN, zw = NAN; //result relative to the box
+        double var[3] = { NAN, NAN, NAN };
+        double this_RWR_N = NAN;
+
+        if (dNx > 0 && dNy > 0 && dNz > 0) { //box must be at least 2x2x2 voxels
+            const size_t nG = dNy*dNx*dNz;
+            scratch.reserve_gradient(nG);
+            T* gx = scratch.gx;
+            T* gy = scratch.gy;
+            T* gz = scratch.gz;
+            T* GradMag = scratch.GradMag;
+
+            const size_t strideZ = nRows*nCols;
+            smoothgrad3D(V + Iy1 + Ix1*nRows + Iz1*strideZ, nRows, strideZ, gx, gy, gz, dNy, dNx, dNz, scratch.work);
+            for (size_t k = 0; k < nG; ++k) {
+                GradMag[k] = sqrt(sqr(gx[k]) + sqr(gy[k]) + sqr(gz[k]));
+            }
+
+            // center guess
+            double Xcom = NAN, Ycom = NAN, Zcom = NAN; //relative to the box
+            if (spec.DistanceExponent == 0 && ((spec.RadiusCutoff == 0 || !isfinite(spec.RadiusCutoff)) || spec.CutoffFactor == 0)) {
+                //dont need COM because we aren't using distance dependence
+            }
+            else if (params.nXYZc != 0 && isfinite(params.XYZc[n]) && isfinite(params.XYZc[n + params.nXYZc]) && isfinite(params.XYZc[n + 2 * params.nXYZc])) {
+                Xcom = params.XYZc[n + 0 * params.nXYZc] - Ix1;
+                Ycom = params.XYZc[n + 1 * params.nXYZc] - Iy1;
+                Zcom = params.XYZc[n + 2 * params.nXYZc] - Iz1;
+            }
+            else if (params.COMmethod == GRAD_MAG) { //COM from magnitude of gradient
+                double acc = 0, cx = 0, cy = 0, cz = 0;
+                for (size_t zi = 0; zi < dNz; ++zi) {
+                    for (size_t xi = 0; xi < dNx; ++xi) {
+                        const T* G = GradMag + dNy*(xi + dNx*zi);
+                        double col = 0, colY = 0;
+                        for (size_t yi = 0; yi < dNy; ++yi) {
+                            col += G[yi];
+                            colY += (yi + 0.5)*G[yi];
+                        }
+                        acc += col;
+                        cx += (xi + 0.5)*col;
+                        cz += (zi + 0.5)*col;
+                        cy += colY;
+                    }
+                }
+                Xcom = cx / acc;
+                Ycom = cy / acc;
+                Zcom = cz / acc;
+            }
+            else { //COM of the voxels (NORMAL) or of |V-mean(V)| (MEAN_ABS)
+                auto voxel = [&](size_t yi, size_t xi, size_t zi) {
+                    return (double)V[(Iy1 + yi) + (Ix1 + xi)*nRows + (Iz1 + zi)*strideZ];
+                };
+                double V_mean = 0;
+                if (params.COMmethod == MEAN_ABS) {
+                    for (size_t zi = 0; zi <= dNz; ++zi) {
+                        for (size_t xi = 0; xi <= dNx; ++xi) {
+                            for (size_t yi = 0; yi <= dNy; ++yi) {
+                                V_mean += voxel(yi, xi, zi);
+                            }
+                        }
+                    }
+                    V_mean /= double(dNx + 1)*double(dNy + 1)*double(dNz + 1);
+                }
+                double acc = 0, cx = 0, cy = 0, cz = 0;
+                for (size_t zi = 0; zi <= dNz; ++zi) {
+                    for (size_t xi = 0; xi <= dNx; ++xi) {
+                        double col = 0, colY = 0;
+                        for (size_t yi = 0; yi <= dNy; ++yi) {
+                            double v = voxel(yi, xi, zi);
+                            if (params.COMmethod == MEAN_ABS) {
+                                v = fabs(v - V_mean);
+                            }
+                            col += v;
+                            colY += yi*v;
+                        }
+                        acc += col;
+                        cx += xi*col;
+                        cz += zi*col;
+                        cy += colY;
+                    }
+                }
+                Xcom = cx / acc;
+                Ycom = cy / acc;
+                Zcom = cz / acc;
+            }
+
+            radialcenter3D_fit(spec, Xcom, Ycom, Zcom, gx, gy, gz, GradMag, dNx, dNy, dNz,
+                out_var || out_RWR_N, xw, yw, zw, var, this_RWR_N);
+        }
+
+        x[n] = xw + Ix1;
+        y[n] = yw + Iy1;
+        z[n] = zw + Iz1;
+        if (out_var) {
+            varXYZ[n + nPart * 0] = var[0];
+            varXYZ[n + nPart * 1] = var[1];
+            varXYZ[n + nPart * 2] = var[2];
+        }
+        if (out_RWR_N) {
+            RWR_N[n] = this_RWR_N;
+        }
+        if (out_Status) {
+            Status[n] = (isfinite(x[n]) && isfinite(y[n]) && isfinite(z[n])) ? WINDOW_OK : WINDOW_FIT_FAILED;
+        }
+    }
+
+    //! Radial Center Detection in a volume
+    //! V is a column-major volume (nRows x nCols x nSlices), V(y,x,z) = V[y + nRows*x + nRows*nCols*z]
+    //! Each box of params.WIND (or the region around params.XYZc) is fit independently;
+    //! boxes are processed by params.nThreads worker threads and the results do not depend on the number of threads.
+    //! Outputs (nPart = number of boxes):
+    //!     x,y,z [nPart]: center of each box (0-indexed voxel coordinates)
+    //!     varXYZ [nPart x 3]: variance estimate of x, y and z
+    //!     RWR_N [nPart]: weighted residual normalized by the effective number of voxels
+    //!     Status [nPart]: rcdefs::WINDOW_STATUS of each box (WINDOW_FIT_FAILED for boxes smaller than 2x2x2)
+    //! Outputs not included in params.OutputMask are not written (and may be nullptr).
+    //! T is the compute type (double or float) used for the per-voxel calculations
+    template <typename T, typename M>
+    void radialcenter3D(double* x, double* y, double* z, double* varXYZ, double* RWR_N,
+        const M* V, size_t nRows, size_t nCols, size_t nSlices, //volume and size
+        const Radialcenter3DParameters& params, //parameters
+        Radialcenter3DWorkspace<T>& workspace, //working memory
+        double* Status = nullptr) //status code of each box (or nullptr)
+    {
+        using namespace std;
+
+        if (nRows == 0 || nCols == 0 || nSlices == 0) {
+            throw(std::runtime_error("radialcenter3D: volume cannot be empty"));
+        }
+
+        size_t nPart = max(size_t(1), params.nWIND); //number of boxes
+        if (params.nXYZc != 0) {
+            if (params.nWIND != 0) {
+                if (params.nXYZc != params.nWIND) {
+                    throw(std::runtime_error("radialcenter3D: nRows XYZc must match nRows WIND"));
+                }
+            }
+            else {
+                nPart = params.nXYZc;
+            }
+        }
+
+        // per-box parameters must be scalars or have one element per box
+        extras::assert_condition(params.nRadiusCutoff <= 1 || params.nRadiusCutoff == nPart, "RadiusCutoff has wrong number of elements");
+        extras::assert_condition(params.nCutoffFactor <= 1 || params.nCutoffFactor == nPart, "CutoffFactor has wrong number of elements");
+        extras::assert_condition(params.nDistanceExponent <= 1 || params.nDistanceExponent == nPart, "DistanceExponent has wrong number of elements");
+        extras::assert_condition(params.nGradientExponent <= 1 || params.nGradientExponent == nPart, "GradientExponent has wrong number of elements");
+
+        size_t nThreads = rcdefs::resolve_threads(params.nThreads, nPart);
+        workspace.prepare(nThreads);
+
+        rcdefs::parallel_for(workspace.pool(), nPart, nThreads, [&](size_t n, size_t thread_id) {
+            radialcenter3D_window(n, nPart, x, y, z, varXYZ, RWR_N, Status, V, nRows, nCols, nSlices, params, workspace.scratch(thread_id));
+        });
+    }
+
+    //! Radial Center Detection in a volume
+    //! Same as above, but uses a temporary workspace
+    template <typename T = double, typename M>
+    void radialcenter3D(double* x, double* y, double* z, double* varXYZ, double* RWR_N,
+        const M* V, size_t nRows, size_t nCols, size_t nSlices, //volume and size
+        const Radialcenter3DParameters& params = Radialcenter3DParameters(), //parameters
+        double* Status = nullptr) //status code of each box (or nullptr)
+    {
+        Radialcenter3DWorkspace<T> workspace;
+        radialcenter3D(x, y, z, varXYZ, RWR_N, V, nRows, nCols, nSlices, params, workspace, Status);
+    }
+}}
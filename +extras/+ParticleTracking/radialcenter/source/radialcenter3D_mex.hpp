@@ -0,0 +1,220 @@
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+#include <mex.h>
+#include <extras/string_extras.hpp>
+#include "radialcenter3D.h"
+
+#include <vector>
+#include <extras/cmex/NumericArray.hpp>
+#include <extras/cmex/mxparamparse.hpp>
+
+namespace extras{namespace ParticleTracking{
+
+    //! Run radialcenter3D() on the volume pV
+    //! out = {x, y, z, varXYZ, RWR_N, Status}; outputs not included in params.OutputMask are left empty
+    template<typename ComputeT = double>
+    std::vector<cmex::NumericArray<double>> radialcenter3D(const mxArray* pV, const Radialcenter3DParameters& params)
+    {
+        size_t nPart = std::max(std::max(size_t(1), params.nWIND), params.nXYZc);
+
+        std::vector<cmex::NumericArray<double>> out(6);
+        out[0].resize(nPart, 1);
+        out[1].resize(nPart, 1);
+        out[2].resize(nPart, 1);
+
+        double* pVarXYZ = nullptr;
+        double* pRWR_N = nullptr;
+        double* pStatus = nullptr;
+        if (params.OutputMask & rcdefs::OUTPUT_VARXY) {
+            out[3].resize(nPart, 3);
+            pVarXYZ = out[3].getdata();
+        }
+        if (params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+            out[4].resize(nPart, 1);
+            pRWR_N = out[4].getdata();
+        }
+        if (params.OutputMask & rcdefs::OUTPUT_STATUS) {
+            out[5].resize(nPart, 1);
+            pStatus = out[5].getdata();
+        }
+
+        // size of the volume
+        const mwSize nDims = mxGetNumberOfDimensions(pV);
+        const mwSize* dims = mxGetDimensions(pV);
+        if (nDims > 3) {
+            throw(std::runtime_error("radialcenter3D: V must be a [nRows x nCols x nSlices] array"));
+        }
+        size_t nRows = dims[0];
+        size_t nCols = dims[1];
+        size_t nSlices = (nDims > 2) ? dims[2] : 1;
+
+        double* x = out[0].getdata();
+        double* y = out[1].getdata();
+        double* z = out[2].getdata();
+
+        switch (mxGetClassID(pV)) { //handle different volume types separately
+        case mxDOUBLE_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (double*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxSINGLE_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (float*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxINT8_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (int8_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxUINT8_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (uint8_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxINT16_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (int16_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxUINT16_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (uint16_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxINT32_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (int32_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxUINT32_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (uint32_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxINT64_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (int64_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        case mxUINT64_CLASS:
+            radialcenter3D<ComputeT>(x, y, z, pVarXYZ, pRWR_N, (uint64_t*)mxGetData(pV), nRows, nCols, nSlices, params, pStatus);
+            break;
+        default:
+            throw(std::runtime_error("radialcenter3D: Only numeric volume types allowed"));
+        }
+
+        return out;
+    }
+
+    /// Wrapper for radialcenter3D, accepting the standard arguments for a mexFunction
+    void radialcenter3D_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+        if (nrhs<1) { //not enough inputs
+            mexErrMsgIdAndTxt("MATLAB:radialcenter3D:invalidNumInputs",
+                "At least one input required.");
+        }
+        if (nlhs<1) { //nothing to do.
+            return;
+        }
+
+        if (!mxIsNumeric(prhs[0]) || mxIsComplex(prhs[0])) {
+            mexErrMsgTxt("radialcenter3D: V must be a real, numeric array");
+        }
+
+        cmex::NumericArray<double> WIND;
+        bool found_wind = false;
+
+        int ParamIndex = 1;
+
+        if (nrhs > 1 && !mxIsChar(prhs[1])) {
+            WIND = prhs[1];
+            ParamIndex = 2;
+            found_wind = true;
+        }
+
+        Radialcenter3DParameters params;
+        cmex::MxInputParser Parser(false); //create non-case sensitive input parser
+        Parser.AddParameter("RadiusCutoff", INFINITY); //default to no radius cutoff
+        Parser.AddParameter("CutoffFactor", INFINITY); //default to top-hat function
+        Parser.AddParameter("DistanceExponent", 1);
+        Parser.AddParameter("GradientExponent", 5);
+        Parser.AddParameter("XYZc");
+        Parser.AddParameter("COMmethod", "gradmag");
+        Parser.AddParameter("nThreads", 1);
+        Parser.AddParameter("Precision", "double");
+        if (!found_wind) {
+            Parser.AddParameter("Window");
+        }
+
+        //parse parameters
+        if (ParamIndex < nrhs) {
+            int res = Parser.Parse(nrhs - ParamIndex, &prhs[ParamIndex]);
+            if (res != 0) {
+                mexErrMsgTxt("radialcenter3D: could not parse input parameters");
+            }
+        }
+
+        try {
+            cmex::NumericArray<double> RadiusCutoff(Parser("RadiusCutoff"));
+            params.RadiusCutoff = RadiusCutoff.getdata();
+            params.nRadiusCutoff = RadiusCutoff.numel();
+
+            cmex::NumericArray<double> CutoffFactor(Parser("CutoffFactor"));
+            params.CutoffFactor = CutoffFactor.getdata();
+            params.nCutoffFactor = CutoffFactor.numel();
+
+            cmex::NumericArray<double> DistanceExponent(Parser("DistanceExponent"));
+            params.DistanceExponent = DistanceExponent.getdata();
+            params.nDistanceExponent = DistanceExponent.numel();
+
+            cmex::NumericArray<double> GradientExponent(Parser("GradientExponent"));
+            params.GradientExponent = GradientExponent.getdata();
+            params.nGradientExponent = GradientExponent.numel();
+
+            cmex::NumericArray<double> XYZc(Parser("XYZc"));
+            if (!XYZc.isempty()) {
+                assert_condition(XYZc.nCols() == 3, "radialcenter3D(): XYZc must be [n x 3]");
+            }
+            XYZc -= 1;//shift from 1-indexing
+            params.XYZc = XYZc.getdata();
+            params.nXYZc = XYZc.nRows();
+
+            params.COMmethod = string2COMmethod(cmex::getstring(Parser("COMmethod")));
+
+            double nThreads = mxGetScalar(Parser("nThreads"));
+            if (!(nThreads >= 0)) {
+                throw(std::runtime_error("radialcenter3D: nThreads must be >=0"));
+            }
+            params.nThreads = (size_t)nThreads;
+
+            bool single_precision = string2SinglePrecision(cmex::getstring(Parser("Precision")));
+
+            // only compute the outputs that were requested
+            params.OutputMask = rcdefs::OUTPUT_XY;
+            if (nlhs > 3) {
+                params.OutputMask |= rcdefs::OUTPUT_VARXY;
+            }
+            if (nlhs > 4) {
+                params.OutputMask |= rcdefs::OUTPUT_RWR_N;
+            }
+            if (nlhs > 5) {
+                params.OutputMask |= rcdefs::OUTPUT_STATUS;
+            }
+
+            if (!found_wind) {
+                WIND = Parser("Window");
+            }
+            if (!WIND.isempty()) {
+                assert_condition(WIND.nCols() == 6, "radialcenter3D(): WIND must be [n x 6]");
+                for (size_t n = 0; n < WIND.nRows(); ++n) { //fix 1-index --> 0-index
+                    WIND(n, 0) -= 1;
+                    WIND(n, 1) -= 1;
+                    WIND(n, 2) -= 1;
+                }
+            }
+            params.WIND = WIND.getdata();
+            params.nWIND = WIND.nRows();
+
+            std::vector<cmex::NumericArray<double>> out = single_precision ?
+                radialcenter3D<float>(prhs[0], params) :
+                radialcenter3D<double>(prhs[0], params);
+
+            for (int k = 0; k < nlhs && k < 6; ++k) {
+                if (k < 3) {
+                    out[k] += 1;
+                }
+                plhs[k] = out[k];
+            }
+        }
+        catch (std::exception& e) {
+            mexErrMsgTxt(e.what());
+        }
+    }
+}}
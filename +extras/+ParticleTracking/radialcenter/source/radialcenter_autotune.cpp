@@ -0,0 +1,67 @@
+/*//////////////////////////////
+/// Wrapper for radialcenter_autotune, accepting the standard arguments for a mexFunction
+% [best,results] = radialcenter_autotune(I,XYc,TargetPrecision)
+%                = radialcenter_autotune(__,name,value);
+%
+% Find the cheapest radialcenter parameters that reach a target localization precision
+% I is a stack of frames of stuck (immobile) beads. Every combination of the
+% parameter values is tested: each bead is tracked in a square window centered on
+% XYc and the precision is measured from the frame-to-frame jitter of the beads,
+% the cost from the time needed to track them.
+%
+% Input:
+%   I: representative image stack, [nRows x nCols x nFrames] array or cell array of [nRows x nCols] frames
+%       at least 2 frames are required
+%   XYc: [n x 2] approximate positions [x,y] of the stuck beads
+%   TargetPrecision: required precision (px)
+%
+% Output:
+%   best: struct describing the cheapest configuration with Precision<=TargetPrecision
+%       (or the most precise configuration if none reaches the target)
+%       .WindowSize: width and height of the ROI window (px)
+%       .RadiusCutoff, .CutoffFactor, .DistanceExponent, .GradientExponent:
+%           radialcenter/RoiTracker parameters
+%       .Precision: rms frame-to-frame jitter per axis (px)
+%       .Cost: time per ROI (ns)
+%       .MeetsTarget: true if Precision<=TargetPrecision
+%   results: [nConfigurations x 7] table of every configuration that was tested
+%       [WindowSize,RadiusCutoff,CutoffFactor,DistanceExponent,GradientExponent,Precision,Cost]
+%
+%   The jitter is the rms deviation of each bead from its mean position; with more than one bead
+%   the common motion of all beads (stage drift) is subtracted in each frame.
+%   A configuration for which any fit fails has Precision=Inf.
+%   The cost is the fastest of Repeats passes over the stack, so it does not include the first
+%   call (which allocates the workspace).
+%
+%   The RoiTracker parameters of best can be applied with e.g.
+%       roiTracker.setParameters('RadiusCutoff',best.RadiusCutoff,'CutoffFactor',best.CutoffFactor,...
+%           'DistanceExponent',best.DistanceExponent,'GradientExponent',best.GradientExponent)
+%   and best.WindowSize used as the width and height of each roiList(k).Window
+%
+% Name,Value Parameters:
+% -------------------------
+%   Values that are swept (every combination is tested):
+%   'WindowSize',[w1,w2,...]: window sizes (px) (default=[16,24,32,48,64])
+%   'RadiusCutoff',[v1,v2,...]: (default=Inf)
+%   'CutoffFactor',[v1,v2,...]: (default=Inf)
+%   'DistanceExponent',[v1,v2,...]: (default=[0,1])
+%   'GradientExponent',[v1,v2,...]: (default=[2,5])
+%
+%   Fixed parameters:
+%   'COMmethod',method: center of mass method used by radialcenter (default='gradmag')
+%   'nThreads',n: number of threads used by radialcenter (default=1)
+%   'Precision','double' or 'single': floating point type used by radialcenter (default='double')
+%   'Repeats',N: number of timed passes over the stack (default=3)
+*/
+
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+
+
+#include "radialcenter_autotune_mex.hpp"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+    extras::ParticleTracking::radialcenter_autotune_mex(nlhs,plhs,nrhs,prhs);
+}
@@ -0,0 +1,212 @@
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+#include "radialcenter.h"
+
+#include <chrono>
+#include <limits>
+#include <vector>
+
+namespace rcdefs {
+    //! RMS frame-to-frame jitter (per axis) of nBeads stuck beads tracked over nFrames
+    //! x[n+nBeads*f], y[n+nBeads*f] are the positions of bead n in frame f.
+    //! The mean position of each bead is subtracted; with more than one bead the common
+    //! motion of all beads (stage drift) in each frame is subtracted as well.
+    //! Returns INFINITY if any position is not finite.
+    inline double tracking_jitter(const double* x, const double* y, size_t nBeads, size_t nFrames)
+    {
+        if (nFrames < 2) {
+            return NAN;
+        }
+        for (size_t k = 0; k < nBeads*nFrames; ++k) {
+            if (!std::isfinite(x[k]) || !std::isfinite(y[k])) {
+                return INFINITY;
+            }
+        }
+
+        // mean position of each bead
+        std::vector<double> mx(nBeads, 0.0), my(nBeads, 0.0);
+        for (size_t f = 0; f < nFrames; ++f) {
+            for (size_t n = 0; n < nBeads; ++n) {
+                mx[n] += x[n + nBeads*f];
+                my[n] += y[n + nBeads*f];
+            }
+        }
+        for (size_t n = 0; n < nBeads; ++n) {
+            mx[n] /= nFrames;
+            my[n] /= nFrames;
+        }
+
+        const bool drift = nBeads > 1;
+        double ss = 0;
+        for (size_t f = 0; f < nFrames; ++f) {
+            double cx = 0, cy = 0; //common motion in this frame
+            if (drift) {
+                for (size_t n = 0; n < nBeads; ++n) {
+                    cx += x[n + nBeads*f] - mx[n];
+                    cy += y[n + nBeads*f] - my[n];
+                }
+                cx /= nBeads;
+                cy /= nBeads;
+            }
+            for (size_t n = 0; n < nBeads; ++n) {
+                double dx = x[n + nBeads*f] - mx[n] - cx;
+                double dy = y[n + nBeads*f] - my[n] - cy;
+                ss += dx*dx + dy*dy;
+            }
+        }
+
+        double dof = (double)(nFrames - 1)*(drift ? nBeads - 1 : 1);
+        return sqrt(ss / (2 * dof));
+    }
+}
+
+namespace extras{namespace ParticleTracking{
+
+    //! Parameter values swept by radialcenter_autotune(); every combination is tested
+    struct RadialcenterTuneGrid {
+        std::vector<double> WindowSize = { 16, 24, 32, 48, 64 }; //width=height of the square window around each bead (px)
+        std::vector<double> RadiusCutoff = { INFINITY };
+        std::vector<double> CutoffFactor = { INFINITY };
+        std::vector<double> DistanceExponent = { 0, 1 };
+        std::vector<double> GradientExponent = { 2, 5 };
+    };
+
+    //! Precision and cost of one parameter combination tested by radialcenter_autotune()
+    struct RadialcenterTuneResult {
+        double WindowSize = NAN;
+        double RadiusCutoff = NAN;
+        double CutoffFactor = NAN;
+        double DistanceExponent = NAN;
+        double GradientExponent = NAN;
+        double Precision = NAN; //rms frame-to-frame jitter of the beads, per axis (px); INFINITY if a fit failed
+        double Cost = NAN; //time per window (ns)
+    };
+
+    //! Find the cheapest radialcenter parameters that reach a target localization precision
+    //!
+    //! frames[f] (f<nFrames, nRows x nCols, layout given by base_params.ImageLayout) is a stack of images of
+    //! nBeads stuck beads at (approximately) XYc = [nBeads x 2] (0-indexed, column-major [x...,y...]).
+    //! Every combination of the values in grid is tested: the beads are tracked in a square WindowSize window
+    //! centered on XYc, the precision is the frame-to-frame jitter (rcdefs::tracking_jitter()) and the cost
+    //! is the fastest of Repeats timed passes over the stack, in ns per window.
+    //! The other parameters (COMmethod, nThreads, RefineIterations, ...) are taken from base_params.
+    //!
+    //! results receives one entry per combination. Returns the index of the cheapest combination with
+    //! Precision<=TargetPrecision, or of the most precise combination if none reaches the target
+    //! (MeetsTarget is set accordingly).
+    template <typename T, typename M>
+    size_t radialcenter_autotune(std::vector<RadialcenterTuneResult>& results, bool& MeetsTarget,
+        const M* const* frames, size_t nFrames, size_t nRows, size_t nCols, //image stack
+        const double* XYc, size_t nBeads, //bead positions
+        double TargetPrecision, //required precision (px)
+        const RadialcenterTuneGrid& grid = RadialcenterTuneGrid(), //values swept
+        const RadialcenterParameters& base_params = RadialcenterParameters(), //other parameters
+        size_t Repeats = 3) //number of timed passes
+    {
+        using namespace std;
+        using clock = std::chrono::steady_clock;
+
+        if (nFrames < 2) {
+            throw(std::runtime_error("radialcenter_autotune: at least two frames are required"));
+        }
+        if (nBeads < 1) {
+            throw(std::runtime_error("radialcenter_autotune: at least one bead position is required"));
+        }
+        if (grid.WindowSize.empty() || grid.RadiusCutoff.empty() || grid.CutoffFactor.empty() || grid.DistanceExponent.empty() || grid.GradientExponent.empty()) {
+            throw(std::runtime_error("radialcenter_autotune: every parameter must have at least one value"));
+        }
+        Repeats = max(size_t(1), Repeats);
+
+        vector<double> WIND(4 * nBeads);
+        vector<double> x(nBeads*nFrames), y(nBeads*nFrames);
+        RadialcenterWorkspace<T> workspace;
+
+        RadialcenterParameters params = base_params;
+        params.WIND = WIND.data();
+        params.nWIND = nBeads;
+        params.XYc = nullptr;
+        params.nXYc = 0;
+        params.OutputMask = rcdefs::OUTPUT_XY;
+
+        results.clear();
+        for (double w : grid.WindowSize) {
+            if (!(w >= 4)) {
+                throw(std::runtime_error("radialcenter_autotune: WindowSize must be >=4"));
+            }
+            for (size_t n = 0; n < nBeads; ++n) { //window centered on each bead
+                WIND[n] = floor(XYc[n] - (w - 1) / 2);
+                WIND[n + nBeads] = floor(XYc[n + nBeads] - (w - 1) / 2);
+                WIND[n + 2 * nBeads] = w;
+                WIND[n + 3 * nBeads] = w;
+            }
+
+            for (double RC : grid.RadiusCutoff) {
+                for (double CF : grid.CutoffFactor) {
+                    for (double DE : grid.DistanceExponent) {
+                        for (double GE : grid.GradientExponent) {
+                            params.RadiusCutoff = &RC;
+                            params.nRadiusCutoff = 1;
+                            params.CutoffFactor = &CF;
+                            params.nCutoffFactor = 1;
+                            params.DistanceExponent = &DE;
+                            params.nDistanceExponent = 1;
+                            params.GradientExponent = &GE;
+                            params.nGradientExponent = 1;
+
+                            RadialcenterTuneResult res;
+                            res.WindowSize = w;
+                            res.RadiusCutoff = RC;
+                            res.CutoffFactor = CF;
+                            res.DistanceExponent = DE;
+                            res.GradientExponent = GE;
+
+                            // precision (this pass also grows the workspace, so the timed passes do not allocate)
+                            for (size_t f = 0; f < nFrames; ++f) {
+                                radialcenter(x.data() + nBeads*f, y.data() + nBeads*f, (double*)nullptr, (double*)nullptr,
+                                    frames[f], nRows, nCols, params, workspace);
+                            }
+                            res.Precision = rcdefs::tracking_jitter(x.data(), y.data(), nBeads, nFrames);
+
+                            // cost
+                            double best = numeric_limits<double>::infinity();
+                            for (size_t r = 0; r < Repeats; ++r) {
+                                auto t0 = clock::now();
+                                for (size_t f = 0; f < nFrames; ++f) {
+                                    radialcenter(x.data() + nBeads*f, y.data() + nBeads*f, (double*)nullptr, (double*)nullptr,
+                                        frames[f], nRows, nCols, params, workspace);
+                                }
+                                double dt = std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+                                best = min(best, dt);
+                            }
+                            res.Cost = best / (nFrames*nBeads);
+
+                            results.push_back(res);
+                        }
+                    }
+                }
+            }
+        }
+
+        // cheapest combination that reaches the target, otherwise the most precise
+        size_t best_idx = results.size();
+        for (size_t k = 0; k < results.size(); ++k) {
+            if (results[k].Precision <= TargetPrecision && (best_idx == results.size() || results[k].Cost < results[best_idx].Cost)) {
+                best_idx = k;
+            }
+        }
+        MeetsTarget = best_idx < results.size();
+        if (!MeetsTarget) {
+            best_idx = 0;
+            for (size_t k = 1; k < results.size(); ++k) {
+                if (results[k].Precision < results[best_idx].Precision) {
+                    best_idx = k;
+                }
+            }
+        }
+        return best_idx;
+    }
+}}
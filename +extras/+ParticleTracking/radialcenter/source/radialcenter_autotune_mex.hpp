@@ -0,0 +1,188 @@
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+#include <mex.h>
+#include <extras/string_extras.hpp>
+#include "radialcenter_autotune.h"
+#include "radialcenter_mex.hpp"
+
+#include <vector>
+#include <extras/cmex/NumericArray.hpp>
+#include <extras/cmex/mxparamparse.hpp>
+
+namespace extras{namespace ParticleTracking{
+
+    //! call radialcenter_autotune() with frames cast to M
+    template<typename ComputeT, typename M>
+    size_t radialcenter_autotune_typed(std::vector<RadialcenterTuneResult>& results, bool& MeetsTarget,
+        const std::vector<const void*>& frames, size_t nRows, size_t nCols,
+        const double* XYc, size_t nBeads, double TargetPrecision,
+        const RadialcenterTuneGrid& grid, const RadialcenterParameters& params, size_t Repeats)
+    {
+        std::vector<const M*> typed_frames(frames.size());
+        for (size_t f = 0; f < frames.size(); ++f) {
+            typed_frames[f] = (const M*)frames[f];
+        }
+        return radialcenter_autotune<ComputeT>(results, MeetsTarget, typed_frames.data(), typed_frames.size(), nRows, nCols,
+            XYc, nBeads, TargetPrecision, grid, params, Repeats);
+    }
+
+    //! call radialcenter_autotune() for the image stack pI (see radialcenter_stack_frames())
+    template<typename ComputeT>
+    size_t radialcenter_autotune(std::vector<RadialcenterTuneResult>& results, bool& MeetsTarget,
+        const mxArray* pI, const double* XYc, size_t nBeads, double TargetPrecision,
+        const RadialcenterTuneGrid& grid, const RadialcenterParameters& params, size_t Repeats)
+    {
+        std::vector<const void*> frames;
+        size_t nRows, nCols;
+        mxClassID cls = radialcenter_stack_frames(pI, frames, nRows, nCols);
+
+        switch (cls) { //handle different image types separately
+        case mxDOUBLE_CLASS:
+            return radialcenter_autotune_typed<ComputeT, double>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxSINGLE_CLASS:
+            return radialcenter_autotune_typed<ComputeT, float>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxINT8_CLASS:
+            return radialcenter_autotune_typed<ComputeT, int8_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxUINT8_CLASS:
+            return radialcenter_autotune_typed<ComputeT, uint8_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxINT16_CLASS:
+            return radialcenter_autotune_typed<ComputeT, int16_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxUINT16_CLASS:
+            return radialcenter_autotune_typed<ComputeT, uint16_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxINT32_CLASS:
+            return radialcenter_autotune_typed<ComputeT, int32_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxUINT32_CLASS:
+            return radialcenter_autotune_typed<ComputeT, uint32_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxINT64_CLASS:
+            return radialcenter_autotune_typed<ComputeT, int64_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        case mxUINT64_CLASS:
+            return radialcenter_autotune_typed<ComputeT, uint64_t>(results, MeetsTarget, frames, nRows, nCols, XYc, nBeads, TargetPrecision, grid, params, Repeats);
+        default:
+            throw(std::runtime_error("radialcenter_autotune: Only numeric image types allowed"));
+        }
+    }
+
+    //! values of a numeric parameter (or the default values if the parameter is empty)
+    inline std::vector<double> radialcenter_autotune_values(const mxArray* pVal, const std::vector<double>& default_values)
+    {
+        cmex::NumericArray<double> val(pVal);
+        if (val.isempty()) {
+            return default_values;
+        }
+        return std::vector<double>(val.getdata(), val.getdata() + val.numel());
+    }
+
+    /// Wrapper for radialcenter_autotune, accepting the standard arguments for a mexFunction
+    void radialcenter_autotune_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+    {
+        if (nrhs < 3) { //not enough inputs
+            mexErrMsgIdAndTxt("MATLAB:radialcenter_autotune:invalidNumInputs",
+                "Three inputs required: I, XYc, TargetPrecision.");
+        }
+
+        try {
+            cmex::NumericArray<double> XYc(prhs[1]);
+            if (XYc.isempty() || XYc.nCols() != 2) {
+                throw(std::runtime_error("radialcenter_autotune: XYc must be [n x 2]"));
+            }
+            XYc -= 1;//shift from 1-indexing
+
+            double TargetPrecision = mxGetScalar(prhs[2]);
+            if (!(TargetPrecision > 0)) {
+                throw(std::runtime_error("radialcenter_autotune: TargetPrecision must be >0"));
+            }
+
+            RadialcenterTuneGrid grid; //values not specified are swept over the default values
+            cmex::MxInputParser Parser(false); //create non-case sensitive input parser
+            Parser.AddParameter("WindowSize");
+            Parser.AddParameter("RadiusCutoff");
+            Parser.AddParameter("CutoffFactor");
+            Parser.AddParameter("DistanceExponent");
+            Parser.AddParameter("GradientExponent");
+            Parser.AddParameter("COMmethod", "gradmag");
+            Parser.AddParameter("nThreads", 1);
+            Parser.AddParameter("Precision", "double");
+            Parser.AddParameter("Repeats", 3);
+
+            //parse parameters
+            if (nrhs > 3) {
+                int res = Parser.Parse(nrhs - 3, &prhs[3]);
+                if (res != 0) {
+                    throw(std::runtime_error("radialcenter_autotune: could not parse input parameters"));
+                }
+            }
+
+            grid.WindowSize = radialcenter_autotune_values(Parser("WindowSize"), grid.WindowSize);
+            grid.RadiusCutoff = radialcenter_autotune_values(Parser("RadiusCutoff"), grid.RadiusCutoff);
+            grid.CutoffFactor = radialcenter_autotune_values(Parser("CutoffFactor"), grid.CutoffFactor);
+            grid.DistanceExponent = radialcenter_autotune_values(Parser("DistanceExponent"), grid.DistanceExponent);
+            grid.GradientExponent = radialcenter_autotune_values(Parser("GradientExponent"), grid.GradientExponent);
+
+            RadialcenterParameters params;
+            params.COMmethod = string2COMmethod(cmex::getstring(Parser("COMmethod")));
+
+            double nThreads = mxGetScalar(Parser("nThreads"));
+            if (!(nThreads >= 0)) {
+                throw(std::runtime_error("radialcenter_autotune: nThreads must be >=0"));
+            }
+            params.nThreads = (size_t)nThreads;
+
+            bool single_precision = string2SinglePrecision(cmex::getstring(Parser("Precision")));
+
+            double Repeats = mxGetScalar(Parser("Repeats"));
+            if (!(Repeats >= 1)) {
+                throw(std::runtime_error("radialcenter_autotune: Repeats must be >=1"));
+            }
+
+            std::vector<RadialcenterTuneResult> results;
+            bool MeetsTarget;
+            size_t best = single_precision ?
+                radialcenter_autotune<float>(results, MeetsTarget, prhs[0], XYc.getdata(), XYc.nRows(), TargetPrecision, grid, params, (size_t)Repeats) :
+                radialcenter_autotune<double>(results, MeetsTarget, prhs[0], XYc.getdata(), XYc.nRows(), TargetPrecision, grid, params, (size_t)Repeats);
+
+            // best configuration, as a struct holding only RoiTracker parameters
+            const RadialcenterTuneResult& b = results[best];
+            const char* param_fields[] = { "RadiusCutoff", "CutoffFactor", "DistanceExponent", "GradientExponent" };
+            mxArray* pBest = mxCreateStructMatrix(1, 1, 4, param_fields);
+            mxSetField(pBest, 0, "RadiusCutoff", mxCreateDoubleScalar(b.RadiusCutoff));
+            mxSetField(pBest, 0, "CutoffFactor", mxCreateDoubleScalar(b.CutoffFactor));
+            mxSetField(pBest, 0, "DistanceExponent", mxCreateDoubleScalar(b.DistanceExponent));
+            mxSetField(pBest, 0, "GradientExponent", mxCreateDoubleScalar(b.GradientExponent));
+            plhs[0] = pBest;
+
+            // window size and measured performance of the best configuration
+            if (nlhs > 1) {
+                const char* info_fields[] = { "WindowSize", "Precision", "Cost", "MeetsTarget" };
+                mxArray* pInfo = mxCreateStructMatrix(1, 1, 4, info_fields);
+                mxSetField(pInfo, 0, "WindowSize", mxCreateDoubleScalar(b.WindowSize));
+                mxSetField(pInfo, 0, "Precision", mxCreateDoubleScalar(b.Precision));
+                mxSetField(pInfo, 0, "Cost", mxCreateDoubleScalar(b.Cost));
+                mxSetField(pInfo, 0, "MeetsTarget", mxCreateLogicalScalar(MeetsTarget));
+                plhs[1] = pInfo;
+            }
+
+            // every configuration: [WindowSize,RadiusCutoff,CutoffFactor,DistanceExponent,GradientExponent,Precision,Cost]
+            if (nlhs > 2) {
+                size_t n = results.size();
+                plhs[2] = mxCreateDoubleMatrix(n, 7, mxREAL);
+                double* pRes = mxGetPr(plhs[2]);
+                for (size_t k = 0; k < n; ++k) {
+                    pRes[k] = results[k].WindowSize;
+                    pRes[k + n] = results[k].RadiusCutoff;
+                    pRes[k + 2 * n] = results[k].CutoffFactor;
+                    pRes[k + 3 * n] = results[k].DistanceExponent;
+                    pRes[k + 4 * n] = results[k].GradientExponent;
+                    pRes[k + 5 * n] = results[k].Precision;
+                    pRes[k + 6 * n] = results[k].Cost;
+                }
+            }
+        }
+        catch (std::exception& e) {
+            mexErrMsgTxt(e.what());
+        }
+    }
+}}
@@ -0,0 +1,446 @@
+/*--------------------------------------------------
+Copyright 2018-2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+/*
+Cross-window SIMD lanes for batches of small windows (radialcenter() with params.LaneBatchSize>0)
+
+The per-window kernels vectorize along the columns of a window. For small windows most of each vector is
+spent on the edges (the gradient of a 12 px window has 11 px columns, less than 3 AVX2 double vectors).
+The lane kernels instead process LANES = simd::pack<T>::width windows of the same size at once, one window
+per SIMD lane. The pixels of the batch are gathered into a lane-interleaved (structure-of-arrays) tile:
+	element (y,x) of window l is at [(y + x*nY)*LANES + l]   (nY = number of rows of the buffer)
+so every per-pixel operation (gradient, center of mass, weights and sums) is a single vector operation on
+the same pixel of all windows. The 2x2 systems of the batch are then solved lane by lane from the sums.
+
+Each lane performs the same operations, in the same order, as the per-window path (smoothgrad_fused() and
+weighted_sums_kernel()). Pixels outside the circle of a window are given zero weight instead of being
+skipped, which leaves its sums unchanged. The results are therefore the same as the per-window path, except:
+	- uint8 and uint16 images use the floating point gradient instead of the integer-domain kernel
+	  (which can differ in the last bits, see smoothgrad_simd.h)
+	- the compiler can fuse multiply-adds (e.g. gcc -march=native) differently in the two paths.
+As in the per-window path (see Single precision in radialcenter_weights.h), the sums of each row are accumulated
+in T lanes and then added to double lanes (a row of float lanes is converted to two vectors of double), and the
+gradient magnitude of a float window is divided by its maximum over the window (one scale per lane).
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+#include "smoothgrad_simd.h"
+#include "radialcenter_weights.h"
+
+namespace rcdefs {
+
+	//! v^E for an exponent E selected at run time (E from integer_exponent(); same operations as pack_pow<E>)
+	template<class P>
+	inline typename P::type pack_pow_runtime(typename P::type v, int E, typename P::value_type e) {
+		switch (E) {
+		case 0:
+			return pack_pow<0>::template eval<P>(v, e);
+		case 1:
+			return pack_pow<1>::template eval<P>(v, e);
+		case 2:
+			return pack_pow<2>::template eval<P>(v, e);
+		case 4:
+			return pack_pow<4>::template eval<P>(v, e);
+		case 5:
+			return pack_pow<5>::template eval<P>(v, e);
+		default:
+			return pack_pow<GENERIC_EXPONENT>::template eval<P>(v, e);
+		}
+	}
+
+	//! 3x1 mean of the lane-interleaved column h (dNy rows), stored in O (same as smoothgrad_fused_vpass())
+	template<class P>
+	inline void lane_smoothgrad_vpass(const typename P::value_type* h, size_t dNy, typename P::value_type* O) {
+		using vec = typename P::type;
+		using V = typename P::value_type;
+		const size_t L = P::width;
+		const vec two = P::set1(V(2.0));
+		const vec three = P::set1(V(3.0));
+
+		P::store(O, P::div(P::add(P::load(h), P::load(h + L)), two));
+		for (size_t y = 1; y < dNy - 1; ++y) {
+			P::store(O + y*L, P::div(P::add(P::add(P::load(h + (y - 1)*L), P::load(h + y*L)), P::load(h + (y + 1)*L)), three));
+		}
+		P::store(O + (dNy - 1)*L, P::div(P::add(P::load(h + (dNy - 2)*L), P::load(h + (dNy - 1)*L)), two));
+	}
+
+	//! Smoothed gradient of a batch of windows
+	//! tile: lane-interleaved pixels of the windows, (dNy+1) x (dNx+1)
+	//! du, dv: lane-interleaved gradient, dNy x dNx
+	//! colbuf: buffer with space for 2*dNy*LANES elements
+	//! Each lane is computed with the same operations as smoothgrad_fused(); dNy>=2, dNx>=2
+	template<typename T>
+	void lane_smoothgrad(const T* tile, size_t dNy, size_t dNx, T* du, T* dv, T* colbuf) {
+		typedef simd::pack<T> P;
+		typedef typename P::type vec;
+		const size_t L = P::width;
+		const size_t cs = (dNy + 1)*L; //column stride of the tile
+		const vec two = P::set1(T(2.0));
+		const vec three = P::set1(T(3.0));
+
+		T* hu = colbuf;
+		T* hv = colbuf + dNy*L;
+
+		for (size_t x = 0; x < dNx; ++x) {
+			// 1x3 mean of the differences (smoothgrad_fused_hpass)
+			const T* c0 = (x > 0) ? tile + (x - 1)*cs : nullptr; //column x-1
+			const T* c1 = tile + x*cs; //column x
+			const T* c2 = tile + (x + 1)*cs; //column x+1
+			const T* c3 = (x + 2 <= dNx) ? tile + (x + 2)*cs : nullptr; //column x+2
+
+			if (x == 0) { //first column: average tu(x), tu(x+1)
+				for (size_t y = 0; y < dNy; ++y) {
+					const size_t a = y*L;
+					const size_t b = a + L;
+					vec a1 = P::load(c1 + a), a2 = P::load(c2 + a), a3 = P::load(c3 + a);
+					vec b1 = P::load(c1 + b), b2 = P::load(c2 + b), b3 = P::load(c3 + b);
+					P::store(hu + a, P::div(P::add(P::sub(b2, a1), P::sub(b3, a2)), two));
+					P::store(hv + a, P::div(P::add(P::sub(b1, a2), P::sub(b2, a3)), two));
+				}
+			}
+			else if (x == dNx - 1) { //last column: average tu(x-1), tu(x)
+				for (size_t y = 0; y < dNy; ++y) {
+					const size_t a = y*L;
+					const size_t b = a + L;
+					vec a0 = P::load(c0 + a), a1 = P::load(c1 + a), a2 = P::load(c2 + a);
+					vec b0 = P::load(c0 + b), b1 = P::load(c1 + b), b2 = P::load(c2 + b);
+					P::store(hu + a, P::div(P::add(P::sub(b1, a0), P::sub(b2, a1)), two));
+					P::store(hv + a, P::div(P::add(P::sub(b0, a1), P::sub(b1, a2)), two));
+				}
+			}
+			else { //middle columns: average tu(x-1), tu(x), tu(x+1)
+				for (size_t y = 0; y < dNy; ++y) {
+					const size_t a = y*L;
+					const size_t b = a + L;
+					vec a0 = P::load(c0 + a), a1 = P::load(c1 + a), a2 = P::load(c2 + a), a3 = P::load(c3 + a);
+					vec b0 = P::load(c0 + b), b1 = P::load(c1 + b), b2 = P::load(c2 + b), b3 = P::load(c3 + b);
+					P::store(hu + a, P::div(P::add(P::add(P::sub(b1, a0), P::sub(b2, a1)), P::sub(b3, a2)), three));
+					P::store(hv + a, P::div(P::add(P::add(P::sub(b0, a1), P::sub(b1, a2)), P::sub(b2, a3)), three));
+				}
+			}
+
+			// 3x1 mean
+			lane_smoothgrad_vpass<P>(hu, dNy, du + x*dNy*L);
+			lane_smoothgrad_vpass<P>(hv, dNy, dv + x*dNy*L);
+		}
+	}
+
+	//! Center of mass of the gradient magnitude of each window of a batch (COMmethod=GRAD_MAG)
+	//! du, dv: lane-interleaved gradient (dNy x dNx)
+	//! Xcom, Ycom (LANES elements each) receive the center of each window, relative to the window
+	//! Same sums, in the same order, as radialcenter_window()
+	template<typename T>
+	void lane_gradmag_com(const T* du, const T* dv, size_t dNy, size_t dNx, double* Xcom, double* Ycom) {
+		typedef simd::pack<T> P;
+		typedef simd::pack<double> PD;
+		typedef typename P::type vec;
+		typedef typename PD::type dvec;
+		const size_t L = P::width;
+		const size_t H = L / PD::width; //double vectors per vector of T
+		static_assert(L % PD::width == 0, "lane_gradmag_com: lanes of T must fill whole double vectors");
+
+		dvec sx[H], sy[H], sg[H];
+		for (size_t h = 0; h < H; ++h) {
+			sx[h] = PD::set1(0);
+			sy[h] = PD::set1(0);
+			sg[h] = PD::set1(0);
+		}
+
+		for (size_t yi = 0; yi < dNy; ++yi) {
+			const vec yk = P::set1(yi + T(0.5));
+			for (size_t xi = 0; xi < dNx; ++xi) {
+				const vec xk = P::set1(xi + T(0.5));
+				const size_t ind = (yi + xi*dNy)*L;
+				const vec vdu = P::load(du + ind);
+				const vec vdv = P::load(dv + ind);
+				const vec gm = P::sqrt(P::add(P::mul(vdu, vdu), P::mul(vdv, vdv)));
+				const vec gx = P::mul(xk, gm);
+				const vec gy = P::mul(yk, gm);
+				for (size_t h = 0; h < H; ++h) {
+					sx[h] = PD::add(sx[h], P::to_double(gx, h));
+					sy[h] = PD::add(sy[h], P::to_double(gy, h));
+					sg[h] = PD::add(sg[h], P::to_double(gm, h));
+				}
+			}
+		}
+
+		for (size_t h = 0; h < H; ++h) {
+			PD::store(Xcom + h*PD::width, PD::div(sx[h], sg[h]));
+			PD::store(Ycom + h*PD::width, PD::div(sy[h], sg[h]));
+		}
+	}
+
+	//! Inputs and outputs of lane_weighted_sums(): the WeightedSums of each window of a batch
+	//! Per-window values have one element per lane; the other parameters are the same for every window.
+	template<typename T>
+	struct LaneWeightedSums {
+		static constexpr size_t LANES = simd::pack<T>::width;
+
+		// lane-interleaved gradient of the batch (dNy x dNx)
+		const T* du;
+		const T* dv;
+		size_t dNx;
+		size_t dNy;
+
+		bool residual; //accumulate the moments used to compute the residual (Syy, SXy1, SXy2)
+		bool weighted; //false: no weighting factor (GradientExponent=0, DistanceExponent=0 and no cutoff)
+		RADIUS_CUTOFF cutoff;
+
+		alignas(64) T Xcom[LANES]; //center guess of each window, relative to the window
+		alignas(64) T Ycom[LANES];
+		alignas(64) T Xref[LANES]; //reference point of the residual moments
+		alignas(64) T Yref[LANES];
+
+		T RE2; //square of the radius around the center that is summed over
+		T RadiusCutoff;
+		T CutoffFactor;
+		T DistanceExponent;
+		T GradientExponent;
+		alignas(64) T GradScale[LANES]; //scale of the gradient magnitude in the weights, see lane_gradient_weight_scale()
+
+		// sums of each window
+		alignas(64) double sw[LANES];
+		alignas(64) double sw2[LANES];
+		alignas(64) double A[LANES];
+		alignas(64) double B[LANES];
+		alignas(64) double D[LANES];
+		alignas(64) double XWy1[LANES];
+		alignas(64) double XWy2[LANES];
+		alignas(64) double Syy[LANES];
+		alignas(64) double SXy1[LANES];
+		alignas(64) double SXy2[LANES];
+	};
+
+	//! Set s.GradScale of each window of a batch (1/max|grad(I)| of each window, see gradient_weight_scale())
+	template<typename T>
+	void lane_gradient_weight_scale(LaneWeightedSums<T>& s) {
+		typedef simd::pack<T> P;
+		const size_t L = P::width;
+		typename P::type vm2 = P::set1(0); //max |grad(I)|^2 of each window
+		if (s.weighted && s.GradientExponent != 0) {
+			for (size_t i = 0; i < s.dNx*s.dNy; ++i) {
+				const typename P::type vdu = P::load(s.du + i*L);
+				const typename P::type vdv = P::load(s.dv + i*L);
+				vm2 = P::max(vm2, P::add(P::mul(vdu, vdu), P::mul(vdv, vdv)));
+			}
+		}
+		alignas(64) T m2[L];
+		P::store(m2, vm2);
+		for (size_t l = 0; l < L; ++l) {
+			const T m = std::sqrt(m2[l]);
+			s.GradScale[l] = (m > 0 && std::isfinite(m)) ? T(1) / m : T(1);
+		}
+	}
+	inline void lane_gradient_weight_scale(LaneWeightedSums<double>& s) {
+		for (size_t l = 0; l < LaneWeightedSums<double>::LANES; ++l) {
+			s.GradScale[l] = 1;
+		}
+	}
+
+	//! weighted least-squares loop of a batch, for cutoff type CUTOFF
+	//! WEIGHTED==false: the loop without weighting factor of radialcenter_fit()
+	//! Exponents are selected at run time (pack_pow_runtime()): the branch is the same for every pixel,
+	//! and a single instantiation per cutoff keeps the compile time down.
+	template<int CUTOFF, bool WEIGHTED, typename T>
+	void lane_weighted_sums_kernel(LaneWeightedSums<T>& s) {
+		using namespace std;
+		typedef simd::pack<T> P;
+		typedef simd::pack<double> PD;
+		typedef typename P::type vec;
+		typedef typename PD::type dvec;
+		const size_t L = P::width;
+		const size_t H = L / PD::width; //double vectors per vector of T
+		static_assert(L % PD::width == 0, "lane_weighted_sums_kernel: lanes of T must fill whole double vectors");
+
+		const size_t dNy = s.dNy;
+		const size_t dNx = s.dNx;
+		const bool residual = s.residual;
+		const T RE2 = s.RE2;
+		const int DE = integer_exponent(s.DistanceExponent);
+		const int GE = integer_exponent(s.GradientExponent);
+		const T DistanceExponent = s.DistanceExponent;
+		const T GradientExponent = s.GradientExponent;
+		const vec RadiusCutoff = P::set1(s.RadiusCutoff);
+		const vec CutoffFactor = P::set1(s.CutoffFactor);
+		const vec one = P::set1(T(1.0));
+		const vec Xcom = P::load(s.Xcom);
+		const vec Ycom = P::load(s.Ycom);
+		const vec Xref = P::load(s.Xref);
+		const vec Yref = P::load(s.Yref);
+		const vec GradScale = P::load(s.GradScale);
+
+		dvec sw[H], sw2[H], A[H], B[H], D[H], XWy1[H], XWy2[H], Syy[H], SXy1[H], SXy2[H];
+		for (size_t h = 0; h < H; ++h) {
+			sw[h] = sw2[h] = A[h] = B[h] = D[h] = XWy1[h] = XWy2[h] = Syy[h] = SXy1[h] = SXy2[h] = PD::set1(0);
+		}
+
+		alignas(64) T dy2buf[L]; //per-lane circle bounds of a row
+		alignas(64) T xsbuf[L];
+		alignas(64) T xebuf[L];
+
+		for (size_t yi = 0; yi < dNy; ++yi) {
+			const T yk = yi + T(0.5); // y coordinate
+			const vec vyk = P::set1(yk);
+			const vec dy2 = P::mul(P::sub(Ycom, vyk), P::sub(Ycom, vyk)); //square of y-component of radius
+
+			// columns summed by each window (same bounds as weighted_sums_kernel)
+			size_t xLo = 0;
+			size_t xHi = dNx;
+			vec xStart = P::set1(0);
+			vec xEnd = P::set1(0);
+			if (CUTOFF != NO_CUTOFF) {
+				P::store(dy2buf, dy2);
+				xLo = dNx;
+				xHi = 0;
+				for (size_t l = 0; l < L; ++l) {
+					xsbuf[l] = 0;
+					xebuf[l] = 0;
+					if (!(dy2buf[l] > RE2)) { //row intersects the circle
+						T xr = sqrt(RE2 - dy2buf[l]);
+						size_t xs, xe;
+						circle_columns(s.Xcom[l], xr, dNx, xs, xe);
+						if (xs < xe) {
+							xsbuf[l] = (T)xs;
+							xebuf[l] = (T)xe;
+							xLo = min(xLo, xs);
+							xHi = max(xHi, xe);
+						}
+					}
+				}
+				xStart = P::load(xsbuf);
+				xEnd = P::load(xebuf);
+			}
+
+			// sums of the row
+			vec rsw = P::set1(0), rsw2 = rsw, rA = rsw, rB = rsw, rD = rsw, rXWy1 = rsw, rXWy2 = rsw, rSyy = rsw, rSXy1 = rsw, rSXy2 = rsw;
+			for (size_t xi = xLo; xi < xHi; ++xi) {
+				const size_t ind = (yi + xi*dNy)*L;
+				const T xk = xi + T(0.5); //x coordinate
+				const vec vxk = P::set1(xk);
+				const vec vdu = P::load(s.du + ind);
+				const vec vdv = P::load(s.dv + ind);
+				const vec mag = P::sqrt(P::add(P::mul(vdu, vdu), P::mul(vdv, vdv))); //|grad(I)|
+
+				vec w = one; //weight factor
+				vec wx0, wx1;
+				if (WEIGHTED) {
+					if (CUTOFF == LOGISTIC_CUTOFF || DE != 0) { //need to compute radius
+						const vec this_r = P::sqrt(P::add(P::mul(P::sub(Xcom, vxk), P::sub(Xcom, vxk)), dy2));
+						if (DE != 0) {
+							w = P::div(w, pack_pow_runtime<P>(this_r, DE, DistanceExponent));
+						}
+						if (CUTOFF == LOGISTIC_CUTOFF) {
+							const vec e = pack_apply<P>(P::mul(CutoffFactor, P::sub(this_r, RadiusCutoff)), [](T v) { return exp(v); });
+							w = P::mul(w, P::div(one, P::add(one, e)));
+						}
+						else if (CUTOFF == TOPHAT_CUTOFF) {
+							w = P::keep_not_greater(w, this_r, RadiusCutoff);
+						}
+					}
+
+					// pixels excluded by the radius filter (w==0), or with a gradient of exactly zero, have no weight
+					const vec wg = P::mul(w, pack_pow_runtime<P>(P::mul(mag, GradScale), GE, GradientExponent));
+					const vec sqw_mag = P::keep_nonzero(P::keep_nonzero(P::div(P::sqrt(wg), mag), w), mag); //sqrt(w)/mag
+					w = P::keep_nonzero(P::keep_nonzero(wg, w), mag);
+					wx0 = P::mul(P::add(vdu, vdv), sqw_mag);
+					wx1 = P::mul(P::sub(vdv, vdu), sqw_mag);
+				}
+				else {
+					wx0 = P::div(P::add(vdu, vdv), mag);
+					wx1 = P::div(P::sub(vdv, vdu), mag);
+				}
+
+				if (CUTOFF != NO_CUTOFF) { //pixels outside the circle of a window (xi<xStart or xi>=xEnd) are not summed
+					const vec x0 = P::set1(T(xi));
+					const vec x1 = P::set1(T(xi + 1));
+					w = P::keep_not_greater(P::keep_not_greater(w, xStart, x0), x1, xEnd);
+					wx0 = P::keep_not_greater(P::keep_not_greater(wx0, xStart, x0), x1, xEnd);
+					wx1 = P::keep_not_greater(P::keep_not_greater(wx1, xStart, x0), x1, xEnd);
+				}
+
+				const vec wy = P::add(P::mul(vxk, wx0), P::mul(vyk, wx1));
+				const vec wyr = residual ? P::add(P::mul(P::sub(vxk, Xref), wx0), P::mul(P::sub(vyk, Yref), wx1)) : wy;
+
+				if (WEIGHTED) {
+					rsw2 = P::add(rsw2, P::mul(w, w));
+					rsw = P::add(rsw, w);
+				}
+
+				rA = P::add(rA, P::mul(wx0, wx0));
+				rD = P::add(rD, P::mul(wx1, wx1));
+				rB = P::add(rB, P::mul(wx0, wx1));
+
+				rXWy1 = P::add(rXWy1, P::mul(wx0, wy));
+				rXWy2 = P::add(rXWy2, P::mul(wx1, wy));
+
+				if (residual) {
+					rSyy = P::add(rSyy, P::mul(wyr, wyr));
+					rSXy1 = P::add(rSXy1, P::mul(wx0, wyr));
+					rSXy2 = P::add(rSXy2, P::mul(wx1, wyr));
+				}
+			}//end xi loop
+
+			// add the row to the sums of the windows
+			for (size_t h = 0; h < H; ++h) {
+				sw[h] = PD::add(sw[h], P::to_double(rsw, h));
+				sw2[h] = PD::add(sw2[h], P::to_double(rsw2, h));
+				A[h] = PD::add(A[h], P::to_double(rA, h));
+				B[h] = PD::add(B[h], P::to_double(rB, h));
+				D[h] = PD::add(D[h], P::to_double(rD, h));
+				XWy1[h] = PD::add(XWy1[h], P::to_double(rXWy1, h));
+				XWy2[h] = PD::add(XWy2[h], P::to_double(rXWy2, h));
+				Syy[h] = PD::add(Syy[h], P::to_double(rSyy, h));
+				SXy1[h] = PD::add(SXy1[h], P::to_double(rSXy1, h));
+				SXy2[h] = PD::add(SXy2[h], P::to_double(rSXy2, h));
+			}
+		}//end yi loop
+
+		for (size_t h = 0; h < H; ++h) {
+			const size_t o = h*PD::width;
+			PD::store(s.sw + o, sw[h]);
+			PD::store(s.sw2 + o, sw2[h]);
+			PD::store(s.A + o, A[h]);
+			PD::store(s.B + o, B[h]);
+			PD::store(s.D + o, D[h]);
+			PD::store(s.XWy1 + o, XWy1[h]);
+			PD::store(s.XWy2 + o, XWy2[h]);
+			PD::store(s.Syy + o, Syy[h]);
+			PD::store(s.SXy1 + o, SXy1[h]);
+			PD::store(s.SXy2 + o, SXy2[h]);
+		}
+		if (!WEIGHTED) { //every pixel has unit weight
+			for (size_t l = 0; l < L; ++l) {
+				s.sw[l] = double(dNx*dNy);
+				s.sw2[l] = double(dNx*dNy);
+			}
+		}
+	}
+
+	//! Compute the weighted least-squares sums of every window of a batch
+	//! selects the loop for s.weighted and s.cutoff
+	template<typename T>
+	void lane_weighted_sums(LaneWeightedSums<T>& s) {
+		lane_gradient_weight_scale(s);
+		if (!s.weighted) {
+			lane_weighted_sums_kernel<NO_CUTOFF, false>(s);
+			return;
+		}
+		switch (s.cutoff) {
+		case NO_CUTOFF:
+			lane_weighted_sums_kernel<NO_CUTOFF, true>(s);
+			break;
+		case TOPHAT_CUTOFF:
+			lane_weighted_sums_kernel<TOPHAT_CUTOFF, true>(s);
+			break;
+		case LOGISTIC_CUTOFF:
+			lane_weighted_sums_kernel<LOGISTIC_CUTOFF, true>(s);
+			break;
+		}
+	}
+}
@@ -6,7 +6,7 @@ All rights reserved.
 
 #include <mex.h>
 #include <extras/string_extras.hpp>
-#include "radialcenter.h"
+#include "radialcenter.hpp"
 
 #include <vector>
 #include <extras/Array.hpp>
@@ -15,7 +15,7 @@ All rights reserved.
 
 namespace extras{namespace ParticleTracking{
 
-    template<class OutContainerClass> //OutContainerClass must be and ArrayBase derived class with template type=double
+    template<class OutContainerClass, typename ComputeT = double> //OutContainerClass must be and ArrayBase derived class with template type=double
     std::vector<OutContainerClass> radialcenter(const mxArray* pI,
                                 const RadialcenterParameters& params = RadialcenterParameters())
     {
@@ -25,75 +25,93 @@ namespace extras{namespace ParticleTracking{
 		//Setup Output variables
 		//----------------------------
 		std::vector<OutContainerClass> out;
-		out.resize(4);
+		out.resize(5);
 
 		auto& x = out[0];
 		auto& y = out[1];
 		auto& varXY = out[2];
 		auto& RWR_N = out[3];
-        //auto& oXYc = out[4];
+		auto& Status = out[4];
 
-        //oXYc.resize(nPart,2);
-
-		// Resize output vars
+		// Resize output vars (outputs that are not requested in params.OutputMask are left empty)
 		x.resize(nPart, 1);
 		y.resize(nPart, 1);
 
-		varXY.resize(nPart, 2);
-		RWR_N.resize(nPart, 1);
+		double* pVarXY = nullptr;
+		double* pRWR_N = nullptr;
+		double* pStatus = nullptr;
+		if (params.OutputMask & rcdefs::OUTPUT_VARXY) {
+			varXY.resize(nPart, 2);
+			pVarXY = varXY.getdata();
+		}
+		if (params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+			RWR_N.resize(nPart, 1);
+			pRWR_N = RWR_N.getdata();
+		}
+		if (params.OutputMask & rcdefs::OUTPUT_STATUS) {
+			Status.resize(nPart, 1);
+			pStatus = Status.getdata();
+		}
+
+		// size of the image (for ROW_MAJOR_LAYOUT pI holds a row-major frame, i.e. the transposed image)
+		size_t nRows = mxGetM(pI);
+		size_t nCols = mxGetN(pI);
+		if (params.ImageLayout == rcdefs::ROW_MAJOR_LAYOUT) {
+			std::swap(nRows, nCols);
+		}
 
 		//Call radialcenter
 		//---------------------
         switch (mxGetClassID(pI)) { //handle different image types seperatelys
     	case mxDOUBLE_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(double*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(double*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxSINGLE_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(float*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(float*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxINT8_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(int8_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(int8_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxUINT8_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(uint8_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(uint8_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxINT16_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(int16_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(int16_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxUINT16_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(uint16_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(uint16_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxINT32_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(int32_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(int32_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxUINT32_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(uint32_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(uint32_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxINT64_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(int64_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(int64_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	case mxUINT64_CLASS:
-			radialcenter(x.getdata(), y.getdata(), varXY.getdata(), RWR_N.getdata(),
-				(uint64_t*)mxGetData(pI), mxGetM(pI), mxGetN(pI),
-				params);//,oXYc.getdata());
+			radialcenter<ComputeT>(x.getdata(), y.getdata(), pVarXY, pRWR_N,
+				(uint64_t*)mxGetData(pI), nRows, nCols,
+				params, pStatus);
 			break;
     	default:
     		throw(std::runtime_error("radialcenter: Only numeric image types allowed"));
@@ -102,22 +120,328 @@ namespace extras{namespace ParticleTracking{
 		return out;
     }
 
+    //! Collect pointers to the frames of an image stack (nRows x nCols x nFrames array, or cell array of frames)
+    //! All frames must be numeric with the same type and size
+    //! Returns the class of the frames and sets nRows, nCols
+    inline mxClassID radialcenter_stack_frames(const mxArray* pI, std::vector<const void*>& frames, size_t& nRows, size_t& nCols)
+    {
+        frames.clear();
+        if (mxIsCell(pI)) {
+            size_t nFrames = mxGetNumberOfElements(pI);
+            if (nFrames == 0) {
+                throw(std::runtime_error("radialcenter: image stack cannot be an empty cell"));
+            }
+            mxClassID cls = mxUNKNOWN_CLASS;
+            for (size_t f = 0; f < nFrames; ++f) {
+                const mxArray* pF = mxGetCell(pI, f);
+                if (pF == nullptr || !mxIsNumeric(pF) || mxIsComplex(pF) || mxGetNumberOfDimensions(pF) > 2) {
+                    throw(std::runtime_error("radialcenter: each cell of the image stack must be a real, 2D numeric image"));
+                }
+                if (f == 0) {
+                    cls = mxGetClassID(pF);
+                    nRows = mxGetM(pF);
+                    nCols = mxGetN(pF);
+                }
+                else if (mxGetClassID(pF) != cls || mxGetM(pF) != nRows || mxGetN(pF) != nCols) {
+                    throw(std::runtime_error("radialcenter: all frames in the image stack must have the same type and size"));
+                }
+                frames.push_back(mxGetData(pF));
+            }
+            return cls;
+        }
+
+        const mwSize* dims = mxGetDimensions(pI);
+        size_t nDims = mxGetNumberOfDimensions(pI);
+        nRows = dims[0];
+        nCols = dims[1];
+        size_t nFrames = 1;
+        for (size_t d = 2; d < nDims; ++d) {
+            nFrames *= dims[d];
+        }
+        const char* data = (const char*)mxGetData(pI);
+        for (size_t f = 0; f < nFrames; ++f) {
+            frames.push_back(data + f*nRows*nCols*mxGetElementSize(pI));
+        }
+        return mxGetClassID(pI);
+    }
+
+    //! call radialcenter_stack() with frames cast to M
+    template<typename ComputeT, typename M>
+    void radialcenter_stack_typed(double* x, double* y, double* varXY, double* RWR_N, double* Status,
+        const std::vector<const void*>& frames, size_t nRows, size_t nCols,
+        const RadialcenterParameters& params)
+    {
+        std::vector<const M*> typed_frames(frames.size());
+        for (size_t f = 0; f < frames.size(); ++f) {
+            typed_frames[f] = (const M*)frames[f];
+        }
+        radialcenter_stack<ComputeT>(x, y, varXY, RWR_N, typed_frames.data(), typed_frames.size(), nRows, nCols, params, Status);
+    }
+
+    //! Radial Center Detection for an image stack
+    //! pI is an nRows x nCols x nFrames numeric array, or a cell array of nRows x nCols frames
+    //! Outputs are x,y,RWR_N,Status: [nPart x nFrames] and varXY: [nPart x 2 x nFrames]
+    //! Frames are processed in parallel using params.nThreads
+    template<class OutContainerClass, typename ComputeT = double> //OutContainerClass must be and ArrayBase derived class with template type=double
+    std::vector<OutContainerClass> radialcenter_stack(const mxArray* pI,
+                                const RadialcenterParameters& params = RadialcenterParameters())
+    {
+		//number of particles to find
+		size_t nPart = std::max(std::max(size_t(1), params.nWIND),params.nXYc);
+
+		std::vector<const void*> frames;
+		size_t nRows, nCols;
+		mxClassID cls = radialcenter_stack_frames(pI, frames, nRows, nCols);
+		size_t nFrames = frames.size();
+		if (params.ImageLayout == rcdefs::ROW_MAJOR_LAYOUT) { //each frame is the transpose of the array's page
+			std::swap(nRows, nCols);
+		}
+
+		//Setup Output variables
+		//----------------------------
+		std::vector<OutContainerClass> out;
+		out.resize(5);
+
+		auto& x = out[0];
+		auto& y = out[1];
+		auto& varXY = out[2];
+		auto& RWR_N = out[3];
+		auto& Status = out[4];
+
+		// Resize output vars (outputs that are not requested in params.OutputMask are left empty)
+		x.resize(nPart, nFrames);
+		y.resize(nPart, nFrames);
+
+		double* pVarXY = nullptr;
+		double* pRWR_N = nullptr;
+		double* pStatus = nullptr;
+		if (params.OutputMask & rcdefs::OUTPUT_VARXY) {
+			varXY.resize({ nPart, 2, nFrames });
+			pVarXY = varXY.getdata();
+		}
+		if (params.OutputMask & rcdefs::OUTPUT_RWR_N) {
+			RWR_N.resize(nPart, nFrames);
+			pRWR_N = RWR_N.getdata();
+		}
+		if (params.OutputMask & rcdefs::OUTPUT_STATUS) {
+			Status.resize(nPart, nFrames);
+			pStatus = Status.getdata();
+		}
+
+		//Call radialcenter
+		//---------------------
+        switch (cls) { //handle different image types seperatelys
+    	case mxDOUBLE_CLASS:
+			radialcenter_stack_typed<ComputeT, double>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxSINGLE_CLASS:
+			radialcenter_stack_typed<ComputeT, float>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxINT8_CLASS:
+			radialcenter_stack_typed<ComputeT, int8_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxUINT8_CLASS:
+			radialcenter_stack_typed<ComputeT, uint8_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxINT16_CLASS:
+			radialcenter_stack_typed<ComputeT, int16_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxUINT16_CLASS:
+			radialcenter_stack_typed<ComputeT, uint16_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxINT32_CLASS:
+			radialcenter_stack_typed<ComputeT, int32_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxUINT32_CLASS:
+			radialcenter_stack_typed<ComputeT, uint32_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxINT64_CLASS:
+			radialcenter_stack_typed<ComputeT, int64_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	case mxUINT64_CLASS:
+			radialcenter_stack_typed<ComputeT, uint64_t>(x.getdata(), y.getdata(), pVarXY, pRWR_N, pStatus, frames, nRows, nCols, params);
+			break;
+    	default:
+    		throw(std::runtime_error("radialcenter: Only numeric image types allowed"));
+    	}
+
+		return out;
+    }
+
+    //! Set params.WIND from the MATLAB window array pWIND ([n x 4], [x,y,w,h], 1-indexed)
+    //! The windows are copied and shifted to 0-indexing
+    inline void radialcenter_set_window(const mxArray* pWIND, RadialcenterParameters_Shared& params)
+    {
+        std::shared_ptr<extras::Array<double>> WIND = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(pWIND));
+        if (!WIND->isempty()) {
+            if (WIND->nCols() != 4) {
+                throw(std::runtime_error("WIND must be [n x 4]"));
+            }
+            for (size_t n = 0; n < WIND->nRows(); ++n) { //fix 1-index --> 0-index
+                (*WIND)(n, 0) -= 1;
+                (*WIND)(n, 1) -= 1;
+            }
+        }
+        params.WIND = WIND;
+    }
+
+    //! OutputMask for a call with nlhs outputs [x,y,varXY,d2,status]
+    inline unsigned radialcenter_output_mask(int nlhs)
+    {
+        unsigned OutputMask = rcdefs::OUTPUT_XY;
+        if (nlhs > 2) {
+            OutputMask |= rcdefs::OUTPUT_VARXY;
+        }
+        if (nlhs > 3) {
+            OutputMask |= rcdefs::OUTPUT_RWR_N;
+        }
+        if (nlhs > 4) {
+            OutputMask |= rcdefs::OUTPUT_STATUS;
+        }
+        return OutputMask;
+    }
+
+    //! Parse the radialcenter Name,Value parameters prhs[0..nParams-1] into params
+    //! The values are copied, so params remains valid after the mex call returns (see RadialcenterContext).
+    //! XYc (and 'Window') are shifted to 0-indexing. 'Window' is only accepted if parse_window==true.
+    //! single_precision is set according to 'Precision'. params.OutputMask is not changed.
+    inline void radialcenter_parse_parameters(int nParams, const mxArray* prhs[], RadialcenterParameters_Shared& params, bool& single_precision, bool parse_window = true)
+    {
+		cmex::MxInputParser Parser(false); //create non-case sensitive input parser
+		Parser.AddParameter("RadiusCutoff",INFINITY); //default to no radius cutoff
+		Parser.AddParameter("CutoffFactor", INFINITY); //default to top-hat function
+		Parser.AddParameter("DistanceExponent", 1); //default to top-hat function
+		Parser.AddParameter("GradientExponent", 5); //default to top-hat function
+		Parser.AddParameter("XYc");
+		Parser.AddParameter("COMmethod", "gradmag");
+		Parser.AddParameter("nThreads", 1);
+		Parser.AddParameter("GradientKernel", "fused");
+		Parser.AddParameter("GradientCache", "none");
+		Parser.AddParameter("WeightKernelCache", 0);
+		Parser.AddParameter("IntegralImage", "none");
+		Parser.AddParameter("WindowOrder", "morton");
+		Parser.AddParameter("RefineIterations", 0);
+		Parser.AddParameter("RefineTolerance", 0.001);
+		Parser.AddParameter("Precision", "double");
+		Parser.AddParameter("ImageLayout", "column");
+		Parser.AddParameter("RejectMethod", "none");
+		Parser.AddParameter("RejectThreshold", 0);
+		Parser.AddParameter("PyramidLevels", 0);
+		Parser.AddParameter("PyramidWindow", 32);
+		Parser.AddParameter("LaneBatchSize", 0);
+		Parser.AddParameter("FixedSizeKernels", 1);
+		if(parse_window){
+			Parser.AddParameter("Window");
+		}
+
+		//parse parameters
+		if (nParams > 0) {
+			/// Parse value pair inputs
+			int res = Parser.Parse(nParams, prhs);
+			if (res != 0) {
+				throw(std::runtime_error("could not parse input parameters"));
+			}
+		}
+
+		params.RadiusCutoff = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(Parser("RadiusCutoff")));
+		params.CutoffFactor = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(Parser("CutoffFactor")));
+		params.DistanceExponent = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(Parser("DistanceExponent")));
+		params.GradientExponent = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(Parser("GradientExponent")));
+
+		std::shared_ptr<extras::Array<double>> XYc = std::make_shared<extras::Array<double>>(cmex::NumericArray<double>(Parser("XYc")));
+		*XYc -= 1;//shift from 1-indexing
+		params.XYc = XYc;
+
+		params.COMmethod = string2COMmethod(cmex::getstring(Parser("COMmethod")));
+
+		double nThreads = mxGetScalar(Parser("nThreads"));
+		if (!(nThreads >= 0)) {
+			throw(std::runtime_error("radialcenter: nThreads must be >=0"));
+		}
+		params.nThreads = (size_t)nThreads;
+
+		params.GradientKernel = string2GradientKernel(cmex::getstring(Parser("GradientKernel")));
+		params.GradientCache = string2GradientCache(cmex::getstring(Parser("GradientCache")));
+
+		double WeightKernelCache = mxGetScalar(Parser("WeightKernelCache"));
+		if (!(WeightKernelCache >= 0)) {
+			throw(std::runtime_error("radialcenter: WeightKernelCache must be >=0"));
+		}
+		params.WeightKernelCache = (size_t)WeightKernelCache;
+
+		params.IntegralImage = string2IntegralImage(cmex::getstring(Parser("IntegralImage")));
+		params.WindowOrder = string2WindowOrder(cmex::getstring(Parser("WindowOrder")));
+
+		double RefineIterations = mxGetScalar(Parser("RefineIterations"));
+		if (!(RefineIterations >= 0)) {
+			throw(std::runtime_error("radialcenter: RefineIterations must be >=0"));
+		}
+		params.RefineIterations = (size_t)RefineIterations;
+
+		params.RefineTolerance = mxGetScalar(Parser("RefineTolerance"));
+		if (!(params.RefineTolerance >= 0)) {
+			throw(std::runtime_error("radialcenter: RefineTolerance must be >=0"));
+		}
+
+		single_precision = string2SinglePrecision(cmex::getstring(Parser("Precision")));
+
+		params.ImageLayout = string2ImageLayout(cmex::getstring(Parser("ImageLayout")));
+
+		params.RejectMethod = string2RejectMethod(cmex::getstring(Parser("RejectMethod")));
+		params.RejectThreshold = mxGetScalar(Parser("RejectThreshold"));
+		if (!(params.RejectThreshold >= 0)) {
+			throw(std::runtime_error("radialcenter: RejectThreshold must be >=0"));
+		}
+
+		double PyramidLevels = mxGetScalar(Parser("PyramidLevels"));
+		if (!(PyramidLevels >= 0 && PyramidLevels <= 16)) {
+			throw(std::runtime_error("radialcenter: PyramidLevels must be between 0 and 16"));
+		}
+		params.PyramidLevels = (size_t)PyramidLevels;
+
+		double PyramidWindow = mxGetScalar(Parser("PyramidWindow"));
+		if (!(PyramidWindow >= 4)) {
+			throw(std::runtime_error("radialcenter: PyramidWindow must be >=4"));
+		}
+		params.PyramidWindow = (size_t)PyramidWindow;
+
+		double LaneBatchSize = mxGetScalar(Parser("LaneBatchSize"));
+		if (!(LaneBatchSize >= 0)) {
+			throw(std::runtime_error("radialcenter: LaneBatchSize must be >=0"));
+		}
+		params.LaneBatchSize = (size_t)LaneBatchSize;
+
+		const mxArray* pFixedSizeKernels = Parser("FixedSizeKernels");
+		if (mxGetNumberOfElements(pFixedSizeKernels) != 1 || !(mxIsNumeric(pFixedSizeKernels) || mxIsLogical(pFixedSizeKernels))) {
+			throw(std::runtime_error("radialcenter: FixedSizeKernels must be scalar logical"));
+		}
+		params.FixedSizeKernels = mxGetScalar(pFixedSizeKernels) != 0;
+
+		if (parse_window) {
+			radialcenter_set_window(Parser("Window"), params);
+		}
+    }
+
     /// Wrapper for radialcenter, accepting the standard arguments for a mexFunction
     /*
-    % [x,y,varXY,d2] = radialcenter(I,WIND)
+    % [x,y,varXY,d2,status] = radialcenter(I,WIND)
     %                = radialcenter(__,name,value);
     %
     % Estimate the center of radial symmetry of an image
     %
     % Input:
     %   I: the image to process
+    %       I can also be an image stack: [nRows x nCols x nFrames] array or cell array of [nRows x nCols] frames
+    %       all frames are processed using the same WIND (and parameters), in parallel using nThreads
     %   WIND: [N x 4] specifying windows [x,y,w,h], default is entire image
     %
     % Output:
     %   x,y: center positions
+    %       for an image stack x,y are [nPart x nFrames]
     %
     %   varXY: variance estimate of the fit
     %       varXY = [Vx,Vy], where Vx and Vy are the variances of each X and Y
+    %       for an image stack varXY is [nPart x 2 x nFrames] and d2 is [nPart x nFrames]
     %
     %   d2: the square of the weighted residual, normalized by the effective number of pixels
     %       d2>>1 indicates poor localization. This roughly characterizes the
@@ -128,6 +452,16 @@ namespace extras{namespace ParticleTracking{
     %      apparent symmetric center, while varXY is useful for characterizing the
     %      precision of the fit
     %
+    %   status: reason code for each window (same size as x)
+    %       0: window was fit
+    %       1: skipped, pixel contrast below RejectThreshold ('RejectMethod','contrast')
+    %       2: skipped, gradient below RejectThreshold ('RejectMethod','gradient')
+    %       3: fit failed, the center is not finite (e.g. the window has no gradient)
+    %       skipped windows return x,y,varXY,d2 = NaN
+    %
+    %   Only the requested outputs are computed: e.g. [x,y] = radialcenter(...) skips the
+    %   accumulation of the weighted residual that is needed for varXY and d2
+    %
     %
     % Name,Value Parameters:
     % -------------------------
@@ -142,6 +476,69 @@ namespace extras{namespace ParticleTracking{
     %       method='gradmag': use magnitude of image gradient to find COM (defalut)
     %   'DistanceExponent',value or [v1,v2,...,vN]: distance scaling from center guess Wii *= 1/r_guess^(DistanceExponent)
     %	'GradientExponent',value or [v1,v2,...,vN]: gradient scaling from center guess Wii *= |GradI_i|^(DistanceExponent)
+    %   'nThreads',n: number of threads used to process the windows (default=1)
+    %       n=0 uses all available processor threads
+    %   'GradientKernel','fused' or 'reference': implementation used to compute the smoothed gradient
+    %       'fused' (default): single-pass kernel (vectorized if compiled with AVX2/AVX-512 enabled)
+    %       'reference': original multi-pass implementation, results are identical
+    %           (up to rounding for uint8 and uint16 images, which 'fused' processes using integer arithmetic)
+    %   'GradientCache','none','shared', or 'auto': how the smoothed gradient is computed
+    %       'none' (default): gradient is computed separately for each window
+    %       'shared': gradient is computed once for the region covering all windows and reused by every window
+    %           faster when many windows overlap, but pixels on the edge of a window are smoothed
+    %           using their neighbors outside the window, so results differ slightly from 'none'
+    %       'auto': 'shared' if the windows overlap enough that it requires less computation, otherwise 'none'
+    %   'WeightKernelCache',Q: cache the distance dependent weights (default=0, no cache)
+    %       the center guess is rounded to 1/Q pixel and the weights for each sub-pixel offset are
+    %       computed once and reused by all windows (and frames) with the same parameters
+    %       Q>0 changes the result slightly (e.g. Q=16 moves the center guess by at most 1/32 px)
+    %   'IntegralImage','none','shared', or 'auto': how the center of mass (COMmethod) is found
+    %       'none' (default): the center of mass is summed over each window
+    %       'shared': a summed-area table and first moment images are computed once for the region
+    %           covering all windows, so the center of mass of each window costs the same regardless of its size
+    %           for 'gradmag' this requires the shared gradient (GradientCache), otherwise it is ignored
+    %       'auto': 'shared' if the windows overlap enough that it requires less computation, otherwise 'none'
+    %   'WindowOrder','morton' or 'input': order in which the windows are processed
+    %       'morton' (default): windows are sorted along a Z-order curve through the image, so consecutive
+    %           windows (and the windows handled by each thread) read neighboring parts of the frame
+    %       'input': windows are processed in the order they are listed
+    %       results are always returned in the order of WIND (and are identical for both orders)
+    %   'RefineIterations',N: number of refinement passes (default=0, no refinement)
+    %       each pass uses the previous solution as the center guess and shrinks the window
+    %       to the radius cutoff around it (RadiusCutoff, or the extent of the logistic cutoff)
+    %       the gradient of the original window is reused, so refinement never reads new pixels
+    %   'RefineTolerance',tol: stop refining once the center moves less than tol px (default=0.001)
+    %   'Precision','double' or 'single': floating point type used for the per-pixel calculations
+    %       'double' (default)
+    %       'single': gradient, weights and sums are computed in single precision (faster)
+    %           the sums of each row are added up in double and outputs are always double
+    %   'ImageLayout','column' or 'row': memory layout of I
+    %       'column' (default): I is the image (MATLAB's column-major order)
+    %       'row': I holds a row-major frame, e.g. a camera buffer that was not transposed (size(I)=[width,height])
+    %           the frame is tracked in place without a transpose pass; WIND, XYc and x,y refer to the frame,
+    %           and the results are the same as radialcenter(I.',...) up to rounding
+    %   'RejectMethod','none','contrast', or 'gradient': check used to skip windows that do not contain a particle
+    %       'none' (default): every window is fit
+    %       'contrast': windows with max(I)-min(I) < RejectThreshold are skipped before the gradient is computed
+    %       'gradient': windows with RMS smoothed gradient magnitude < RejectThreshold are skipped
+    %           before the center of mass, weights and fit are computed
+    %   'RejectThreshold',val: threshold used by RejectMethod, in intensity units of I (default=0)
+    %   'PyramidLevels',L: coarse-to-fine search for large windows (default=0, off)
+    %       the window is binned by 2^L x 2^L (fewer levels if the binned window would be smaller than 8x8 px)
+    %       and the center is located on the binned window, then the fit is repeated at full resolution on a
+    %       PyramidWindow sized window around it. Much faster for large ring patterns; the result differs
+    %       slightly from fitting the full window. GradientCache and IntegralImage are not used.
+    %   'PyramidWindow',w: size (px) of the full-resolution window used by PyramidLevels (default=32)
+    %       windows that are not larger than w are fit directly
+    %   'LaneBatchSize',w: windows up to w px (both width and height) are processed in batches of windows of the
+    %       same size, one window per SIMD lane (default=0, off). Much faster for many small windows (e.g. dense
+    %       single-molecule fields with w<=24); the results are the same as processing each window separately
+    %       (up to rounding). Only used with a single value of RadiusCutoff, CutoffFactor, DistanceExponent and
+    %       GradientExponent, COMmethod 'gradmag' (or valid XYc), GradientKernel 'fused', and without
+    %       GradientCache, IntegralImage, WeightKernelCache, RefineIterations, RejectMethod and PyramidLevels.
+    %   'FixedSizeKernels',tf: use the weight loops compiled for 32, 48 and 64 px windows when a window has one
+    %       of those sizes and the exponents are integers (default=true). The results are the same as with
+    %       false (the generic loop), up to rounding.
     */
     void radialcenter_mex(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     {
@@ -153,83 +550,42 @@ namespace extras{namespace ParticleTracking{
             return;
         }
 
-    	cmex::NumericArray<double> WIND;
+		RadialcenterParameters_Shared shared_params;
 		bool found_wind = false;
 
     	int ParamIndex = 1;
 
     	if (nrhs > 1 && !mxIsChar(prhs[1])) {
-    		WIND = prhs[1];
+    		radialcenter_set_window(prhs[1], shared_params);
     		ParamIndex = 2;
-
-            if(!WIND.isempty()){
-                if(WIND.nCols()!=4){
-                    throw(std::runtime_error("WIND must be [n x 4]"));
-                }
-                for(size_t n=0;n<WIND.nRows();++n){ //fix 1-index --> 0-index
-                    WIND(n,0)-= 1;
-                    WIND(n,1)-=1;
-                }
-            }
 			found_wind = true;
     	}
 
-		RadialcenterParameters params;
-		cmex::MxInputParser Parser(false); //create non-case sensitive input parser
-		Parser.AddParameter("RadiusCutoff",INFINITY); //default to no radius cutoff
-		Parser.AddParameter("CutoffFactor", INFINITY); //default to top-hat function
-		Parser.AddParameter("DistanceExponent", 1); //default to top-hat function
-		Parser.AddParameter("GradientExponent", 5); //default to top-hat function
-		Parser.AddParameter("XYc");
-		Parser.AddParameter("COMmethod", "gradmag");
-		if(!found_wind){
-			Parser.AddParameter("Window");
-		}
-
-		//parse parameters
-		if (ParamIndex < nrhs) {
-			/// Parse value pair inputs
-			int res = Parser.Parse(nrhs - ParamIndex, &prhs[ParamIndex]);
-			if (res != 0) {
-				throw(std::runtime_error("could not parse input parameters"));
-			}
-		}
-
-		cmex::NumericArray<double> RadiusCutoff(Parser("RadiusCutoff"));
-		params.RadiusCutoff = RadiusCutoff.getdata();
-		params.nRadiusCutoff = RadiusCutoff.numel();
-
-		cmex::NumericArray<double> CutoffFactor(Parser("CutoffFactor"));
-		params.CutoffFactor = CutoffFactor.getdata();
-		params.nCutoffFactor = CutoffFactor.numel();
+		bool single_precision;
+		radialcenter_parse_parameters(nrhs - ParamIndex, &prhs[ParamIndex], shared_params, single_precision, !found_wind);
 
-		cmex::NumericArray<double> DistanceExponent(Parser("DistanceExponent"));
-		params.DistanceExponent = DistanceExponent.getdata();
-		params.nDistanceExponent = DistanceExponent.numel();
+		// only compute the outputs that were requested (varXY and d2 need the weighted residual of every window)
+		shared_params.OutputMask = radialcenter_output_mask(nlhs);
 
-		cmex::NumericArray<double> GradientExponent(Parser("GradientExponent"));
-		params.GradientExponent = GradientExponent.getdata();
-		params.nGradientExponent = GradientExponent.numel();
-
-		cmex::NumericArray<double> XYc(Parser("XYc"));
-		XYc -= 1;//shift from 1-indexing
-		params.XYc = XYc.getdata();
-		params.nXYc = XYc.nRows();
-
-		params.COMmethod = string2COMmethod(cmex::getstring(Parser("COMmethod")));
-
-		if (!found_wind) {
-			WIND = Parser("Window");
-		}
-		if (!WIND.isempty()) {
-			assert_condition(WIND.nCols() == 4, "radialcenter(): WIND must have nCols==4");
-		}
-		params.WIND = WIND.getdata();
-		params.nWIND = WIND.nRows();
+		size_t nPart;
+		RadialcenterParameters params = radialcenter_parameters(shared_params, nPart);
 
     	//mexPrintf("About to run radial center...\n");
     	try {
-    		auto out = radialcenter<cmex::NumericArray<double>>(prhs[0], params);
+    		// 3D arrays and cell arrays are processed as a stack of frames
+    		bool is_stack = mxIsCell(prhs[0]) || mxGetNumberOfDimensions(prhs[0]) > 2;
+
+    		std::vector<cmex::NumericArray<double>> out;
+    		if (is_stack) {
+    			out = single_precision ?
+    				radialcenter_stack<cmex::NumericArray<double>, float>(prhs[0], params) :
+    				radialcenter_stack<cmex::NumericArray<double>, double>(prhs[0], params);
+    		}
+    		else {
+    			out = single_precision ?
+    				radialcenter<cmex::NumericArray<double>, float>(prhs[0], params) :
+    				radialcenter<cmex::NumericArray<double>, double>(prhs[0], params);
+    		}
 
     		if (nlhs > 0) {
     			out[0]+=1;
@@ -245,10 +601,9 @@ namespace extras{namespace ParticleTracking{
     		if (nlhs > 3) {
     			plhs[3] = out[3];
     		}
-            /*if(nlhs>4){ //oXYc
-                out[4]+=1; //shift back to 1-indexing
-                plhs[4] = out[4];
-            }*/
+    		if (nlhs > 4) {
+    			plhs[4] = out[4];
+    		}
     	}
     	catch (std::exception& e) {
     		mexErrMsgTxt(e.what());
@@ -0,0 +1,896 @@
+/*--------------------------------------------------
+Copyright 2018-2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+/*
+Weighted least-squares sums used by radialcenter_window()
+
+Each pixel of the window is weighted by
+	w = |grad(I)|^GradientExponent / r^DistanceExponent * cutoff(r)
+where cutoff(r) is either the logistic function 1/(1+exp(CutoffFactor*(r-RadiusCutoff)))
+or the top-hat function r<=RadiusCutoff.
+
+The per-pixel loop is instantiated for the common integer exponents (0,1,2,4,5)
+and for each type of cutoff, so that pow() is replaced by multiplications and the
+branches on the parameters are resolved at compile time.
+Other exponents use the generic (pow) implementation.
+The dispatch from the runtime parameters to the specialized loops is done by weighted_sums().
+
+Weight kernel cache:
+The distance dependent part of the weights (1/r^DistanceExponent * cutoff(r)) only depends
+on the parameters and on the position of the center guess relative to the pixel grid.
+If the center guess is quantized to 1/Q pixel, the weights (and the circle bounds) can be
+precomputed once for each sub-pixel offset and reused for every window with the same parameters.
+WeightKernelCache holds those kernels; weighted_sums_cached() uses them so that the per-pixel loop
+only needs the gradient weight.
+
+Fixed window sizes:
+Gradients of 31x31, 47x47 and 63x63 px (32, 48 and 64 px windows) use loops compiled for that size
+(weighted_sums_fixed_kernel<N>()). The per-pixel weights are computed for a strip of rows at a time with
+the SIMD packs of smoothgrad_simd.h, into fixed-size stack buffers, and then summed in the same order as
+the generic loop. Other sizes (and non-integer exponents) use the generic loop.
+
+Single precision:
+The per-pixel values are summed in the compute type T one row at a time (WeightedRowSums), and the row
+totals are added to the double sums of WeightedSums, so the inner loops do not convert every pixel to double.
+The solution does not depend on a common scale of the weights, so for float the gradient magnitude is divided
+by its maximum over the window (WeightedSums::GradScale, see gradient_weight_scale()) before it is raised to
+GradientExponent. This keeps |grad(I)|^GradientExponent (and its square) within the range of float for any
+pixel type. Double windows are not scaled.
+
+Residual:
+The residual of the fit, sum_i (wy_i - wx0_i*x - wx1_i*y)^2, is found from moments accumulated in the
+same loop, so the per-pixel values do not need to be stored and read back. To limit cancellation the
+moments are taken about a reference point (Xref,Yref) close to the solution (the center guess):
+	RWR = Syy - 2*(dx*SXy1 + dy*SXy2) + dx^2*A + 2*dx*dy*B + dy^2*D,  dx=x-Xref, dy=y-Yref
+where Syy, SXy1, SXy2 are the sums of wy'^2, wx0*wy', wx1*wy' with wy' = wx0*(xk-Xref) + wx1*(yk-Yref).
+*/
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+
+#include "smoothgrad_simd.h"
+
+namespace rcdefs {
+
+	//! type of radius cutoff applied to the weights
+	enum RADIUS_CUTOFF {
+		NO_CUTOFF, //sum over the entire window
+		TOPHAT_CUTOFF, //sum over the circle r<=RadiusCutoff
+		LOGISTIC_CUTOFF //sum over the circle r<=RadExtents, weights scaled by logistic function
+	};
+
+	//! exponent template parameter used for non-integer exponents
+	static const int GENERIC_EXPONENT = -1;
+
+	//! returns the specialized exponent for e, or GENERIC_EXPONENT
+	inline int integer_exponent(double e) {
+		if (e == 0) return 0;
+		if (e == 1) return 1;
+		if (e == 2) return 2;
+		if (e == 4) return 4;
+		if (e == 5) return 5;
+		return GENERIC_EXPONENT;
+	}
+
+	//! v^E for exponents known at compile time
+	//! the generic version uses pow(v,e)
+	template<int E> struct int_pow {
+		template<typename T> static T eval(T v, T e) { return std::pow(v, e); }
+	};
+	template<> struct int_pow<0> {
+		template<typename T> static T eval(T, T) { return T(1); }
+	};
+	template<> struct int_pow<1> {
+		template<typename T> static T eval(T v, T) { return v; }
+	};
+	template<> struct int_pow<2> {
+		template<typename T> static T eval(T v, T) { return v*v; }
+	};
+	template<> struct int_pow<4> {
+		template<typename T> static T eval(T v, T) { T v2 = v*v; return v2*v2; }
+	};
+	template<> struct int_pow<5> {
+		template<typename T> static T eval(T v, T) { T v2 = v*v; return v2*v2*v; }
+	};
+
+	//! apply the scalar function f to each element of the SIMD pack v (P is a simd::pack)
+	template<class P, class F>
+	typename P::type pack_apply(typename P::type v, F f) {
+		alignas(64) typename P::value_type tmp[P::width];
+		P::store(tmp, v);
+		for (size_t k = 0; k < P::width; ++k) {
+			tmp[k] = f(tmp[k]);
+		}
+		return P::load(tmp);
+	}
+
+	//! int_pow for SIMD packs, same operations as int_pow<E>
+	template<int E> struct pack_pow {
+		template<class P> static typename P::type eval(typename P::type v, typename P::value_type e) {
+			return pack_apply<P>(v, [e](typename P::value_type x) { return std::pow(x, e); });
+		}
+	};
+	template<> struct pack_pow<0> {
+		template<class P> static typename P::type eval(typename P::type, typename P::value_type) { return P::set1(1); }
+	};
+	template<> struct pack_pow<1> {
+		template<class P> static typename P::type eval(typename P::type v, typename P::value_type) { return v; }
+	};
+	template<> struct pack_pow<2> {
+		template<class P> static typename P::type eval(typename P::type v, typename P::value_type) { return P::mul(v, v); }
+	};
+	template<> struct pack_pow<4> {
+		template<class P> static typename P::type eval(typename P::type v, typename P::value_type) { typename P::type v2 = P::mul(v, v); return P::mul(v2, v2); }
+	};
+	template<> struct pack_pow<5> {
+		template<class P> static typename P::type eval(typename P::type v, typename P::value_type) { typename P::type v2 = P::mul(v, v); return P::mul(P::mul(v2, v2), v); }
+	};
+
+	//! Columns [xStart,xEnd) of the pixels of a row (pixel xi is centered at xi+0.5) that are within xr of xc,
+	//! clipped to [0,n). Same test as the rows (dy2<=RE2), so the circle is symmetric in x and y.
+	template<typename T>
+	inline void circle_columns(T xc, T xr, size_t n, size_t& xStart, size_t& xEnd) {
+		using std::max;
+		using std::min;
+		xStart = (size_t)max(T(0), std::ceil(xc - xr - T(0.5)));
+		xEnd = (size_t)max(T(0), min((T)n, std::floor(xc + xr - T(0.5)) + T(1)));
+	}
+
+	//! Weighted least-squares sums of one row of a window, accumulated in the compute type T
+	template<typename T>
+	struct WeightedRowSums {
+		T sw = 0;
+		T sw2 = 0;
+		T A = 0;
+		T B = 0;
+		T D = 0;
+		T XWy1 = 0;
+		T XWy2 = 0;
+		T Syy = 0;
+		T SXy1 = 0;
+		T SXy2 = 0;
+
+		//! add a pixel with weight w, weighted gradient direction (wx0,wx1) and wy = xk*wx0 + yk*wx1
+		void add(T w, T wx0, T wx1, T wy) {
+			sw2 += w * w;
+			sw += w;
+			A += wx0 * wx0;
+			D += wx1 * wx1;
+			B += wx0 * wx1;
+			XWy1 += wx0 * wy;
+			XWy2 += wx1 * wy;
+		}
+
+		//! add the residual moments of a pixel, wyr = (xk-Xref)*wx0 + (yk-Yref)*wx1
+		void add_residual(T wx0, T wx1, T wyr) {
+			Syy += wyr * wyr;
+			SXy1 += wx0 * wyr;
+			SXy2 += wx1 * wyr;
+		}
+
+		//! add the row totals to the sums s (WeightedSums, or the double sums of a kernel)
+		template<class S>
+		void add_to(S& s) const {
+			s.sw += sw;
+			s.sw2 += sw2;
+			s.A += A;
+			s.B += B;
+			s.D += D;
+			s.XWy1 += XWy1;
+			s.XWy2 += XWy2;
+			s.Syy += Syy;
+			s.SXy1 += SXy1;
+			s.SXy2 += SXy2;
+		}
+	};
+
+	//! Inputs and outputs of the weighted least-squares loop
+	//! T is the compute type of the per-pixel values and of the sums of each row,
+	//! the sums of the window are accumulated in double (see Single precision above)
+	template<typename T>
+	struct WeightedSums {
+		// gradient, du(yi,xi) = du[yi + xi*gStride]
+		const T* du;
+		const T* dv;
+		size_t gStride;
+
+		const T* GradMag; //gradient magnitude (dNy x dNx), only used if calced_grad_mag==true
+		bool calced_grad_mag;
+
+		bool residual; //accumulate the moments used to compute the residual (Syy, SXy1, SXy2)
+		T Xref; //reference point of the residual moments, relative to the window
+		T Yref;
+
+		size_t dNx; //window size
+		size_t dNy;
+
+		T Xcom; //center guess, relative to the window
+		T Ycom;
+		T RE2; //square of the radius around the center that is summed over
+		T RadiusCutoff;
+		T CutoffFactor;
+		T DistanceExponent;
+		T GradientExponent;
+		T GradScale = 1; //the weights use |grad(I)|*GradScale, see gradient_weight_scale()
+
+		// sums
+		double sw = 0;
+		double sw2 = 0;
+		double A = 0;
+		double B = 0;
+		double D = 0;
+		double XWy1 = 0;
+		double XWy2 = 0;
+
+		// residual moments about (Xref,Yref)
+		double Syy = 0;
+		double SXy1 = 0;
+		double SXy2 = 0;
+	};
+
+	//! Scale of the gradient magnitude in the weights (WeightedSums::GradScale) of a window
+	//! float: 1/max|grad(I)| over the pixels within RE2 of the center guess (with a margin for the quantized
+	//! center of the cached kernels), so the gradient weights are <=1 (see Single precision above)
+	//! double, or weights that do not depend on the gradient: 1
+	template<typename T>
+	T gradient_weight_scale(const WeightedSums<T>& s) {
+		typedef simd::pack<T> P;
+		if (s.GradientExponent == 0) {
+			return 1;
+		}
+
+		// bounding box of the pixels that are summed
+		size_t x0 = 0;
+		size_t x1 = s.dNx;
+		size_t y0 = 0;
+		size_t y1 = s.dNy;
+		const T RE = std::sqrt(s.RE2) + 2;
+		if (std::isfinite(RE) && std::isfinite(s.Xcom) && std::isfinite(s.Ycom)) {
+			x0 = (size_t)std::max(T(0), s.Xcom - RE);
+			x1 = (size_t)std::max(T(0), std::min((T)s.dNx, s.Xcom + RE));
+			y0 = (size_t)std::max(T(0), s.Ycom - RE);
+			y1 = (size_t)std::max(T(0), std::min((T)s.dNy, s.Ycom + RE));
+		}
+
+		typename P::type vm2 = P::set1(0);
+		T m2 = 0; //max |grad(I)|^2
+		for (size_t xi = x0; xi < x1; ++xi) {
+			size_t yi = y0;
+			if (s.calced_grad_mag) {
+				const T* gm = s.GradMag + xi*s.dNy;
+				for (; yi + P::width <= y1; yi += P::width) {
+					const typename P::type g = P::load(gm + yi);
+					vm2 = P::max(vm2, P::mul(g, g));
+				}
+				for (; yi < y1; ++yi) {
+					m2 = std::max(m2, gm[yi] * gm[yi]);
+				}
+			}
+			else {
+				const T* du = s.du + xi*s.gStride;
+				const T* dv = s.dv + xi*s.gStride;
+				for (; yi + P::width <= y1; yi += P::width) {
+					const typename P::type vdu = P::load(du + yi);
+					const typename P::type vdv = P::load(dv + yi);
+					vm2 = P::max(vm2, P::add(P::mul(vdu, vdu), P::mul(vdv, vdv)));
+				}
+				for (; yi < y1; ++yi) {
+					m2 = std::max(m2, du[yi] * du[yi] + dv[yi] * dv[yi]);
+				}
+			}
+		}
+		alignas(64) T buf[P::width];
+		P::store(buf, vm2);
+		for (size_t k = 0; k < P::width; ++k) {
+			m2 = std::max(m2, buf[k]);
+		}
+
+		const T m = std::sqrt(m2);
+		return (m > 0 && std::isfinite(m)) ? T(1) / m : T(1);
+	}
+	inline double gradient_weight_scale(const WeightedSums<double>&) {
+		return 1;
+	}
+
+	//! Residual of the least-squares solution (x,y) from the sums s (see Residual above)
+	//! A, B, D are the sums before they are divided by the determinant
+	inline double weighted_residual(double x, double y, double Xref, double Yref,
+		double A, double B, double D, double Syy, double SXy1, double SXy2)
+	{
+		const double dx = x - Xref;
+		const double dy = y - Yref;
+		const double RWR = Syy - 2 * (dx*SXy1 + dy*SXy2) + dx*dx*A + 2 * dx*dy*B + dy*dy*D;
+		return RWR > 0 ? RWR : 0; //rounding can make a perfect fit slightly negative
+	}
+
+	//! weighted least-squares loop for DistanceExponent=DE, GradientExponent=GE and cutoff type CUTOFF
+	//! with CUTOFF==NO_CUTOFF and DE==0 the weights only depend on the gradient magnitude
+	template<int DE, int GE, int CUTOFF, typename T>
+	void weighted_sums_kernel(WeightedSums<T>& s) {
+		using namespace std;
+
+		const size_t dNy = s.dNy;
+		const size_t dNx = s.dNx;
+
+		for (size_t yi = 0; yi < dNy; ++yi) {
+			T yk = yi + T(0.5); // y coordinate
+			T dy2 = (s.Ycom - yk)*(s.Ycom - yk); //square of y-component of radius
+
+			size_t xStart = 0;
+			size_t xEnd = dNx;
+			if (CUTOFF != NO_CUTOFF) { //using radius cutoff, only sum over circle
+				if (dy2 > s.RE2) { //row does not intersect the circle
+					continue;
+				}
+				T xr = sqrt(s.RE2 - dy2); //x-component of the radius
+				circle_columns(s.Xcom, xr, dNx, xStart, xEnd);
+			}
+
+			WeightedRowSums<T> row;
+			for (size_t xi = xStart; xi < xEnd; ++xi) {
+				size_t ind = yi + xi * dNy; //index of pixel at coordinate xi,yi
+				size_t gind = yi + xi * s.gStride; //index of pixel in gradient
+				T xk = xi + T(0.5); //x coordinate
+
+				T sqw_mag; //sqrt(w)/mag
+				T mag; //|grad(I)|
+				T w = 1; //weight factor
+
+				if (CUTOFF == LOGISTIC_CUTOFF || DE != 0) { //need to compute radius
+					T this_r = sqrt((s.Xcom - xk)*(s.Xcom - xk) + dy2);
+					if (DE != 0) {
+						w /= int_pow<DE>::eval(this_r, s.DistanceExponent);
+					}
+					if (CUTOFF == LOGISTIC_CUTOFF) {
+						w *= T(1.0) / (T(1.0) + exp(s.CutoffFactor*(this_r - s.RadiusCutoff)));
+					}
+					else if (CUTOFF == TOPHAT_CUTOFF) {
+						if (this_r > s.RadiusCutoff) {
+							w = 0;
+						}
+					}
+				}
+
+				if (w != 0) { //haven't been excluded by radius filter yet
+					//calc mag^2, sqrt(w)/mag, w
+					if (!s.calced_grad_mag) {
+						mag = sqrt(s.du[gind] * s.du[gind] + s.dv[gind] * s.dv[gind]);
+					}
+					else {
+						mag = s.GradMag[ind];
+					}
+
+					if (mag == 0) { //special case when gradient was exactly zero (probably rare)
+						sqw_mag = 0;
+						w = 0;
+					}
+					else {
+						w *= int_pow<GE>::eval(mag*s.GradScale, s.GradientExponent); //weight factor;
+						sqw_mag = sqrt(w) / mag;
+					}
+				}
+				else {
+					sqw_mag = 0;
+				}
+
+				const T wx0 = (s.du[gind] + s.dv[gind])*sqw_mag;
+				const T wx1 = (s.dv[gind] - s.du[gind])*sqw_mag;
+				const T wy = xk * wx0 + yk * wx1;
+
+				row.add(w, wx0, wx1, wy);
+				if (s.residual) {
+					row.add_residual(wx0, wx1, (xk - s.Xref) * wx0 + (yk - s.Yref) * wx1);
+				}
+			}//end xi loop
+			row.add_to(s);
+		}//end yi loop
+	}
+
+	///////////////////////////////////////////////////
+	// Fixed window sizes
+
+	//! number of rows of the window processed at a time by weighted_sums_fixed_kernel()
+	//! (a multiple of the widest SIMD vector, 16 floats)
+	static const size_t FIXED_STRIP_ROWS = 16;
+
+	//! weighted least-squares loop for a N x N gradient (a (N+1) x (N+1) px window)
+	//! The window is processed in strips of FIXED_STRIP_ROWS rows: the per-pixel weights and wx0, wx1 of a strip
+	//! are first computed column by column with SIMD packs (the columns are contiguous in the gradient) into
+	//! stack buffers, and then added to the sums row by row.
+	//! The last strip is aligned to the bottom of the window (overlapping the previous strip), so every strip is full.
+	//! The per-pixel operations and the order of the sums are the same as weighted_sums_kernel<DE,GE,CUTOFF>(),
+	//! so the results are identical unless the compiler fuses multiply-adds (e.g. gcc -march=native) differently
+	//! in the two loops, in which case they can differ by rounding.
+	template<size_t N, int DE, int GE, int CUTOFF, typename T>
+	void weighted_sums_fixed_kernel(WeightedSums<T>& s) {
+		using namespace std;
+		typedef simd::pack<T> P;
+		typedef typename P::type vec;
+		const size_t R = FIXED_STRIP_ROWS;
+		static_assert(N >= R, "weighted_sums_fixed_kernel: window must have at least FIXED_STRIP_ROWS rows");
+		static_assert(R % P::width == 0, "weighted_sums_fixed_kernel: FIXED_STRIP_ROWS must be a multiple of the SIMD width");
+
+		// strip buffers, pixel (y0+r, xi) is at [r + xi*R]
+		alignas(64) T wbuf[R*N];
+		alignas(64) T wx0buf[R*N];
+		alignas(64) T wx1buf[R*N];
+		alignas(64) T yk[R];
+		alignas(64) T dy2[R];
+		size_t xStart[R];
+		size_t xEnd[R];
+
+		// parameters are copied to locals, so the compiler knows they are not changed by the stores to the buffers
+		const bool residual = s.residual;
+		const bool calced_grad_mag = s.calced_grad_mag;
+		const size_t gStride = s.gStride;
+		const T Xcom = s.Xcom;
+		const T Ycom = s.Ycom;
+		const T Xref = s.Xref;
+		const T Yref = s.Yref;
+		const T RE2 = s.RE2;
+		const T RadiusCutoff = s.RadiusCutoff;
+		const T CutoffFactor = s.CutoffFactor;
+		const T DistanceExponent = s.DistanceExponent;
+		const T GradientExponent = s.GradientExponent;
+		const vec GradScale = P::set1(s.GradScale);
+		WeightedRowSums<double> sums;
+
+		size_t yDone = 0; //rows already added to the sums
+		for (size_t strip = 0; strip < (N + R - 1) / R; ++strip) {
+			const size_t y0 = min(strip*R, N - R);
+			const size_t r0 = yDone - y0; //first row of the strip that has not been added yet
+			yDone = y0 + R;
+
+			// columns summed in each row (same bounds as weighted_sums_kernel)
+			size_t xLo = N;
+			size_t xHi = 0;
+			for (size_t r = 0; r < R; ++r) {
+				yk[r] = (y0 + r) + T(0.5);
+				dy2[r] = (Ycom - yk[r])*(Ycom - yk[r]);
+				xStart[r] = 0;
+				xEnd[r] = N;
+				if (CUTOFF != NO_CUTOFF) {
+					if (dy2[r] > RE2) { //row does not intersect the circle
+						xEnd[r] = 0;
+					}
+					else {
+						T xr = sqrt(RE2 - dy2[r]);
+						circle_columns(Xcom, xr, N, xStart[r], xEnd[r]);
+					}
+				}
+				if (r >= r0 && xStart[r] < xEnd[r]) {
+					xLo = min(xLo, xStart[r]);
+					xHi = max(xHi, xEnd[r]);
+				}
+			}
+
+			// per-pixel weights of the strip
+			for (size_t xi = xLo; xi < xHi; ++xi) {
+				const T* du = s.du + y0 + xi*gStride;
+				const T* dv = s.dv + y0 + xi*gStride;
+				const T* gm = calced_grad_mag ? s.GradMag + y0 + xi*N : nullptr;
+				const vec dx = P::set1(Xcom - (xi + T(0.5))); //x-component of the radius
+
+				for (size_t r = 0; r < R; r += P::width) {
+					const vec vdu = P::load(du + r);
+					const vec vdv = P::load(dv + r);
+					const vec mag = calced_grad_mag ? P::load(gm + r) : P::sqrt(P::add(P::mul(vdu, vdu), P::mul(vdv, vdv))); //|grad(I)|
+
+					vec w = P::set1(1); //weight factor
+					if (CUTOFF == LOGISTIC_CUTOFF || DE != 0) { //need to compute radius
+						const vec this_r = P::sqrt(P::add(P::mul(dx, dx), P::load(dy2 + r)));
+						if (DE != 0) {
+							w = P::div(w, pack_pow<DE>::template eval<P>(this_r, DistanceExponent));
+						}
+						if (CUTOFF == LOGISTIC_CUTOFF) {
+							const vec e = pack_apply<P>(P::mul(P::set1(CutoffFactor), P::sub(this_r, P::set1(RadiusCutoff))), [](T v) { return exp(v); });
+							w = P::mul(w, P::div(P::set1(1), P::add(P::set1(1), e)));
+						}
+						else if (CUTOFF == TOPHAT_CUTOFF) {
+							w = P::keep_not_greater(w, this_r, P::set1(RadiusCutoff));
+						}
+					}
+
+					// pixels excluded by the radius filter (w==0), or with a gradient of exactly zero, have no weight
+					const vec wg = P::mul(w, pack_pow<GE>::template eval<P>(P::mul(mag, GradScale), GradientExponent));
+					const vec sqw_mag = P::keep_nonzero(P::keep_nonzero(P::div(P::sqrt(wg), mag), w), mag); //sqrt(w)/mag
+					P::store(wbuf + r + xi*R, P::keep_nonzero(P::keep_nonzero(wg, w), mag));
+					P::store(wx0buf + r + xi*R, P::mul(P::add(vdu, vdv), sqw_mag));
+					P::store(wx1buf + r + xi*R, P::mul(P::sub(vdv, vdu), sqw_mag));
+				}
+			}
+
+			// add the rows of the strip to the sums
+			for (size_t r = r0; r < R; ++r) {
+				WeightedRowSums<T> row;
+				for (size_t xi = xStart[r]; xi < xEnd[r]; ++xi) {
+					const T w = wbuf[r + xi*R];
+					const T wx0 = wx0buf[r + xi*R];
+					const T wx1 = wx1buf[r + xi*R];
+					const T xk = xi + T(0.5); //x coordinate
+					const T wy = xk * wx0 + yk[r] * wx1;
+
+					row.add(w, wx0, wx1, wy);
+					if (residual) {
+						row.add_residual(wx0, wx1, (xk - Xref) * wx0 + (yk[r] - Yref) * wx1);
+					}
+				}
+				row.add_to(sums);
+			}
+		}
+
+		sums.add_to(s);
+	}
+
+	//! loop used by the dispatch functions below
+	//! N=0: weighted_sums_kernel() (any window size), otherwise weighted_sums_fixed_kernel<N>()
+	template<size_t N> struct weighted_sums_loop {
+		template<int DE, int GE, int CUTOFF, typename T>
+		static void run(WeightedSums<T>& s) { weighted_sums_fixed_kernel<N, DE, GE, CUTOFF>(s); }
+	};
+	template<> struct weighted_sums_loop<0> {
+		template<int DE, int GE, int CUTOFF, typename T>
+		static void run(WeightedSums<T>& s) { weighted_sums_kernel<DE, GE, CUTOFF>(s); }
+	};
+
+	//! non-integer exponents always use the generic loop (pow() is evaluated element by element,
+	//! so a fixed-size loop would not be faster)
+	template<size_t N, int DE, int GE, typename T>
+	void weighted_sums_cutoff(WeightedSums<T>& s, RADIUS_CUTOFF cutoff) {
+		typedef weighted_sums_loop<(DE == GENERIC_EXPONENT || GE == GENERIC_EXPONENT) ? 0 : N> loop;
+		switch (cutoff) {
+		case NO_CUTOFF:
+			loop::template run<DE, GE, NO_CUTOFF>(s);
+			break;
+		case TOPHAT_CUTOFF:
+			loop::template run<DE, GE, TOPHAT_CUTOFF>(s);
+			break;
+		case LOGISTIC_CUTOFF:
+			loop::template run<DE, GE, LOGISTIC_CUTOFF>(s);
+			break;
+		}
+	}
+
+	template<size_t N, int DE, typename T>
+	void weighted_sums_gradexp(WeightedSums<T>& s, RADIUS_CUTOFF cutoff) {
+		switch (integer_exponent(s.GradientExponent)) {
+		case 0:
+			weighted_sums_cutoff<N, DE, 0>(s, cutoff);
+			break;
+		case 1:
+			weighted_sums_cutoff<N, DE, 1>(s, cutoff);
+			break;
+		case 2:
+			weighted_sums_cutoff<N, DE, 2>(s, cutoff);
+			break;
+		case 4:
+			weighted_sums_cutoff<N, DE, 4>(s, cutoff);
+			break;
+		case 5:
+			weighted_sums_cutoff<N, DE, 5>(s, cutoff);
+			break;
+		default:
+			weighted_sums_cutoff<N, DE, GENERIC_EXPONENT>(s, cutoff);
+		}
+	}
+
+	template<size_t N, typename T>
+	void weighted_sums_distexp(WeightedSums<T>& s, RADIUS_CUTOFF cutoff) {
+		switch (integer_exponent(s.DistanceExponent)) {
+		case 0:
+			weighted_sums_gradexp<N, 0>(s, cutoff);
+			break;
+		case 1:
+			weighted_sums_gradexp<N, 1>(s, cutoff);
+			break;
+		case 2:
+			weighted_sums_gradexp<N, 2>(s, cutoff);
+			break;
+		case 4:
+			weighted_sums_gradexp<N, 4>(s, cutoff);
+			break;
+		case 5:
+			weighted_sums_gradexp<N, 5>(s, cutoff);
+			break;
+		default:
+			weighted_sums_gradexp<N, GENERIC_EXPONENT>(s, cutoff);
+		}
+	}
+
+	//! Compute the weighted least-squares sums
+	//! selects the loop specialized for s.DistanceExponent, s.GradientExponent and cutoff.
+	//! If fixed_size==true, the gradient is 31x31, 47x47 or 63x63 (32, 48 or 64 px windows) and both exponents
+	//! are integers (see integer_exponent()) the loop compiled for that size is used (the results are the same).
+	template<typename T>
+	void weighted_sums(WeightedSums<T>& s, RADIUS_CUTOFF cutoff, bool fixed_size = true) {
+		if (fixed_size && s.dNx == s.dNy) {
+			switch (s.dNx) {
+			case 31:
+				weighted_sums_distexp<31>(s, cutoff);
+				return;
+			case 47:
+				weighted_sums_distexp<47>(s, cutoff);
+				return;
+			case 63:
+				weighted_sums_distexp<63>(s, cutoff);
+				return;
+			}
+		}
+		weighted_sums_distexp<0>(s, cutoff);
+	}
+
+	///////////////////////////////////////////////////
+	// Weight kernel cache
+
+	//! parameters identifying a radial weight kernel
+	struct WeightKernelKey {
+		int cutoff; //RADIUS_CUTOFF
+		long K; //kernel covers offsets -K...K
+		long Q; //number of sub-pixel steps per pixel
+		long fx; //sub-pixel offset of center (in steps of 1/Q)
+		long fy;
+		double RadiusCutoff;
+		double CutoffFactor;
+		double DistanceExponent;
+		double RadExtents;
+
+		bool operator==(const WeightKernelKey& o) const {
+			return cutoff == o.cutoff && K == o.K && Q == o.Q && fx == o.fx && fy == o.fy &&
+				RadiusCutoff == o.RadiusCutoff && CutoffFactor == o.CutoffFactor &&
+				DistanceExponent == o.DistanceExponent && RadExtents == o.RadExtents;
+		}
+	};
+
+	struct WeightKernelKeyHash {
+		size_t operator()(const WeightKernelKey& k) const {
+			size_t h = std::hash<long>()(k.cutoff);
+			auto combine = [&h](size_t v) { h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+			combine(std::hash<long>()(k.K));
+			combine(std::hash<long>()(k.Q));
+			combine(std::hash<long>()(k.fx));
+			combine(std::hash<long>()(k.fy));
+			combine(std::hash<double>()(k.RadiusCutoff));
+			combine(std::hash<double>()(k.CutoffFactor));
+			combine(std::hash<double>()(k.DistanceExponent));
+			combine(std::hash<double>()(k.RadExtents));
+			return h;
+		}
+	};
+
+	//! precomputed distance weights for a center at sub-pixel offset (fx,fy) of pixel (ix,iy)
+	//! weight of pixel (ix+ox, iy+oy) is w[(ox+K) + (oy+K)*N], N=2K+1
+	//! pixels of row oy inside the circle are ox = lo[oy+K] ... hi[oy+K]-1
+	template<typename T>
+	struct RadialWeightKernel {
+		long K = 0;
+		long N = 0;
+		std::vector<T> w;
+		std::vector<long> lo;
+		std::vector<long> hi;
+
+		size_t bytes() const {
+			return w.size() * sizeof(T) + (lo.size() + hi.size()) * sizeof(long);
+		}
+
+		void build(const WeightKernelKey& key) {
+			using namespace std;
+			K = key.K;
+			N = 2 * K + 1;
+			w.assign(N*N, T(0));
+			lo.assign(N, 0);
+			hi.assign(N, 0);
+
+			const T fx = T(key.fx) / T(key.Q);
+			const T fy = T(key.fy) / T(key.Q);
+			const T RE2 = T(key.RadExtents)*T(key.RadExtents);
+			const T RadiusCutoff = T(key.RadiusCutoff);
+			const T CutoffFactor = T(key.CutoffFactor);
+			const T DistanceExponent = T(key.DistanceExponent);
+
+			for (long oy = -K; oy <= K; ++oy) {
+				T dy = fy - (oy + T(0.5));
+				T dy2 = dy*dy;
+				long row = oy + K;
+
+				if (key.cutoff != NO_CUTOFF) { //only pixels inside circle
+					if (dy2 > RE2) {
+						continue;
+					}
+					T xr = sqrt(RE2 - dy2);
+					lo[row] = max(-K, (long)ceil(fx - xr - T(0.5))); //same columns as circle_columns()
+					hi[row] = min(K + 1, (long)floor(fx + xr - T(0.5)) + 1);
+				}
+				else {
+					lo[row] = -K;
+					hi[row] = K + 1;
+				}
+
+				for (long ox = lo[row]; ox < hi[row]; ++ox) {
+					T dx = fx - (ox + T(0.5));
+					T wk = 1;
+					if (key.cutoff == LOGISTIC_CUTOFF || key.DistanceExponent != 0) {
+						T this_r = sqrt(dx*dx + dy2);
+						if (key.DistanceExponent != 0) {
+							//the quantized center can be exactly on a pixel center, which is excluded (its weight would be infinite)
+							wk = (this_r > 0) ? wk / pow(this_r, DistanceExponent) : T(0);
+						}
+						if (key.cutoff == LOGISTIC_CUTOFF) {
+							wk *= T(1.0) / (T(1.0) + exp(CutoffFactor*(this_r - RadiusCutoff)));
+						}
+						else if (key.cutoff == TOPHAT_CUTOFF) {
+							if (this_r > RadiusCutoff) {
+								wk = 0;
+							}
+						}
+					}
+					w[(ox + K) + row*N] = wk;
+				}
+			}
+		}
+	};
+
+	//! statistics of a WeightKernelCache
+	struct WeightKernelCacheStats {
+		size_t hits = 0; //number of windows that used a cached kernel
+		size_t misses = 0; //number of kernels that had to be computed
+		size_t evictions = 0; //number of times the cache was cleared because it exceeded MaxBytes
+		size_t nKernels = 0; //number of kernels currently held
+		size_t bytes = 0; //memory used by the kernels currently held
+
+		double hit_rate() const {
+			return (hits + misses) == 0 ? 0 : double(hits) / double(hits + misses);
+		}
+
+		WeightKernelCacheStats& operator+=(const WeightKernelCacheStats& o) {
+			hits += o.hits;
+			misses += o.misses;
+			evictions += o.evictions;
+			nKernels += o.nKernels;
+			bytes += o.bytes;
+			return *this;
+		}
+	};
+
+	//! Cache of radial weight kernels
+	//! Not thread-safe, each worker thread should use its own cache
+	template<typename T>
+	class WeightKernelCache {
+	protected:
+		std::unordered_map<WeightKernelKey, std::unique_ptr<RadialWeightKernel<T>>, WeightKernelKeyHash> _kernels;
+		WeightKernelCacheStats _stats;
+	public:
+		size_t MaxBytes = size_t(64) << 20; //cache is cleared when it would exceed this size
+
+		//! returns kernel for key, computing it if needed
+		const RadialWeightKernel<T>& get(const WeightKernelKey& key) {
+			auto it = _kernels.find(key);
+			if (it != _kernels.end()) {
+				++_stats.hits;
+				return *(it->second);
+			}
+
+			++_stats.misses;
+			std::unique_ptr<RadialWeightKernel<T>> k(new RadialWeightKernel<T>());
+			k->build(key);
+			if (_stats.bytes + k->bytes() > MaxBytes && !_kernels.empty()) {
+				_kernels.clear();
+				_stats.bytes = 0;
+				++_stats.evictions;
+			}
+			_stats.bytes += k->bytes();
+			const RadialWeightKernel<T>& out = *k;
+			_kernels.emplace(key, std::move(k));
+			return out;
+		}
+
+		WeightKernelCacheStats stats() const {
+			WeightKernelCacheStats s = _stats;
+			s.nKernels = _kernels.size();
+			return s;
+		}
+
+		void clear() {
+			_kernels.clear();
+			_stats = WeightKernelCacheStats();
+		}
+	};
+
+	//! weighted least-squares loop using precomputed distance weights
+	//! (ix,iy) is the pixel containing the (quantized) center guess, which must be inside the window
+	template<int GE, typename T>
+	void weighted_sums_cached_kernel(WeightedSums<T>& s, const RadialWeightKernel<T>& k, long ix, long iy) {
+		using namespace std;
+
+		const size_t dNy = s.dNy;
+		const size_t dNx = s.dNx;
+
+		for (size_t yi = 0; yi < dNy; ++yi) {
+			long oy = (long)yi - iy;
+			if (oy < -k.K || oy > k.K) { //outside of circle
+				continue;
+			}
+			long row = oy + k.K;
+			const long base = row*k.N + k.K - ix; //k.w[base + xi] is weight of pixel xi (base can be negative)
+			T yk = yi + T(0.5); // y coordinate
+
+			size_t xStart = (size_t)max(0L, ix + k.lo[row]);
+			size_t xEnd = (size_t)max(0L, min((long)dNx, ix + k.hi[row]));
+
+			WeightedRowSums<T> rs;
+			for (size_t xi = xStart; xi < xEnd; ++xi) {
+				size_t ind = yi + xi * dNy; //index of pixel at coordinate xi,yi
+				size_t gind = yi + xi * s.gStride; //index of pixel in gradient
+				T xk = xi + T(0.5); //x coordinate
+
+				T sqw_mag; //sqrt(w)/mag
+				T mag; //|grad(I)|
+				T w = k.w[base + (long)xi]; //weight factor
+
+				if (w != 0) { //haven't been excluded by radius filter yet
+					if (!s.calced_grad_mag) {
+						mag = sqrt(s.du[gind] * s.du[gind] + s.dv[gind] * s.dv[gind]);
+					}
+					else {
+						mag = s.GradMag[ind];
+					}
+
+					if (mag == 0) { //special case when gradient was exactly zero (probably rare)
+						sqw_mag = 0;
+						w = 0;
+					}
+					else {
+						w *= int_pow<GE>::eval(mag*s.GradScale, s.GradientExponent); //weight factor;
+						sqw_mag = sqrt(w) / mag;
+					}
+				}
+				else {
+					sqw_mag = 0;
+				}
+
+				const T wx0 = (s.du[gind] + s.dv[gind])*sqw_mag;
+				const T wx1 = (s.dv[gind] - s.du[gind])*sqw_mag;
+				const T wy = xk * wx0 + yk * wx1;
+
+				rs.add(w, wx0, wx1, wy);
+				if (s.residual) {
+					rs.add_residual(wx0, wx1, (xk - s.Xref) * wx0 + (yk - s.Yref) * wx1);
+				}
+			}//end xi loop
+			rs.add_to(s);
+		}//end yi loop
+	}
+
+	//! Compute the weighted least-squares sums using precomputed distance weights
+	//! selects the loop specialized for s.GradientExponent
+	template<typename T>
+	void weighted_sums_cached(WeightedSums<T>& s, const RadialWeightKernel<T>& k, long ix, long iy) {
+		switch (integer_exponent(s.GradientExponent)) {
+		case 0:
+			weighted_sums_cached_kernel<0>(s, k, ix, iy);
+			break;
+		case 1:
+			weighted_sums_cached_kernel<1>(s, k, ix, iy);
+			break;
+		case 2:
+			weighted_sums_cached_kernel<2>(s, k, ix, iy);
+			break;
+		case 4:
+			weighted_sums_cached_kernel<4>(s, k, ix, iy);
+			break;
+		case 5:
+			weighted_sums_cached_kernel<5>(s, k, ix, iy);
+			break;
+		default:
+			weighted_sums_cached_kernel<GENERIC_EXPONENT>(s, k, ix, iy);
+		}
+	}
+}
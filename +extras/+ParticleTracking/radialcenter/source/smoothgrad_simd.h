@@ -0,0 +1,557 @@
+/*--------------------------------------------------
+Copyright 2018-2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+/*
+Fused, vectorized version of rcdefs::smoothgrad()
+
+The reference smoothgrad() computes the Roberts-cross differences into temporary
+images and then calls mean3x3() on each of them (5 passes over the window, 3 allocations).
+smoothgrad_fused() reads the source pixels once per output column, applies the 1x3
+filter on the fly, and then the 3x1 filter on a single column buffer before writing du/dv.
+The order of the floating point operations is the same as the reference implementation,
+so the results are identical to smoothgrad().
+
+uint8 and uint16 images use an integer-domain kernel instead: the differences and the
+3x3 box sums are computed exactly in int16 (uint8) or int32 (uint16) lanes, which hold
+2x (4x) more pixels per vector than double, and each sum is converted to floating point
+and scaled by 1/(number of averaged pixels) only when du/dv are written.
+Because the sums are exact, the result is at least as accurate as smoothgrad(), but it
+can differ from it in the last bits.
+
+SIMD instructions are selected at compile time:
+	__AVX512F__ defined: 8 doubles (16 floats) per vector
+	__AVX2__ defined: 4 doubles (8 floats) per vector
+	otherwise: scalar code
+The int16 lanes of the integer kernel use 512-bit vectors only if __AVX512BW__ is also defined.
+The floating point packs are also used by the fixed-size weight loops (radialcenter_weights.h)
+and by the cross-window lane kernels (radialcenter_lanes.h).
+To enable them use /arch:AVX2 or /arch:AVX512 (MSVC), or -mavx2, -mavx512f, -march=native (gcc/clang)
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace rcdefs { namespace simd {
+
+	//! Thin wrapper around the SIMD vector type holding elements of type T
+	//! Default implementation is scalar (width=1)
+	template<typename T>
+	struct pack {
+		static constexpr size_t width = 1;
+		typedef T value_type;
+		typedef T type;
+
+		static type load(const T* p) { return *p; }
+		static void store(T* p, type v) { *p = v; }
+		static type set1(T v) { return v; }
+		static type add(type a, type b) { return a + b; }
+		static type sub(type a, type b) { return a - b; }
+		static type div(type a, type b) { return a / b; }
+		static type mul(type a, type b) { return a * b; }
+		static type sqrt(type a) { return std::sqrt(a); }
+		//! element-wise maximum (b where either is NaN)
+		static type max(type a, type b) { return a > b ? a : b; }
+
+		//! v where a!=0 (or a is NaN), 0 elsewhere
+		static type keep_nonzero(type v, type a) { return a != 0 ? v : T(0); }
+		//! v where !(a>b), 0 elsewhere
+		static type keep_not_greater(type v, type a, type b) { return a > b ? T(0) : v; }
+
+		//! elements [h*n, (h+1)*n) of v converted to a pack<double> of n elements (h < width/pack<double>::width)
+		static type to_double(type v, size_t) { return v; }
+
+		//! load elements of type M and convert to T
+		template<typename M>
+		static type load_convert(const M* p) { return (T)(*p); }
+	};
+
+#if defined(__AVX512F__)
+	// gcc implements the unmasked sqrt, max, conversion and 256-bit extract/insert intrinsics as masked
+	// builtins that merge into _mm512_undefined_*(), which -Wmaybe-uninitialized reports wherever they are
+	// inlined. The zero-masking forms with all lanes selected are used instead (same instructions).
+	template<>
+	struct pack<double> {
+		static constexpr size_t width = 8;
+		typedef double value_type;
+		typedef __m512d type;
+
+		static type load(const double* p) { return _mm512_loadu_pd(p); }
+		static void store(double* p, type v) { _mm512_storeu_pd(p, v); }
+		static type set1(double v) { return _mm512_set1_pd(v); }
+		static type add(type a, type b) { return _mm512_add_pd(a, b); }
+		static type sub(type a, type b) { return _mm512_sub_pd(a, b); }
+		static type div(type a, type b) { return _mm512_div_pd(a, b); }
+		static type mul(type a, type b) { return _mm512_mul_pd(a, b); }
+		static type sqrt(type a) { return _mm512_maskz_sqrt_pd(0xFF, a); }
+		static type max(type a, type b) { return _mm512_maskz_max_pd(0xFF, a, b); }
+		static type keep_nonzero(type v, type a) { return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_NEQ_UQ), v); }
+		static type keep_not_greater(type v, type a, type b) { return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(a, b, _CMP_NGT_UQ), v); }
+		static type to_double(type v, size_t) { return v; }
+
+		static type load_convert(const double* p) { return _mm512_loadu_pd(p); }
+		static type load_convert(const float* p) { return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(p)); }
+		static type load_convert(const int32_t* p) { return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256((const __m256i*)p)); }
+		static type load_convert(const int16_t* p) { return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+		static type load_convert(const uint16_t* p) { return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+		static type load_convert(const int8_t* p) { return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+		static type load_convert(const uint8_t* p) { return _mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+
+		//! types without a native conversion are converted element-by-element
+		template<typename M>
+		static type load_convert(const M* p) {
+			alignas(64) double tmp[width];
+			for (size_t k = 0; k < width; ++k) {
+				tmp[k] = (double)p[k];
+			}
+			return _mm512_load_pd(tmp);
+		}
+	};
+	template<>
+	struct pack<float> {
+		static constexpr size_t width = 16;
+		typedef float value_type;
+		typedef __m512 type;
+
+		static type load(const float* p) { return _mm512_loadu_ps(p); }
+		static void store(float* p, type v) { _mm512_storeu_ps(p, v); }
+		static type set1(float v) { return _mm512_set1_ps(v); }
+		static type add(type a, type b) { return _mm512_add_ps(a, b); }
+		static type sub(type a, type b) { return _mm512_sub_ps(a, b); }
+		static type div(type a, type b) { return _mm512_div_ps(a, b); }
+		static type mul(type a, type b) { return _mm512_mul_ps(a, b); }
+		static type sqrt(type a) { return _mm512_maskz_sqrt_ps(0xFFFF, a); }
+		static type max(type a, type b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+		static type keep_nonzero(type v, type a) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_NEQ_UQ), v); }
+		static type keep_not_greater(type v, type a, type b) { return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, b, _CMP_NGT_UQ), v); }
+		static __m512d to_double(type v, size_t h) {
+			const __m512d vd = _mm512_castps_pd(v);
+			return _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(h == 0 ? _mm512_maskz_extractf64x4_pd(0xF, vd, 0) : _mm512_maskz_extractf64x4_pd(0xF, vd, 1)));
+		}
+
+		static type load_convert(const float* p) { return _mm512_loadu_ps(p); }
+		static type load_convert(const double* p) {
+			__m256 lo = _mm512_maskz_cvtpd_ps(0xFF, _mm512_loadu_pd(p));
+			__m256 hi = _mm512_maskz_cvtpd_ps(0xFF, _mm512_loadu_pd(p + 8));
+			return _mm512_castpd_ps(_mm512_maskz_insertf64x4(0xFF, _mm512_castpd256_pd512(_mm256_castps_pd(lo)), _mm256_castps_pd(hi), 1));
+		}
+		static type load_convert(const int32_t* p) { return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_loadu_si512((const void*)p)); }
+		static type load_convert(const int16_t* p) { return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_maskz_cvtepi16_epi32(0xFFFF, _mm256_loadu_si256((const __m256i*)p))); }
+		static type load_convert(const uint16_t* p) { return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm256_loadu_si256((const __m256i*)p))); }
+		static type load_convert(const int8_t* p) { return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_maskz_cvtepi8_epi32(0xFFFF, _mm_loadu_si128((const __m128i*)p))); }
+		static type load_convert(const uint8_t* p) { return _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128((const __m128i*)p))); }
+
+		//! types without a native conversion are converted element-by-element
+		template<typename M>
+		static type load_convert(const M* p) {
+			alignas(64) float tmp[width];
+			for (size_t k = 0; k < width; ++k) {
+				tmp[k] = (float)p[k];
+			}
+			return _mm512_load_ps(tmp);
+		}
+	};
+#elif defined(__AVX2__)
+	template<>
+	struct pack<double> {
+		static constexpr size_t width = 4;
+		typedef double value_type;
+		typedef __m256d type;
+
+		static type load(const double* p) { return _mm256_loadu_pd(p); }
+		static void store(double* p, type v) { _mm256_storeu_pd(p, v); }
+		static type set1(double v) { return _mm256_set1_pd(v); }
+		static type add(type a, type b) { return _mm256_add_pd(a, b); }
+		static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+		static type div(type a, type b) { return _mm256_div_pd(a, b); }
+		static type mul(type a, type b) { return _mm256_mul_pd(a, b); }
+		static type sqrt(type a) { return _mm256_sqrt_pd(a); }
+		static type max(type a, type b) { return _mm256_max_pd(a, b); }
+		static type keep_nonzero(type v, type a) { return _mm256_and_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_NEQ_UQ), v); }
+		static type keep_not_greater(type v, type a, type b) { return _mm256_and_pd(_mm256_cmp_pd(a, b, _CMP_NGT_UQ), v); }
+		static type to_double(type v, size_t) { return v; }
+
+		static type load_convert(const double* p) { return _mm256_loadu_pd(p); }
+		static type load_convert(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+		static type load_convert(const int32_t* p) { return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)p)); }
+		static type load_convert(const int16_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+		static type load_convert(const uint16_t* p) { return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+		static type load_convert(const int8_t* p) { int32_t v; std::memcpy(&v, p, 4); return _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(v))); }
+		static type load_convert(const uint8_t* p) { int32_t v; std::memcpy(&v, p, 4); return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(v))); }
+
+		//! types without a native conversion are converted element-by-element
+		template<typename M>
+		static type load_convert(const M* p) {
+			return _mm256_set_pd((double)p[3], (double)p[2], (double)p[1], (double)p[0]);
+		}
+	};
+	template<>
+	struct pack<float> {
+		static constexpr size_t width = 8;
+		typedef float value_type;
+		typedef __m256 type;
+
+		static type load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, type v) { _mm256_storeu_ps(p, v); }
+		static type set1(float v) { return _mm256_set1_ps(v); }
+		static type add(type a, type b) { return _mm256_add_ps(a, b); }
+		static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+		static type div(type a, type b) { return _mm256_div_ps(a, b); }
+		static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+		static type sqrt(type a) { return _mm256_sqrt_ps(a); }
+		static type max(type a, type b) { return _mm256_max_ps(a, b); }
+		static type keep_nonzero(type v, type a) { return _mm256_and_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_UQ), v); }
+		static type keep_not_greater(type v, type a, type b) { return _mm256_and_ps(_mm256_cmp_ps(a, b, _CMP_NGT_UQ), v); }
+		static __m256d to_double(type v, size_t h) { return _mm256_cvtps_pd(h == 0 ? _mm256_castps256_ps128(v) : _mm256_extractf128_ps(v, 1)); }
+
+		static type load_convert(const float* p) { return _mm256_loadu_ps(p); }
+		static type load_convert(const double* p) { return _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(p + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(p))); }
+		static type load_convert(const int32_t* p) { return _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)p)); }
+		static type load_convert(const int16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+		static type load_convert(const uint16_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+		static type load_convert(const int8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+		static type load_convert(const uint8_t* p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+
+		//! types without a native conversion are converted element-by-element
+		template<typename M>
+		static type load_convert(const M* p) {
+			return _mm256_set_ps((float)p[7], (float)p[6], (float)p[5], (float)p[4], (float)p[3], (float)p[2], (float)p[1], (float)p[0]);
+		}
+	};
+#endif
+
+	//! Integer SIMD lanes used by the integer-domain gradient of uint8 and uint16 images
+	//! I is the lane type: int16_t (uint8 images) or int32_t (uint16 images)
+	//! Default implementation is scalar (width=1)
+	template<typename I>
+	struct ipack {
+		static constexpr size_t width = 1;
+		typedef I value_type;
+		typedef I type;
+
+		static void store(I* p, type v) { *p = v; }
+		static type load(const I* p) { return *p; }
+		static type add(type a, type b) { return a + b; }
+		static type sub(type a, type b) { return a - b; }
+
+		//! load unsigned pixels and widen them to I
+		template<typename M>
+		static type load_widen(const M* p) { return (I)(*p); }
+	};
+
+#if defined(__AVX512F__)
+	template<>
+	struct ipack<int32_t> {
+		static constexpr size_t width = 16;
+		typedef int32_t value_type;
+		typedef __m512i type;
+
+		static void store(int32_t* p, type v) { _mm512_storeu_si512((void*)p, v); }
+		static type load(const int32_t* p) { return _mm512_loadu_si512((const void*)p); }
+		static type add(type a, type b) { return _mm512_add_epi32(a, b); }
+		static type sub(type a, type b) { return _mm512_sub_epi32(a, b); }
+
+		static type load_widen(const uint16_t* p) { return _mm512_maskz_cvtepu16_epi32(0xFFFF, _mm256_loadu_si256((const __m256i*)p)); }
+		static type load_widen(const uint8_t* p) { return _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128((const __m128i*)p)); }
+	};
+#elif defined(__AVX2__)
+	template<>
+	struct ipack<int32_t> {
+		static constexpr size_t width = 8;
+		typedef int32_t value_type;
+		typedef __m256i type;
+
+		static void store(int32_t* p, type v) { _mm256_storeu_si256((__m256i*)p, v); }
+		static type load(const int32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		static type add(type a, type b) { return _mm256_add_epi32(a, b); }
+		static type sub(type a, type b) { return _mm256_sub_epi32(a, b); }
+
+		static type load_widen(const uint16_t* p) { return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)); }
+		static type load_widen(const uint8_t* p) { return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)); }
+	};
+#endif
+
+#if defined(__AVX512BW__)
+	template<>
+	struct ipack<int16_t> {
+		static constexpr size_t width = 32;
+		typedef int16_t value_type;
+		typedef __m512i type;
+
+		static void store(int16_t* p, type v) { _mm512_storeu_si512((void*)p, v); }
+		static type load(const int16_t* p) { return _mm512_loadu_si512((const void*)p); }
+		static type add(type a, type b) { return _mm512_add_epi16(a, b); }
+		static type sub(type a, type b) { return _mm512_sub_epi16(a, b); }
+
+		static type load_widen(const uint8_t* p) { return _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)p)); }
+	};
+#elif defined(__AVX2__)
+	template<>
+	struct ipack<int16_t> {
+		static constexpr size_t width = 16;
+		typedef int16_t value_type;
+		typedef __m256i type;
+
+		static void store(int16_t* p, type v) { _mm256_storeu_si256((__m256i*)p, v); }
+		static type load(const int16_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		static type add(type a, type b) { return _mm256_add_epi16(a, b); }
+		static type sub(type a, type b) { return _mm256_sub_epi16(a, b); }
+
+		static type load_widen(const uint8_t* p) { return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p)); }
+	};
+#endif
+
+	//! Integer lane type that holds the 3x3 sums of the differences of M pixels without overflow
+	//! (9*255 fits in int16, 9*65535 needs int32)
+	template<typename M> struct int_lane;
+	template<> struct int_lane<uint8_t> { typedef int16_t type; };
+	template<> struct int_lane<uint16_t> { typedef int32_t type; };
+
+}}
+
+namespace rcdefs {
+
+	// Apply 1x3 mean to the finite differences of column x of the window
+	// the differences are computed directly from the source pixels:
+	//		tu(y,x) = I(y+1,x+1) - I(y,x)
+	//		tv(y,x) = I(y+1,x) - I(y,x+1)
+	// Results are stored in hu[0...dNy-1] and hv[0...dNy-1]
+	// Edges are handled the same way as mean3x3() (first and last column average 2 elements)
+	template<typename M, class P>
+	inline void smoothgrad_fused_hpass(const M* I, size_t stride, size_t dNy, size_t dNx, size_t x, typename P::value_type* hu, typename P::value_type* hv) {
+		using T = typename P::type;
+		using V = typename P::value_type;
+		const size_t W = P::width;
+
+		const M* c0 = (x > 0) ? I + (x - 1)*stride : nullptr; //column x-1
+		const M* c1 = I + x * stride; //column x
+		const M* c2 = I + (x + 1)*stride; //column x+1
+		const M* c3 = (x + 2 <= dNx) ? I + (x + 2)*stride : nullptr; //column x+2 (exists if x+1<dNx)
+
+		const T two = P::set1(V(2.0));
+		const T three = P::set1(V(3.0));
+
+		size_t y = 0;
+		if (x == 0) { //first column: average tu(x), tu(x+1)
+			for (; y + W <= dNy; y += W) {
+				T a1 = P::load_convert(c1 + y), a2 = P::load_convert(c2 + y), a3 = P::load_convert(c3 + y);
+				T b1 = P::load_convert(c1 + y + 1), b2 = P::load_convert(c2 + y + 1), b3 = P::load_convert(c3 + y + 1);
+				P::store(hu + y, P::div(P::add(P::sub(b2, a1), P::sub(b3, a2)), two));
+				P::store(hv + y, P::div(P::add(P::sub(b1, a2), P::sub(b2, a3)), two));
+			}
+			for (; y < dNy; ++y) {
+				hu[y] = (((V)c2[y + 1] - (V)c1[y]) + ((V)c3[y + 1] - (V)c2[y])) / V(2.0);
+				hv[y] = (((V)c1[y + 1] - (V)c2[y]) + ((V)c2[y + 1] - (V)c3[y])) / V(2.0);
+			}
+		}
+		else if (x == dNx - 1) { //last column: average tu(x-1), tu(x)
+			for (; y + W <= dNy; y += W) {
+				T a0 = P::load_convert(c0 + y), a1 = P::load_convert(c1 + y), a2 = P::load_convert(c2 + y);
+				T b0 = P::load_convert(c0 + y + 1), b1 = P::load_convert(c1 + y + 1), b2 = P::load_convert(c2 + y + 1);
+				P::store(hu + y, P::div(P::add(P::sub(b1, a0), P::sub(b2, a1)), two));
+				P::store(hv + y, P::div(P::add(P::sub(b0, a1), P::sub(b1, a2)), two));
+			}
+			for (; y < dNy; ++y) {
+				hu[y] = (((V)c1[y + 1] - (V)c0[y]) + ((V)c2[y + 1] - (V)c1[y])) / V(2.0);
+				hv[y] = (((V)c0[y + 1] - (V)c1[y]) + ((V)c1[y + 1] - (V)c2[y])) / V(2.0);
+			}
+		}
+		else { //middle columns: average tu(x-1), tu(x), tu(x+1)
+			for (; y + W <= dNy; y += W) {
+				T a0 = P::load_convert(c0 + y), a1 = P::load_convert(c1 + y), a2 = P::load_convert(c2 + y), a3 = P::load_convert(c3 + y);
+				T b0 = P::load_convert(c0 + y + 1), b1 = P::load_convert(c1 + y + 1), b2 = P::load_convert(c2 + y + 1), b3 = P::load_convert(c3 + y + 1);
+				P::store(hu + y, P::div(P::add(P::add(P::sub(b1, a0), P::sub(b2, a1)), P::sub(b3, a2)), three));
+				P::store(hv + y, P::div(P::add(P::add(P::sub(b0, a1), P::sub(b1, a2)), P::sub(b2, a3)), three));
+			}
+			for (; y < dNy; ++y) {
+				hu[y] = (((V)c1[y + 1] - (V)c0[y]) + ((V)c2[y + 1] - (V)c1[y]) + ((V)c3[y + 1] - (V)c2[y])) / V(3.0);
+				hv[y] = (((V)c0[y + 1] - (V)c1[y]) + ((V)c1[y + 1] - (V)c2[y]) + ((V)c2[y + 1] - (V)c3[y])) / V(3.0);
+			}
+		}
+	}
+
+	// Apply 3x1 mean to column h (length dNy) and store in O
+	// Edges are handled the same way as mean3x3() (first and last row average 2 elements)
+	template<class P>
+	inline void smoothgrad_fused_vpass(const typename P::value_type* h, size_t dNy, typename P::value_type* O) {
+		using T = typename P::type;
+		using V = typename P::value_type;
+		const size_t W = P::width;
+		const T three = P::set1(V(3.0));
+
+		O[0] = (h[0] + h[1]) / V(2.0);
+
+		size_t y = 1;
+		for (; y + W <= dNy - 1; y += W) {
+			P::store(O + y, P::div(P::add(P::add(P::load(h + y - 1), P::load(h + y)), P::load(h + y + 1)), three));
+		}
+		for (; y < dNy - 1; ++y) {
+			O[y] = (h[y - 1] + h[y] + h[y + 1]) / V(3.0);
+		}
+
+		O[dNy - 1] = (h[dNy - 2] + h[dNy - 1]) / V(2.0);
+	}
+
+	// Calculate columns [x0,x1) of the 3x3-smoothed image gradient of a dNy x dNx window
+	// Columns are independent, so disjoint column ranges of the same window can be computed concurrently
+	// I is colum-major data pointing to I[y1+x1*stride]
+	// du and dv should point to pre-allocated arrays of size dNy x dNx (the whole window)
+	// colbuf is a buffer with space for 2*dNy elements of type T
+	// The window must be at least 2x2 (dNy>=2, dNx>=2)
+	template<typename M, typename T>
+	void smoothgrad_fused_columns(const M *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, size_t x0, size_t x1, T* colbuf) {
+		typedef simd::pack<T> P;
+
+		T* hu = colbuf;
+		T* hv = colbuf + dNy;
+
+		for (size_t x = x0; x < x1; ++x) {
+			smoothgrad_fused_hpass<M, P>(I, stride, dNy, dNx, x, hu, hv);
+			smoothgrad_fused_vpass<P>(hu, dNy, du + x * dNy);
+			smoothgrad_fused_vpass<P>(hv, dNy, dv + x * dNy);
+		}
+	}
+
+	// Integer version of smoothgrad_fused_hpass() used for uint8 and uint16 images
+	// Sums (rather than averages) the finite differences of columns xa...xb (x-1...x+1, except at the edges) exactly.
+	// With the row sums A(y) = sum_{k=xa}^{xb} I(y,k) and B(y) = sum_{k=xa+1}^{xb+1} I(y,k):
+	//		hu(y) = B(y+1) - A(y)
+	//		hv(y) = A(y+1) - B(y)
+	// so each pixel is loaded once per row (instead of once per difference)
+	// Results are stored in hu[0...dNy-1] and hv[0...dNy-1]
+	template<typename M, class IP>
+	inline void smoothgrad_int_hpass(const M* I, size_t stride, size_t dNy, size_t dNx, size_t x, typename IP::value_type* hu, typename IP::value_type* hv) {
+		using L = typename IP::type;
+		using V = typename IP::value_type;
+		const size_t W = IP::width;
+
+		// first and last column only sum two differences (same as smoothgrad_fused_hpass)
+		const size_t xa = (x > 0) ? x - 1 : 0; //first column of differences
+		const size_t xb = (x + 1 < dNx) ? x + 1 : x; //last column of differences
+
+		const M* ca = I + xa*stride; //only in A
+		const M* c1 = ca + stride; //in A and B
+		const M* c2 = c1 + stride; //in A and B (middle columns only)
+		const M* cb = I + (xb + 1)*stride; //only in B
+
+		size_t y = 0;
+		if (xb - xa == 2) { //middle columns
+			for (; y + W <= dNy; y += W) {
+				L s0 = IP::add(IP::load_widen(c1 + y), IP::load_widen(c2 + y));
+				L s1 = IP::add(IP::load_widen(c1 + y + 1), IP::load_widen(c2 + y + 1));
+				IP::store(hu + y, IP::sub(IP::add(s1, IP::load_widen(cb + y + 1)), IP::add(s0, IP::load_widen(ca + y))));
+				IP::store(hv + y, IP::sub(IP::add(s1, IP::load_widen(ca + y + 1)), IP::add(s0, IP::load_widen(cb + y))));
+			}
+		}
+		else { //first and last column
+			for (; y + W <= dNy; y += W) {
+				L s0 = IP::load_widen(c1 + y);
+				L s1 = IP::load_widen(c1 + y + 1);
+				IP::store(hu + y, IP::sub(IP::add(s1, IP::load_widen(cb + y + 1)), IP::add(s0, IP::load_widen(ca + y))));
+				IP::store(hv + y, IP::sub(IP::add(s1, IP::load_widen(ca + y + 1)), IP::add(s0, IP::load_widen(cb + y))));
+			}
+		}
+		for (; y < dNy; ++y) {
+			V A0 = 0, A1 = 0, B0 = 0, B1 = 0;
+			for (size_t k = xa; k <= xb; ++k) {
+				A0 += V(I[k*stride + y]);
+				A1 += V(I[k*stride + y + 1]);
+				B0 += V(I[(k + 1)*stride + y]);
+				B1 += V(I[(k + 1)*stride + y + 1]);
+			}
+			hu[y] = B1 - A0;
+			hv[y] = A1 - B0;
+		}
+	}
+
+	// Integer version of smoothgrad_fused_vpass()
+	// Sums rows y-1...y+1 of h in integer lanes, then converts the sums to T and scales them by
+	// 1/(number of averaged differences) (nh differences per row, 3 rows, 2 on the first and last row)
+	template<class IP, class P>
+	inline void smoothgrad_int_vpass(const typename IP::value_type* h, size_t dNy, typename P::value_type nh, typename P::value_type* O) {
+		using V = typename IP::value_type;
+		using T = typename P::value_type;
+		const size_t W = IP::width;
+		static_assert(IP::width % P::width == 0, "integer lanes must hold a whole number of floating point vectors");
+		const typename P::type scale = P::set1(T(1.0) / (T(3.0)*nh));
+
+		O[0] = T(h[0] + h[1]) / (T(2.0)*nh);
+
+		alignas(64) V sum[W]; //integer sums of one vector, converted to T in P::width blocks
+		size_t y = 1;
+		for (; y + W <= dNy - 1; y += W) {
+			IP::store(sum, IP::add(IP::add(IP::load(h + y - 1), IP::load(h + y)), IP::load(h + y + 1)));
+			for (size_t k = 0; k < W; k += P::width) {
+				P::store(O + y + k, P::mul(P::load_convert(sum + k), scale));
+			}
+		}
+		for (; y < dNy - 1; ++y) {
+			O[y] = T(h[y - 1] + h[y] + h[y + 1]) / (T(3.0)*nh);
+		}
+
+		O[dNy - 1] = T(h[dNy - 2] + h[dNy - 1]) / (T(2.0)*nh);
+	}
+
+	// Integer-domain smoothgrad_fused_columns() for unsigned 8 and 16 bit images
+	// colbuf (2*dNy elements of T) holds the integer column sums
+	template<typename M, typename T>
+	void smoothgrad_int_columns(const M *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, size_t x0, size_t x1, T* colbuf) {
+		typedef typename simd::int_lane<M>::type L;
+		typedef simd::ipack<L> IP;
+		typedef simd::pack<T> P;
+		static_assert(sizeof(L) <= sizeof(T), "colbuf is too small for the integer column sums");
+
+		L* hu = reinterpret_cast<L*>(colbuf);
+		L* hv = hu + dNy;
+
+		for (size_t x = x0; x < x1; ++x) {
+			const T nh = (x == 0 || x == dNx - 1) ? T(2.0) : T(3.0); //number of differences summed by the hpass
+			smoothgrad_int_hpass<M, IP>(I, stride, dNy, dNx, x, hu, hv);
+			smoothgrad_int_vpass<IP, P>(hu, dNy, nh, du + x * dNy);
+			smoothgrad_int_vpass<IP, P>(hv, dNy, nh, dv + x * dNy);
+		}
+	}
+
+	// uint8 and uint16 images use the integer-domain kernel
+	template<typename T>
+	void smoothgrad_fused_columns(const uint8_t *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, size_t x0, size_t x1, T* colbuf) {
+		smoothgrad_int_columns(I, stride, du, dv, dNy, dNx, x0, x1, colbuf);
+	}
+	template<typename T>
+	void smoothgrad_fused_columns(const uint16_t *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, size_t x0, size_t x1, T* colbuf) {
+		smoothgrad_int_columns(I, stride, du, dv, dNy, dNx, x0, x1, colbuf);
+	}
+
+	// Calculate 3x3-smoothed image gradient in a single pass over the source image
+	// Produces the same output as smoothgrad() (up to rounding for uint8 and uint16 images)
+	// I is colum-major data pointing to I[y1+x1*stride]
+	// du and dv should point to pre-allocated arrays of size dNy x dNx
+	// T is the compute type (double or float) of du and dv
+	// colbuf is an optional buffer with space for 2*dNy elements of type T. If nullptr the buffer is allocated internally.
+	// The window must be at least 2x2 (dNy>=2, dNx>=2)
+	template<typename M, typename T>
+	void smoothgrad_fused(const M *I, size_t stride, T *du, T * dv, size_t dNy, size_t dNx, T* colbuf = nullptr) {
+		bool free_colbuf = (colbuf == nullptr);
+		if (free_colbuf) {
+			colbuf = (T*)std::malloc(2 * dNy * sizeof(T));
+			if (colbuf == nullptr) {
+				throw std::bad_alloc();
+			}
+		}
+
+		smoothgrad_fused_columns(I, stride, du, dv, dNy, dNx, 0, dNx, colbuf);
+
+		if (free_colbuf) {
+			std::free(colbuf);
+		}
+	}
+}
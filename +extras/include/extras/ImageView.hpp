@@ -0,0 +1,111 @@
+/*--------------------------------------------------
+Copyright 2019, Daniel T. Kovari, Emory University
+All rights reserved.
+----------------------------------------------------*/
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace extras {
+
+	/// Memory layout policies for ImageView
+	/// ColumnMajor: pixel (y,x) is located at data[y + x*stride] (MATLAB arrays)
+	struct ColumnMajor {
+		static size_t index(size_t y, size_t x, size_t stride) {
+			return y + x*stride;
+		}
+		/// number of pixels in each contiguous line (a column)
+		static size_t line_length(size_t nRows, size_t) {
+			return nRows;
+		}
+	};
+
+	/// RowMajor: pixel (y,x) is located at data[x + y*stride] (camera buffers and most image files)
+	struct RowMajor {
+		static size_t index(size_t y, size_t x, size_t stride) {
+			return x + y*stride;
+		}
+		/// number of pixels in each contiguous line (a row)
+		static size_t line_length(size_t, size_t nCols) {
+			return nCols;
+		}
+	};
+
+	/// Layout of the transpose of an image with layout L
+	template<typename L> struct TransposedLayout;
+	template<> struct TransposedLayout<ColumnMajor> { typedef RowMajor type; };
+	template<> struct TransposedLayout<RowMajor> { typedef ColumnMajor type; };
+
+	/// Non-owning view of an image stored somewhere in memory
+	/// Layout is the memory layout policy (ColumnMajor or RowMajor).
+	/// Pixels within a line (a column for ColumnMajor, a row for RowMajor) must be contiguous, but the lines
+	/// may be padded (stride>line length), which allows a view to refer to a sub-region of a larger image
+	/// or to a buffer with a padded pitch without copying the data.
+	/// Regardless of layout, y is the row and x is the column of a pixel.
+	/// The view does not manage the memory; the data must outlive the view.
+	template<typename M, typename Layout = ColumnMajor>
+	struct ImageView {
+		typedef Layout layout_type;
+
+		const M* data = nullptr; //pointer to pixel (0,0) of the view
+		size_t nRows = 0; //height of the view
+		size_t nCols = 0; //width of the view
+		size_t stride = 0; //distance (in elements) between the start of adjacent lines (columns or rows)
+
+		ImageView() = default;
+
+		/// construct view of image data
+		/// stride=0 (default) means the lines are packed
+		ImageView(const M* data, size_t nRows, size_t nCols, size_t stride = 0) :
+			data(data),
+			nRows(nRows),
+			nCols(nCols),
+			stride(stride == 0 ? Layout::line_length(nRows, nCols) : stride)
+		{
+			if (this->stride < Layout::line_length(nRows, nCols)) {
+				throw(std::runtime_error("ImageView: stride must be >= the length of each line"));
+			}
+		}
+
+		/// pixel (y,x)
+		const M& operator()(size_t y, size_t x) const {
+			return data[Layout::index(y, x, stride)];
+		}
+
+		/// pointer to pixel (y,x)
+		const M* ptr(size_t y, size_t x) const {
+			return data + Layout::index(y, x, stride);
+		}
+
+		/// true if the pixels are stored without padding
+		bool isdense() const {
+			return stride == Layout::line_length(nRows, nCols);
+		}
+
+		/// view of the sub-region starting at (y0,x0) with the size nRows x nCols
+		/// the data are not copied; the sub-view shares the parent's stride
+		ImageView subview(size_t y0, size_t x0, size_t nRows, size_t nCols) const {
+			if (y0 + nRows > this->nRows || x0 + nCols > this->nCols) {
+				throw(std::runtime_error("ImageView::subview(): region extends beyond the image"));
+			}
+			ImageView out;
+			out.data = ptr(y0, x0);
+			out.nRows = nRows;
+			out.nCols = nCols;
+			out.stride = stride;
+			return out;
+		}
+
+		/// view of the transposed image (the same memory, interpreted with the opposite layout)
+		/// pixel (y,x) of the transpose is pixel (x,y) of this view
+		ImageView<M, typename TransposedLayout<Layout>::type> transposed() const {
+			ImageView<M, typename TransposedLayout<Layout>::type> out;
+			out.data = data;
+			out.nRows = nCols;
+			out.nCols = nRows;
+			out.stride = stride;
+			return out;
+		}
+	};
+}